@@ -0,0 +1,305 @@
+#include "QDiffCliWriter.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <algorithm>
+
+namespace QDiffX{
+
+namespace {
+
+// One line of a unified diff: ' ' context, '-' left only, '+' right only
+struct LineOp {
+    char kind;
+    QString text;
+    bool newline;
+};
+
+// Results whose changes are whole lines without '\n' (DTL); the final empty
+// element of a side stands for the newline that ends its text
+QList<LineOp> lineOpsFromLines(const QList<DiffChange> &changes)
+{
+    int lastLeft = -1, lastRight = -1;
+    for (int i = 0; i < changes.size(); ++i) {
+        if (changes[i].operation != DiffOperation::Insert) lastLeft = i;
+        if (changes[i].operation != DiffOperation::Delete) lastRight = i;
+    }
+
+    QList<LineOp> ops;
+    for (int i = 0; i < changes.size(); ++i) {
+        const DiffChange &change = changes[i];
+        bool inLeft = change.operation != DiffOperation::Insert;
+        bool inRight = change.operation != DiffOperation::Delete;
+        bool leftNewline = true, rightNewline = true;
+        if (i == lastLeft) {
+            if (change.text.isEmpty()) inLeft = false;
+            else leftNewline = false;
+        }
+        if (i == lastRight) {
+            if (change.text.isEmpty()) inRight = false;
+            else rightNewline = false;
+        }
+
+        if (inLeft && inRight && leftNewline == rightNewline) {
+            ops.append(LineOp{' ', change.text, leftNewline});
+        } else {
+            if (inLeft) ops.append(LineOp{'-', change.text, leftNewline});
+            if (inRight) ops.append(LineOp{'+', change.text, rightNewline});
+        }
+    }
+    return ops;
+}
+
+// Results made of arbitrary text chunks (DMP, LCS). A line is context only when
+// neither side's copy was touched by a change; otherwise it is collected into
+// the pending removed/added block, which is flushed before the next context line
+QList<LineOp> lineOpsFromChunks(const QList<DiffChange> &changes)
+{
+    QList<LineOp> ops, removed, added;
+    QString leftLine, rightLine;
+    bool leftChanged = false, rightChanged = false;
+    auto flush = [&]() {
+        ops.append(removed);
+        ops.append(added);
+        removed.clear();
+        added.clear();
+    };
+
+    for (const DiffChange &change : changes) {
+        const QStringList pieces = change.text.split('\n');
+        for (int j = 0; j < pieces.size(); ++j) {
+            if (j > 0) {
+                switch (change.operation) {
+                case DiffOperation::Delete:
+                    removed.append(LineOp{'-', leftLine, true});
+                    leftLine.clear();
+                    leftChanged = false;
+                    if (!rightLine.isEmpty()) rightChanged = true;
+                    break;
+                case DiffOperation::Insert:
+                    added.append(LineOp{'+', rightLine, true});
+                    rightLine.clear();
+                    rightChanged = false;
+                    if (!leftLine.isEmpty()) leftChanged = true;
+                    break;
+                default:
+                    if (!leftChanged && !rightChanged) {
+                        flush();
+                        ops.append(LineOp{' ', leftLine, true});
+                    } else {
+                        removed.append(LineOp{'-', leftLine, true});
+                        added.append(LineOp{'+', rightLine, true});
+                    }
+                    leftLine.clear();
+                    rightLine.clear();
+                    leftChanged = rightChanged = false;
+                    break;
+                }
+            }
+            const QString &piece = pieces[j];
+            if (change.operation != DiffOperation::Insert) {
+                leftLine += piece;
+                if (change.operation != DiffOperation::Equal && !piece.isEmpty()) leftChanged = true;
+            }
+            if (change.operation != DiffOperation::Delete) {
+                rightLine += piece;
+                if (change.operation != DiffOperation::Equal && !piece.isEmpty()) rightChanged = true;
+            }
+        }
+    }
+
+    // Last lines without a trailing newline
+    if (!leftChanged && !rightChanged && !leftLine.isEmpty() && leftLine == rightLine) {
+        flush();
+        ops.append(LineOp{' ', leftLine, false});
+    } else {
+        if (!leftLine.isEmpty()) removed.append(LineOp{'-', leftLine, false});
+        if (!rightLine.isEmpty()) added.append(LineOp{'+', rightLine, false});
+    }
+    flush();
+    return ops;
+}
+
+QString hunkRange(int start, int count)
+{
+    // GNU diff: an empty range names the line before it, a single line omits the count
+    if (count == 1)
+        return QString::number(start + 1);
+    return QStringLiteral("%1,%2").arg(count == 0 ? start : start + 1).arg(count);
+}
+
+QString operationName(DiffOperation operation)
+{
+    switch (operation) {
+    case DiffOperation::Insert:
+        return QStringLiteral("insert");
+    case DiffOperation::Delete:
+        return QStringLiteral("delete");
+    case DiffOperation::Replace:
+        return QStringLiteral("replace");
+    case DiffOperation::Equal:
+    default:
+        return QStringLiteral("equal");
+    }
+}
+
+} // namespace
+
+QDiffCliWriter::QDiffCliWriter(QIODevice *device, QDiffCliFormat format, int contextLines)
+    : m_device(device), m_stream(device), m_format(format), m_contextLines(qMax(0, contextLines))
+{
+    m_stream.setVersion(QDataStream::Qt_6_0);
+}
+
+void QDiffCliWriter::begin()
+{
+    if (m_format == QDiffCliFormat::Binary)
+        m_stream << BINARY_MAGIC << BINARY_VERSION;
+}
+
+void QDiffCliWriter::end()
+{
+    if (m_format == QDiffCliFormat::Binary)
+        m_stream << quint32(0xFFFFFFFF);
+}
+
+bool QDiffCliWriter::hasDifferences(const QDiffResult &result)
+{
+    const QList<DiffChange> changes = result.changes();
+    return std::any_of(changes.cbegin(), changes.cend(), [](const DiffChange &change) {
+        return change.operation != DiffOperation::Equal;
+    });
+}
+
+void QDiffCliWriter::writePair(int index, const QString &leftName, const QString &rightName, const QDiffResult &result)
+{
+    switch (m_format) {
+    case QDiffCliFormat::Json:
+        writeJson(index, leftName, rightName, result);
+        break;
+    case QDiffCliFormat::Binary:
+        writeBinary(index, leftName, rightName, result, false);
+        break;
+    case QDiffCliFormat::Unified:
+    default:
+        writeUnified(leftName, rightName, result);
+        break;
+    }
+}
+
+void QDiffCliWriter::writeBinaryFiles(int index, const QString &leftName, const QString &rightName)
+{
+    switch (m_format) {
+    case QDiffCliFormat::Json: {
+        QJsonObject object;
+        object["index"] = index;
+        object["left"] = leftName;
+        object["right"] = rightName;
+        object["binary"] = true;
+        m_device->write(QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n');
+        break;
+    }
+    case QDiffCliFormat::Binary:
+        writeBinary(index, leftName, rightName, QDiffResult(), true);
+        break;
+    case QDiffCliFormat::Unified:
+    default:
+        m_device->write(QStringLiteral("Binary files %1 and %2 differ\n").arg(leftName, rightName).toUtf8());
+        break;
+    }
+}
+
+// ----------------------- Formats -------------------------
+
+void QDiffCliWriter::writeUnified(const QString &leftName, const QString &rightName, const QDiffResult &result)
+{
+    if (!result.success()) {
+        m_device->write(QStringLiteral("qdiffx: %1 %2: %3\n").arg(leftName, rightName, result.errorMessage()).toUtf8());
+        return;
+    }
+
+    const QList<LineOp> ops = result.metaData("line_separated").toBool()
+                                  ? lineOpsFromLines(result.changes())
+                                  : lineOpsFromChunks(result.changes());
+    QList<int> changed;
+    for (int i = 0; i < ops.size(); ++i) {
+        if (ops[i].kind != ' ')
+            changed.append(i);
+    }
+    if (changed.isEmpty())
+        return;
+
+    // Line numbers before every op, so hunk headers are a lookup
+    QList<int> leftBefore(ops.size() + 1), rightBefore(ops.size() + 1);
+    for (int i = 0; i < ops.size(); ++i) {
+        leftBefore[i + 1] = leftBefore[i] + (ops[i].kind != '+' ? 1 : 0);
+        rightBefore[i + 1] = rightBefore[i] + (ops[i].kind != '-' ? 1 : 0);
+    }
+
+    QString out;
+    out += QStringLiteral("--- %1\n+++ %2\n").arg(leftName, rightName);
+    int first = 0;
+    while (first < changed.size()) {
+        // Changes closer than two contexts share a hunk
+        int last = first;
+        while (last + 1 < changed.size() && changed[last + 1] - changed[last] <= 2 * m_contextLines + 1)
+            ++last;
+        const int begin = qMax(0, changed[first] - m_contextLines);
+        const int end = qMin(int(ops.size()), changed[last] + m_contextLines + 1);
+
+        out += QStringLiteral("@@ -%1 +%2 @@\n")
+                   .arg(hunkRange(leftBefore[begin], leftBefore[end] - leftBefore[begin]),
+                        hunkRange(rightBefore[begin], rightBefore[end] - rightBefore[begin]));
+        for (int i = begin; i < end; ++i) {
+            out += QChar::fromLatin1(ops[i].kind);
+            out += ops[i].text;
+            out += '\n';
+            if (!ops[i].newline)
+                out += QStringLiteral("\\ No newline at end of file\n");
+        }
+        first = last + 1;
+    }
+    m_device->write(out.toUtf8());
+}
+
+void QDiffCliWriter::writeJson(int index, const QString &leftName, const QString &rightName, const QDiffResult &result)
+{
+    QJsonObject object;
+    object["index"] = index;
+    object["left"] = leftName;
+    object["right"] = rightName;
+    object["success"] = result.success();
+    if (!result.success()) {
+        object["error"] = result.errorMessage();
+    } else {
+        QJsonArray changes;
+        for (const DiffChange &change : result.changes()) {
+            QJsonObject item;
+            item["op"] = operationName(change.operation);
+            item["text"] = change.text;
+            item["line"] = change.lineNumber;
+            item["position"] = change.position;
+            changes.append(item);
+        }
+        object["changes"] = changes;
+        object["metadata"] = QJsonObject::fromVariantMap(result.allMetaData());
+    }
+    m_device->write(QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void QDiffCliWriter::writeBinary(int index, const QString &leftName, const QString &rightName,
+                                 const QDiffResult &result, bool binaryFiles)
+{
+    quint8 flags = 0;
+    if (result.success()) flags |= 1;
+    if (binaryFiles) flags |= 2;
+
+    const QList<DiffChange> changes = result.changes();
+    m_stream << quint32(index) << leftName << rightName << flags
+             << result.metaData("algorithm").toString() << quint32(changes.size());
+    for (const DiffChange &change : changes)
+        m_stream << quint8(change.operation) << change.text;
+}
+
+}//namespace QDiffX
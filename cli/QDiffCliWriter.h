@@ -0,0 +1,51 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <QString>
+
+namespace QDiffX{
+
+enum class QDiffCliFormat {
+    Unified,        // GNU style unified diff
+    Json,           // One JSON object per pair and line (JSON Lines)
+    Binary          // Compact QDataStream records, see QDiffCliWriter
+};
+
+// Writes diff results of qdiffx-cli in one of the output formats.
+//
+// Binary layout (QDataStream, Qt_6_0, big endian):
+//   header:  quint32 BINARY_MAGIC, quint8 BINARY_VERSION
+//   record:  quint32 pair index, QString left name, QString right name,
+//            quint8 flags (1 = success, 2 = binary files),
+//            QString algorithm, quint32 change count,
+//            per change: quint8 DiffOperation, QString text
+//   trailer: quint32 0xFFFFFFFF
+class QDiffCliWriter
+{
+public:
+    QDiffCliWriter(QIODevice *device, QDiffCliFormat format, int contextLines = 3);
+
+    void begin();
+    void writePair(int index, const QString &leftName, const QString &rightName, const QDiffResult &result);
+    void writeBinaryFiles(int index, const QString &leftName, const QString &rightName);
+    void end();
+
+    static bool hasDifferences(const QDiffResult &result);
+
+    static constexpr quint32 BINARY_MAGIC = 0x51445842;    // "QDXB"
+    static constexpr quint8 BINARY_VERSION = 1;
+
+private:
+    void writeUnified(const QString &leftName, const QString &rightName, const QDiffResult &result);
+    void writeJson(int index, const QString &leftName, const QString &rightName, const QDiffResult &result);
+    void writeBinary(int index, const QString &leftName, const QString &rightName, const QDiffResult &result, bool binaryFiles);
+
+private:
+    QIODevice *m_device;
+    QDataStream m_stream;
+    QDiffCliFormat m_format;
+    int m_contextLines;
+};
+
+}//namespace QDiffX
@@ -0,0 +1,276 @@
+#include "QDiffDaemon.h"
+#include "QDiffDaemonProtocol.h"
+#include "QAlgorithmRegistry.h"
+#include <QCryptographicHash>
+#include <QFutureWatcher>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+namespace QDiffX{
+
+namespace {
+
+// Rough footprint of a cached result, the cache cost unit
+qint64 resultCost(const QDiffResult &result)
+{
+    qint64 cost = 64;
+    for (const DiffChange &change : result.changes())
+        cost += 32 + change.text.size() * qint64(sizeof(QChar));
+    return cost;
+}
+
+QByteArrayView utf16Bytes(const QString &text)
+{
+    return QByteArrayView(reinterpret_cast<const char *>(text.constData()), text.size() * qsizetype(sizeof(QChar)));
+}
+
+} // namespace
+
+QDiffDaemon::QDiffDaemon(QObject *parent)
+    : QObject(parent), m_server(new QLocalServer(this))
+{
+    m_cache.setMaxCost(DEFAULT_CACHE_CAPACITY);
+    connect(m_server, &QLocalServer::newConnection, this, &QDiffDaemon::onNewConnection);
+}
+
+QDiffDaemon::~QDiffDaemon()
+{
+    // Pool tasks still hold this
+    QThreadPool::globalInstance()->waitForDone();
+}
+
+bool QDiffDaemon::listen(const QString &serverName)
+{
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server->listen(serverName)) {
+        // A daemon that died leaves its socket behind
+        QLocalServer::removeServer(serverName);
+        if (!m_server->listen(serverName))
+            return false;
+    }
+    m_uptime.start();
+    warmUp();
+    return true;
+}
+
+QString QDiffDaemon::errorString() const
+{
+    return m_server->errorString();
+}
+
+void QDiffDaemon::setCacheCapacity(qint64 bytes)
+{
+    QMutexLocker locker(&m_cacheMutex);
+    m_cache.setMaxCost(qMax<qint64>(0, bytes));
+}
+
+void QDiffDaemon::setMaxRequestSize(quint32 bytes)
+{
+    m_maxRequestSize = qMin(bytes, QDiffDaemonProtocol::MAX_FRAME_SIZE);
+}
+
+QVariantMap QDiffDaemon::statistics() const
+{
+    QVariantMap stats;
+    stats["uptime_ms"] = m_uptime.isValid() ? m_uptime.elapsed() : 0;
+    stats["connections"] = m_connectionCount;
+    stats["requests"] = m_requestCount.load();
+    stats["cache_hits"] = m_cacheHitCount.load();
+    stats["inline_diffs"] = m_inlineCount.load();
+    const QAlgorithmPoolStatistics pool = QAlgorithmRegistry::get_Instance().poolStatistics();
+    stats["algorithm_instances"] = pool.checkouts - pool.hits;
+    stats["algorithm_pool_hit_rate"] = pool.hitRate();
+    stats["worker_threads"] = QThreadPool::globalInstance()->maxThreadCount();
+    QMutexLocker locker(&m_cacheMutex);
+    stats["cache_entries"] = m_cache.count();
+    stats["cache_cost"] = m_cache.totalCost();
+    return stats;
+}
+
+// ----------------------- Connections -------------------------
+
+void QDiffDaemon::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        ++m_connectionCount;
+        connect(socket, &QLocalSocket::readyRead, this, &QDiffDaemon::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            --m_connectionCount;
+            socket->deleteLater();
+        });
+    }
+}
+
+void QDiffDaemon::onReadyRead()
+{
+    auto *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket)
+        return;
+
+    QByteArray payload;
+    bool error = false;
+    while (QDiffDaemonProtocol::readFrame(socket, &payload, &error, m_maxRequestSize)) {
+        QDataStream in(payload);
+        in.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+        quint8 type = 0;
+        quint32 id = 0;
+        in >> type >> id;
+        if (in.status() != QDataStream::Ok) {
+            error = true;
+            break;
+        }
+        ++m_requestCount;
+
+        switch (type) {
+        case QDiffDaemonProtocol::Diff:
+            handleDiff(socket, id, in);
+            break;
+        case QDiffDaemonProtocol::Stats: {
+            QByteArray body;
+            QDataStream out(&body, QIODevice::WriteOnly);
+            out.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+            out << statistics();
+            reply(socket, type, id, body);
+            break;
+        }
+        default:
+            error = true;
+            break;
+        }
+        if (error)
+            break;
+    }
+    if (error) {
+        qWarning() << "QDiffDaemon::onReadyRead:: malformed request, dropping client";
+        socket->disconnectFromServer();
+    }
+}
+
+void QDiffDaemon::handleDiff(QLocalSocket *socket, quint32 id, QDataStream &in)
+{
+    QString algorithmId, leftText, rightText;
+    quint8 mode = 0;
+    in >> algorithmId >> mode >> leftText >> rightText;
+    // The frame itself was whole, so the client is answered and kept
+    if (in.status() != QDataStream::Ok) {
+        replyDiff(socket, id, false, QDiffResult(QStringLiteral("Malformed diff request")));
+        return;
+    }
+
+    if (mode > quint8(DiffMode::WordByWord)) {
+        replyDiff(socket, id, false, QDiffResult(QStringLiteral("Unknown diff mode %1").arg(mode)));
+        return;
+    }
+    const DiffMode diffMode = DiffMode(mode);
+    if (algorithmId.isEmpty())
+        algorithmId = m_manager.selectAlgorithm(leftText, rightText, diffMode);
+
+    // A reconfigured algorithm gets a new revision, so results of the old configuration are not served
+    const quint64 revision = QAlgorithmRegistry::get_Instance().algorithmRevision(algorithmId);
+    const QByteArray key = cacheKey(algorithmId, revision, diffMode, leftText, rightText);
+    QDiffResult result;
+    if (cachedResult(key, &result)) {
+        ++m_cacheHitCount;
+        replyDiff(socket, id, true, result);
+        return;
+    }
+
+    if (leftText.size() + rightText.size() < INLINE_DIFF_THRESHOLD) {
+        ++m_inlineCount;
+        result = diff(algorithmId, diffMode, leftText, rightText);
+        cacheResult(key, result);
+        replyDiff(socket, id, false, result);
+        return;
+    }
+
+    auto future = QtConcurrent::run([this, algorithmId, diffMode, leftText, rightText, key]() {
+        QDiffResult result = diff(algorithmId, diffMode, leftText, rightText);
+        cacheResult(key, result);
+        return result;
+    });
+    auto *watcher = new QFutureWatcher<QDiffResult>(this);
+    QPointer<QLocalSocket> client(socket);
+    connect(watcher, &QFutureWatcher<QDiffResult>::finished, this, [this, watcher, client, id]() {
+        if (client && client->state() == QLocalSocket::ConnectedState)
+            replyDiff(client, id, false, watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(future);
+}
+
+void QDiffDaemon::reply(QLocalSocket *socket, quint8 type, quint32 id, const QByteArray &body)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+    out << type << id;
+    payload.append(body);
+    QDiffDaemonProtocol::writeFrame(socket, payload);
+}
+
+void QDiffDaemon::replyDiff(QLocalSocket *socket, quint32 id, bool cached, const QDiffResult &result)
+{
+    QByteArray body;
+    QDataStream out(&body, QIODevice::WriteOnly);
+    out.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+    out << cached << result;
+    reply(socket, QDiffDaemonProtocol::Diff, id, body);
+}
+
+// ----------------------- Diffing -------------------------
+
+QDiffResult QDiffDaemon::diff(const QString &algorithmId, DiffMode mode, const QString &leftText, const QString &rightText)
+{
+    // Pooled instances of a reconfigured algorithm are retired by the registry
+    QPooledAlgorithm algorithm = QAlgorithmRegistry::get_Instance().checkoutAlgorithm(algorithmId);
+    if (!algorithm)
+        return QDiffResult(QStringLiteral("Failed to create algorithm instance for %1").arg(algorithmId));
+    return algorithm->calculateDiff(leftText, rightText, mode);
+}
+
+bool QDiffDaemon::cachedResult(const QByteArray &key, QDiffResult *result) const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    const QDiffResult *cached = m_cache.object(key);
+    if (!cached)
+        return false;
+    *result = *cached;
+    return true;
+}
+
+void QDiffDaemon::cacheResult(const QByteArray &key, const QDiffResult &result)
+{
+    if (!result.success())
+        return;
+    QMutexLocker locker(&m_cacheMutex);
+    m_cache.insert(key, new QDiffResult(result), resultCost(result));
+}
+
+QByteArray QDiffDaemon::cacheKey(const QString &algorithmId, quint64 revision, DiffMode mode,
+                                 const QString &leftText, const QString &rightText)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const qint64 header[3] = {qint64(revision), qint64(mode), qint64(leftText.size())};
+    hash.addData(utf16Bytes(algorithmId));
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(header), sizeof(header)));
+    hash.addData(utf16Bytes(leftText));
+    hash.addData(utf16Bytes(rightText));
+    return hash.result();
+}
+
+// Pool threads and one instance of every algorithm exist before the first client
+void QDiffDaemon::warmUp()
+{
+    QThreadPool *pool = QThreadPool::globalInstance();
+    pool->setExpiryTimeout(-1);
+    for (int i = 0; i < pool->maxThreadCount(); ++i)
+        pool->start([]() {});
+
+    for (const QString &algorithmId : m_manager.getAvailableAlgorithms())
+        diff(algorithmId, DiffMode::LineByLine, QStringLiteral("a\n"), QStringLiteral("b\n"));
+}
+
+}//namespace QDiffX
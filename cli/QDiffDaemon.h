@@ -0,0 +1,74 @@
+#pragma once
+#include "QAlgorithmManager.h"
+#include <QCache>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <atomic>
+
+class QLocalServer;
+class QLocalSocket;
+
+namespace QDiffX{
+
+// Serves diff requests over a local socket (see QDiffDaemonProtocol), so
+// short-lived clients skip registry start-up, thread creation and cold caches.
+// Requests below INLINE_DIFF_THRESHOLD are diffed right on the server thread,
+// larger ones on the global thread pool, whose threads never expire. Algorithm
+// instances are checked out of the registry's per-thread pool, and results are
+// kept in an LRU cache keyed by a hash of algorithm, its registry revision, mode
+// and both texts. Clients may not send frames above maxRequestSize().
+class QDiffDaemon : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QDiffDaemon(QObject *parent = nullptr);
+    ~QDiffDaemon();
+
+    bool listen(const QString &serverName);
+    QString errorString() const;
+
+    void setCacheCapacity(qint64 bytes);
+    quint32 maxRequestSize() const { return m_maxRequestSize; }
+    void setMaxRequestSize(quint32 bytes);
+    QVariantMap statistics() const;
+
+    // Pairs with fewer characters (both sides) are diffed without a thread hop
+    static constexpr int INLINE_DIFF_THRESHOLD = 16 * 1024;
+    static constexpr qint64 DEFAULT_CACHE_CAPACITY = 256 * 1024 * 1024;
+    static constexpr quint32 DEFAULT_MAX_REQUEST_SIZE = 64 * 1024 * 1024;
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    void handleDiff(QLocalSocket *socket, quint32 id, QDataStream &in);
+    void reply(QLocalSocket *socket, quint8 type, quint32 id, const QByteArray &body);
+    void replyDiff(QLocalSocket *socket, quint32 id, bool cached, const QDiffResult &result);
+
+    // Thread safe; called on the server thread and on pool threads
+    QDiffResult diff(const QString &algorithmId, DiffMode mode, const QString &leftText, const QString &rightText);
+    bool cachedResult(const QByteArray &key, QDiffResult *result) const;
+    void cacheResult(const QByteArray &key, const QDiffResult &result);
+    static QByteArray cacheKey(const QString &algorithmId, quint64 revision, DiffMode mode,
+                               const QString &leftText, const QString &rightText);
+
+    void warmUp();
+
+private:
+    QLocalServer *m_server;
+    QAlgorithmManager m_manager;        // Only for auto selection, on the server thread
+
+    mutable QMutex m_cacheMutex;
+    QCache<QByteArray, QDiffResult> m_cache;
+    quint32 m_maxRequestSize = DEFAULT_MAX_REQUEST_SIZE;
+
+    QElapsedTimer m_uptime;
+    std::atomic<quint64> m_requestCount{0};
+    std::atomic<quint64> m_cacheHitCount{0};
+    std::atomic<quint64> m_inlineCount{0};
+    int m_connectionCount = 0;
+};
+
+}//namespace QDiffX
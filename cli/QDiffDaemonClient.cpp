@@ -0,0 +1,101 @@
+#include "QDiffDaemonClient.h"
+#include "QDiffDaemonProtocol.h"
+#include <QElapsedTimer>
+#include <limits>
+
+namespace QDiffX{
+
+bool QDiffDaemonClient::connectToDaemon(const QString &serverName, int timeoutMs)
+{
+    m_socket.connectToServer(serverName);
+    if (!m_socket.waitForConnected(timeoutMs)) {
+        m_errorString = m_socket.errorString();
+        return false;
+    }
+    return true;
+}
+
+void QDiffDaemonClient::submit(const QList<QDiffPair> &pairs, const QString &algorithmId, DiffMode mode)
+{
+    for (const QDiffPair &pair : pairs) {
+        const quint32 id = m_nextId++;
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+        out << quint8(QDiffDaemonProtocol::Diff) << id << algorithmId << quint8(mode) << pair.leftText << pair.rightText;
+        QDiffDaemonProtocol::writeFrame(&m_socket, payload);
+        m_pendingIds.append(id);
+    }
+    m_socket.flush();
+}
+
+QList<QDiffResult> QDiffDaemonClient::collect(int timeoutMs)
+{
+    QList<QDiffResult> results;
+    results.reserve(m_pendingIds.size());
+    const bool complete = readReplies(int(m_pendingIds.size()), timeoutMs);
+    for (quint32 id : std::as_const(m_pendingIds)) {
+        if (m_results.contains(id))
+            results.append(m_results.take(id));
+        else
+            results.append(QDiffResult(complete ? QStringLiteral("No reply from daemon") : m_errorString));
+    }
+    m_pendingIds.clear();
+    m_results.clear();
+    return results;
+}
+
+QVariantMap QDiffDaemonClient::statistics(int timeoutMs)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+    out << quint8(QDiffDaemonProtocol::Stats) << m_nextId++;
+    QDiffDaemonProtocol::writeFrame(&m_socket, payload);
+    m_socket.flush();
+
+    m_statistics.clear();
+    readReplies(std::numeric_limits<int>::max(), timeoutMs);
+    return m_statistics;
+}
+
+// Reads until pendingCount diff replies are stored, or a stats reply arrived
+bool QDiffDaemonClient::readReplies(int pendingCount, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray payload;
+    bool error = false;
+    while (m_results.size() < pendingCount) {
+        while (QDiffDaemonProtocol::readFrame(&m_socket, &payload, &error)) {
+            QDataStream in(payload);
+            in.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+            quint8 type = 0;
+            quint32 id = 0;
+            in >> type >> id;
+            if (type == QDiffDaemonProtocol::Diff) {
+                bool cached = false;
+                QDiffResult result;
+                in >> cached >> result;
+                m_results.insert(id, result);
+            } else if (type == QDiffDaemonProtocol::Stats) {
+                in >> m_statistics;
+                return true;
+            }
+        }
+        if (error) {
+            m_errorString = QStringLiteral("Malformed reply from daemon");
+            return false;
+        }
+        if (m_results.size() >= pendingCount)
+            break;
+        const int remaining = timeoutMs < 0 ? -1 : timeoutMs - int(timer.elapsed());
+        if ((timeoutMs >= 0 && remaining <= 0) || !m_socket.waitForReadyRead(remaining)) {
+            m_errorString = m_socket.errorString();
+            return false;
+        }
+    }
+    return true;
+}
+
+}//namespace QDiffX
@@ -0,0 +1,36 @@
+#pragma once
+#include "QBatchDiffEngine.h"
+#include <QHash>
+#include <QLocalSocket>
+#include <QVariantMap>
+
+namespace QDiffX{
+
+// Blocking client of QDiffDaemon, meant for command line tools without an event loop.
+// Requests are pipelined: submit() only writes them, collect() waits for the replies.
+class QDiffDaemonClient
+{
+public:
+    bool connectToDaemon(const QString &serverName, int timeoutMs = 1000);
+    QString errorString() const { return m_errorString; }
+
+    // An empty algorithmId lets the daemon select one
+    void submit(const QList<QDiffPair> &pairs, const QString &algorithmId, DiffMode mode);
+    // Results of everything submitted since the last collect(), in submission order
+    QList<QDiffResult> collect(int timeoutMs = -1);
+
+    QVariantMap statistics(int timeoutMs = 1000);
+
+private:
+    bool readReplies(int pendingCount, int timeoutMs);
+
+private:
+    QLocalSocket m_socket;
+    QString m_errorString;
+    quint32 m_nextId = 1;
+    QList<quint32> m_pendingIds;
+    QHash<quint32, QDiffResult> m_results;
+    QVariantMap m_statistics;
+};
+
+}//namespace QDiffX
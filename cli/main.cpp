@@ -0,0 +1,501 @@
+#include "QDiffCliWriter.h"
+#include "QDiffDaemon.h"
+#include "QDiffDaemonClient.h"
+#include "QDiffDaemonProtocol.h"
+#include "QAlgorithmManager.h"
+#include "QAlgorithmRegistry.h"
+#include "QDirectoryCompare.h"
+#include "QDiffTrace.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThreadPool>
+#include <memory>
+#include <unordered_map>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#include <fcntl.h>
+#include <io.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+using namespace QDiffX;
+
+namespace {
+
+// Pairs are read and diffed this many at a time, which bounds memory on large trees
+constexpr int PAIR_CHUNK_SIZE = 512;
+constexpr int BINARY_PROBE_SIZE = 8000;
+
+enum ExitCode {
+    ExitSame = 0,
+    ExitDifferent = 1,
+    ExitTrouble = 2
+};
+
+struct InputPair {
+    QString leftName;
+    QString rightName;
+    QString leftPath;           // Empty for a side that does not exist, "-" for stdin
+    QString rightPath;
+};
+
+struct LoadedPair {
+    QString leftText;
+    QString rightText;
+    bool binary = false;
+    bool ok = true;
+    QString error;
+};
+
+struct RunStats {
+    int pairCount = 0;
+    int diffedPairCount = 0;
+    qint64 bytesRead = 0;
+    qint64 readMs = 0;
+    qint64 diffMs = 0;
+    int taskCount = 0;
+    int splitPairCount = 0;
+    int stealCount = 0;
+    int workerCount = 0;
+};
+
+qint64 peakResidentBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return qint64(counters.PeakWorkingSetSize);
+    return -1;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(Q_OS_DARWIN)
+    return qint64(usage.ru_maxrss);             // Bytes
+#else
+    return qint64(usage.ru_maxrss) * 1024;      // Kilobytes
+#endif
+#else
+    return -1;
+#endif
+}
+
+QByteArray readInput(const QString &path, bool *ok)
+{
+    QFile file;
+    bool opened;
+    if (path == QLatin1String("-")) {
+        opened = file.open(stdin, QIODevice::ReadOnly);
+    } else {
+        file.setFileName(path);
+        opened = file.open(QIODevice::ReadOnly);
+    }
+    *ok = opened;
+    return opened ? file.readAll() : QByteArray();
+}
+
+LoadedPair loadPair(const InputPair &pair, RunStats &stats)
+{
+    LoadedPair loaded;
+    QByteArray left, right;
+    bool ok = true;
+    if (!pair.leftPath.isEmpty()) {
+        left = readInput(pair.leftPath, &ok);
+        if (!ok) {
+            loaded.ok = false;
+            loaded.error = QStringLiteral("cannot read %1").arg(pair.leftPath);
+            return loaded;
+        }
+    }
+    if (!pair.rightPath.isEmpty()) {
+        right = readInput(pair.rightPath, &ok);
+        if (!ok) {
+            loaded.ok = false;
+            loaded.error = QStringLiteral("cannot read %1").arg(pair.rightPath);
+            return loaded;
+        }
+    }
+    stats.bytesRead += left.size() + right.size();
+    loaded.binary = left.left(BINARY_PROBE_SIZE).contains('\0') || right.left(BINARY_PROBE_SIZE).contains('\0');
+    if (loaded.binary)
+        loaded.binary = left != right;
+    if (!loaded.binary) {
+        loaded.leftText = QString::fromUtf8(left);
+        loaded.rightText = QString::fromUtf8(right);
+    }
+    return loaded;
+}
+
+// Changed files of two trees, named like diff -r does
+QList<InputPair> directoryPairs(const QString &leftRoot, const QString &rightRoot, QString *error)
+{
+    QList<InputPair> pairs;
+    const QDirectoryCompareResult result = QDirectoryCompareEngine().compare(leftRoot, rightRoot);
+    if (!result.success()) {
+        *error = result.errorMessage();
+        return pairs;
+    }
+    for (const QFileCompareEntry &entry : result.entries()) {
+        if (entry.status == QFileCompareStatus::Unchanged)
+            continue;
+        InputPair pair;
+        pair.leftName = entry.leftSize >= 0 ? leftRoot + '/' + entry.relativePath : QStringLiteral("/dev/null");
+        pair.rightName = entry.rightSize >= 0 ? rightRoot + '/' + entry.relativePath : QStringLiteral("/dev/null");
+        pair.leftPath = entry.leftSize >= 0 ? result.leftRoot() + '/' + entry.relativePath : QString();
+        pair.rightPath = entry.rightSize >= 0 ? result.rightRoot() + '/' + entry.relativePath : QString();
+        pairs.append(pair);
+    }
+    return pairs;
+}
+
+// "left<TAB>right" per line
+QList<InputPair> listedPairs(const QString &listPath, QString *error)
+{
+    QList<InputPair> pairs;
+    bool ok = false;
+    const QString list = QString::fromUtf8(readInput(listPath, &ok));
+    if (!ok) {
+        *error = QStringLiteral("cannot read pair list %1").arg(listPath);
+        return pairs;
+    }
+    const QStringList lines = list.split('\n', Qt::SkipEmptyParts);
+    for (const QString &line : lines) {
+        const QStringList fields = line.trimmed().split('\t');
+        if (fields.size() != 2) {
+            *error = QStringLiteral("malformed pair list line: %1").arg(line);
+            return QList<InputPair>();
+        }
+        pairs.append(InputPair{fields[0], fields[1], fields[0], fields[1]});
+    }
+    return pairs;
+}
+
+// Diffs requests from stdin until it closes, for QProcessDiffPool
+int runWorker()
+{
+#if defined(Q_OS_WIN)
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    QFile input, output;
+    if (!input.open(stdin, QIODevice::ReadOnly | QIODevice::Unbuffered)
+        || !output.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered))
+        return ExitTrouble;
+
+    std::unordered_map<QString, std::unique_ptr<QDiffAlgorithm>> algorithms;
+    QByteArray request;
+    while (QDiffDaemonProtocol::readFrameBlocking(&input, &request)) {
+        QDataStream in(request);
+        in.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+        quint8 type = 0, mode = 0;
+        quint32 id = 0;
+        QString algorithmId, leftText, rightText;
+        in >> type >> id >> algorithmId >> mode >> leftText >> rightText;
+        if (type != QDiffDaemonProtocol::Diff || in.status() != QDataStream::Ok)
+            return ExitTrouble;
+
+        std::unique_ptr<QDiffAlgorithm> &algorithm = algorithms[algorithmId];
+        if (!algorithm)
+            algorithm = QAlgorithmRegistry::get_Instance().createAlgorithm(algorithmId);
+        const QDiffResult result = algorithm ? algorithm->calculateDiff(leftText, rightText, DiffMode(mode))
+                                             : QDiffResult(QStringLiteral("Failed to create algorithm instance for %1").arg(algorithmId));
+
+        QByteArray reply;
+        QDataStream out(&reply, QIODevice::WriteOnly);
+        out.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+        out << type << id << false << result;
+        QDiffDaemonProtocol::writeFrame(&output, reply);
+        // Unbuffered only skips Qt's buffer, stdio still holds back a pipe's output
+        output.flush();
+    }
+    return ExitSame;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qdiffx-cli");
+    QCoreApplication::setApplicationVersion(QStringLiteral("1.0.0"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Diff files, directories or stdin with the QDiffX engines.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("left", "Left file or directory, '-' for stdin.");
+    parser.addPositionalArgument("right", "Right file or directory, '-' for stdin.");
+    const QCommandLineOption algorithmOption({"a", "algorithm"}, "Algorithm id, or 'auto' (default).", "id", "auto");
+    const QCommandLineOption modeOption({"m", "mode"}, "Diff mode: line (default), char, word or auto.", "mode", "line");
+    const QCommandLineOption formatOption({"f", "format"}, "Output format: unified (default), json or binary.", "format", "unified");
+    const QCommandLineOption outputOption({"o", "output"}, "Write output to file instead of stdout.", "file");
+    const QCommandLineOption contextOption({"U", "unified"}, "Context lines of unified output (default 3).", "lines", "3");
+    const QCommandLineOption pairsOption("pairs", "Diff every 'left<TAB>right' line of file ('-' for stdin).", "file");
+    const QCommandLineOption jobsOption({"j", "jobs"}, "Worker threads (default: all cores).", "count");
+    const QCommandLineOption statsOption("stats", "Print timings, throughput and peak memory to stderr.");
+    const QCommandLineOption traceOption("trace", "Write a Chrome trace of the run to file (needs a QDIFFX_TRACING build).", "file");
+    const QCommandLineOption listOption("list-algorithms", "List the registered algorithms and exit.");
+    const QCommandLineOption daemonOption("daemon", "Serve diff requests on a local socket until killed.");
+    const QCommandLineOption connectOption("connect", "Have a running daemon do the diffs.");
+    const QCommandLineOption socketOption("socket", "Local socket name of the daemon.", "name",
+                                          QDiffDaemonProtocol::defaultServerName());
+    const QCommandLineOption cacheOption("cache-size", "Result cache of the daemon, in MiB (default 256).", "mib");
+    const QCommandLineOption requestSizeOption("max-request-size", "Largest request the daemon accepts, in MiB (default 64).", "mib");
+    QCommandLineOption workerOption("worker", "Serve one QProcessDiffPool over stdin and stdout.");
+    workerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({algorithmOption, modeOption, formatOption, outputOption, contextOption,
+                       pairsOption, jobsOption, statsOption, traceOption, listOption,
+                       daemonOption, connectOption, socketOption, cacheOption, requestSizeOption, workerOption});
+    parser.process(app);
+
+    if (parser.isSet(workerOption))
+        return runWorker();
+
+    QTextStream err(stderr);
+    QAlgorithmManager manager;
+
+    if (parser.isSet(listOption)) {
+        QTextStream out(stdout);
+        for (const QString &id : manager.getAvailableAlgorithms())
+            out << id << '\n';
+        return ExitSame;
+    }
+
+    // ----------------------- Options -------------------------
+
+    DiffMode diffMode;
+    const QString mode = parser.value(modeOption);
+    if (mode == "line") diffMode = DiffMode::LineByLine;
+    else if (mode == "char") diffMode = DiffMode::CharByChar;
+    else if (mode == "word") diffMode = DiffMode::WordByWord;
+    else if (mode == "auto") diffMode = DiffMode::Auto;
+    else {
+        err << "qdiffx-cli: unknown mode " << mode << '\n';
+        return ExitTrouble;
+    }
+    manager.setDiffMode(diffMode);
+
+    QDiffCliFormat format;
+    const QString formatName = parser.value(formatOption);
+    if (formatName == "unified") format = QDiffCliFormat::Unified;
+    else if (formatName == "json") format = QDiffCliFormat::Json;
+    else if (formatName == "binary") format = QDiffCliFormat::Binary;
+    else {
+        err << "qdiffx-cli: unknown format " << formatName << '\n';
+        return ExitTrouble;
+    }
+
+    QString algorithm = parser.value(algorithmOption);
+    const QAlgorithmSelectionMode selectionMode = algorithm == "auto" ? QAlgorithmSelectionMode::Auto
+                                                                      : QAlgorithmSelectionMode::Manual;
+    if (selectionMode == QAlgorithmSelectionMode::Auto) {
+        algorithm.clear();
+    } else if (!manager.isAlgorithmAvailable(algorithm)) {
+        err << "qdiffx-cli: unknown algorithm " << algorithm << '\n';
+        return ExitTrouble;
+    }
+
+    if (parser.isSet(jobsOption)) {
+        bool ok = false;
+        const int jobs = parser.value(jobsOption).toInt(&ok);
+        if (!ok || jobs < 1) {
+            err << "qdiffx-cli: invalid job count " << parser.value(jobsOption) << '\n';
+            return ExitTrouble;
+        }
+        QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+    }
+
+    if (parser.isSet(daemonOption)) {
+        QDiffDaemon daemon;
+        if (parser.isSet(cacheOption))
+            daemon.setCacheCapacity(parser.value(cacheOption).toLongLong() * 1024 * 1024);
+        if (parser.isSet(requestSizeOption)) {
+            bool ok = false;
+            const uint mib = parser.value(requestSizeOption).toUInt(&ok);
+            if (!ok || mib < 1 || mib > QDiffDaemonProtocol::MAX_FRAME_SIZE / (1024 * 1024)) {
+                err << "qdiffx-cli: invalid request size " << parser.value(requestSizeOption) << '\n';
+                return ExitTrouble;
+            }
+            daemon.setMaxRequestSize(quint32(mib) * 1024 * 1024);
+        }
+        if (!daemon.listen(parser.value(socketOption))) {
+            err << "qdiffx-cli: cannot listen on " << parser.value(socketOption) << ": " << daemon.errorString() << '\n';
+            return ExitTrouble;
+        }
+        return app.exec();
+    }
+
+    QDiffDaemonClient client;
+    const bool useDaemon = parser.isSet(connectOption);
+    if (useDaemon && !client.connectToDaemon(parser.value(socketOption))) {
+        err << "qdiffx-cli: cannot connect to " << parser.value(socketOption) << ": " << client.errorString() << '\n';
+        return ExitTrouble;
+    }
+
+    if (parser.isSet(traceOption))
+        QDiffTrace::start();
+
+    // ----------------------- Inputs -------------------------
+
+    QElapsedTimer total;
+    total.start();
+    QString error;
+    QList<InputPair> pairs;
+    const QStringList positional = parser.positionalArguments();
+    if (parser.isSet(pairsOption)) {
+        pairs = listedPairs(parser.value(pairsOption), &error);
+    } else if (positional.size() == 2) {
+        const QString &left = positional[0];
+        const QString &right = positional[1];
+        if (left == "-" && right == "-")
+            error = QStringLiteral("only one side can be read from stdin");
+        else if (QFileInfo(left).isDir() && QFileInfo(right).isDir())
+            pairs = directoryPairs(left, right, &error);
+        else
+            pairs.append(InputPair{left, right, left, right});
+    } else {
+        parser.showHelp(ExitTrouble);
+    }
+    if (!error.isEmpty()) {
+        err << "qdiffx-cli: " << error << '\n';
+        return ExitTrouble;
+    }
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "qdiffx-cli: cannot write " << output.fileName() << '\n';
+            return ExitTrouble;
+        }
+    } else if (!output.open(stdout, QIODevice::WriteOnly)) {
+        return ExitTrouble;
+    }
+
+    // ----------------------- Diff -------------------------
+
+    QDiffCliWriter writer(&output, format, parser.value(contextOption).toInt());
+    writer.begin();
+
+    RunStats stats;
+    stats.pairCount = int(pairs.size());
+    bool different = false;
+    bool trouble = false;
+
+    // Chunk k + 1 is read while chunk k is being diffed on the pool
+    auto loadChunk = [&](int first) {
+        QElapsedTimer timer;
+        timer.start();
+        QList<LoadedPair> chunk;
+        const int last = qMin(int(pairs.size()), first + PAIR_CHUNK_SIZE);
+        for (int i = first; i < last; ++i)
+            chunk.append(loadPair(pairs[i], stats));
+        stats.readMs += timer.elapsed();
+        return chunk;
+    };
+
+    QList<LoadedPair> chunk = loadChunk(0);
+    for (int first = 0; first < pairs.size(); first += PAIR_CHUNK_SIZE) {
+        QList<QDiffPair> textPairs;
+        QList<int> slots;           // Batch result index of each pair, -1 when not diffed
+        for (const LoadedPair &loaded : chunk) {
+            if (!loaded.ok || loaded.binary) {
+                slots.append(-1);
+                continue;
+            }
+            slots.append(int(textPairs.size()));
+            textPairs.append(QDiffPair{loaded.leftText, loaded.rightText});
+        }
+
+        QElapsedTimer diffTimer;
+        diffTimer.start();
+        QEventLoop batchLoop;
+        QObject::connect(&manager, &QAlgorithmManager::batchFinished, &batchLoop, &QEventLoop::quit);
+        QFuture<QDiffResult> future;
+        QList<QDiffResult> daemonResults;
+        if (useDaemon)
+            client.submit(textPairs, algorithm, diffMode);
+        else if (!textPairs.isEmpty())
+            future = manager.calculateBatchDiff(textPairs, selectionMode, algorithm);
+
+        const QList<LoadedPair> current = chunk;
+        if (first + PAIR_CHUNK_SIZE < pairs.size())
+            chunk = loadChunk(first + PAIR_CHUNK_SIZE);
+        if (useDaemon)
+            daemonResults = client.collect();
+
+        // Written in input order, each as soon as its own diff is done
+        for (int i = 0; i < current.size(); ++i) {
+            const InputPair &pair = pairs[first + i];
+            const LoadedPair &loaded = current[i];
+            if (!loaded.ok) {
+                err << "qdiffx-cli: " << loaded.error << '\n';
+                trouble = true;
+            } else if (loaded.binary) {
+                writer.writeBinaryFiles(first + i, pair.leftName, pair.rightName);
+                different = true;
+            } else {
+                const QDiffResult result = useDaemon ? daemonResults[slots[i]] : future.resultAt(slots[i]);
+                if (!result.success()) trouble = true;
+                if (QDiffCliWriter::hasDifferences(result)) different = true;
+                writer.writePair(first + i, pair.leftName, pair.rightName, result);
+            }
+        }
+
+        if (useDaemon) {
+            stats.diffedPairCount += int(textPairs.size());
+        } else if (!textPairs.isEmpty()) {
+            // The batch statistics arrive through the manager's watcher
+            batchLoop.exec();
+            const QBatchDiffStats batchStats = manager.lastBatchStats();
+            stats.diffedPairCount += batchStats.pairCount;
+            stats.taskCount += batchStats.taskCount;
+            stats.splitPairCount += batchStats.splitPairCount;
+            stats.stealCount += batchStats.stealCount;
+            stats.workerCount = batchStats.workerCount;
+        }
+        stats.diffMs += diffTimer.elapsed();
+    }
+    writer.end();
+    output.flush();
+
+    if (parser.isSet(traceOption)) {
+        QDiffTrace::stop();
+        if (!QDiffTrace::saveChromeTrace(parser.value(traceOption))) {
+            err << "qdiffx-cli: cannot write trace " << parser.value(traceOption) << '\n';
+            trouble = true;
+        }
+    }
+
+    if (parser.isSet(statsOption)) {
+        const qint64 elapsedMs = total.elapsed();
+        const double seconds = qMax<qint64>(1, elapsedMs) / 1000.0;
+        const qint64 peak = peakResidentBytes();
+        err << "pairs:          " << stats.pairCount << " (" << stats.diffedPairCount << " diffed)\n"
+            << "bytes read:     " << stats.bytesRead << '\n'
+            << "elapsed:        " << elapsedMs << " ms (read " << stats.readMs << " ms, diff " << stats.diffMs << " ms)\n"
+            << "throughput:     " << QString::number(stats.pairCount / seconds, 'f', 1) << " pairs/s, "
+            << QString::number(stats.bytesRead / seconds / (1024.0 * 1024.0), 'f', 2) << " MiB/s\n"
+            << "tasks:          " << stats.taskCount << " (" << stats.splitPairCount << " split pairs, "
+            << stats.stealCount << " steals, " << stats.workerCount << " workers)\n"
+            << "peak memory:    " << (peak >= 0 ? QString::number(peak / (1024.0 * 1024.0), 'f', 1) + " MiB" : QStringLiteral("n/a")) << '\n';
+        if (useDaemon) {
+            const QVariantMap daemonStats = client.statistics();
+            err << "daemon:         " << daemonStats.value("requests").toULongLong() << " requests, "
+                << daemonStats.value("cache_hits").toULongLong() << " cache hits, "
+                << daemonStats.value("cache_entries").toInt() << " cached results\n";
+        }
+    }
+
+    if (trouble)
+        return ExitTrouble;
+    return different ? ExitDifferent : ExitSame;
+}
@@ -0,0 +1,158 @@
+/*
+ * QDiffX - Modern Qt6 Diff Algorithm & Widget
+ *
+ * Multi-word bit-vector approximate matcher used by match_bitap.
+ */
+
+#include "diff_bitap.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace diff_bitap {
+
+namespace {
+
+using Word = std::uint64_t;
+constexpr int kWordBits = 64;
+constexpr int kAlphabetSize = 0x10000;
+
+
+/**
+ * Match masks of the reversed pattern: bit i of mask(c) is set when
+ * pattern[length - 1 - i] equals c.  Symbols are looked up through a flat
+ * per-thread table of 64K slots; only the slots used by the pattern are
+ * touched, and they are cleared again on destruction.
+ */
+class PatternMasks {
+ public:
+  PatternMasks(const char16_t *pattern, int length)
+      : pattern_(pattern), length_(length),
+        words_((length + kWordBits - 1) / kWordBits),
+        slots_(table()) {
+    // Slot 0 is the all-zero mask of symbols absent from the pattern.
+    masks_.assign(static_cast<std::size_t>(words_), 0);
+    for (int i = 0; i < length; i++) {
+      const char16_t c = pattern[length - 1 - i];
+      std::uint32_t &slot = slots_[c];
+      if (slot == 0) {
+        slot = static_cast<std::uint32_t>(masks_.size() / words_);
+        masks_.resize(masks_.size() + words_, 0);
+      }
+      masks_[static_cast<std::size_t>(slot) * words_ + i / kWordBits]
+          |= Word(1) << (i % kWordBits);
+    }
+  }
+
+  ~PatternMasks() {
+    for (int i = 0; i < length_; i++) {
+      slots_[pattern_[i]] = 0;
+    }
+  }
+
+  PatternMasks(const PatternMasks &) = delete;
+  PatternMasks &operator=(const PatternMasks &) = delete;
+
+  int words() const { return words_; }
+
+  const Word *mask(char16_t c) const {
+    return masks_.data() + static_cast<std::size_t>(slots_[c]) * words_;
+  }
+
+ private:
+  static std::uint32_t *table() {
+    thread_local std::vector<std::uint32_t> slots(kAlphabetSize, 0);
+    return slots.data();
+  }
+
+  const char16_t *pattern_;
+  int length_;
+  int words_;
+  std::uint32_t *slots_;
+  std::vector<Word> masks_;
+};
+
+
+/**
+ * Advance one 64-row block of the error column by one text symbol
+ * (Myers 1999).  pv/mv hold the positive/negative vertical deltas,
+ * hin is the horizontal delta entering the block from above, and the
+ * delta leaving it at bit 'high' is returned.
+ */
+inline int advanceBlock(Word &pv, Word &mv, Word eq, int hin, Word high) {
+  const Word xv = eq | mv;
+  if (hin < 0) {
+    eq |= 1;
+  }
+  const Word xh = (((eq & pv) + pv) ^ pv) | eq;
+  Word ph = mv | ~(xh | pv);
+  Word mh = pv & xh;
+  int hout = 0;
+  if ((ph & high) != 0) {
+    hout = 1;
+  } else if ((mh & high) != 0) {
+    hout = -1;
+  }
+  ph <<= 1;
+  mh <<= 1;
+  if (hin < 0) {
+    mh |= 1;
+  } else if (hin > 0) {
+    ph |= 1;
+  }
+  pv = mh | ~(xv | ph);
+  mv = ph & xv;
+  return hout;
+}
+
+}  // namespace
+
+
+std::vector<int> startDistances(const char16_t *text, int text_length,
+                                const char16_t *pattern, int pattern_length,
+                                int from, int to) {
+  from = std::max(from, 0);
+  to = std::min(to, text_length - 1);
+  std::vector<int> distances;
+  if (from > to) {
+    return distances;
+  }
+  distances.assign(static_cast<std::size_t>(to - from) + 1, pattern_length);
+  if (pattern_length <= 0) {
+    std::fill(distances.begin(), distances.end(), 0);
+    return distances;
+  }
+
+  // The reversed pattern is matched against the text read backwards, so
+  // the bottom row at text position p scores matches that start at p.
+  // A match never spans more than twice the pattern length (the empty
+  // match already costs pattern_length), which bounds the scan.
+  const PatternMasks masks(pattern, pattern_length);
+  const int words = masks.words();
+  const int lastWord = words - 1;
+  const Word lastHigh = Word(1) << ((pattern_length - 1) % kWordBits);
+  const Word high = Word(1) << (kWordBits - 1);
+  std::vector<Word> pv(static_cast<std::size_t>(words), ~Word(0));
+  std::vector<Word> mv(static_cast<std::size_t>(words), 0);
+  int score = pattern_length;
+
+  const int end = static_cast<int>(
+      std::min<long long>(text_length, static_cast<long long>(to) + 2 * pattern_length));
+  for (int p = end - 1; p >= from; p--) {
+    const Word *eq = masks.mask(text[p]);
+    // The top row is free in a search, so nothing enters the first block.
+    int carry = 0;
+    for (int w = 0; w < lastWord; w++) {
+      carry = advanceBlock(pv[w], mv[w], eq[w], carry, high);
+    }
+    score += advanceBlock(pv[lastWord], mv[lastWord], eq[lastWord], carry, lastHigh);
+    if (p <= to) {
+      distances[static_cast<std::size_t>(p - from)] = score;
+    }
+  }
+  return distances;
+}
+
+}  // namespace diff_bitap
@@ -0,0 +1,41 @@
+/*
+ * QDiffX - Modern Qt6 Diff Algorithm & Widget
+ *
+ * Multi-word bit-vector approximate matcher used by match_bitap.
+ *
+ * The pattern is held as a column of bit vectors, 64 rows per machine
+ * word, so patterns of any length can be matched (the classic Bitap only
+ * handles patterns up to the width of an int).  Match masks are looked up
+ * through a flat table indexed by UTF-16 code unit instead of a map.
+ *
+ * For every candidate start position the matcher reports the smallest
+ * number of errors (insertions, deletions, substitutions) with which the
+ * pattern occurs there, in a single pass over the text.
+ */
+
+#pragma once
+
+#include <vector>
+
+/*
+ * Approximate string matching for the match and patch functions.
+ */
+namespace diff_bitap {
+
+/**
+ * Best error count for each start position in [from, to].
+ * Entry i is the edit distance between the pattern and the closest
+ * substring of text starting at from + i.
+ * @param text Text to search.
+ * @param text_length Length of the text.
+ * @param pattern Pattern to search for.
+ * @param pattern_length Length of the pattern.
+ * @param from First start position to report (clamped to the text).
+ * @param to Last start position to report (clamped to the text).
+ * @return Error counts, empty when the range is empty.
+ */
+std::vector<int> startDistances(const char16_t *text, int text_length,
+                                const char16_t *pattern, int pattern_length,
+                                int from, int to);
+
+}  // namespace diff_bitap
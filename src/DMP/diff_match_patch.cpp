@@ -10,6 +10,11 @@
 #include <QtCore>
 #include <time.h>
 #include "diff_match_patch.h"
+#include "diff_bitap.h"
+#include "diff_simd.h"
+#include "LCS/bit_parallel_lcs.h"
+#include "QDiffCancellation.h"
+#include "QDiffTrace.h"
 
 
 //////////////////////////
@@ -291,7 +296,7 @@ QList<Diff> diff_match_patch::diff_lineMode(QString text1, QString text2,
             pointer.remove();
           }
           foreach(Diff newDiff,
-              diff_main(text_delete, text_insert, false, deadline)) {
+              diff_refine(text_delete, text_insert, deadline)) {
             pointer.insert(newDiff);
           }
         }
@@ -309,11 +314,50 @@ QList<Diff> diff_match_patch::diff_lineMode(QString text1, QString text2,
 }
 
 
+QList<Diff> diff_match_patch::diff_refine(const QString &text1,
+    const QString &text2, clock_t deadline) {
+  // Replacement blocks are usually a few lines long and densely edited,
+  // where the bit-parallel LCS is far cheaper than bisecting.  Larger
+  // blocks keep using diff_main, which honours the deadline.
+  const qint64 cells = static_cast<qint64>(text1.length()) * text2.length();
+  if (cells == 0 || cells > BITPARALLEL_MAX_CELLS) {
+    return diff_main(text1, text2, false, deadline);
+  }
+  const std::vector<bit_lcs::Edit> edits = bit_lcs::diff(
+      utf16(text1), static_cast<int>(text1.length()),
+      utf16(text2), static_cast<int>(text2.length()));
+  QList<Diff> diffs;
+  int pointer1 = 0;
+  int pointer2 = 0;
+  for (const bit_lcs::Edit &edit : edits) {
+    switch (edit.op) {
+      case bit_lcs::EditOp::Equal:
+        diffs.append(Diff(EQUAL, text1.mid(pointer1, edit.length)));
+        pointer1 += edit.length;
+        pointer2 += edit.length;
+        break;
+      case bit_lcs::EditOp::Delete:
+        diffs.append(Diff(DELETE, text1.mid(pointer1, edit.length)));
+        pointer1 += edit.length;
+        break;
+      case bit_lcs::EditOp::Insert:
+        diffs.append(Diff(INSERT, text2.mid(pointer2, edit.length)));
+        pointer2 += edit.length;
+        break;
+    }
+  }
+  return diffs;
+}
+
+
 QList<Diff> diff_match_patch::diff_bisect(const QString &text1,
     const QString &text2, clock_t deadline) {
+  QDIFFX_TRACE_SCOPE("dmp", "bisect");
   // Cache the text lengths to prevent multiple calls.
   const int text1_length = text1.length();
   const int text2_length = text2.length();
+  const char16_t *chars1 = utf16(text1);
+  const char16_t *chars2 = utf16(text2);
   const int max_d = (text1_length + text2_length + 1) / 2;
   const int v_offset = max_d;
   const int v_length = 2 * max_d;
@@ -336,8 +380,8 @@ QList<Diff> diff_match_patch::diff_bisect(const QString &text1,
   int k2start = 0;
   int k2end = 0;
   for (int d = 0; d < max_d; d++) {
-    // Bail out if deadline is reached.
-    if (clock() > deadline) {
+    // Bail out if deadline is reached or the diff was cancelled.
+    if (clock() > deadline || QDiffX::QDiffCancellation::isCancelled()) {
       break;
     }
 
@@ -351,10 +395,10 @@ QList<Diff> diff_match_patch::diff_bisect(const QString &text1,
         x1 = v1[k1_offset - 1] + 1;
       }
       int y1 = x1 - k1;
-      while (x1 < text1_length && y1 < text2_length
-          && text1[x1] == text2[y1]) {
-        x1++;
-        y1++;
+      if (x1 >= 0 && y1 >= 0) {
+        x1 = diff_simd::snakeForward(chars1, text1_length,
+                                     chars2, text2_length, x1, y1);
+        y1 = x1 - k1;
       }
       v1[k1_offset] = x1;
       if (x1 > text1_length) {
@@ -388,10 +432,10 @@ QList<Diff> diff_match_patch::diff_bisect(const QString &text1,
         x2 = v2[k2_offset - 1] + 1;
       }
       int y2 = x2 - k2;
-      while (x2 < text1_length && y2 < text2_length
-          && text1[text1_length - x2 - 1] == text2[text2_length - y2 - 1]) {
-        x2++;
-        y2++;
+      if (x2 >= 0 && y2 >= 0) {
+        x2 = diff_simd::snakeReverse(chars1, text1_length,
+                                     chars2, text2_length, x2, y2);
+        y2 = x2 - k2;
       }
       v2[k2_offset] = x2;
       if (x2 > text1_length) {
@@ -443,6 +487,7 @@ QList<Diff> diff_match_patch::diff_bisectSplit(const QString &text1,
 
 QList<QVariant> diff_match_patch::diff_linesToChars(const QString &text1,
                                                     const QString &text2) {
+  QDIFFX_TRACE_SCOPE("dmp", "linesToChars");
   QStringList lineArray;
   QMap<QString, int> lineHash;
   // e.g. linearray[4] == "Hello\n"
@@ -512,13 +557,9 @@ void diff_match_patch::diff_charsToLines(QList<Diff> &diffs,
 int diff_match_patch::diff_commonPrefix(const QString &text1,
                                         const QString &text2) {
   // Performance analysis: http://neil.fraser.name/news/2007/10/09/
+  // Compared a vector of code units at a time, see diff_simd.
   const int n = std::min(text1.length(), text2.length());
-  for (int i = 0; i < n; i++) {
-    if (text1[i] != text2[i]) {
-      return i;
-    }
-  }
-  return n;
+  return diff_simd::commonPrefix(utf16(text1), utf16(text2), n);
 }
 
 
@@ -528,12 +569,8 @@ int diff_match_patch::diff_commonSuffix(const QString &text1,
   const int text1_length = text1.length();
   const int text2_length = text2.length();
   const int n = std::min(text1_length, text2_length);
-  for (int i = 1; i <= n; i++) {
-    if (text1[text1_length - i] != text2[text2_length - i]) {
-      return i - 1;
-    }
-  }
-  return n;
+  return diff_simd::commonSuffix(utf16(text1) + text1_length,
+                                 utf16(text2) + text2_length, n);
 }
 
 int diff_match_patch::diff_commonOverlap(const QString &text1,
@@ -545,17 +582,15 @@ int diff_match_patch::diff_commonOverlap(const QString &text1,
   if (text1_length == 0 || text2_length == 0) {
     return 0;
   }
-  // Truncate the longer string.
-  QString text1_trunc = text1;
-  QString text2_trunc = text2;
-  if (text1_length > text2_length) {
-    text1_trunc = text1.right(text2_length);
-  } else if (text1_length < text2_length) {
-    text2_trunc = text2.left(text1_length);
-  }
+  // Truncate the longer string.  Views avoid copying either text.
   const int text_length = std::min(text1_length, text2_length);
+  const QStringView text1_trunc = QStringView(text1).right(text_length);
+  const QStringView text2_trunc = QStringView(text2).left(text_length);
+  const char16_t *tail1 = utf16(text1) + text1_length;
+  const char16_t *head2 = utf16(text2);
   // Quick check for the worst case.
-  if (text1_trunc == text2_trunc) {
+  if (diff_simd::commonPrefix(tail1 - text_length, head2, text_length)
+      == text_length) {
     return text_length;
   }
 
@@ -565,13 +600,14 @@ int diff_match_patch::diff_commonOverlap(const QString &text1,
   int best = 0;
   int length = 1;
   while (true) {
-    QString pattern = text1_trunc.right(length);
-    int found = text2_trunc.indexOf(pattern);
+    const QStringView pattern = text1_trunc.right(length);
+    const int found = static_cast<int>(text2_trunc.indexOf(pattern));
     if (found == -1) {
       return best;
     }
     length += found;
-    if (found == 0 || text1_trunc.right(length) == text2_trunc.left(length)) {
+    if (found == 0 || diff_simd::commonPrefix(tail1 - length, head2, length)
+        == length) {
       best = length;
       length++;
     }
@@ -629,10 +665,12 @@ QStringList diff_match_patch::diff_halfMatchI(const QString &longtext,
   QString best_longtext_a, best_longtext_b;
   QString best_shorttext_a, best_shorttext_b;
   while ((j = shorttext.indexOf(seed, j + 1)) != -1) {
-    const int prefixLength = diff_commonPrefix(safeMid(longtext, i),
-        safeMid(shorttext, j));
-    const int suffixLength = diff_commonSuffix(longtext.left(i),
-        shorttext.left(j));
+    // Compare in place rather than on copied substrings.
+    const int prefixLength = diff_simd::commonPrefix(
+        utf16(longtext) + i, utf16(shorttext) + j,
+        std::min(longtext.length() - i, shorttext.length() - j));
+    const int suffixLength = diff_simd::commonSuffix(
+        utf16(longtext) + i, utf16(shorttext) + j, std::min(i, j));
     if (best_common.length() < suffixLength + prefixLength) {
       best_common = safeMid(shorttext, j - suffixLength, suffixLength)
           + safeMid(shorttext, j, prefixLength);
@@ -654,6 +692,7 @@ QStringList diff_match_patch::diff_halfMatchI(const QString &longtext,
 
 
 void diff_match_patch::diff_cleanupSemantic(QList<Diff> &diffs) {
+  QDIFFX_TRACE_SCOPE("dmp", "cleanupSemantic");
   if (diffs.isEmpty()) {
     return;
   }
@@ -797,6 +836,7 @@ void diff_match_patch::diff_cleanupSemantic(QList<Diff> &diffs) {
 
 
 void diff_match_patch::diff_cleanupSemanticLossless(QList<Diff> &diffs) {
+  QDIFFX_TRACE_SCOPE("dmp", "cleanupSemanticLossless");
   QString equality1, edit, equality2;
   QString commonString;
   int commonOffset;
@@ -926,6 +966,7 @@ QRegularExpression diff_match_patch::BLANKLINESTART = QRegularExpression("^\\r?\
 
 
 void diff_match_patch::diff_cleanupEfficiency(QList<Diff> &diffs) {
+  QDIFFX_TRACE_SCOPE("dmp", "cleanupEfficiency");
   if (diffs.isEmpty()) {
     return;
   }
@@ -1034,6 +1075,7 @@ void diff_match_patch::diff_cleanupEfficiency(QList<Diff> &diffs) {
 
 
 void diff_match_patch::diff_cleanupMerge(QList<Diff> &diffs) {
+  QDIFFX_TRACE_SCOPE("dmp", "cleanupMerge");
   diffs.append(Diff(EQUAL, ""));  // Add a dummy entry at the end.
   QMutableListIterator<Diff> pointer(diffs);
   int count_delete = 0;
@@ -1396,9 +1438,6 @@ int diff_match_patch::match_bitap(const QString &text, const QString &pattern,
     throw "Pattern too long for this application.";
   }
 
-  // Initialise the alphabet.
-  QMap<QChar, int> s = match_alphabet(pattern);
-
   // Highest score beyond which we give up.
   double score_threshold = Match_Threshold;
   // Is there a nearby exact match? (speedup)
@@ -1414,81 +1453,32 @@ int diff_match_patch::match_bitap(const QString &text, const QString &pattern,
     }
   }
 
-  // Initialise the bit arrays.
-  int matchmask = 1 << (pattern.length() - 1);
-  best_loc = -1;
+  // Only start positions close enough to 'loc' can score within the
+  // threshold, whatever their error count.
+  const int radius = Match_Distance == 0 ? 0
+      : static_cast<int>(std::min<double>(score_threshold * Match_Distance,
+                                          text.length()));
+  const int from = std::max(0, loc - radius);
+  const int to = std::min(static_cast<int>(text.length()) - 1, loc + radius);
 
-  int bin_min, bin_mid;
-  int bin_max = pattern.length() + text.length();
-  int *rd;
-  int *last_rd = NULL;
-  for (int d = 0; d < pattern.length(); d++) {
-    // Scan for the best match; each iteration allows for one more error.
-    // Run a binary search to determine how far from 'loc' we can stray at
-    // this error level.
-    bin_min = 0;
-    bin_mid = bin_max;
-    while (bin_min < bin_mid) {
-      if (match_bitapScore(d, loc + bin_mid, loc, pattern)
-          <= score_threshold) {
-        bin_min = bin_mid;
-      } else {
-        bin_max = bin_mid;
-      }
-      bin_mid = (bin_max - bin_min) / 2 + bin_min;
-    }
-    // Use the result from this iteration as the maximum for the next.
-    bin_max = bin_mid;
-    int start = std::max(1, loc - bin_mid + 1);
-    int finish = std::min(static_cast<int>(loc + bin_mid), static_cast<int>(text.length())) + pattern.length();
-
-
-    rd = new int[finish + 2];
-    rd[finish + 1] = (1 << d) - 1;
-    for (int j = finish; j >= start; j--) {
-      int charMatch;
-      if (text.length() <= j - 1) {
-        // Out of range.
-        charMatch = 0;
-      } else {
-        charMatch = s.value(text[j - 1], 0);
-      }
-      if (d == 0) {
-        // First pass: exact match.
-        rd[j] = ((rd[j + 1] << 1) | 1) & charMatch;
-      } else {
-        // Subsequent passes: fuzzy match.
-        rd[j] = ((rd[j + 1] << 1) | 1) & charMatch
-            | (((last_rd[j + 1] | last_rd[j]) << 1) | 1)
-            | last_rd[j + 1];
-      }
-      if ((rd[j] & matchmask) != 0) {
-        double score = match_bitapScore(d, j - 1, loc, pattern);
-        // This match will almost certainly be better than any existing
-        // match.  But check anyway.
-        if (score <= score_threshold) {
-          // Told you so.
-          score_threshold = score;
-          best_loc = j - 1;
-          if (best_loc > loc) {
-            // When passing loc, don't exceed our current distance from loc.
-            start = std::max(1, 2 * loc - best_loc);
-          } else {
-            // Already passed loc, downhill from here on in.
-            break;
-          }
-        }
-      }
+  // One pass of the multi-word matcher yields the best error count for
+  // every start position, for patterns of any length.
+  const std::vector<int> errors = diff_bitap::startDistances(
+      utf16(text), static_cast<int>(text.length()),
+      utf16(pattern), static_cast<int>(pattern.length()), from, to);
+
+  best_loc = -1;
+  for (int x = from; x <= to; x++) {
+    const int d = errors[x - from];
+    if (d >= pattern.length()) {
+      continue;
     }
-    if (match_bitapScore(d + 1, loc, loc, pattern) > score_threshold) {
-      // No hope for a (better) match at greater error levels.
-      break;
+    double score = match_bitapScore(d, x, loc, pattern);
+    if (score < score_threshold || (score == score_threshold && best_loc == -1)) {
+      score_threshold = score;
+      best_loc = x;
     }
-    delete [] last_rd;
-    last_rd = rd;
   }
-  delete [] last_rd;
-  delete [] rd;
   return best_loc;
 }
 
@@ -1841,7 +1831,7 @@ QString diff_match_patch::patch_addPadding(QList<Patch> &patches) {
   }
 
   // Add some padding on end of last diff.
-  Patch &lastPatch = patches.first();
+  Patch &lastPatch = patches.last();
   QList<Diff> &lastPatchDiffs = lastPatch.diffs;
   if (lastPatchDiffs.empty() || lastPatchDiffs.last().operation != EQUAL) {
     // Add nullPadding equality.
@@ -143,7 +143,9 @@ class diff_match_patch {
   // Chunk size for context length.
   short Patch_Margin;
 
-  // The number of bits in an int.
+  // Longest pattern match_bitap accepts (0 for no limit).  The matcher works
+  // on multi-word bit vectors, so this only bounds the cost of a search and
+  // the size of the chunks patches are split into.
   short Match_MaxBits;
 
  private:
@@ -233,6 +235,21 @@ class diff_match_patch {
  protected:
   QList<Diff> diff_bisect(const QString &text1, const QString &text2, clock_t deadline);
 
+  /**
+   * Character-level rediff of one replacement block found by diff_lineMode.
+   * Uses the bit-parallel LCS engine for blocks up to BITPARALLEL_MAX_CELLS
+   * (length of text1 times length of text2), diff_main otherwise.
+   * @param text1 Deleted text.
+   * @param text2 Inserted text.
+   * @param deadline Time when the diff should be complete by.
+   * @return Linked List of Diff objects.
+   */
+ private:
+  QList<Diff> diff_refine(const QString &text1, const QString &text2, clock_t deadline);
+
+  // Largest block (in character pairs) refined with the bit-parallel LCS.
+  static constexpr qint64 BITPARALLEL_MAX_CELLS = qint64(1) << 26;
+
   /**
    * Given the location of the 'middle snake', split the diff in two parts
    * and recurse.
@@ -619,4 +636,14 @@ class diff_match_patch {
   static inline QString safeMid(const QString &str, int pos, int len) {
     return (pos == str.length()) ? QString("") : str.mid(pos, len);
   }
+
+  /**
+   * Raw UTF-16 code units of a string, as consumed by the diff_simd kernels.
+   * @param str String to expose.
+   * @return Pointer to the first code unit.
+   */
+ private:
+  static inline const char16_t *utf16(const QString &str) {
+    return reinterpret_cast<const char16_t *>(str.constData());
+  }
 };
@@ -0,0 +1,252 @@
+/*
+ * QDiffX - Modern Qt6 Diff Algorithm & Widget
+ *
+ * Vectorized UTF-16 comparison kernels used by the diff engines.
+ */
+
+#include "diff_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define DIFF_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(DIFF_SIMD_X86) && (defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define DIFF_SIMD_HAS_SSE2 1
+#endif
+
+#if defined(DIFF_SIMD_HAS_SSE2) && (defined(__GNUC__) || defined(__clang__) \
+    || defined(_MSC_VER))
+#define DIFF_SIMD_HAS_AVX2 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DIFF_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DIFF_SIMD_TARGET_AVX2
+#endif
+
+
+namespace diff_simd {
+
+namespace {
+
+using PrefixKernel = int (*)(const char16_t *, const char16_t *, int);
+using SuffixKernel = int (*)(const char16_t *, const char16_t *, int);
+
+struct KernelSet {
+  PrefixKernel prefix;
+  SuffixKernel suffix;
+  const char *name;
+};
+
+
+inline int lowestSetBit(unsigned int mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+inline int highestSetBit(unsigned int mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanReverse(&index, mask);
+  return static_cast<int>(index);
+#else
+  return 31 - __builtin_clz(mask);
+#endif
+}
+
+
+//  SCALAR KERNELS
+
+
+int scalarCommonPrefix(const char16_t *text1, const char16_t *text2,
+                       int length) {
+  for (int i = 0; i < length; i++) {
+    if (text1[i] != text2[i]) {
+      return i;
+    }
+  }
+  return length;
+}
+
+int scalarCommonSuffix(const char16_t *text1End, const char16_t *text2End,
+                       int length) {
+  for (int i = 1; i <= length; i++) {
+    if (text1End[-i] != text2End[-i]) {
+      return i - 1;
+    }
+  }
+  return length;
+}
+
+
+#if defined(DIFF_SIMD_HAS_SSE2)
+
+//  SSE2 KERNELS (8 code units per step)
+
+
+int sse2CommonPrefix(const char16_t *text1, const char16_t *text2,
+                     int length) {
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text1 + i));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text2 + i));
+    const unsigned int equal = static_cast<unsigned int>(
+        _mm_movemask_epi8(_mm_cmpeq_epi16(a, b)));
+    if (equal != 0xFFFFu) {
+      // Two mask bits per code unit.
+      return i + lowestSetBit(~equal & 0xFFFFu) / 2;
+    }
+  }
+  return i + scalarCommonPrefix(text1 + i, text2 + i, length - i);
+}
+
+int sse2CommonSuffix(const char16_t *text1End, const char16_t *text2End,
+                     int length) {
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const __m128i a = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(text1End - i - 8));
+    const __m128i b = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(text2End - i - 8));
+    const unsigned int equal = static_cast<unsigned int>(
+        _mm_movemask_epi8(_mm_cmpeq_epi16(a, b)));
+    if (equal != 0xFFFFu) {
+      const int lastMismatch = highestSetBit(~equal & 0xFFFFu) / 2;
+      return i + (7 - lastMismatch);
+    }
+  }
+  return i + scalarCommonSuffix(text1End - i, text2End - i, length - i);
+}
+
+#endif  // DIFF_SIMD_HAS_SSE2
+
+
+#if defined(DIFF_SIMD_HAS_AVX2)
+
+//  AVX2 KERNELS (16 code units per step)
+
+
+DIFF_SIMD_TARGET_AVX2
+int avx2CommonPrefix(const char16_t *text1, const char16_t *text2,
+                     int length) {
+  int i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text1 + i));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text2 + i));
+    const unsigned int equal = static_cast<unsigned int>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi16(a, b)));
+    if (equal != 0xFFFFFFFFu) {
+      return i + lowestSetBit(~equal) / 2;
+    }
+  }
+  return i + sse2CommonPrefix(text1 + i, text2 + i, length - i);
+}
+
+DIFF_SIMD_TARGET_AVX2
+int avx2CommonSuffix(const char16_t *text1End, const char16_t *text2End,
+                     int length) {
+  int i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __m256i a = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(text1End - i - 16));
+    const __m256i b = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(text2End - i - 16));
+    const unsigned int equal = static_cast<unsigned int>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi16(a, b)));
+    if (equal != 0xFFFFFFFFu) {
+      const int lastMismatch = highestSetBit(~equal) / 2;
+      return i + (15 - lastMismatch);
+    }
+  }
+  return i + sse2CommonSuffix(text1End - i, text2End - i, length - i);
+}
+
+bool cpuSupportsAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx) {
+    return false;
+  }
+  // The OS must save the YMM registers on context switch.
+  if ((_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif  // DIFF_SIMD_HAS_AVX2
+
+
+KernelSet selectKernels() {
+#if defined(DIFF_SIMD_HAS_AVX2)
+  if (cpuSupportsAvx2()) {
+    return {avx2CommonPrefix, avx2CommonSuffix, "avx2"};
+  }
+#endif
+#if defined(DIFF_SIMD_HAS_SSE2)
+  return {sse2CommonPrefix, sse2CommonSuffix, "sse2"};
+#else
+  return {scalarCommonPrefix, scalarCommonSuffix, "scalar"};
+#endif
+}
+
+const KernelSet &kernels() {
+  // Resolved once; function-local statics are initialised thread-safely.
+  static const KernelSet selected = selectKernels();
+  return selected;
+}
+
+}  // namespace
+
+
+int commonPrefix(const char16_t *text1, const char16_t *text2, int length) {
+  if (length <= 0) {
+    return 0;
+  }
+  // Most snakes in the bisect loop are a handful of characters long, so
+  // settle short mismatches before paying for the dispatch.
+  if (text1[0] != text2[0]) {
+    return 0;
+  }
+  return kernels().prefix(text1, text2, length);
+}
+
+int commonSuffix(const char16_t *text1End, const char16_t *text2End,
+                 int length) {
+  if (length <= 0) {
+    return 0;
+  }
+  if (text1End[-1] != text2End[-1]) {
+    return 0;
+  }
+  return kernels().suffix(text1End, text2End, length);
+}
+
+const char *activeKernel() {
+  return kernels().name;
+}
+
+}  // namespace diff_simd
@@ -0,0 +1,87 @@
+/*
+ * QDiffX - Modern Qt6 Diff Algorithm & Widget
+ *
+ * Vectorized UTF-16 comparison kernels used by the diff engines.
+ *
+ * The kernels compare raw UTF-16 code units, exactly like QChar::operator==
+ * does, so they can be dropped in wherever the engines used to compare
+ * QChars one at a time.  The best implementation for the running CPU
+ * (AVX2, SSE2 or plain scalar) is picked once, on first use.
+ */
+
+#pragma once
+
+/*
+ * Kernel set for comparing runs of UTF-16 code units.
+ */
+namespace diff_simd {
+
+/**
+ * Length of the common prefix of two buffers.
+ * @param text1 First buffer.
+ * @param text2 Second buffer.
+ * @param length Number of code units to inspect in both buffers.
+ * @return Number of leading code units that are equal, at most length.
+ */
+int commonPrefix(const char16_t *text1, const char16_t *text2, int length);
+
+/**
+ * Length of the common suffix of two buffers.
+ * @param text1End One past the last code unit of the first buffer.
+ * @param text2End One past the last code unit of the second buffer.
+ * @param length Number of code units to inspect backwards in both buffers.
+ * @return Number of trailing code units that are equal, at most length.
+ */
+int commonSuffix(const char16_t *text1End, const char16_t *text2End,
+                 int length);
+
+/**
+ * Follow a forward snake (diagonal of matches) in the edit graph.
+ * @param text1 First text.
+ * @param text1_length Length of the first text.
+ * @param text2 Second text.
+ * @param text2_length Length of the second text.
+ * @param x Current position in text1.
+ * @param y Current position in text2.
+ * @return Position in text1 reached once the diagonal ends.
+ */
+inline int snakeForward(const char16_t *text1, int text1_length,
+                        const char16_t *text2, int text2_length,
+                        int x, int y) {
+  const int n = (text1_length - x) < (text2_length - y)
+      ? (text1_length - x) : (text2_length - y);
+  if (n <= 0) {
+    return x;
+  }
+  return x + commonPrefix(text1 + x, text2 + y, n);
+}
+
+/**
+ * Follow a reverse snake in the edit graph.  Positions are measured from
+ * the end of each text, as in the reverse pass of diff_bisect.
+ * @param text1 First text.
+ * @param text1_length Length of the first text.
+ * @param text2 Second text.
+ * @param text2_length Length of the second text.
+ * @param x Current reverse position in text1.
+ * @param y Current reverse position in text2.
+ * @return Reverse position in text1 reached once the diagonal ends.
+ */
+inline int snakeReverse(const char16_t *text1, int text1_length,
+                        const char16_t *text2, int text2_length,
+                        int x, int y) {
+  const int n = (text1_length - x) < (text2_length - y)
+      ? (text1_length - x) : (text2_length - y);
+  if (n <= 0) {
+    return x;
+  }
+  return x + commonSuffix(text1 + text1_length - x,
+                          text2 + text2_length - y, n);
+}
+
+/**
+ * Name of the kernel set selected for this CPU ("avx2", "sse2" or "scalar").
+ */
+const char *activeKernel();
+
+}  // namespace diff_simd
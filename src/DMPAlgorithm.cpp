@@ -1,4 +1,7 @@
 #include "DMPAlgorithm.h"
+#include "QDiffCancellation.h"
+#include "QDiffMemoryBudget.h"
+#include "QDiffProfiler.h"
 #include <QRegularExpression>
 #include <QRegularExpressionMatchIterator>
 #include <QMap>
@@ -16,6 +19,17 @@ const QString DMPAlgorithm::CONFIG_PATCH_DELETE_THRESHOLD = "patch_delete_thresh
 const QString DMPAlgorithm::CONFIG_PATCH_MARGIN = "patch_margin";
 const QString DMPAlgorithm::CONFIG_MATCH_MAX_BITS = "match_max_bits";
 
+// Charges the encoded texts and line table, plus the two bisect vectors diff_main
+// allocates for them, to the memory budget of the running diff
+static void chargeEncoding(const QString &leftText, const QString &rightText,
+                           const QString &chars1, const QString &chars2, const QStringList &lineArray)
+{
+    const qint64 symbols = chars1.size() + chars2.size();
+    QDiffMemoryBudget::require((leftText.size() + rightText.size() + symbols) * qint64(sizeof(QChar))
+                               + lineArray.size() * (qint64(sizeof(QString)) + 32)
+                               + symbols * 2 * qint64(sizeof(int)));
+}
+
 
 
 QDiffX::DMPAlgorithm::DMPAlgorithm() {
@@ -32,6 +46,7 @@ QDiffX::DMPAlgorithm::DMPAlgorithm() {
 QDiffX::QDiffResult QDiffX::DMPAlgorithm::calculateDiff(const QString &leftFile, const QString &rightFile, DiffMode mode)
 {
     QDiffResult result;
+    QDiffProfiler::Scope profile;
     try {
         QList<Diff> dmpChanges;
 
@@ -53,7 +68,10 @@ QDiffX::QDiffResult QDiffX::DMPAlgorithm::calculateDiff(const QString &leftFile,
         }
 
 
+        // diff_bisect bails out with a coarse diff when cancelled, never keep that
+        QDiffCancellation::checkpoint();
         QList<QDiffX::DiffChange> changes = convertDiffList(dmpChanges);
+        QDiffProfiler::phase("convert");
 
         result.setChanges(changes);
         result.setSuccess(true);
@@ -65,6 +83,7 @@ QDiffX::QDiffResult QDiffX::DMPAlgorithm::calculateDiff(const QString &leftFile,
                                (mode == DiffMode::WordByWord) ? "word" : "auto";
         metadata["total_changes"] = changes.size();
         result.setMetaData(metadata);
+        profile.annotate(result, leftFile, rightFile, mode);
 
     } catch (...) {
         result.setSuccess(false);
@@ -93,9 +112,12 @@ QList<Diff> DMPAlgorithm::diffWordByWord(const QString &leftFile, const QString
     QString chars1 = result[0].toString();
     QString chars2 = result[1].toString();
     QStringList lineArray = result[2].toStringList();
+    chargeEncoding(modifiedLeft, modifiedRight, chars1, chars2, lineArray);
     qDebug()<< result[0].toString() << "\n" << result[1].toString() << "\n"<< result[2].toStringList(); ;
+    QDiffProfiler::phase("tokenize");
 
     QList<Diff> diffs = m_dmp.diff_main(chars1, chars2);
+    QDiffProfiler::phase("engine");
     m_dmp.diff_charsToLines(diffs, lineArray);
 
 
@@ -120,9 +142,12 @@ QList<Diff> DMPAlgorithm::diffLineByLine(const QString &leftFile, const QString
     QString chars1 = lineResult[0].toString();
     QString chars2 = lineResult[1].toString();
     QStringList lineArray = lineResult[2].toStringList(); // line mapping
+    chargeEncoding(leftFile, rightFile, chars1, chars2, lineArray);
+    QDiffProfiler::phase("tokenize");
 
     // Diff the encoded strings
     QList<Diff> lineDiffs = m_dmp.diff_main(chars1, chars2);
+    QDiffProfiler::phase("engine");
 
     // Convert back to lines
     m_dmp.diff_charsToLines(lineDiffs, lineArray);
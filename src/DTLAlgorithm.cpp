@@ -1,4 +1,7 @@
 #include "DTLAlgorithm.h"
+#include "QDiffMemoryBudget.h"
+#include "QDiffProfiler.h"
+#include "QDiffTrace.h"
 
 namespace QDiffX {
 
@@ -24,6 +27,7 @@ DTLAlgorithm::DTLAlgorithm()
 QDiffResult DTLAlgorithm::calculateDiff(const QString &leftFile, const QString &rightFile, DiffMode mode)
 {
     QDiffResult result;
+    QDiffProfiler::Scope profile;
     try {
         QList<DiffChange> changes;
 
@@ -52,7 +56,9 @@ QDiffResult DTLAlgorithm::calculateDiff(const QString &leftFile, const QString &
         metadata["algorithm_name"] = getName();
         metadata["mode"] = (mode == DiffMode::LineByLine) ? "line" : "auto";
         metadata["total_changes"] = changes.size();
+        metadata["line_separated"] = true;  // Change texts are lines without their '\n'
         result.setMetaData(metadata);
+        profile.annotate(result, leftFile, rightFile, DiffMode::LineByLine);
 
     } catch (...) {
         result.setSuccess(false);
@@ -67,17 +73,41 @@ QList<DiffChange> DTLAlgorithm::diffLineByLine(const QString &leftFile, const QS
     // Split texts into lines for DTL processing
     QStringList leftLines = splitIntoLines(leftFile);
     QStringList rightLines = splitIntoLines(rightFile);
+    const qint64 lineCount = leftLines.size() + rightLines.size();
+    QDiffMemoryBudget::require((leftFile.size() + rightFile.size()) * qint64(sizeof(QChar))
+                               + lineCount * qint64(sizeof(QString)) * 2);
 
     // Convert to std::vector for DTL
     std::vector<QString> leftVec(leftLines.begin(), leftLines.end());
     std::vector<QString> rightVec(rightLines.begin(), rightLines.end());
+    QDiffProfiler::phase("tokenize");
+
+    // Charged before compose() builds anything, for the worst case: p can reach
+    // the shorter side's length, and compose() records its edit script in steps
+    // once it holds MAX_CORDINATES_SIZE path coordinates
+    const qint64 delta = qAbs(leftLines.size() - rightLines.size());
+    const qint64 p = qMin(leftLines.size(), rightLines.size());
+    const qint64 coordinates = qMin<qint64>(qint64(dtl::MAX_CORDINATES_SIZE) + lineCount, (p + 1) * (delta + p + 1));
+    QDiffMemoryBudget::require((lineCount + 3) * 2 * qint64(sizeof(long long))
+                               + coordinates * 3 * qint64(sizeof(long long))
+                               + lineCount * (qint64(sizeof(DiffChange)) + qint64(sizeof(QString)) + 3 * qint64(sizeof(long long))));
 
     // Create DTL diff object and calculate differences
-    dtl::Diff<QString> dtlDiff(leftVec, rightVec);
-    dtlDiff.compose();
+    DTLLineDiff dtlDiff(leftVec, rightVec);
+    {
+        QDIFFX_TRACE_SCOPE("dtl", "compose");
+        dtlDiff.compose();
+    }
+    QDiffProfiler::phase("engine");
 
     // Convert DTL result to QDiffX format
-    return convertDTLSequence(dtlDiff);
+    QList<DiffChange> changes;
+    {
+        QDIFFX_TRACE_SCOPE("dtl", "convert");
+        changes = convertDTLSequence(dtlDiff);
+    }
+    QDiffProfiler::phase("convert");
+    return changes;
 }
 
 
@@ -151,7 +181,7 @@ double DTLAlgorithm::calculateSimilarity(const QList<DiffChange> &changes, const
 
 // ----------------------- Helper Functions -------------------------
 
-QList<DiffChange> DTLAlgorithm::convertDTLSequence(const dtl::Diff<QString> &dtlDiff) const
+QList<DiffChange> DTLAlgorithm::convertDTLSequence(const DTLLineDiff &dtlDiff) const
 {
     QList<DiffChange> changes;
     auto ses = dtlDiff.getSes();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "QDiffAlgorithm.h"
+#include "QDiffCancellation.h"
 #include "dtl/dtl.hpp"
 /*
 TODO:
@@ -8,6 +9,23 @@ TODO:
 */
 namespace QDiffX {
 
+// Line equality for dtl that aborts compose() once the running diff is cancelled
+class DTLLineCompare : public dtl::Compare<QString>
+{
+public:
+    DTLLineCompare() : m_cancelled(QDiffCancellation::currentFlag()) {}
+    inline bool impl(const QString &e1, const QString &e2) const override {
+        if (m_cancelled && m_cancelled->load(std::memory_order_relaxed))
+            throw QDiffCancelled();
+        return e1 == e2;
+    }
+
+private:
+    const std::atomic_bool *m_cancelled;
+};
+
+using DTLLineDiff = dtl::Diff<QString, std::vector<QString>, DTLLineCompare>;
+
 class DTLAlgorithm : public QDiffAlgorithm
 {
 public:
@@ -39,7 +57,7 @@ public:
 
 private:
     // DTL conversion helpers
-    QList<DiffChange> convertDTLSequence(const dtl::Diff<QString> &dtlDiff) const;
+    QList<DiffChange> convertDTLSequence(const DTLLineDiff &dtlDiff) const;
     DiffOperation convertDTLOperation(dtl::edit_t dtlOp) const;
     void calculateLineNumbers(QList<DiffChange> &changes, const QString &leftFile, const QString &rightFile) const;
 
@@ -0,0 +1,305 @@
+/*
+ * QDiffX - Modern Qt6 Diff Algorithm & Widget
+ *
+ * Bit-parallel longest common subsequence engine.
+ */
+
+#include "bit_parallel_lcs.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+
+
+namespace bit_lcs {
+
+namespace {
+
+using Word = std::uint64_t;
+constexpr int kWordBits = 64;
+
+// Stored columns for a direct traceback may use up to this many words
+// (32 MB); larger problems are split in half first.
+constexpr std::size_t kTracebackBudgetWords = std::size_t(1) << 22;
+
+
+/**
+ * Read-only view of a sequence that can be walked backwards, so the reverse
+ * Hirschberg pass does not need a reversed copy.
+ */
+template<typename Symbol>
+struct Sequence {
+  const Symbol *data;
+  int length;
+  bool reversed;
+
+  Symbol at(int i) const {
+    return reversed ? data[length - 1 - i] : data[i];
+  }
+};
+
+
+/**
+ * Match masks of the first sequence: bit i of mask(c) is set when symbol i
+ * equals c.  Only symbols present in the sequence are stored.
+ */
+template<typename Symbol>
+class PatternMasks {
+ public:
+  explicit PatternMasks(const Sequence<Symbol> &pattern)
+      : words_((pattern.length + kWordBits - 1) / kWordBits) {
+    index_.reserve(64);
+    for (int i = 0; i < pattern.length; i++) {
+      const Symbol c = pattern.at(i);
+      auto it = index_.find(c);
+      int slot;
+      if (it == index_.end()) {
+        slot = static_cast<int>(index_.size());
+        index_.emplace(c, slot);
+        masks_.resize(masks_.size() + words_, 0);
+      } else {
+        slot = it->second;
+      }
+      masks_[static_cast<std::size_t>(slot) * words_ + i / kWordBits]
+          |= Word(1) << (i % kWordBits);
+    }
+  }
+
+  int words() const { return words_; }
+
+  // nullptr when the symbol does not occur in the pattern.
+  const Word *mask(Symbol c) const {
+    auto it = index_.find(c);
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    return masks_.data() + static_cast<std::size_t>(it->second) * words_;
+  }
+
+ private:
+  int words_;
+  std::unordered_map<Symbol, int> index_;
+  std::vector<Word> masks_;
+};
+
+
+/**
+ * Advance one LCS column by one symbol of the second sequence:
+ * V' = (V + (V & M)) | (V & ~M), with the carry rippling across words.
+ * A set bit i in V means row i+1 adds nothing to the LCS of the prefix.
+ */
+inline void advanceColumn(Word *v, const Word *m, int words) {
+  Word carry = 0;
+  for (int w = 0; w < words; w++) {
+    const Word x = v[w];
+    const Word u = x & m[w];
+    Word sum = x + u;
+    Word nextCarry = sum < x ? 1 : 0;
+    sum += carry;
+    nextCarry |= sum < carry ? 1 : 0;
+    v[w] = sum | (x & ~m[w]);
+    carry = nextCarry;
+  }
+}
+
+inline bool testBit(const Word *v, int i) {
+  return ((v[i / kWordBits] >> (i % kWordBits)) & 1) != 0;
+}
+
+
+/**
+ * LCS of every prefix of a against the whole of b:
+ * prefixLcs[i] = LCS(a[0..i), b) for i in [0, a.length].
+ */
+template<typename Symbol>
+std::vector<int> prefixLcs(const Sequence<Symbol> &a, const Sequence<Symbol> &b) {
+  const PatternMasks<Symbol> masks(a);
+  const int words = masks.words();
+  std::vector<Word> v(static_cast<std::size_t>(words), ~Word(0));
+  for (int j = 0; j < b.length; j++) {
+    const Word *m = masks.mask(b.at(j));
+    if (m != nullptr) {
+      advanceColumn(v.data(), m, words);
+    }
+  }
+  std::vector<int> lcs(static_cast<std::size_t>(a.length) + 1, 0);
+  for (int i = 0; i < a.length; i++) {
+    lcs[i + 1] = lcs[i] + (testBit(v.data(), i) ? 0 : 1);
+  }
+  return lcs;
+}
+
+
+void appendRun(std::vector<Edit> &edits, EditOp op, int length) {
+  if (length <= 0) {
+    return;
+  }
+  if (!edits.empty() && edits.back().op == op) {
+    edits.back().length += length;
+  } else {
+    edits.push_back(Edit{op, length});
+  }
+}
+
+
+/**
+ * Diff small enough to keep every column: run the bit-parallel pass once,
+ * storing the columns, then walk back from the bottom-right corner.
+ */
+template<typename Symbol>
+void directDiff(const Symbol *a, int m, const Symbol *b, int n,
+                std::vector<Edit> &edits) {
+  const PatternMasks<Symbol> masks(Sequence<Symbol>{a, m, false});
+  const int words = masks.words();
+  std::vector<Word> columns((static_cast<std::size_t>(n) + 1) * words, ~Word(0));
+  for (int j = 0; j < n; j++) {
+    Word *column = columns.data() + static_cast<std::size_t>(j + 1) * words;
+    std::copy_n(column - words, words, column);
+    const Word *mask = masks.mask(b[j]);
+    if (mask != nullptr) {
+      advanceColumn(column, mask, words);
+    }
+  }
+
+  // Equal symbols always extend the LCS diagonally; otherwise a set bit
+  // says the row above holds the same LCS value, so a[i-1] can be dropped.
+  std::vector<Edit> reversed;
+  int i = m;
+  int j = n;
+  while (i > 0 || j > 0) {
+    if (i > 0 && j > 0 && a[i - 1] == b[j - 1]) {
+      appendRun(reversed, EditOp::Equal, 1);
+      i--;
+      j--;
+    } else if (i > 0 && testBit(columns.data() + static_cast<std::size_t>(j) * words, i - 1)) {
+      appendRun(reversed, EditOp::Delete, 1);
+      i--;
+    } else {
+      appendRun(reversed, EditOp::Insert, 1);
+      j--;
+    }
+  }
+  for (auto it = reversed.rbegin(); it != reversed.rend(); ++it) {
+    appendRun(edits, it->op, it->length);
+  }
+}
+
+
+template<typename Symbol>
+void solve(const Symbol *a, int m, const Symbol *b, int n,
+           std::vector<Edit> &edits) {
+  // Trim off common prefix and suffix (speedup).
+  int prefix = 0;
+  const int shortest = std::min(m, n);
+  while (prefix < shortest && a[prefix] == b[prefix]) {
+    prefix++;
+  }
+  int suffix = 0;
+  while (suffix < shortest - prefix
+         && a[m - 1 - suffix] == b[n - 1 - suffix]) {
+    suffix++;
+  }
+  appendRun(edits, EditOp::Equal, prefix);
+  a += prefix;
+  b += prefix;
+  m -= prefix + suffix;
+  n -= prefix + suffix;
+
+  if (m == 0 || n == 0) {
+    appendRun(edits, EditOp::Delete, m);
+    appendRun(edits, EditOp::Insert, n);
+  } else {
+    const std::size_t words = static_cast<std::size_t>((m + kWordBits - 1) / kWordBits);
+    if ((static_cast<std::size_t>(n) + 1) * words <= kTracebackBudgetWords || n == 1) {
+      directDiff(a, m, b, n, edits);
+    } else {
+      // Hirschberg split: pick the row where the upper half of b meets
+      // the lower half on an optimal path.
+      const int mid = n / 2;
+      const std::vector<int> upper = prefixLcs(Sequence<Symbol>{a, m, false},
+                                               Sequence<Symbol>{b, mid, false});
+      const std::vector<int> lower = prefixLcs(Sequence<Symbol>{a, m, true},
+                                               Sequence<Symbol>{b + mid, n - mid, true});
+      int split = 0;
+      int best = -1;
+      for (int k = 0; k <= m; k++) {
+        const int total = upper[k] + lower[m - k];
+        if (total > best) {
+          best = total;
+          split = k;
+        }
+      }
+      solve(a, split, b, mid, edits);
+      solve(a + split, m - split, b + mid, n - mid, edits);
+    }
+  }
+
+  appendRun(edits, EditOp::Equal, suffix);
+}
+
+
+/**
+ * Put every gap between two equalities in Delete-then-Insert order and
+ * merge the runs of each kind.
+ */
+std::vector<Edit> normalize(const std::vector<Edit> &edits) {
+  std::vector<Edit> result;
+  result.reserve(edits.size());
+  int deleted = 0;
+  int inserted = 0;
+  for (const Edit &edit : edits) {
+    switch (edit.op) {
+      case EditOp::Delete:
+        deleted += edit.length;
+        break;
+      case EditOp::Insert:
+        inserted += edit.length;
+        break;
+      case EditOp::Equal:
+        appendRun(result, EditOp::Delete, deleted);
+        appendRun(result, EditOp::Insert, inserted);
+        appendRun(result, EditOp::Equal, edit.length);
+        deleted = 0;
+        inserted = 0;
+        break;
+    }
+  }
+  appendRun(result, EditOp::Delete, deleted);
+  appendRun(result, EditOp::Insert, inserted);
+  return result;
+}
+
+}  // namespace
+
+
+template<typename Symbol>
+std::vector<Edit> diff(const Symbol *text1, int text1_length,
+                       const Symbol *text2, int text2_length) {
+  std::vector<Edit> edits;
+  if (text1_length <= 0 && text2_length <= 0) {
+    return edits;
+  }
+  solve(text1, std::max(text1_length, 0), text2, std::max(text2_length, 0), edits);
+  return normalize(edits);
+}
+
+template<typename Symbol>
+int lcsLength(const Symbol *text1, int text1_length,
+              const Symbol *text2, int text2_length) {
+  if (text1_length <= 0 || text2_length <= 0) {
+    return 0;
+  }
+  return prefixLcs(Sequence<Symbol>{text1, text1_length, false},
+                   Sequence<Symbol>{text2, text2_length, false})[text1_length];
+}
+
+template std::vector<Edit> diff<char16_t>(const char16_t *, int,
+                                          const char16_t *, int);
+template std::vector<Edit> diff<std::uint32_t>(const std::uint32_t *, int,
+                                               const std::uint32_t *, int);
+template int lcsLength<char16_t>(const char16_t *, int,
+                                 const char16_t *, int);
+template int lcsLength<std::uint32_t>(const std::uint32_t *, int,
+                                      const std::uint32_t *, int);
+
+}  // namespace bit_lcs
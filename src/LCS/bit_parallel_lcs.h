@@ -0,0 +1,71 @@
+/*
+ * QDiffX - Modern Qt6 Diff Algorithm & Widget
+ *
+ * Bit-parallel longest common subsequence engine.
+ *
+ * Computes an optimal (minimal insert + delete) edit script between two
+ * symbol sequences using the Allison-Dix / Hyyro bit-vector formulation:
+ * one column of the LCS matrix is held as a bit vector of the first text
+ * and advanced 64 rows per machine word.  Small problems are traced back
+ * from the stored columns; larger ones are split Hirschberg-style so the
+ * working set stays bounded.
+ *
+ * Symbols are UTF-16 code units for character diffs, or interned ids for
+ * line and word diffs.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Bit-parallel LCS diff engine.
+ */
+namespace bit_lcs {
+
+enum class EditOp : unsigned char {
+  Equal,
+  Delete,
+  Insert
+};
+
+/**
+ * One run of the edit script.  Equal and Delete runs consume text1,
+ * Equal and Insert runs consume text2.  Within each gap between two Equal
+ * runs the Delete run always precedes the Insert run.
+ */
+struct Edit {
+  EditOp op;
+  int length;
+};
+
+/**
+ * Compute the edit script turning text1 into text2.
+ * @param text1 Old sequence.
+ * @param text1_length Length of the old sequence.
+ * @param text2 New sequence.
+ * @param text2_length Length of the new sequence.
+ * @return Edit runs, empty when both sequences are empty.
+ */
+template<typename Symbol>
+std::vector<Edit> diff(const Symbol *text1, int text1_length,
+                       const Symbol *text2, int text2_length);
+
+/**
+ * Length of the longest common subsequence, without building a script.
+ */
+template<typename Symbol>
+int lcsLength(const Symbol *text1, int text1_length,
+              const Symbol *text2, int text2_length);
+
+extern template std::vector<Edit> diff<char16_t>(const char16_t *, int,
+                                                 const char16_t *, int);
+extern template std::vector<Edit> diff<std::uint32_t>(const std::uint32_t *, int,
+                                                      const std::uint32_t *, int);
+extern template int lcsLength<char16_t>(const char16_t *, int,
+                                        const char16_t *, int);
+extern template int lcsLength<std::uint32_t>(const std::uint32_t *, int,
+                                             const std::uint32_t *, int);
+
+}  // namespace bit_lcs
@@ -0,0 +1,354 @@
+#include "LCSAlgorithm.h"
+#include "QDiffMemoryBudget.h"
+#include "QDiffProfiler.h"
+#include "QDiffTrace.h"
+#include <QHash>
+#include <limits>
+
+namespace QDiffX {
+
+const QString LCSAlgorithm::CONFIG_MAX_CHAR_LENGTH = "max_char_length";
+
+// Helper to number changes the same way DMPAlgorithm::convertDiffList does
+static void assignPositions(QList<DiffChange> &changes)
+{
+    int position = 0;
+    int line = 1;
+    for (auto &change : changes) {
+        change.lineNumber = line;
+        change.position = position;
+        if (change.operation != DiffOperation::Delete) {
+            position += change.text.length();
+        }
+        line++;
+    }
+}
+
+static const char16_t *utf16(const QString &text)
+{
+    return reinterpret_cast<const char16_t *>(text.constData());
+}
+
+// Charges the stored traceback columns of bit_lcs::diff (capped by its
+// kTracebackBudgetWords) and its linear rows to the running diff's memory budget
+static void chargeEngine(qint64 leftLength, qint64 rightLength)
+{
+    const qint64 tracebackWords = qMin<qint64>(qint64(1) << 22, (rightLength + 1) * ((leftLength + 63) / 64));
+    QDiffMemoryBudget::require(tracebackWords * 8 + (leftLength + rightLength) * qint64(sizeof(int)) * 2);
+}
+
+static DiffOperation convertOperation(bit_lcs::EditOp op)
+{
+    switch (op) {
+    case bit_lcs::EditOp::Insert:
+        return DiffOperation::Insert;
+    case bit_lcs::EditOp::Delete:
+        return DiffOperation::Delete;
+    case bit_lcs::EditOp::Equal:
+    default:
+        return DiffOperation::Equal;
+    }
+}
+
+
+LCSAlgorithm::LCSAlgorithm()
+{
+    QMap<QString, QVariant> defaultConfig;
+    defaultConfig[CONFIG_MAX_CHAR_LENGTH] = DEFAULT_MAX_CHAR_LENGTH;
+
+    setConfiguration(defaultConfig);
+}
+
+// ----------------------- Diff calculation -------------------------
+
+QDiffResult LCSAlgorithm::calculateDiff(const QString &leftFile, const QString &rightFile, DiffMode mode)
+{
+    QDiffResult result;
+    QDiffProfiler::Scope profile;
+    try {
+        QList<DiffChange> changes;
+        QString modeName;
+
+        switch (mode) {
+        case DiffMode::CharByChar:
+            changes = diffCharByChar(leftFile, rightFile);
+            modeName = "char";
+            break;
+
+        case DiffMode::WordByWord:
+            changes = diffWordByWord(leftFile, rightFile);
+            modeName = "word";
+            break;
+
+        case DiffMode::LineByLine:
+            changes = diffLineByLine(leftFile, rightFile);
+            modeName = "line";
+            break;
+
+        case DiffMode::Auto:
+        default:
+            changes = diffLineByLine(leftFile, rightFile);
+            modeName = "auto";
+            break;
+        }
+
+        result.setChanges(changes);
+        result.setSuccess(true);
+
+        // Add metadata about the algorithm used
+        QMap<QString, QVariant> metadata;
+        metadata["algorithm"] = "LCS";
+        metadata["algorithm_name"] = getName();
+        metadata["mode"] = modeName;
+        metadata["total_changes"] = changes.size();
+        result.setMetaData(metadata);
+        profile.annotate(result, leftFile, rightFile, mode);
+
+    } catch (...) {
+        result.setSuccess(false);
+        result.setErrorMessage("LCS algorithm failed to calculate diff");
+    }
+
+    return result;
+}
+
+QList<DiffChange> LCSAlgorithm::diffCharByChar(const QString &leftFile, const QString &rightFile) const
+{
+    if (leftFile.length() <= m_maxCharLength && rightFile.length() <= m_maxCharLength) {
+        QDIFFX_TRACE_SCOPE("lcs", "diffChars");
+        chargeEngine(leftFile.length(), rightFile.length());
+        auto edits = bit_lcs::diff(utf16(leftFile), int(leftFile.length()),
+                                   utf16(rightFile), int(rightFile.length()));
+        QDiffProfiler::phase("engine");
+        QList<DiffChange> changes = convertEdits(edits, leftFile, rightFile);
+        assignPositions(changes);
+        QDiffProfiler::phase("convert");
+        return changes;
+    }
+
+    // Too large for a whole-text character diff: align lines first, then
+    // refine each replaced block that is small enough character by character.
+    const QList<DiffChange> lineChanges = diffLineByLine(leftFile, rightFile);
+    QList<DiffChange> changes;
+    for (int i = 0; i < lineChanges.size(); ++i) {
+        const DiffChange &change = lineChanges[i];
+        const bool isReplacement = change.operation == DiffOperation::Delete
+                                   && i + 1 < lineChanges.size()
+                                   && lineChanges[i + 1].operation == DiffOperation::Insert;
+        if (isReplacement) {
+            const QString &deleted = change.text;
+            const QString &inserted = lineChanges[i + 1].text;
+            if (deleted.length() <= m_maxCharLength && inserted.length() <= m_maxCharLength) {
+                auto edits = bit_lcs::diff(utf16(deleted), int(deleted.length()),
+                                           utf16(inserted), int(inserted.length()));
+                QDiffProfiler::phase("engine");
+                changes += convertEdits(edits, deleted, inserted);
+                QDiffProfiler::phase("convert");
+                ++i;
+                continue;
+            }
+        }
+        changes.append(change);
+    }
+    assignPositions(changes);
+    QDiffProfiler::phase("convert");
+    return changes;
+}
+
+QList<DiffChange> LCSAlgorithm::diffLineByLine(const QString &leftFile, const QString &rightFile) const
+{
+    QList<DiffChange> changes = diffTokens(splitIntoLines(leftFile), splitIntoLines(rightFile));
+    assignPositions(changes);
+    QDiffProfiler::phase("convert");
+    return changes;
+}
+
+QList<DiffChange> LCSAlgorithm::diffWordByWord(const QString &leftFile, const QString &rightFile) const
+{
+    QList<DiffChange> changes = diffTokens(splitIntoWords(leftFile), splitIntoWords(rightFile));
+    assignPositions(changes);
+    QDiffProfiler::phase("convert");
+    return changes;
+}
+
+// ----------------------- Algorithm Info -------------------------
+
+AlgorithmCapabilities LCSAlgorithm::getCapabilities() const
+{
+    AlgorithmCapabilities caps;
+    caps.supportsLargeFiles = false;
+    caps.supportsUnicode = true;
+    caps.supportsBinary = false;
+    caps.supportsLineByLine = true;
+    caps.supportsCharByChar = true;
+    caps.supportsWordByWord = true;
+    caps.maxRecommendedSize = 2 * DEFAULT_MAX_CHAR_LENGTH;
+    caps.description = getDescription();
+
+    return caps;
+}
+
+// ----------------------- Algorithm Configuration -------------------------
+
+void LCSAlgorithm::setConfiguration(const QMap<QString, QVariant> &newConfig)
+{
+    QDiffAlgorithm::setConfiguration(newConfig);
+
+    if (newConfig.contains(CONFIG_MAX_CHAR_LENGTH)) {
+        m_maxCharLength = qMax(0, newConfig[CONFIG_MAX_CHAR_LENGTH].toInt());
+    }
+}
+
+QStringList LCSAlgorithm::getConfigurationKeys() const
+{
+    return {
+        CONFIG_MAX_CHAR_LENGTH
+    };
+}
+
+// ----------------------- Performance -------------------------
+
+int LCSAlgorithm::estimateComplexity(const QString &leftText, const QString &rightText) const
+{
+    // One 64-bit word operation per 64 characters of the left text, per character of the right text
+    const qint64 words = (leftText.length() + 63) / 64;
+    const qint64 cost = words * rightText.length();
+    return int(qMin<qint64>(cost, std::numeric_limits<int>::max()));
+}
+
+bool LCSAlgorithm::isRecommendedFor(const QString &leftText, const QString &rightText) const
+{
+    return leftText.length() <= m_maxCharLength && rightText.length() <= m_maxCharLength;
+}
+
+// ----------------------- Helper Functions -------------------------
+
+QList<DiffChange> LCSAlgorithm::diffTokens(const QStringList &leftTokens, const QStringList &rightTokens) const
+{
+    QDIFFX_TRACE_SCOPE("lcs", "diffTokens");
+    // Intern tokens so the engine compares 32-bit ids instead of strings
+    QHash<QString, quint32> ids;
+    ids.reserve(leftTokens.size() + rightTokens.size());
+    auto intern = [&ids](const QStringList &tokens) {
+        std::vector<std::uint32_t> sequence;
+        sequence.reserve(tokens.size());
+        for (const QString &token : tokens) {
+            auto it = ids.constFind(token);
+            if (it == ids.constEnd())
+                it = ids.insert(token, quint32(ids.size()));
+            sequence.push_back(it.value());
+        }
+        return sequence;
+    };
+    const std::vector<std::uint32_t> left = intern(leftTokens);
+    const std::vector<std::uint32_t> right = intern(rightTokens);
+    QDiffMemoryBudget::require((leftTokens.size() + rightTokens.size()) * (qint64(sizeof(QString)) + 32 + 4));
+    chargeEngine(qint64(left.size()), qint64(right.size()));
+    QDiffProfiler::phase("tokenize");
+
+    auto edits = bit_lcs::diff(left.data(), int(left.size()), right.data(), int(right.size()));
+    QDiffProfiler::phase("engine");
+    return convertTokenEdits(edits, leftTokens, rightTokens);
+}
+
+QList<DiffChange> LCSAlgorithm::convertEdits(const std::vector<bit_lcs::Edit> &edits,
+                                             const QString &leftFile, const QString &rightFile) const
+{
+    QList<DiffChange> changes;
+    changes.reserve(int(edits.size()));
+    int leftPos = 0, rightPos = 0;
+    for (const auto &edit : edits) {
+        DiffChange change;
+        change.operation = convertOperation(edit.op);
+        switch (edit.op) {
+        case bit_lcs::EditOp::Equal:
+            change.text = leftFile.mid(leftPos, edit.length);
+            leftPos += edit.length;
+            rightPos += edit.length;
+            break;
+        case bit_lcs::EditOp::Delete:
+            change.text = leftFile.mid(leftPos, edit.length);
+            leftPos += edit.length;
+            break;
+        case bit_lcs::EditOp::Insert:
+            change.text = rightFile.mid(rightPos, edit.length);
+            rightPos += edit.length;
+            break;
+        }
+        changes.append(change);
+    }
+    return changes;
+}
+
+QList<DiffChange> LCSAlgorithm::convertTokenEdits(const std::vector<bit_lcs::Edit> &edits,
+                                                  const QStringList &leftTokens, const QStringList &rightTokens) const
+{
+    QList<DiffChange> changes;
+    changes.reserve(int(edits.size()));
+    int leftPos = 0, rightPos = 0;
+    auto joinRange = [](const QStringList &tokens, int from, int count) {
+        QString text;
+        for (int i = from; i < from + count; ++i)
+            text += tokens[i];
+        return text;
+    };
+    for (const auto &edit : edits) {
+        DiffChange change;
+        change.operation = convertOperation(edit.op);
+        switch (edit.op) {
+        case bit_lcs::EditOp::Equal:
+            change.text = joinRange(leftTokens, leftPos, edit.length);
+            leftPos += edit.length;
+            rightPos += edit.length;
+            break;
+        case bit_lcs::EditOp::Delete:
+            change.text = joinRange(leftTokens, leftPos, edit.length);
+            leftPos += edit.length;
+            break;
+        case bit_lcs::EditOp::Insert:
+            change.text = joinRange(rightTokens, rightPos, edit.length);
+            rightPos += edit.length;
+            break;
+        }
+        changes.append(change);
+    }
+    return changes;
+}
+
+QStringList LCSAlgorithm::splitIntoLines(const QString &text) const
+{
+    // Lines keep their '\n' so the joined runs reproduce the input exactly
+    QStringList lines;
+    int lineStart = 0;
+    while (lineStart < text.length()) {
+        int lineEnd = text.indexOf('\n', lineStart);
+        if (lineEnd == -1)
+            lineEnd = text.length() - 1;
+        lines.append(text.mid(lineStart, lineEnd + 1 - lineStart));
+        lineStart = lineEnd + 1;
+    }
+    return lines;
+}
+
+QStringList LCSAlgorithm::splitIntoWords(const QString &text) const
+{
+    // Words, whitespace runs and single punctuation marks are separate tokens
+    QStringList tokens;
+    int i = 0;
+    while (i < text.length()) {
+        const QChar c = text[i];
+        int j = i + 1;
+        if (c.isLetterOrNumber() || c == '_') {
+            while (j < text.length() && (text[j].isLetterOrNumber() || text[j] == '_'))
+                ++j;
+        } else if (c.isSpace()) {
+            while (j < text.length() && text[j].isSpace() && text[j] != '\n' && c != '\n')
+                ++j;
+        }
+        tokens.append(text.mid(i, j - i));
+        i = j;
+    }
+    return tokens;
+}
+
+} // namespace QDiffX
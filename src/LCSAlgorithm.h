@@ -0,0 +1,61 @@
+#pragma once
+
+#include "QDiffAlgorithm.h"
+#include "LCS/bit_parallel_lcs.h"
+
+namespace QDiffX {
+
+// Character-level diff engine built on the bit-parallel LCS in LCS/.
+// Line and word modes intern their tokens and run the same engine on ids.
+class LCSAlgorithm : public QDiffAlgorithm
+{
+public:
+    LCSAlgorithm();
+    virtual ~LCSAlgorithm() = default;
+
+    // QDiffAlgorithm interface Implementation
+    QDiffResult calculateDiff(const QString &leftFile, const QString &rightFile, DiffMode mode = DiffMode::Auto) override;
+
+    // diff methods
+    QList<DiffChange> diffCharByChar(const QString &leftFile, const QString &rightFile) const;
+    QList<DiffChange> diffLineByLine(const QString &leftFile, const QString &rightFile) const;
+    QList<DiffChange> diffWordByWord(const QString &leftFile, const QString &rightFile) const;
+
+    QString getName() const override { return "Bit-Parallel-LCS-Algorithm"; }
+    QString getDescription() const override {
+        return "Bit-parallel (Allison-Dix / Hyyro) LCS engine producing minimal character, word or line edit scripts for medium-sized texts";
+    }
+
+    AlgorithmCapabilities getCapabilities() const override;
+
+    // Algorithm Configuration
+    void setConfiguration(const QMap<QString, QVariant> &newConfig) override;
+    QStringList getConfigurationKeys() const override;
+
+    // Performance
+    int estimateComplexity(const QString &leftText, const QString &rightText) const override;
+    bool isRecommendedFor(const QString &leftText, const QString &rightText) const override;
+
+    // Default upper bound, per side, for a whole-text character diff
+    static constexpr int DEFAULT_MAX_CHAR_LENGTH = 100000;
+
+private:
+    // Runs the engine over interned tokens and rebuilds the text of each run
+    QList<DiffChange> diffTokens(const QStringList &leftTokens, const QStringList &rightTokens) const;
+    QList<DiffChange> convertEdits(const std::vector<bit_lcs::Edit> &edits,
+                                   const QString &leftFile, const QString &rightFile) const;
+    QList<DiffChange> convertTokenEdits(const std::vector<bit_lcs::Edit> &edits,
+                                        const QStringList &leftTokens, const QStringList &rightTokens) const;
+
+    // Tokenizers
+    QStringList splitIntoLines(const QString &text) const;
+    QStringList splitIntoWords(const QString &text) const;
+
+private:
+    int m_maxCharLength = DEFAULT_MAX_CHAR_LENGTH;
+
+    // Configuration keys
+    static const QString CONFIG_MAX_CHAR_LENGTH;
+};
+
+} // namespace QDiffX
@@ -1,9 +1,15 @@
 #include "QAlgorithmManager.h"
+#include "DMP/diff_bitap.h"
+#include "DMP/diff_match_patch.h"
+#include "QDiffTrace.h"
+#include <QElapsedTimer>
 #include <QtConcurrent/QtConcurrent>
 
 namespace QDiffX{
 const QString QAlgorithmManager::DEFAULT_ALGORITHM = "dtl";
 const QString QAlgorithmManager::DEFAULT_FALLBACK = "dmp";
+const QString QAlgorithmManager::LINEAR_MEMORY_ALGORITHM = "lcs";
+const QString QAlgorithmManager::RACE_ALGORITHMS[2] = {"dtl", "dmp"};
 
 
 QAlgorithmManager::QAlgorithmManager(QObject *parent)
@@ -12,13 +18,12 @@ QAlgorithmManager::QAlgorithmManager(QObject *parent)
     m_fallBackAlgorithm(DEFAULT_FALLBACK),
     m_selectionMode(QAlgorithmSelectionMode::Auto),
     m_executionMode(QExecutionMode::Synchronous),
-    m_lastError(QAlgorithmManagerError::None),
-    m_isCalculating(false)
+    m_lastError(QAlgorithmManagerError::None)
 {
 
 }
 
-QFuture<QDiffResult> QAlgorithmManager::calculateDiff(const QString &leftText, const QString &rightText, QExecutionMode executionMode, QAlgorithmSelectionMode selectionMode, QString algorithmId)
+QFuture<QDiffResult> QAlgorithmManager::calculateDiff(const QString &leftText, const QString &rightText, QExecutionMode executionMode, QAlgorithmSelectionMode selectionMode, QString algorithmId, QDiffPriority priority)
 {
     if (executionMode == QExecutionMode::Synchronous) {
         QPromise<QDiffResult> promise;
@@ -26,12 +31,14 @@ QFuture<QDiffResult> QAlgorithmManager::calculateDiff(const QString &leftText, c
         promise.addResult(calculateDiffSync(leftText, rightText, selectionMode, algorithmId));
         promise.finish();
         return promise.future();
+    } else if (executionMode == QExecutionMode::OutOfProcess) {
+        return calculateDiffOutOfProcess(leftText, rightText, selectionMode, algorithmId);
     } else {
-        return calculateDiffAsync(leftText, rightText, selectionMode, algorithmId);
+        return calculateDiffAsync(leftText, rightText, selectionMode, algorithmId, priority);
     }
 }
 
-QFuture<QDiffResult> QAlgorithmManager::calculateDiffAsync(const QString &leftText, const QString &rightText, QAlgorithmSelectionMode selectionMode, QString algorithmId)
+QFuture<QDiffResult> QAlgorithmManager::calculateDiffAsync(const QString &leftText, const QString &rightText, QAlgorithmSelectionMode selectionMode, QString algorithmId, QDiffPriority priority)
 {
     QString algorithm;
     if(selectionMode == QAlgorithmSelectionMode::Manual)
@@ -63,14 +70,25 @@ QFuture<QDiffResult> QAlgorithmManager::calculateDiffAsync(const QString &leftTe
             algorithm = algorithmId;
         }
     }
-    else {
+    else if (selectionMode == QAlgorithmSelectionMode::Auto) {
         algorithm = autoSelectAlgorithm(leftText, rightText);
     }
-    auto future =  QtConcurrent::run(&QAlgorithmManager::executeAlgorithm,
-                                    this,
-                                    algorithm,
-                                    leftText,
-                                    rightText);
+    if (isTinyDiff(leftText, rightText, selectionMode)) {
+        const QDiffResult result = executeTinyDiff(algorithm, leftText, rightText);
+        // Still delivered from the event loop, as it would be from a worker thread
+        if (hasReceivers(&QAlgorithmManager::diffCalculated))
+            QMetaObject::invokeMethod(this, [this, result]() { emit diffCalculated(result); }, Qt::QueuedConnection);
+        QPromise<QDiffResult> promise;
+        promise.start();
+        promise.addResult(result);
+        promise.finish();
+        return promise.future();
+    }
+    auto future = selectionMode == QAlgorithmSelectionMode::Racing
+                      ? m_taskPool.run(priority, [this, leftText, rightText]() { return executeRace(leftText, rightText); })
+                      : m_taskPool.run(priority, [this, algorithm, leftText, rightText]() {
+                            return executeAlgorithm(algorithm, leftText, rightText);
+                        });
     auto *watcher = new QFutureWatcher<QDiffResult>(this);
     connect(watcher, &QFutureWatcher<QDiffResult>::finished, this, [this, watcher]() {
         emit diffCalculated(watcher->result());
@@ -101,10 +119,17 @@ QDiffResult QAlgorithmManager::calculateDiffSync(const QString &leftText, const
             }
             algorithm = algorithmId;
         }
-    } else {
+    } else if (selectionMode == QAlgorithmSelectionMode::Auto) {
         algorithm = autoSelectAlgorithm(leftText, rightText);
     }
-    QDiffResult result = executeAlgorithm(algorithm, leftText, rightText);
+    if (isTinyDiff(leftText, rightText, selectionMode)) {
+        QDiffResult result = executeTinyDiff(algorithm, leftText, rightText);
+        if (result.success() && hasReceivers(&QAlgorithmManager::diffCalculated))
+            emit diffCalculated(result);
+        return result;
+    }
+    QDiffResult result = selectionMode == QAlgorithmSelectionMode::Racing ? executeRace(leftText, rightText)
+                                                                          : executeAlgorithm(algorithm, leftText, rightText);
     if (result.success()) {
         emit diffCalculated(result);
     }
@@ -128,8 +153,108 @@ QDiffResult QAlgorithmManager::calculateDiffWithAlgorithm(const QString &algorit
     return executeAlgorithm(algorithmId, leftText, rightText);
 }
 
+QFuture<QDiffResult> QAlgorithmManager::calculateDiffOutOfProcess(const QString &leftText, const QString &rightText, QAlgorithmSelectionMode selectionMode, QString algorithmId)
+{
+    auto future = submitOutOfProcess(leftText, rightText, selectionMode, algorithmId, nullptr);
+    auto *watcher = new QFutureWatcher<QDiffResult>(this);
+    connect(watcher, &QFutureWatcher<QDiffResult>::finished, this, [this, watcher]() {
+        emit diffCalculated(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(future);
+    return future;
+}
+
+QFuture<QDiffResult> QAlgorithmManager::submitOutOfProcess(const QString &leftText, const QString &rightText, QAlgorithmSelectionMode selectionMode, QString algorithmId, QString *algorithmUsed)
+{
+    QString algorithm;
+    if (selectionMode == QAlgorithmSelectionMode::Manual) {
+        algorithm = algorithmId.isEmpty() ? m_currentAlgorithm : algorithmId;
+        QAlgorithmManagerError error = QAlgorithmManagerError::None;
+        if (algorithm.isEmpty())
+            error = QAlgorithmManagerError::InvalidAlgorithmId;
+        else if (!isAlgorithmAvailable(algorithm))
+            error = QAlgorithmManagerError::AlgorithmNotFound;
+        if (error != QAlgorithmManagerError::None) {
+            setLastError(error);
+            if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::submitOutOfProcess:: Algorithm " << '"' << algorithm << '"' << " is not usable";
+            emit errorOccurred(error, errorMessage(error));
+            QPromise<QDiffResult> promise;
+            promise.start();
+            promise.addResult(QDiffResult(errorMessage(error)));
+            promise.finish();
+            return promise.future();
+        }
+    } else {
+        algorithm = autoSelectAlgorithm(leftText, rightText);
+    }
+    if (algorithmUsed)
+        *algorithmUsed = algorithm;
+
+    auto future = processPool()->submit(algorithm, m_diffMode, leftText, rightText);
+    auto *watcher = new QFutureWatcher<QDiffResult>(this);
+    connect(watcher, &QFutureWatcher<QDiffResult>::finished, this, [this, watcher]() {
+        const QDiffResult result = watcher->result();
+        if (!result.success()) {
+            setLastError(QAlgorithmManagerError::DiffExecutionFailed);
+            if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::submitOutOfProcess:: Diff failed:" << result.errorMessage();
+            emit errorOccurred(QAlgorithmManagerError::DiffExecutionFailed, result.errorMessage());
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(future);
+    return future;
+}
+
+QProcessDiffPool *QAlgorithmManager::processPool()
+{
+    if (!m_processPool)
+        m_processPool = new QProcessDiffPool(this);
+    return m_processPool;
+}
 
-QFuture<QSideBySideDiffResult> QAlgorithmManager::calculateSideBySideDiff(const QString &leftText, const QString &rightText, QExecutionMode executionMode, QAlgorithmSelectionMode selectionMode, QString algorithmId)
+QFuture<QDiffResult> QAlgorithmManager::calculateBatchDiff(const QList<QDiffPair> &pairs, QAlgorithmSelectionMode selectionMode, QString algorithmId)
+{
+    QString algorithm;
+    if (selectionMode == QAlgorithmSelectionMode::Manual) {
+        algorithm = algorithmId.isEmpty() ? m_currentAlgorithm : algorithmId;
+        if (algorithm.isEmpty()) {
+            setLastError(QAlgorithmManagerError::InvalidAlgorithmId);
+            if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::calculateBatchDiff:: Algorithm ID is empty no selected algorithm";
+            emit errorOccurred(QAlgorithmManagerError::InvalidAlgorithmId, errorMessage(QAlgorithmManagerError::InvalidAlgorithmId));
+            return QFuture<QDiffResult>();
+        }
+        if (!isAlgorithmAvailable(algorithm)) {
+            setLastError(QAlgorithmManagerError::AlgorithmNotFound);
+            if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::calculateBatchDiff:: Algorithm " << '"' << algorithm << '"' << " is not Found ";
+            emit errorOccurred(QAlgorithmManagerError::AlgorithmNotFound, errorMessage(QAlgorithmManagerError::AlgorithmNotFound));
+            return QFuture<QDiffResult>();
+        }
+    }
+
+    QList<QBatchDiffJob> jobs;
+    jobs.reserve(pairs.size());
+    for (const QDiffPair &pair : pairs) {
+        jobs.append(QBatchDiffJob{pair.leftText, pair.rightText,
+                                  algorithm.isEmpty() ? autoSelectAlgorithm(pair.leftText, pair.rightText) : algorithm});
+    }
+
+    auto stats = std::make_shared<QBatchDiffStats>();
+    auto future = m_batchEngine.run(jobs, m_diffMode, stats);
+    auto *watcher = new QFutureWatcher<QDiffResult>(this);
+    connect(watcher, &QFutureWatcher<QDiffResult>::resultReadyAt, this, [this, watcher](int index) {
+        emit batchResultReady(index, watcher->resultAt(index));
+    });
+    connect(watcher, &QFutureWatcher<QDiffResult>::finished, this, [this, watcher, stats]() {
+        m_lastBatchStats = *stats;
+        emit batchFinished(m_lastBatchStats);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(future);
+    return future;
+}
+
+QFuture<QSideBySideDiffResult> QAlgorithmManager::calculateSideBySideDiff(const QString &leftText, const QString &rightText, QExecutionMode executionMode, QAlgorithmSelectionMode selectionMode, QString algorithmId, QDiffPriority priority)
 {
     if (executionMode == QExecutionMode::Synchronous) {
         QPromise<QSideBySideDiffResult> promise;
@@ -137,12 +262,29 @@ QFuture<QSideBySideDiffResult> QAlgorithmManager::calculateSideBySideDiff(const
         promise.addResult(calculateSideBySideDiffSync(leftText, rightText, selectionMode, algorithmId));
         promise.finish();
         return promise.future();
+    } else if (executionMode == QExecutionMode::OutOfProcess) {
+        // The worker diffs the pair, only the split into sides happens here
+        QString algorithm;
+        auto future = submitOutOfProcess(leftText, rightText, selectionMode, algorithmId, &algorithm)
+                          .then(QtFuture::Launch::Async, [this, algorithm](QDiffResult unifiedResult) {
+            if (!unifiedResult.success())
+                return QSideBySideDiffResult(unifiedResult.errorMessage());
+            unifiedResult.setHunkIndex(std::make_shared<const QDiffHunkIndex>(unifiedResult.changes(), unifiedResult.metaData("line_separated").toBool()));
+            return divideDiffForSideBySide(unifiedResult, algorithm);
+        });
+        auto *watcher = new QFutureWatcher<QSideBySideDiffResult>(this);
+        connect(watcher, &QFutureWatcher<QSideBySideDiffResult>::finished, this, [this, watcher]() {
+            emit sideBySideDiffCalculated(watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(future);
+        return future;
     } else {
-        return calculateSideBySideDiffAsync(leftText, rightText, selectionMode, algorithmId);
+        return calculateSideBySideDiffAsync(leftText, rightText, selectionMode, algorithmId, priority);
     }
 }
 
-QFuture<QSideBySideDiffResult> QAlgorithmManager::calculateSideBySideDiffAsync(const QString &leftText, const QString &rightText, QAlgorithmSelectionMode selectionMode, QString algorithmId)
+QFuture<QSideBySideDiffResult> QAlgorithmManager::calculateSideBySideDiffAsync(const QString &leftText, const QString &rightText, QAlgorithmSelectionMode selectionMode, QString algorithmId, QDiffPriority priority)
 {
     QString algorithm;
     if(selectionMode == QAlgorithmSelectionMode::Manual)
@@ -178,7 +320,7 @@ QFuture<QSideBySideDiffResult> QAlgorithmManager::calculateSideBySideDiffAsync(c
         algorithm = autoSelectAlgorithm(leftText, rightText);
     }
     
-    auto future = QtConcurrent::run([this, algorithm, leftText, rightText]() {
+    auto future = m_taskPool.run(priority, [this, algorithm, leftText, rightText]() {
         // Execute the algorithm directly to get unified diff
         QDiffResult unifiedResult = executeAlgorithm(algorithm, leftText, rightText);
         
@@ -260,6 +402,19 @@ void QAlgorithmManager::setExecutionMode(QExecutionMode newExecutionMode)
     emit executionModeChanged();
 }
 
+DiffMode QAlgorithmManager::diffMode() const
+{
+    return m_diffMode;
+}
+
+void QAlgorithmManager::setDiffMode(DiffMode newDiffMode)
+{
+    if (m_diffMode == newDiffMode)
+        return;
+    m_diffMode = newDiffMode;
+    emit diffModeChanged();
+}
+
 QString QAlgorithmManager::currentAlgorithm() const
 {
     return m_currentAlgorithm;
@@ -330,6 +485,10 @@ QString QAlgorithmManager::errorMessage(const QAlgorithmManagerError &error) con
         return context + tr("Diff operation timed out");
     case QAlgorithmManagerError::OperationCancelled:
         return context + tr("Operation was cancelled");
+    case QAlgorithmManagerError::InvalidPatch:
+        return context + tr("Patch could not be built or parsed");
+    case QAlgorithmManagerError::MemoryBudgetExceeded:
+        return context + tr("Diff does not fit the memory budget");
     case QAlgorithmManagerError::Unknown:
     default:
         return context + tr("Unknown error");
@@ -356,14 +515,35 @@ void QAlgorithmManager::setLastError(QAlgorithmManagerError newLastError)
     m_lastError = newLastError;
 }
 
-QString QAlgorithmManager::autoSelectAlgorithm(const QString& leftText, const QString& rightText) const
+QString QAlgorithmManager::autoSelectAlgorithm(const QString& leftText, const QString& rightText, const QDiffShape *shape) const
+{
+    return selectAlgorithm(leftText, rightText, m_diffMode, shape);
+}
+
+QString QAlgorithmManager::selectAlgorithm(const QString& leftText, const QString& rightText, DiffMode mode) const
+{
+    return selectAlgorithm(leftText, rightText, mode, nullptr);
+}
+
+QString QAlgorithmManager::selectAlgorithm(const QString& leftText, const QString& rightText, DiffMode mode,
+                                           const QDiffShape *shape) const
 {
     const int threshold = 1000;
     int totalLength = leftText.length() + rightText.length();
 
+    // Only the bit-parallel LCS engine really diffs at character granularity
+    if (mode == DiffMode::CharByChar && isAlgorithmAvailable("lcs")) {
+        return "lcs";
+    }
     if (totalLength < threshold && isAlgorithmAvailable("dmp")) {
         return "dmp";
     }
+    // Which engine is faster depends on the edit distance, so past races decide when they agree
+    if (mode != DiffMode::WordByWord && m_raceEngine.hasRecords()) {
+        const QString learned = m_raceEngine.learnedWinner(shape ? *shape : QDiffMemoryBudget::measure(leftText, rightText));
+        if (!learned.isEmpty() && isAlgorithmAvailable(learned))
+            return learned;
+    }
     if (isAlgorithmAvailable("dtl")) {
         return "dtl";
     }
@@ -378,17 +558,17 @@ QString QAlgorithmManager::autoSelectAlgorithm(const QString& leftText, const QS
 }
 
 bool QAlgorithmManager::isCalculating() const {
-    return m_isCalculating;
+    return m_runningCount > 0;
 }
 
 QDiffResult QAlgorithmManager::executeAlgorithm(const QString& algorithmId, const QString& leftText, const QString& rightText)
 {
-    m_isCalculating = true;
+    QDIFFX_TRACE_SCOPE("manager", "executeAlgorithm");
+    ++m_runningCount;
     emit aboutToCalculateDiff(leftText, rightText, algorithmId);
     emit calculationStarted();
-    QMutexLocker locker(&m_mutex);
     auto& registry = QAlgorithmRegistry::get_Instance();
-    auto algorithm = registry.createAlgorithm(algorithmId);
+    QPooledAlgorithm algorithm = registry.checkoutAlgorithm(algorithmId);
 
     if (!algorithm) {
         auto regErrorMsg = registry.lastErrorMessage();
@@ -399,31 +579,192 @@ QDiffResult QAlgorithmManager::executeAlgorithm(const QString& algorithmId, cons
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::executeAlgorithm:: Failed to create algorithm instance for" << algorithmId << ", :" << regErrorMsg;
         emit errorOccurred(QAlgorithmManagerError::AlgorithmCreationFailed, msg);
         QDiffResult failResult(msg);
-        m_isCalculating = false;
+        --m_runningCount;
         emit calculationFinished(failResult);
         return failResult;
     }
 
-    QDiffResult result = algorithm->calculateDiff(leftText, rightText, DiffMode::LineByLine);
-    m_isCalculating = false;
+    QDiffResult result = m_memoryBudget > 0 ? calculateWithinBudget(algorithmId, std::move(algorithm), leftText, rightText)
+                                            : algorithm->calculateDiff(leftText, rightText, m_diffMode);
+    --m_runningCount;
 
     if (!result.success()) {
-        setLastError(QAlgorithmManagerError::DiffExecutionFailed);
+        const QAlgorithmManagerError error = result.metaData("degradation") == QLatin1String("budget_exceeded")
+                                                 ? QAlgorithmManagerError::MemoryBudgetExceeded
+                                                 : QAlgorithmManagerError::DiffExecutionFailed;
+        setLastError(error);
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::executeAlgorithm:: Diff failed:" << result.errorMessage();
+        emit errorOccurred(error, result.errorMessage());
+    } else {
+        setLastError(QAlgorithmManagerError::None);
+        if (!result.allMetaData().contains("algorithm_id")) {
+            QMap<QString, QVariant> metadata = result.allMetaData();
+            metadata["algorithm_id"] = algorithmId;
+            result.setMetaData(metadata);
+        }
+        result.setHunkIndex(std::make_shared<const QDiffHunkIndex>(result.changes(), result.metaData("line_separated").toBool()));
+        m_statistics.record(result.metaData("algorithm_id").toString(), result);
+    }
+
+    emit calculationFinished(result);
+    return result;
+}
+
+QDiffResult QAlgorithmManager::executeRace(const QString& leftText, const QString& rightText)
+{
+    QDIFFX_TRACE_SCOPE("manager", "executeRace");
+    // dtl diffs lines only, and two engines at once would each need the whole memory budget
+    if ((m_diffMode != DiffMode::LineByLine && m_diffMode != DiffMode::Auto) || m_memoryBudget > 0
+        || !isAlgorithmAvailable(RACE_ALGORITHMS[0]) || !isAlgorithmAvailable(RACE_ALGORITHMS[1])) {
+        return executeAlgorithm(autoSelectAlgorithm(leftText, rightText), leftText, rightText);
+    }
+
+    // The favourite runs on this thread and starts first
+    const QDiffShape shape = QDiffMemoryBudget::measure(leftText, rightText);
+    const bool swap = autoSelectAlgorithm(leftText, rightText, &shape) == RACE_ALGORITHMS[1];
+    const QString &first = RACE_ALGORITHMS[swap ? 1 : 0];
+    const QString &second = RACE_ALGORITHMS[swap ? 0 : 1];
+
+    ++m_runningCount;
+    emit aboutToCalculateDiff(leftText, rightText, first + '|' + second);
+    emit calculationStarted();
+    QDiffResult result = m_raceEngine.race(first, second, m_diffMode, leftText, rightText, shape);
+    --m_runningCount;
+
+    if (!result.success()) {
+        setLastError(QAlgorithmManagerError::DiffExecutionFailed);
+        if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::executeRace:: Both contenders failed:" << result.errorMessage();
         emit errorOccurred(QAlgorithmManagerError::DiffExecutionFailed, result.errorMessage());
     } else {
         setLastError(QAlgorithmManagerError::None);
+        result.setHunkIndex(std::make_shared<const QDiffHunkIndex>(result.changes(), result.metaData("line_separated").toBool()));
+        m_statistics.record(result.metaData("algorithm_id").toString(), result);
     }
 
     emit calculationFinished(result);
     return result;
 }
 
+bool QAlgorithmManager::isTinyDiff(const QString& leftText, const QString& rightText, QAlgorithmSelectionMode selectionMode) const
+{
+    // Budgets and races need the full machinery
+    return leftText.size() + rightText.size() <= m_tinyDiffThreshold
+           && selectionMode != QAlgorithmSelectionMode::Racing && m_memoryBudget == 0;
+}
+
+QDiffResult QAlgorithmManager::executeTinyDiff(const QString& algorithmId, const QString& leftText, const QString& rightText)
+{
+    if (hasReceivers(&QAlgorithmManager::aboutToCalculateDiff))
+        emit aboutToCalculateDiff(leftText, rightText, algorithmId);
+    if (hasReceivers(&QAlgorithmManager::calculationStarted))
+        emit calculationStarted();
+
+    QDiffResult result;
+    {
+        auto& registry = QAlgorithmRegistry::get_Instance();
+        QPooledAlgorithm algorithm = registry.checkoutAlgorithm(algorithmId);
+        if (algorithm) {
+            QDiffProfiler::Suspend suspend;
+            result = algorithm->calculateDiff(leftText, rightText, m_diffMode);
+        } else {
+            auto regErrorMsg = registry.lastErrorMessage();
+            setLastError(QAlgorithmManagerError::AlgorithmCreationFailed);
+            QString msg = errorMessage(QAlgorithmManagerError::AlgorithmCreationFailed);
+            if (!regErrorMsg.isEmpty())
+                msg += ": " + regErrorMsg;
+            if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::executeTinyDiff:: Failed to create algorithm instance for" << algorithmId << ", :" << regErrorMsg;
+            emit errorOccurred(QAlgorithmManagerError::AlgorithmCreationFailed, msg);
+            QDiffResult failResult(msg);
+            if (hasReceivers(&QAlgorithmManager::calculationFinished))
+                emit calculationFinished(failResult);
+            return failResult;
+        }
+    }
+
+    if (!result.success()) {
+        setLastError(QAlgorithmManagerError::DiffExecutionFailed);
+        if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::executeTinyDiff:: Diff failed:" << result.errorMessage();
+        emit errorOccurred(QAlgorithmManagerError::DiffExecutionFailed, result.errorMessage());
+    } else {
+        setLastError(QAlgorithmManagerError::None);
+        result.setMetaData("algorithm_id", algorithmId);
+        result.setHunkIndex(std::make_shared<const QDiffHunkIndex>(result.changes(), result.metaData("line_separated").toBool()));
+    }
+    if (hasReceivers(&QAlgorithmManager::calculationFinished))
+        emit calculationFinished(result);
+    return result;
+}
+
+QDiffResult QAlgorithmManager::calculateWithinBudget(const QString& algorithmId, QPooledAlgorithm algorithm,
+                                                     const QString& leftText, const QString& rightText)
+{
+    struct Candidate {
+        QString algorithmId;
+        QString degradation;
+    };
+    QList<Candidate> candidates{{algorithmId, QStringLiteral("none")}};
+    if (algorithmId != LINEAR_MEMORY_ALGORITHM && isAlgorithmAvailable(LINEAR_MEMORY_ALGORITHM))
+        candidates.append({LINEAR_MEMORY_ALGORITHM, QStringLiteral("linear_memory")});
+    if (!m_fallBackAlgorithm.isEmpty() && m_fallBackAlgorithm != algorithmId
+        && m_fallBackAlgorithm != LINEAR_MEMORY_ALGORITHM && isAlgorithmAvailable(m_fallBackAlgorithm))
+        candidates.append({m_fallBackAlgorithm, QStringLiteral("fallback_algorithm")});
+
+    const QDiffShape shape = QDiffMemoryBudget::measure(leftText, rightText);
+    QStringList overruns;
+    for (int i = 0; i < candidates.size(); ++i) {
+        const Candidate &candidate = candidates[i];
+        const qint64 estimate = QDiffMemoryBudget::estimate(candidate.algorithmId, m_diffMode, shape);
+        // The last candidate runs regardless, its charges are what finally decide
+        if (estimate > m_memoryBudget && i + 1 < candidates.size()) {
+            overruns.append(QStringLiteral("%1 estimated at %2 bytes").arg(candidate.algorithmId).arg(estimate));
+            continue;
+        }
+        QPooledAlgorithm instance = i == 0 ? std::move(algorithm)
+                                           : QAlgorithmRegistry::get_Instance().checkoutAlgorithm(candidate.algorithmId);
+        if (!instance)
+            continue;
+
+        QDiffMemoryBudget::Scope scope(m_memoryBudget);
+        QDiffResult result = instance->calculateDiff(leftText, rightText, m_diffMode);
+        if (scope.exceeded()) {
+            overruns.append(QStringLiteral("%1 charged %2 bytes").arg(candidate.algorithmId).arg(scope.chargedBytes()));
+            continue;
+        }
+
+        QMap<QString, QVariant> metadata = result.allMetaData();
+        metadata["algorithm_id"] = candidate.algorithmId;
+        metadata["memory_budget"] = m_memoryBudget;
+        metadata["memory_estimate"] = estimate;
+        metadata["memory_charged"] = scope.chargedBytes();
+        metadata["degradation"] = candidate.degradation;
+        if (i > 0) {
+            metadata["requested_algorithm"] = algorithmId;
+            metadata["degradation_reasons"] = overruns;
+        }
+        result.setMetaData(metadata);
+        return result;
+    }
+
+    QDiffResult failResult(errorMessage(QAlgorithmManagerError::MemoryBudgetExceeded) + ": " + overruns.join("; "));
+    QMap<QString, QVariant> metadata;
+    metadata["memory_budget"] = m_memoryBudget;
+    metadata["degradation"] = QStringLiteral("budget_exceeded");
+    metadata["requested_algorithm"] = algorithmId;
+    metadata["degradation_reasons"] = overruns;
+    failResult.setMetaData(metadata);
+    return failResult;
+}
+
 void QAlgorithmManager::resetManager() {
     setSelectionMode(QDiffX::QAlgorithmSelectionMode::Auto);
     setExecutionMode(QDiffX::QExecutionMode::Synchronous);
+    setDiffMode(DiffMode::LineByLine);
     setCurrentAlgorithm(DEFAULT_ALGORITHM);
     setFallBackAlgorithm(DEFAULT_FALLBACK);
+    setMemoryBudget(0);
+    m_tinyDiffThreshold = DEFAULT_TINY_DIFF_THRESHOLD;
+    m_raceEngine.clearRecords();
+    m_statistics.clear();
     setErrorOutputEnabled(false);
     setLastError(QAlgorithmManagerError::None);
     emit managerReset();
@@ -457,8 +798,134 @@ QStringList QAlgorithmManager::getAvailableAlgorithms() const {
     return QAlgorithmRegistry::get_Instance().getAvailableAlgorithms();
 }
 
+int QAlgorithmManager::fuzzyLocate(const QString &text, const QString &block, int expectedPosition,
+                                   double threshold, int distance) const
+{
+    if (text.isEmpty() || block.isEmpty())
+        return -1;
+
+    diff_match_patch dmp;
+    dmp.Match_Threshold = float(qBound(0.0, threshold, 1.0));
+    dmp.Match_Distance = qMax(0, distance);
+    dmp.Match_MaxBits = 0;  // The multi-word matcher has no pattern length limit
+    return dmp.match_main(text, block, expectedPosition);
+}
+
+QList<QFuzzyMatch> QAlgorithmManager::fuzzyFindAll(const QString &text, const QString &block, int maxErrors) const
+{
+    QList<QFuzzyMatch> matches;
+    if (text.isEmpty() || block.isEmpty() || maxErrors < 0)
+        return matches;
+
+    const std::vector<int> errors = diff_bitap::startDistances(
+        reinterpret_cast<const char16_t *>(text.constData()), int(text.length()),
+        reinterpret_cast<const char16_t *>(block.constData()), int(block.length()),
+        0, int(text.length()) - 1);
+
+    // Neighbouring start positions of one occurrence all match with a few errors,
+    // so keep the best start within each block-sized window and skip past it
+    const int count = int(errors.size());
+    int position = 0;
+    while (position < count) {
+        if (errors[position] > maxErrors) {
+            ++position;
+            continue;
+        }
+        int best = position;
+        const int windowEnd = qMin(count, position + int(block.length()));
+        for (int i = position + 1; i < windowEnd; ++i) {
+            if (errors[i] < errors[best])
+                best = i;
+        }
+        matches.append(QFuzzyMatch{best, errors[best]});
+        position = best + int(block.length());
+    }
+    return matches;
+}
+
+QList<QDiffPatch> QAlgorithmManager::makePatches(const QString &leftText, const QString &rightText) const
+{
+    return m_patchEngine.makePatches(leftText, rightText);
+}
+
+QList<QDiffPatch> QAlgorithmManager::makePatches(const QString &leftText, const QDiffResult &diffResult)
+{
+    bool ok = diffResult.success();
+    QList<QDiffPatch> patches;
+    if (ok)
+        patches = m_patchEngine.makePatches(leftText, diffResult, &ok);
+    if (!ok) {
+        setLastError(QAlgorithmManagerError::InvalidPatch);
+        if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::makePatches:: Diff result does not describe the given left text";
+        emit errorOccurred(QAlgorithmManagerError::InvalidPatch, errorMessage(QAlgorithmManagerError::InvalidPatch));
+    }
+    return patches;
+}
+
+QString QAlgorithmManager::patchesToText(const QList<QDiffPatch> &patches) const
+{
+    return m_patchEngine.toText(patches);
+}
+
+QList<QDiffPatch> QAlgorithmManager::patchesFromText(const QString &patchText)
+{
+    bool ok = false;
+    QList<QDiffPatch> patches = m_patchEngine.fromText(patchText, &ok);
+    if (!ok) {
+        setLastError(QAlgorithmManagerError::InvalidPatch);
+        if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::patchesFromText:: Malformed patch text";
+        emit errorOccurred(QAlgorithmManagerError::InvalidPatch, errorMessage(QAlgorithmManagerError::InvalidPatch));
+    }
+    return patches;
+}
+
+QPatchResult QAlgorithmManager::applyPatches(const QList<QDiffPatch> &patches, const QString &text) const
+{
+    return m_patchEngine.apply(patches, text);
+}
+
+QList<QPatchResult> QAlgorithmManager::applyPatches(const QList<QDiffPatch> &patches, const QStringList &texts) const
+{
+    return m_patchEngine.apply(patches, texts);
+}
+
+QMergeResult QAlgorithmManager::calculateMerge(const QString &baseText, const QString &oursText, const QString &theirsText)
+{
+    QMergeResult result = m_mergeEngine.merge(baseText, oursText, theirsText);
+    if (!result.success()) {
+        setLastError(QAlgorithmManagerError::DiffExecutionFailed);
+        if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::calculateMerge:: " << result.errorMessage();
+        emit errorOccurred(QAlgorithmManagerError::DiffExecutionFailed, errorMessage(QAlgorithmManagerError::DiffExecutionFailed));
+        return result;
+    }
+    emit mergeCalculated(result);
+    return result;
+}
+
+QFuture<QMergeResult> QAlgorithmManager::calculateMergeAsync(const QString &baseText, const QString &oursText, const QString &theirsText)
+{
+    auto future = QtConcurrent::run(&QMergeEngine::merge, &m_mergeEngine, baseText, oursText, theirsText);
+    auto *watcher = new QFutureWatcher<QMergeResult>(this);
+    connect(watcher, &QFutureWatcher<QMergeResult>::finished, this, [this, watcher]() {
+        const QMergeResult result = watcher->result();
+        if (result.success()) {
+            emit mergeCalculated(result);
+        } else {
+            setLastError(QAlgorithmManagerError::DiffExecutionFailed);
+            if (m_errorOutputEnabled) qWarning() << "QAlgorithmManager::calculateMergeAsync:: " << result.errorMessage();
+            emit errorOccurred(QAlgorithmManagerError::DiffExecutionFailed, errorMessage(QAlgorithmManagerError::DiffExecutionFailed));
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(future);
+    return future;
+}
+
 QSideBySideDiffResult QAlgorithmManager::divideDiffForSideBySide(const QDiffResult& unifiedResult, const QString& algorithmUsed)
 {
+    QDIFFX_TRACE_SCOPE("manager", "divideDiffForSideBySide");
+    QElapsedTimer timer;
+    timer.start();
     QSideBySideDiffResult result;
     result.algorithmUsed = algorithmUsed;
     
@@ -469,6 +936,9 @@ QSideBySideDiffResult QAlgorithmManager::divideDiffForSideBySide(const QDiffResu
     // Copy metadata from unified result
     result.leftSide.setMetaData(unifiedResult.allMetaData());
     result.rightSide.setMetaData(unifiedResult.allMetaData());
+    // Both sides share the unified result's hunks
+    result.leftSide.setHunkIndex(unifiedResult.hunkIndex());
+    result.rightSide.setHunkIndex(unifiedResult.hunkIndex());
     
     QList<DiffChange> leftChanges;
     QList<DiffChange> rightChanges;
@@ -577,6 +1047,11 @@ QSideBySideDiffResult QAlgorithmManager::divideDiffForSideBySide(const QDiffResu
     
     result.leftSide.setChanges(leftChanges);
     result.rightSide.setChanges(rightChanges);
+
+    const qint64 elapsed = timer.nsecsElapsed();
+    QDiffProfiler::addPhase(result.leftSide, QStringLiteral("side_by_side"), elapsed);
+    QDiffProfiler::addPhase(result.rightSide, QStringLiteral("side_by_side"), elapsed);
+    m_statistics.record(unifiedResult.metaData("algorithm_id").toString(), QStringLiteral("side_by_side"), elapsed);
     
     return result;
 }
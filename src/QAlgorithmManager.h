@@ -2,7 +2,18 @@
 #include "QDiffAlgorithm.h"
 #include "QAlgorithmRegistry.h"
 #include "QAlgorithmManagerError.h"
+#include "QPatchEngine.h"
+#include "QMergeEngine.h"
+#include "QBatchDiffEngine.h"
+#include "QProcessDiffPool.h"
+#include "QDiffMemoryBudget.h"
+#include "QDiffRaceEngine.h"
+#include "QDiffProfiler.h"
+#include "QDiffTaskPool.h"
+#include "QDiffHunkIndex.h"
 #include <QFuture>
+#include <QMetaMethod>
+#include <atomic>
 
 
 
@@ -12,12 +23,21 @@ namespace QDiffX {
 
 enum class QAlgorithmSelectionMode{
     Auto,
-    Manual
+    Manual,
+    Racing      // Runs dtl and dmp at once and keeps the first to finish (line diffs only)
 };
 
 enum class QExecutionMode{
     Asynchronous,
-    Synchronous
+    Synchronous,
+    OutOfProcess    // Asynchronous, in a worker process (see QProcessDiffPool); side-by-side
+                    // diffs are split in this process once the worker's result is back
+};
+
+// Approximate occurrence of a block found by QAlgorithmManager::fuzzyFindAll
+struct QFuzzyMatch {
+    int position = -1;  // Start of the occurrence in the searched text
+    int errors = 0;     // Edit distance between the occurrence and the block
 };
 
 
@@ -28,6 +48,7 @@ class QAlgorithmManager : public QObject
     Q_OBJECT
     Q_PROPERTY(QAlgorithmSelectionMode selectionMode READ selectionMode WRITE setSelectionMode NOTIFY selectionModeChanged)
     Q_PROPERTY(QExecutionMode executionMode READ executionMode WRITE setExecutionMode NOTIFY executionModeChanged)
+    Q_PROPERTY(DiffMode diffMode READ diffMode WRITE setDiffMode NOTIFY diffModeChanged)
     Q_PROPERTY(QString currentAlgorithm READ currentAlgorithm WRITE setCurrentAlgorithm NOTIFY currentAlgorithmChanged)
     Q_PROPERTY(QString fallBackAlgorithm READ fallBackAlgorithm WRITE setFallBackAlgorithm NOTIFY fallBackAlgorithmChanged)
     Q_PROPERTY(bool errorOutputEnabled READ errorOutputEnabled WRITE setErrorOutputEnabled)
@@ -39,14 +60,17 @@ public:
     ~QAlgorithmManager() = default;
 
     // Diff Functions:
+    // priority orders asynchronous diffs on taskPool(), synchronous ones ignore it
     QFuture<QDiffResult> calculateDiff(const QString &leftText, const QString &rightText,
                                        QExecutionMode executionMode = QExecutionMode::Asynchronous,
                                        QAlgorithmSelectionMode selectionMode = QAlgorithmSelectionMode::Auto,
-                                       QString algorithmId = QString());
+                                       QString algorithmId = QString(),
+                                       QDiffPriority priority = QDiffPriority::Interactive);
 
     QFuture<QDiffResult> calculateDiffAsync(const QString &leftText, const QString &rightText,
                                             QAlgorithmSelectionMode selectionMode = QAlgorithmSelectionMode::Auto,
-                                            QString algorithmId = QString());
+                                            QString algorithmId = QString(),
+                                            QDiffPriority priority = QDiffPriority::Interactive);
 
     QDiffResult calculateDiffSync(const QString &leftText, const QString &rightText,
                                   QAlgorithmSelectionMode selectionMode = QAlgorithmSelectionMode::Auto,
@@ -56,30 +80,68 @@ public:
                                            const QString& leftText,
                                            const QString& rightText);
 
+    // Isolates the host from diffs that crash or exhaust memory; a worker killed by
+    // the pool's watchdog yields a failed result instead of taking this process down
+    QFuture<QDiffResult> calculateDiffOutOfProcess(const QString &leftText, const QString &rightText,
+                                                   QAlgorithmSelectionMode selectionMode = QAlgorithmSelectionMode::Auto,
+                                                   QString algorithmId = QString());
+    // Worker processes of OutOfProcess execution, created on first use
+    QProcessDiffPool *processPool();
+    // Winners of Racing selections; Auto selection takes the usual winner for inputs shaped alike
+    QDiffRaceEngine *raceEngine() { return &m_raceEngine; }
+    // Rolling p50/p95/p99 latency of every algorithm and phase (see QDiffProfiler)
+    QDiffStatistics *statistics() { return &m_statistics; }
+    // Threads of asynchronous diffs, with per-priority caps, aging and queue metrics
+    QDiffTaskPool *taskPool() { return &m_taskPool; }
+
     // Side-by-side diff functions
     QFuture<QSideBySideDiffResult> calculateSideBySideDiff(const QString &leftText, const QString &rightText,
                                                           QExecutionMode executionMode = QExecutionMode::Asynchronous,
                                                           QAlgorithmSelectionMode selectionMode = QAlgorithmSelectionMode::Auto,
-                                                          QString algorithmId = QString());
+                                                          QString algorithmId = QString(),
+                                                          QDiffPriority priority = QDiffPriority::Interactive);
 
     QFuture<QSideBySideDiffResult> calculateSideBySideDiffAsync(const QString &leftText, const QString &rightText,
                                                                QAlgorithmSelectionMode selectionMode = QAlgorithmSelectionMode::Auto,
-                                                               QString algorithmId = QString());
+                                                               QString algorithmId = QString(),
+                                                               QDiffPriority priority = QDiffPriority::Interactive);
 
     QSideBySideDiffResult calculateSideBySideDiffSync(const QString &leftText, const QString &rightText,
                                                      QAlgorithmSelectionMode selectionMode = QAlgorithmSelectionMode::Auto,
                                                      QString algorithmId = QString());
 
+    // Batch diff: results are reported per pair (batchResultReady, or the future's
+    // resultReadyAt) as they complete, in whatever order that is
+    QFuture<QDiffResult> calculateBatchDiff(const QList<QDiffPair> &pairs,
+                                            QAlgorithmSelectionMode selectionMode = QAlgorithmSelectionMode::Auto,
+                                            QString algorithmId = QString());
+    QBatchDiffStats lastBatchStats() const { return m_lastBatchStats; }
+
     bool isAlgorithmAvailable(const QString &algorithmId) const;
+    // The algorithm Auto selection picks for a pair diffed in mode
+    QString selectAlgorithm(const QString& leftText, const QString& rightText, DiffMode mode) const;
 
     QAlgorithmSelectionMode selectionMode() const;
     void setSelectionMode(QAlgorithmSelectionMode newSelectionMode);
     QExecutionMode executionMode() const;
     void setExecutionMode(QExecutionMode newExecutionMode);
+    DiffMode diffMode() const;
+    void setDiffMode(DiffMode newDiffMode);
     QString currentAlgorithm() const;
     void setCurrentAlgorithm(const QString &newCurrentAlgorithm);
     QString fallBackAlgorithm() const;
     void setFallBackAlgorithm(const QString &newFallBackAlgorithm);
+    // Bytes one diff may use, 0 for no limit. A diff estimated or charged above it
+    // is redone with the linear-memory "lcs" engine, then the fallback algorithm;
+    // the result's "degradation" metadata says which one produced it
+    qint64 memoryBudget() const { return m_memoryBudget; }
+    void setMemoryBudget(qint64 bytes) { m_memoryBudget = qMax<qint64>(0, bytes); }
+    // Diffs of at most this many characters in all (0 turns it off) take a fast path:
+    // inline on the caller's thread, without the manager lock, thread pool, profiling
+    // metadata or latency statistics, and emitting only the signals somebody listens to
+    int tinyDiffThreshold() const { return m_tinyDiffThreshold; }
+    void setTinyDiffThreshold(int characters) { m_tinyDiffThreshold = qMax(0, characters); }
+    static constexpr int DEFAULT_TINY_DIFF_THRESHOLD = 512;
 
     // Algorithm Configuration Management (Delegates to QAlgorithmRegistry)
     QMap<QString, QVariant> getAlgorithmConfiguration(const QString& algorithmId) const;
@@ -87,6 +149,26 @@ public:
     QStringList getAlgorithmConfigurationKeys(const QString& algorithmId) const;
 
     QStringList getAvailableAlgorithms() const;
+
+    // Fuzzy block location, e.g. to relocate a patch hunk in a file that has drifted.
+    // fuzzyLocate returns the best start near expectedPosition, or -1 when nothing
+    // scores within threshold (0.0 exact .. 1.0 anything); distance is how far from
+    // expectedPosition a match may drift before its score reaches 1.0.
+    int fuzzyLocate(const QString &text, const QString &block, int expectedPosition,
+                    double threshold = 0.5, int distance = 1000) const;
+    QList<QFuzzyMatch> fuzzyFindAll(const QString &text, const QString &block, int maxErrors) const;
+
+    // Patch functions (diff_match_patch patch format)
+    QList<QDiffPatch> makePatches(const QString &leftText, const QString &rightText) const;
+    QList<QDiffPatch> makePatches(const QString &leftText, const QDiffResult &diffResult);
+    QString patchesToText(const QList<QDiffPatch> &patches) const;
+    QList<QDiffPatch> patchesFromText(const QString &patchText);
+    QPatchResult applyPatches(const QList<QDiffPatch> &patches, const QString &text) const;
+    QList<QPatchResult> applyPatches(const QList<QDiffPatch> &patches, const QStringList &texts) const;
+
+    // Three-way merge functions
+    QMergeResult calculateMerge(const QString &baseText, const QString &oursText, const QString &theirsText);
+    QFuture<QMergeResult> calculateMergeAsync(const QString &baseText, const QString &oursText, const QString &theirsText);
     
     // Error Handeling
     QAlgorithmManagerError lastError() const { return m_lastError; }
@@ -106,6 +188,7 @@ signals:
     void fallBackAlgorithmChanged();
     void selectionModeChanged();
     void executionModeChanged();
+    void diffModeChanged();
     void diffCalculated(const QDiffX::QDiffResult &result);
     void algorithmAvailabilityChanged(const QString& algorithmId, bool available);
     void availableAlgorithmsChanged(const QStringList& newList);
@@ -116,29 +199,65 @@ signals:
     void calculationFinished(const QDiffX::QDiffResult& result);
     void algorithmConfigurationChanged(const QString& algorithmId, const QMap<QString, QVariant>& config);
     void sideBySideDiffCalculated(const QDiffX::QSideBySideDiffResult &result);
+    void mergeCalculated(const QDiffX::QMergeResult &result);
+    void batchResultReady(int index, const QDiffX::QDiffResult &result);
+    void batchFinished(const QDiffX::QBatchDiffStats &stats);
 
 private:
     void setLastError(QAlgorithmManagerError newLastError);
     QDiffResult executeAlgorithm(const QString& algorithmId,
                                  const QString& leftText,
                                  const QString& rightText);
+    // shape, when the caller has measured the pair already, saves measuring it again
     QString autoSelectAlgorithm (const QString& leftText,
-                                const QString& rightText) const;
+                                const QString& rightText,
+                                const QDiffShape *shape = nullptr) const;
+    QString selectAlgorithm(const QString& leftText, const QString& rightText, DiffMode mode,
+                            const QDiffShape *shape) const;
+    QDiffResult executeRace(const QString& leftText, const QString& rightText);
+    // Validates the selection and hands the pair to processPool(); algorithmUsed receives the pick
+    QFuture<QDiffResult> submitOutOfProcess(const QString &leftText, const QString &rightText,
+                                            QAlgorithmSelectionMode selectionMode, QString algorithmId,
+                                            QString *algorithmUsed);
+    QDiffResult calculateWithinBudget(const QString& algorithmId,
+                                      QPooledAlgorithm algorithm,
+                                      const QString& leftText,
+                                      const QString& rightText);
     QSideBySideDiffResult divideDiffForSideBySide(const QDiffResult& unifiedResult, const QString& algorithmUsed);
+    bool isTinyDiff(const QString& leftText, const QString& rightText, QAlgorithmSelectionMode selectionMode) const;
+    QDiffResult executeTinyDiff(const QString& algorithmId, const QString& leftText, const QString& rightText);
+    template<typename Signal>
+    bool hasReceivers(Signal signal) const { return isSignalConnected(QMetaMethod::fromSignal(signal)); }
 private:
     QAlgorithmSelectionMode m_selectionMode;
     QExecutionMode m_executionMode;
+    DiffMode m_diffMode = DiffMode::LineByLine;
     QString m_currentAlgorithm;
     QString m_fallBackAlgorithm;
-    mutable QMutex m_mutex;
 
     // Default algorithms
     static const QString DEFAULT_ALGORITHM;
     static const QString DEFAULT_FALLBACK;
+    static const QString LINEAR_MEMORY_ALGORITHM;
+    static const QString RACE_ALGORITHMS[2];
+
+    QPatchEngine m_patchEngine;
+    QMergeEngine m_mergeEngine;
+    QBatchDiffEngine m_batchEngine;
+    QBatchDiffStats m_lastBatchStats;
+    QProcessDiffPool *m_processPool = nullptr;
+    qint64 m_memoryBudget = 0;
+    int m_tinyDiffThreshold = DEFAULT_TINY_DIFF_THRESHOLD;
+    QDiffRaceEngine m_raceEngine;
+    QDiffStatistics m_statistics;
 
-    QAlgorithmManagerError m_lastError;
+    // Written from the task pool's threads
+    std::atomic<QAlgorithmManagerError> m_lastError;
     bool m_errorOutputEnabled = false;
-    bool m_isCalculating = false;
+    std::atomic_int m_runningCount{0};
+
+    // Last, so its threads are done before anything they use is destroyed
+    QDiffTaskPool m_taskPool;
 };
 
 }//namespace QDiffX
@@ -12,6 +12,8 @@ enum class QAlgorithmManagerError {
     ConfigurationError,
     Timeout,
     OperationCancelled,
+    InvalidPatch,
+    MemoryBudgetExceeded,
     Unknown
 };
 
@@ -1,10 +1,80 @@
 #include "QAlgorithmRegistry.h"
 #include "DTLAlgorithm.h"
 #include "DMPAlgorithm.h"
+#include "LCSAlgorithm.h"
 #include <QMutexLocker>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 namespace QDiffX{
 
+namespace {
+
+// Per thread, so lookups from many threads do not contend on it
+thread_local QAlgorithmRegistryError t_lastError = QAlgorithmRegistryError::None;
+
+// Only the owning thread writes its counters, relaxed is enough for statistics
+void bump(std::atomic<qint64> &counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+struct InstancePool;
+
+QMutex &poolsMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+// Live pools and the counts of pools whose threads have exited, behind poolsMutex()
+std::vector<InstancePool *> &livePools()
+{
+    static std::vector<InstancePool *> pools;
+    return pools;
+}
+
+QAlgorithmPoolStatistics &retiredStatistics()
+{
+    static QAlgorithmPoolStatistics statistics;
+    return statistics;
+}
+
+// Idle instances of one thread, so checkout and return never lock
+struct InstancePool {
+    struct Entry {
+        std::unique_ptr<QDiffAlgorithm> algorithm;
+        quint64 revision;
+    };
+
+    InstancePool()
+    {
+        QMutexLocker locker(&poolsMutex());
+        livePools().push_back(this);
+    }
+
+    ~InstancePool()
+    {
+        QMutexLocker locker(&poolsMutex());
+        std::vector<InstancePool *> &pools = livePools();
+        pools.erase(std::find(pools.begin(), pools.end(), this));
+        QAlgorithmPoolStatistics &retired = retiredStatistics();
+        retired.checkouts += checkouts.load(std::memory_order_relaxed);
+        retired.hits += hits.load(std::memory_order_relaxed);
+        retired.invalidated += invalidated.load(std::memory_order_relaxed);
+    }
+
+    std::unordered_map<QString, std::vector<Entry>> idle;
+    std::atomic<qint64> checkouts{0};
+    std::atomic<qint64> hits{0};
+    std::atomic<qint64> invalidated{0};
+};
+
+thread_local InstancePool t_pool;
+
+} // namespace
+
 QAlgorithmRegistry &QAlgorithmRegistry::get_Instance()
 {
     static QAlgorithmRegistry instance;
@@ -13,28 +83,34 @@ QAlgorithmRegistry &QAlgorithmRegistry::get_Instance()
 
 QAlgorithmRegistry::QAlgorithmRegistry()
 {
-    initializeDefaultAlgorithms();
-    QMutexLocker locker(&m_mutex);
-    for (auto it = m_algorithms.begin(); it != m_algorithms.end(); ++it) {
+    auto initial = std::make_shared<Snapshot>();
+    initial->algorithms = defaultAlgorithms();
+    for (const QString &algorithmId : initial->algorithms.keys())
+        initial->revisions[algorithmId] = m_nextRevision++;
+    for (auto it = initial->algorithms.begin(); it != initial->algorithms.end(); ++it) {
         if (it.value().factory) {
             std::unique_ptr<QDiffAlgorithm> algo = it.value().factory();
             if (algo) {
-                m_algorithmConfigs[it.key()] = algo->getConfiguration();
+                initial->configs[it.key()] = algo->getConfiguration();
             }
         }
     }
+    QMutexLocker locker(&m_mutex);
+    publish(std::move(initial));
     setLastError(QAlgorithmRegistryError::None);
 }
 
-void QAlgorithmRegistry::initializeDefaultAlgorithms()
+QMap<QString, QAlgorithmInfo> QAlgorithmRegistry::defaultAlgorithms()
 {
+    QMap<QString, QAlgorithmInfo> algorithms;
+
     DTLAlgorithm dtl;
     QAlgorithmInfo dtlInfo;
     dtlInfo.name = dtl.getName();
     dtlInfo.description = dtl.getDescription();
     dtlInfo.capabilities = dtl.getCapabilities();
     dtlInfo.factory = []() { return std::make_unique<DTLAlgorithm>(); };
-    registerAlgorithmInternal("dtl", dtlInfo);
+    algorithms.insert("dtl", dtlInfo);
 
     // Register DMP Algorithm
     DMPAlgorithm dmp;
@@ -43,17 +119,41 @@ void QAlgorithmRegistry::initializeDefaultAlgorithms()
     dmpInfo.description = dmp.getDescription();
     dmpInfo.capabilities = dmp.getCapabilities();
     dmpInfo.factory = []() { return std::make_unique<DMPAlgorithm>(); };
-    registerAlgorithmInternal("dmp", dmpInfo);
+    algorithms.insert("dmp", dmpInfo);
+
+    // Register bit-parallel LCS Algorithm (character level)
+    LCSAlgorithm lcs;
+    QAlgorithmInfo lcsInfo;
+    lcsInfo.name = lcs.getName();
+    lcsInfo.description = lcs.getDescription();
+    lcsInfo.capabilities = lcs.getCapabilities();
+    lcsInfo.factory = []() { return std::make_unique<LCSAlgorithm>(); };
+    algorithms.insert("lcs", lcsInfo);
+
+    return algorithms;
 }
 
-bool QAlgorithmRegistry::registerAlgorithm(const QString &algorithmId, const QAlgorithmInfo &info)
+thread_local QAlgorithmRegistry::SnapshotCache QAlgorithmRegistry::t_snapshotCache;
+
+const std::shared_ptr<const QAlgorithmRegistry::Snapshot> &QAlgorithmRegistry::snapshot() const
 {
-    QMutexLocker locker(&m_mutex);
-   return registerAlgorithmInternal(algorithmId, info);
+    // Readers share nothing but the version counter, so lookups scale with threads
+    SnapshotCache &cache = t_snapshotCache;
+    if (cache.version != m_snapshotVersion.load(std::memory_order_relaxed)) {
+        QMutexLocker locker(&m_mutex);
+        cache.snapshot = m_snapshot;
+        cache.version = m_snapshotVersion.load(std::memory_order_relaxed);
+    }
+    return cache.snapshot;
+}
+
+void QAlgorithmRegistry::publish(std::shared_ptr<const Snapshot> next)
+{
+    m_snapshot = std::move(next);
+    m_snapshotVersion.fetch_add(1, std::memory_order_relaxed);
 }
 
-// DOES NOT ACQUIRE MUTEX (assumes caller has locked)
-bool QAlgorithmRegistry::registerAlgorithmInternal(const QString &algorithmId, const QAlgorithmInfo &info)
+bool QAlgorithmRegistry::registerAlgorithm(const QString &algorithmId, const QAlgorithmInfo &info)
 {
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::registerAlgorithm: Empty algorithm ID provided";
@@ -61,22 +161,32 @@ bool QAlgorithmRegistry::registerAlgorithmInternal(const QString &algorithmId, c
         emit errorOccurred(QAlgorithmRegistryError::EmptyAlgorithmId, errorMessage(QAlgorithmRegistryError::EmptyAlgorithmId));
         return false;
     }
-    if (m_algorithms.contains(algorithmId)) {
+    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> current = m_snapshot;
+    if (current->algorithms.contains(algorithmId)) {
+        locker.unlock();
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::registerAlgorithm: Algorithm already registered:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmAlreadyRegistered);
         emit errorOccurred(QAlgorithmRegistryError::AlgorithmAlreadyRegistered, errorMessage(QAlgorithmRegistryError::AlgorithmAlreadyRegistered) + ": " + algorithmId);
         return false;
     }
     if (!info.factory) {
+        locker.unlock();
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::registerAlgorithm: No factory function provided for algorithm:" << algorithmId;
         setLastError(QAlgorithmRegistryError::InvalidFactory);
         emit errorOccurred(QAlgorithmRegistryError::InvalidFactory, errorMessage(QAlgorithmRegistryError::InvalidFactory) + ": " + algorithmId);
         return false;
     }
-    m_algorithms[algorithmId] = info;
+    auto next = std::make_shared<Snapshot>(*current);
+    next->algorithms[algorithmId] = info;
+    next->revisions[algorithmId] = m_nextRevision++;
+    const QStringList algorithmIds = next->algorithms.keys();
+    publish(std::move(next));
+    locker.unlock();
+
     emit algorithmRegistered(algorithmId);
     emit algorithmAvailabilityChanged(algorithmId, true);
-    emit algorithmsChanged(internalGetAvailableAlgorithms());
+    emit algorithmsChanged(algorithmIds);
     qDebug() << "QAlgorithmRegistry: Registered algorithm " << algorithmId << "(" << info.name << ")";
     setLastError(QAlgorithmRegistryError::None);
     return true;
@@ -84,51 +194,51 @@ bool QAlgorithmRegistry::registerAlgorithmInternal(const QString &algorithmId, c
 
 bool QAlgorithmRegistry::unregisterAlgorithm(const QString &algorithmId)
 {
-    QMutexLocker locker(&m_mutex); // Mutex acquired for the entire operation
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::unregisterAlgorithm: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         emit errorOccurred(QAlgorithmRegistryError::EmptyAlgorithmId, errorMessage(QAlgorithmRegistryError::EmptyAlgorithmId));
         return false;
     }
-    if (!m_algorithms.contains(algorithmId)) {
+    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> current = m_snapshot;
+    if (!current->algorithms.contains(algorithmId)) {
+        locker.unlock();
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::unregisterAlgorithm: Algorithm not registered:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         emit errorOccurred(QAlgorithmRegistryError::AlgorithmNotFound, errorMessage(QAlgorithmRegistryError::AlgorithmNotFound) + ": " + algorithmId);
         return false;
     }
-    m_algorithms.remove(algorithmId);
+    auto next = std::make_shared<Snapshot>(*current);
+    next->algorithms.remove(algorithmId);
+    next->revisions.remove(algorithmId);
+    const QStringList algorithmIds = next->algorithms.keys();
+    publish(std::move(next));
+    locker.unlock();
+
     emit algorithmUnregistered(algorithmId);
     emit algorithmAvailabilityChanged(algorithmId, false);
-    emit algorithmsChanged(internalGetAvailableAlgorithms()); // Call internal helper
+    emit algorithmsChanged(algorithmIds);
     qDebug() << "QAlgorithmRegistry: unregistered algorithm" << algorithmId;
     setLastError(QAlgorithmRegistryError::None);
     return true;
 }
 
-// Public accessor for available algorithms (acquires mutex)
 QStringList QAlgorithmRegistry::getAvailableAlgorithms() const
 {
-    QMutexLocker locker(&m_mutex);
-    return internalGetAvailableAlgorithms(); // Call the internal helper
-}
-
-// New internal helper for getting available algorithms (assumes caller holds mutex)
-QStringList QAlgorithmRegistry::internalGetAvailableAlgorithms() const
-{
-    return m_algorithms.keys();
+    return snapshot()->algorithms.keys();
 }
 
 std::optional<QAlgorithmInfo> QAlgorithmRegistry::getAlgorithmInfo(const QString &algorithmId) const
 {
-    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> &current = snapshot();
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmInfo: empty algorithm id provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         return std::nullopt;
     }
-    auto it = m_algorithms.find(algorithmId);
-    if (it == m_algorithms.end()) {
+    auto it = current->algorithms.find(algorithmId);
+    if (it == current->algorithms.end()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmInfo: algorithm not found:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         return std::nullopt;
@@ -139,46 +249,55 @@ std::optional<QAlgorithmInfo> QAlgorithmRegistry::getAlgorithmInfo(const QString
 
 bool QAlgorithmRegistry::isAlgorithmAvailable(const QString &algorithmId) const
 {
-    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> &current = snapshot();
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::isAlgorithmAvailable: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         return false;
     }
-    bool available = m_algorithms.contains(algorithmId);
+    bool available = current->algorithms.contains(algorithmId);
     setLastError(QAlgorithmRegistryError::None);
     return available;
 }
 
 void QAlgorithmRegistry::clear()
 {
-    QMutexLocker locker(&m_mutex); // Mutex acquired for the entire clear operation
-    m_algorithms.clear();
-    // Re-initialize default algorithms *within* the locked context,
-    // safe because initializeDefaultAlgorithms calls registerAlgorithmInternal which doesn't lock
-    initializeDefaultAlgorithms();
+    QMutexLocker locker(&m_mutex);
+    auto next = std::make_shared<Snapshot>();
+    next->algorithms = defaultAlgorithms();
+    // Configurations survive, as the defaults come back under the same ids
+    next->configs = m_snapshot->configs;
+    const QStringList algorithmIds = next->algorithms.keys();
+    for (const QString &algorithmId : algorithmIds)
+        next->revisions[algorithmId] = m_nextRevision++;
+    publish(std::move(next));
+    locker.unlock();
+
+    for (const QString &algorithmId : algorithmIds) {
+        emit algorithmRegistered(algorithmId);
+        emit algorithmAvailabilityChanged(algorithmId, true);
+    }
     emit registryCleared();
-    emit algorithmsChanged(internalGetAvailableAlgorithms()); // Call internal helper
+    emit algorithmsChanged(algorithmIds);
     setLastError(QAlgorithmRegistryError::None); // Ensure error state is None after clear and re-init
 }
 
 int QAlgorithmRegistry::getAlgorithmCount()
 {
-    QMutexLocker locker(&m_mutex);
     setLastError(QAlgorithmRegistryError::None);
-    return m_algorithms.size();
+    return snapshot()->algorithms.size();
 }
 
 QString QAlgorithmRegistry::getAlgorithmName(const QString &algorithmId) const
 {
-    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> &current = snapshot();
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmName: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         return QString();
     }
-    auto it = m_algorithms.find(algorithmId);
-    if (it == m_algorithms.end()) {
+    auto it = current->algorithms.find(algorithmId);
+    if (it == current->algorithms.end()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmName: algorithm not found:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         return QString();
@@ -189,14 +308,14 @@ QString QAlgorithmRegistry::getAlgorithmName(const QString &algorithmId) const
 
 QString QAlgorithmRegistry::getAlgorithmDescription(const QString &algorithmId) const
 {
-    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> &current = snapshot();
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmDescription: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         return QString();
     }
-    auto it = m_algorithms.find(algorithmId);
-    if (it == m_algorithms.end()) {
+    auto it = current->algorithms.find(algorithmId);
+    if (it == current->algorithms.end()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmDescription: algorithm not found:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         return QString();
@@ -207,14 +326,14 @@ QString QAlgorithmRegistry::getAlgorithmDescription(const QString &algorithmId)
 
 AlgorithmCapabilities QAlgorithmRegistry::getAlgorithmCapabilities(const QString &algorithmId) const
 {
-    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> &current = snapshot();
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmCapabilities: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         return AlgorithmCapabilities();
     }
-    auto it = m_algorithms.find(algorithmId);
-    if (it == m_algorithms.end()) {
+    auto it = current->algorithms.find(algorithmId);
+    if (it == current->algorithms.end()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmCapabilities: algorithm not found:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         return AlgorithmCapabilities();
@@ -223,24 +342,29 @@ AlgorithmCapabilities QAlgorithmRegistry::getAlgorithmCapabilities(const QString
     return it.value().capabilities;
 }
 
+quint64 QAlgorithmRegistry::algorithmRevision(const QString &algorithmId) const
+{
+    return snapshot()->revisions.value(algorithmId, 0);
+}
+
 QMap<QString, QVariant> QAlgorithmRegistry::getAlgorithmConfiguration(const QString &algorithmId) const
 {
-    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> current = snapshot();
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmConfiguration: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         return QMap<QString, QVariant>();
     }
-    auto it = m_algorithms.find(algorithmId);
-    if (it == m_algorithms.end()) {
+    auto it = current->algorithms.find(algorithmId);
+    if (it == current->algorithms.end()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmConfiguration: algorithm not found:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         return QMap<QString, QVariant>();
     }
     // Return stored config if available
-    if (m_algorithmConfigs.contains(algorithmId)) {
+    if (current->configs.contains(algorithmId)) {
         setLastError(QAlgorithmRegistryError::None);
-        return m_algorithmConfigs[algorithmId];
+        return current->configs.value(algorithmId);
     }
     // Fallback: get from default instance
     if (it.value().factory) {
@@ -256,21 +380,27 @@ QMap<QString, QVariant> QAlgorithmRegistry::getAlgorithmConfiguration(const QStr
 
 bool QAlgorithmRegistry::setAlgorithmConfiguration(const QString &algorithmId, const QMap<QString, QVariant> &config)
 {
-    QMutexLocker locker(&m_mutex);
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::setAlgorithmConfiguration: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         emit errorOccurred(QAlgorithmRegistryError::EmptyAlgorithmId, errorMessage(QAlgorithmRegistryError::EmptyAlgorithmId));
         return false;
     }
-    auto it = m_algorithms.find(algorithmId);
-    if (it == m_algorithms.end()) {
+    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> current = m_snapshot;
+    if (!current->algorithms.contains(algorithmId)) {
+        locker.unlock();
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::setAlgorithmConfiguration: algorithm not found:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         emit errorOccurred(QAlgorithmRegistryError::AlgorithmNotFound, errorMessage(QAlgorithmRegistryError::AlgorithmNotFound) + ": " + algorithmId);
         return false;
     }
-    m_algorithmConfigs[algorithmId] = config;
+    auto next = std::make_shared<Snapshot>(*current);
+    next->configs[algorithmId] = config;
+    next->revisions[algorithmId] = m_nextRevision++;
+    publish(std::move(next));
+    locker.unlock();
+
     emit algorithmConfigurationChanged(algorithmId, config);
     setLastError(QAlgorithmRegistryError::None);
     return true;
@@ -278,15 +408,15 @@ bool QAlgorithmRegistry::setAlgorithmConfiguration(const QString &algorithmId, c
 
 std::unique_ptr<QDiffAlgorithm> QAlgorithmRegistry::createAlgorithm(const QString &algorithmId)
 {
-    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> current = snapshot();
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::createAlgorithm: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         emit errorOccurred(QAlgorithmRegistryError::EmptyAlgorithmId, errorMessage(QAlgorithmRegistryError::EmptyAlgorithmId));
         return nullptr;
     }
-    auto it = m_algorithms.find(algorithmId);
-    if (it == m_algorithms.end()) {
+    auto it = current->algorithms.find(algorithmId);
+    if (it == current->algorithms.end()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::createAlgorithm: algorithm not found:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         emit errorOccurred(QAlgorithmRegistryError::AlgorithmNotFound, errorMessage(QAlgorithmRegistryError::AlgorithmNotFound) + ": " + algorithmId);
@@ -305,23 +435,85 @@ std::unique_ptr<QDiffAlgorithm> QAlgorithmRegistry::createAlgorithm(const QStrin
         emit errorOccurred(QAlgorithmRegistryError::FactoryCreationFailed, errorMessage(QAlgorithmRegistryError::FactoryCreationFailed) + ": " + algorithmId);
         return nullptr;
     }
-    if (m_algorithmConfigs.contains(algorithmId)) {
-        algo->setConfiguration(m_algorithmConfigs[algorithmId]);
+    if (current->configs.contains(algorithmId)) {
+        algo->setConfiguration(current->configs.value(algorithmId));
     }
     setLastError(QAlgorithmRegistryError::None);
     return algo;
 }
 
+QPooledAlgorithm QAlgorithmRegistry::checkoutAlgorithm(const QString &algorithmId)
+{
+    const quint64 revision = snapshot()->revisions.value(algorithmId);
+    if (revision == 0 || m_poolCapacity <= 0)
+        return QPooledAlgorithm(createAlgorithm(algorithmId).release(), QAlgorithmReturn{algorithmId, revision});
+
+    InstancePool &pool = t_pool;
+    bump(pool.checkouts);
+    auto it = pool.idle.find(algorithmId);
+    if (it != pool.idle.end()) {
+        std::vector<InstancePool::Entry> &entries = it->second;
+        while (!entries.empty()) {
+            InstancePool::Entry entry = std::move(entries.back());
+            entries.pop_back();
+            if (entry.revision == revision) {
+                bump(pool.hits);
+                setLastError(QAlgorithmRegistryError::None);
+                return QPooledAlgorithm(entry.algorithm.release(), QAlgorithmReturn{algorithmId, revision});
+            }
+            bump(pool.invalidated);
+        }
+    }
+    // A registration racing with us at worst stamps the new instance stale, it is then not pooled
+    return QPooledAlgorithm(createAlgorithm(algorithmId).release(), QAlgorithmReturn{algorithmId, revision});
+}
+
+void QAlgorithmRegistry::returnAlgorithm(const QString &algorithmId, quint64 revision, std::unique_ptr<QDiffAlgorithm> algorithm)
+{
+    const int capacity = m_poolCapacity;
+    if (capacity <= 0)
+        return;
+    InstancePool &pool = t_pool;
+    if (snapshot()->revisions.value(algorithmId) != revision) {
+        bump(pool.invalidated);
+        return;
+    }
+    std::vector<InstancePool::Entry> &entries = pool.idle[algorithmId];
+    if (int(entries.size()) >= capacity)
+        return;
+    algorithm->reset();
+    entries.push_back({std::move(algorithm), revision});
+}
+
+QAlgorithmPoolStatistics QAlgorithmRegistry::poolStatistics() const
+{
+    QMutexLocker locker(&poolsMutex());
+    QAlgorithmPoolStatistics statistics = retiredStatistics();
+    for (const InstancePool *pool : livePools()) {
+        statistics.checkouts += pool->checkouts.load(std::memory_order_relaxed);
+        statistics.hits += pool->hits.load(std::memory_order_relaxed);
+        statistics.invalidated += pool->invalidated.load(std::memory_order_relaxed);
+    }
+    return statistics;
+}
+
+void QAlgorithmReturn::operator()(QDiffAlgorithm *algorithm) const
+{
+    std::unique_ptr<QDiffAlgorithm> owned(algorithm);
+    if (owned && revision != 0)
+        QAlgorithmRegistry::get_Instance().returnAlgorithm(algorithmId, revision, std::move(owned));
+}
+
 QStringList QAlgorithmRegistry::getAlgorithmConfigurationKeys(const QString& algorithmId) const
 {
-    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<const Snapshot> current = snapshot();
     if (algorithmId.isEmpty()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmConfigurationKeys: Empty algorithm ID provided";
         setLastError(QAlgorithmRegistryError::EmptyAlgorithmId);
         return QStringList();
     }
-    auto it = m_algorithms.find(algorithmId);
-    if (it == m_algorithms.end()) {
+    auto it = current->algorithms.find(algorithmId);
+    if (it == current->algorithms.end()) {
         if (m_errorOutputEnabled) qWarning() << "QAlgorithmRegistry::getAlgorithmConfigurationKeys: algorithm not found:" << algorithmId;
         setLastError(QAlgorithmRegistryError::AlgorithmNotFound);
         return QStringList();
@@ -368,10 +560,19 @@ QString QAlgorithmRegistry::errorMessage(const QAlgorithmRegistryError &error) c
     }
 }
 
+QAlgorithmRegistryError QAlgorithmRegistry::lastError() const
+{
+    return t_lastError;
+}
+
+void QAlgorithmRegistry::setLastError(QAlgorithmRegistryError error) const
+{
+    t_lastError = error;
+}
+
 QString QAlgorithmRegistry::lastErrorMessage() const
 {
-    QMutexLocker locker(&m_mutex);
-    return errorMessage(m_lastError);
+    return errorMessage(t_lastError);
 }
 
 }// namespace QDiffX
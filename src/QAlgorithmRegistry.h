@@ -1,6 +1,8 @@
 #pragma once
 #include "QDiffAlgorithm.h"
 #include <QMutex>
+#include <atomic>
+#include <memory>
 
 namespace QDiffX{
 
@@ -28,7 +30,28 @@ struct QAlgorithmInfo{
         capabilities(std::move(capabilities)), factory(std::move(factory)) {}
 };
 
+struct QAlgorithmPoolStatistics {
+    qint64 checkouts = 0;
+    qint64 hits = 0;            // Served by an idle pooled instance
+    qint64 invalidated = 0;     // Pooled instances dropped as their configuration changed
+
+    double hitRate() const { return checkouts > 0 ? double(hits) / double(checkouts) : 0.0; }
+};
+
+// Deleter of checked-out instances: hands them back to the pool of the thread releasing them
+struct QAlgorithmReturn {
+    QString algorithmId;
+    quint64 revision = 0;
+    void operator()(QDiffAlgorithm *algorithm) const;
+};
+using QPooledAlgorithm = std::unique_ptr<QDiffAlgorithm, QAlgorithmReturn>;
+
 // follows singleton pattern
+// Reads go to an immutable snapshot of the registered algorithms and never take
+// m_mutex; writers (register, unregister, clear, configuration) serialize on it,
+// publish a modified copy and emit their signals once the lock is released.
+// A snapshot is freed once it is replaced and the last reader holding it is done.
+// lastError() reports the last call made on the calling thread.
 class QAlgorithmRegistry : public QObject
 {
     Q_OBJECT
@@ -41,7 +64,16 @@ public:
     bool registerAlgorithm(const QString &algorithmId, const QAlgorithmInfo &info);
     bool unregisterAlgorithm(const QString &algorithmId);
     std::unique_ptr<QDiffAlgorithm> createAlgorithm(const QString& algorithmId);
+    // Like createAlgorithm, but reuses an idle configured instance of this thread when there is one.
+    // Checked-out instances must not be reconfigured, they go back to the pool as they are.
+    QPooledAlgorithm checkoutAlgorithm(const QString& algorithmId);
+
+    // Idle instances kept per algorithm and thread, 0 disables pooling
+    int poolCapacity() const { return m_poolCapacity; }
+    void setPoolCapacity(int capacity) { m_poolCapacity = qMax(0, capacity); }
+    QAlgorithmPoolStatistics poolStatistics() const;
 
+    static constexpr int DEFAULT_POOL_CAPACITY = 4;
 
     std::optional<QAlgorithmInfo> getAlgorithmInfo(const QString &algorithmId) const;
     bool isAlgorithmAvailable(const QString &algorithmId) const;
@@ -72,22 +104,18 @@ public:
     QMap<QString, QVariant> getAlgorithmConfiguration(const QString& algorithmId) const;
     bool setAlgorithmConfiguration(const QString& algorithmId, const QMap<QString, QVariant>& config);
     QStringList getAlgorithmConfigurationKeys(const QString& algorithmId) const;
+    // Changes whenever the algorithm is (re)registered or reconfigured; 0 if unknown
+    quint64 algorithmRevision(const QString& algorithmId) const;
 
     QStringList getAvailableAlgorithms() const;
 
     // Error Handeling:
-    QAlgorithmRegistryError lastError() const {  QMutexLocker locker(&m_mutex); return m_lastError; }
+    QAlgorithmRegistryError lastError() const;
     QString errorMessage(const QAlgorithmRegistryError &error) const;
     QString lastErrorMessage() const;
 
-    void setErrorOutputEnabled(bool enabled) {
-        QMutexLocker locker(&m_mutex);
-        m_errorOutputEnabled = enabled;
-    }
-    bool isErrorOutputEnabled() const {
-        QMutexLocker locker(&m_mutex);
-        return m_errorOutputEnabled;
-    }
+    void setErrorOutputEnabled(bool enabled) { m_errorOutputEnabled = enabled; }
+    bool isErrorOutputEnabled() const { return m_errorOutputEnabled; }
 
 
 
@@ -104,27 +132,46 @@ private:
     QAlgorithmRegistry();
     ~QAlgorithmRegistry() = default;
 
-    // Init Function to Register all default algotithms (note: to integrate additional algorithms add them here)
-    void initializeDefaultAlgorithms();
+    struct Snapshot {
+        QMap<QString, QAlgorithmInfo> algorithms;
+        QMap<QString, QMap<QString, QVariant>> configs;
+        // Changes whenever an id is (re)registered or reconfigured, retiring its pooled instances
+        QMap<QString, quint64> revisions;
+    };
+
+    // All default algotithms (note: to integrate additional algorithms add them here)
+    static QMap<QString, QAlgorithmInfo> defaultAlgorithms();
 
     QAlgorithmRegistry(const QAlgorithmRegistry &) = delete;
     QAlgorithmRegistry(const QAlgorithmRegistry &&) = delete;
     QAlgorithmRegistry operator=(const QAlgorithmRegistry &) = delete;
     QAlgorithmRegistry operator=(const QAlgorithmRegistry &&) = delete;
 
-    // without mutex locking (assumes caller handles locking)
-    bool registerAlgorithmInternal(const QString &algorithmId, const QAlgorithmInfo &info);
-    // without mutex locking (assumes caller handles locking)
-    QStringList internalGetAvailableAlgorithms() const;
+    // This thread's copy of the current snapshot, reloaded only when one was published
+    // since. Stays valid until this thread reads again after a publish, callers that
+    // run factories or other outside code in between hold their own copy.
+    const std::shared_ptr<const Snapshot> &snapshot() const;
+    // caller holds m_mutex
+    void publish(std::shared_ptr<const Snapshot> next);
+
+    void setLastError(QAlgorithmRegistryError error) const;
+
+    friend struct QAlgorithmReturn;
+    void returnAlgorithm(const QString &algorithmId, quint64 revision, std::unique_ptr<QDiffAlgorithm> algorithm);
 
-    void setLastError(QAlgorithmRegistryError error) const { m_lastError = error; }
+    struct SnapshotCache {
+        quint64 version = 0;
+        std::shared_ptr<const Snapshot> snapshot;
+    };
+    static thread_local SnapshotCache t_snapshotCache;
 
 private:
-    QMap<QString, QAlgorithmInfo> m_algorithms;
+    std::shared_ptr<const Snapshot> m_snapshot;     // guarded by m_mutex
+    std::atomic<quint64> m_snapshotVersion{0};      // bumped by every publish
     mutable QMutex m_mutex;
-    mutable QAlgorithmRegistryError m_lastError = QAlgorithmRegistryError::None;
-    bool m_errorOutputEnabled = false;
-    QMap<QString, QMap<QString, QVariant>> m_algorithmConfigs;
+    quint64 m_nextRevision = 1;     // guarded by m_mutex
+    std::atomic_bool m_errorOutputEnabled{false};
+    std::atomic_int m_poolCapacity{DEFAULT_POOL_CAPACITY};
 
 };
 
@@ -0,0 +1,362 @@
+#include "QBatchDiffEngine.h"
+#include "QAlgorithmRegistry.h"
+#include "QDiffTrace.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QPromise>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+namespace QDiffX{
+
+namespace {
+
+// Workers with nothing to take wait this long for a split pair to publish its parts
+constexpr int IDLE_WAIT_MS = 5;
+
+// Start of every line, plus the end of the text; lines keep their '\n'
+QVector<int> lineStarts(const QString &text)
+{
+    QVector<int> starts;
+    starts.reserve(text.count('\n') + 2);
+    starts.append(0);
+    int from = 0;
+    int newline;
+    while ((newline = text.indexOf('\n', from)) != -1) {
+        starts.append(newline + 1);
+        from = newline + 1;
+    }
+    if (starts.last() < text.length())
+        starts.append(text.length());
+    return starts;
+}
+
+// Maps every line to its index, or to -1 when it occurs more than once
+QHash<QStringView, int> uniqueLines(const QString &text, const QVector<int> &starts)
+{
+    QHash<QStringView, int> lines;
+    lines.reserve(starts.size());
+    for (int i = 0; i + 1 < starts.size(); ++i) {
+        const QStringView line = QStringView(text).mid(starts[i], starts[i + 1] - starts[i]);
+        auto it = lines.find(line);
+        if (it == lines.end())
+            lines.insert(line, i);
+        else
+            it.value() = -1;
+    }
+    return lines;
+}
+
+} // namespace
+
+struct QBatchDiffEngine::Task {
+    int pair = -1;
+    int part = -1;              // -1 for a whole pair, which may still be split
+    QString leftText;
+    QString rightText;
+    QString algorithmId;
+    qint64 cost = 0;
+};
+
+struct QBatchDiffEngine::BatchState {
+    struct WorkerQueue {
+        QMutex mutex;
+        std::deque<Task> tasks;     // Largest first
+    };
+    struct PairState {
+        QMutex mutex;
+        QList<QDiffResult> parts;
+        int remaining = 0;
+    };
+
+    BatchState(int workerCount, int pairCount) : queues(size_t(workerCount)), pairs(size_t(pairCount)) {}
+
+    DiffMode mode = DiffMode::Auto;
+    QPromise<QDiffResult> *promise = nullptr;   // Owned by the driver, which outlives every task
+    std::vector<WorkerQueue> queues;
+    std::vector<PairState> pairs;
+
+    std::atomic<int> outstanding{0};            // Tasks queued or running
+    std::atomic<int> completedPairs{0};
+    std::atomic<int> taskCount{0};
+    std::atomic<int> splitPairCount{0};
+    std::atomic<int> stealCount{0};
+
+    QMutex idleMutex;
+    QWaitCondition idle;
+};
+
+// ----------------------- Scheduling -------------------------
+
+QFuture<QDiffResult> QBatchDiffEngine::run(const QList<QBatchDiffJob> &jobs, DiffMode mode,
+                                           std::shared_ptr<QBatchDiffStats> stats, int workerCount) const
+{
+    if (workerCount <= 0)
+        workerCount = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+
+    return QtConcurrent::run([jobs, mode, stats, workerCount](QPromise<QDiffResult> &promise) {
+        QElapsedTimer timer;
+        timer.start();
+
+        auto state = std::make_shared<BatchState>(workerCount, int(jobs.size()));
+        state->mode = mode;
+        state->promise = &promise;
+
+        std::vector<Task> tasks;
+        tasks.reserve(size_t(jobs.size()));
+        qint64 totalCharacters = 0;
+        for (int i = 0; i < jobs.size(); ++i) {
+            Task task;
+            task.pair = i;
+            task.leftText = jobs[i].leftText;
+            task.rightText = jobs[i].rightText;
+            task.algorithmId = jobs[i].algorithmId;
+            task.cost = qint64(task.leftText.length()) + task.rightText.length();
+            totalCharacters += task.cost;
+            tasks.push_back(std::move(task));
+        }
+
+        // Largest estimated cost first, dealt round-robin so every worker starts on big pairs
+        std::stable_sort(tasks.begin(), tasks.end(), [](const Task &a, const Task &b) {
+            return a.cost > b.cost;
+        });
+        for (size_t i = 0; i < tasks.size(); ++i)
+            state->queues[i % size_t(workerCount)].tasks.push_back(std::move(tasks[i]));
+        state->outstanding = int(tasks.size());
+
+        promise.setProgressRange(0, int(jobs.size()));
+        if (!tasks.empty()) {
+            for (int worker = 1; worker < workerCount; ++worker)
+                QThreadPool::globalInstance()->start([state, worker]() { work(state, worker); });
+            // The driver is worker 0, so the batch progresses even when the pool is saturated
+            work(state, 0);
+        }
+
+        if (stats) {
+            stats->pairCount = int(jobs.size());
+            stats->taskCount = state->taskCount;
+            stats->splitPairCount = state->splitPairCount;
+            stats->stealCount = state->stealCount;
+            stats->workerCount = workerCount;
+            stats->totalCharacters = totalCharacters;
+            stats->elapsedMs = timer.elapsed();
+        }
+    });
+}
+
+void QBatchDiffEngine::work(const std::shared_ptr<BatchState> &state, int worker)
+{
+    Task task;
+    while (state->outstanding.load() > 0) {
+        if (takeTask(*state, worker, task)) {
+            runTask(*state, worker, task);
+            continue;
+        }
+        // Nothing to take, but a pair that is being split may still publish parts
+        QMutexLocker locker(&state->idleMutex);
+        if (state->outstanding.load() > 0)
+            state->idle.wait(&state->idleMutex, IDLE_WAIT_MS);
+    }
+}
+
+bool QBatchDiffEngine::takeTask(BatchState &state, int worker, Task &task)
+{
+    const int workerCount = int(state.queues.size());
+    for (int i = 0; i < workerCount; ++i) {
+        BatchState::WorkerQueue &queue = state.queues[size_t((worker + i) % workerCount)];
+        QMutexLocker locker(&queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        // Thieves also take the victim's largest task, so the biggest remaining work starts first
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        if (i > 0)
+            ++state.stealCount;
+        return true;
+    }
+    return false;
+}
+
+void QBatchDiffEngine::runTask(BatchState &state, int worker, Task &task)
+{
+    QDIFFX_TRACE_SCOPE("batch", "task");
+    auto finishTask = [&state]() {
+        if (--state.outstanding == 0) {
+            QMutexLocker locker(&state.idleMutex);
+            state.idle.wakeAll();
+        }
+    };
+
+    if (state.promise->isCanceled()) {
+        finishTask();
+        return;
+    }
+
+    if (task.part < 0 && task.cost >= SPLIT_COST_THRESHOLD) {
+        const int maxParts = int(qMin<qint64>(MAX_SPLIT_PARTS, task.cost / SPLIT_PART_COST));
+        QList<Task> parts = splitTask(task, maxParts);
+        if (parts.size() > 1) {
+            BatchState::PairState &pair = state.pairs[size_t(task.pair)];
+            {
+                QMutexLocker locker(&pair.mutex);
+                pair.parts = QList<QDiffResult>(parts.size());
+                pair.remaining = int(parts.size());
+            }
+            ++state.splitPairCount;
+            // The whole-pair task turns into its parts
+            state.outstanding += int(parts.size()) - 1;
+            {
+                BatchState::WorkerQueue &queue = state.queues[size_t(worker)];
+                QMutexLocker locker(&queue.mutex);
+                for (auto it = parts.rbegin(); it != parts.rend(); ++it)
+                    queue.tasks.push_front(std::move(*it));
+            }
+            QMutexLocker locker(&state.idleMutex);
+            state.idle.wakeAll();
+            return;
+        }
+    }
+
+    QDiffResult result;
+    QPooledAlgorithm algorithm = QAlgorithmRegistry::get_Instance().checkoutAlgorithm(task.algorithmId);
+    if (algorithm)
+        result = algorithm->calculateDiff(task.leftText, task.rightText, state.mode);
+    else
+        result = QDiffResult(QStringLiteral("Failed to create algorithm instance for %1").arg(task.algorithmId));
+    ++state.taskCount;
+
+    if (task.part >= 0) {
+        BatchState::PairState &pair = state.pairs[size_t(task.pair)];
+        QList<QDiffResult> parts;
+        {
+            QMutexLocker locker(&pair.mutex);
+            pair.parts[task.part] = result;
+            if (--pair.remaining > 0) {
+                locker.unlock();
+                finishTask();
+                return;
+            }
+            parts.swap(pair.parts);
+        }
+        result = stitch(parts);
+    }
+
+    state.promise->addResult(result, task.pair);
+    state.promise->setProgressValue(++state.completedPairs);
+    finishTask();
+}
+
+// ----------------------- Splitting -------------------------
+
+QList<QBatchDiffEngine::Task> QBatchDiffEngine::splitTask(const Task &task, int maxParts)
+{
+    QList<Task> parts;
+    if (maxParts < 2)
+        return parts;
+
+    const QString &left = task.leftText;
+    const QString &right = task.rightText;
+    const QVector<int> leftStarts = lineStarts(left);
+    const QVector<int> rightStarts = lineStarts(right);
+    const QHash<QStringView, int> leftUnique = uniqueLines(left, leftStarts);
+    const QHash<QStringView, int> rightUnique = uniqueLines(right, rightStarts);
+    const int leftLineCount = int(leftStarts.size()) - 1;
+
+    auto addPart = [&](int leftFrom, int leftTo, int rightFrom, int rightTo) {
+        Task part;
+        part.pair = task.pair;
+        part.part = int(parts.size());
+        part.leftText = left.mid(leftFrom, leftTo - leftFrom);
+        part.rightText = right.mid(rightFrom, rightTo - rightFrom);
+        part.algorithmId = task.algorithmId;
+        part.cost = qint64(part.leftText.length()) + part.rightText.length();
+        parts.append(std::move(part));
+    };
+
+    // Cut right after a line that occurs exactly once in both texts (and not at
+    // the end of either), at the '\n' ending it; the '\n' itself is dropped from
+    // both parts and restored when the part results are stitched together
+    int leftFrom = 0;
+    int rightFrom = 0;
+    int nextLine = 0;
+    int lastRightLine = -1;
+    for (int k = 1; k < maxParts; ++k) {
+        const int target = int(qint64(left.length()) * k / maxParts);
+        int line = int(std::lower_bound(leftStarts.begin(), leftStarts.end() - 1, target) - leftStarts.begin());
+        line = qMax(line, nextLine);
+
+        bool found = false;
+        for (; line < leftLineCount; ++line) {
+            const int leftEnd = leftStarts[line + 1];
+            if (leftEnd >= left.length())
+                break;
+            const QStringView text = QStringView(left).mid(leftStarts[line], leftEnd - leftStarts[line]);
+            if (leftUnique.value(text, -1) != line)
+                continue;
+            const int rightLine = rightUnique.value(text, -1);
+            if (rightLine <= lastRightLine || rightStarts[rightLine + 1] >= right.length())
+                continue;
+
+            const int leftCut = leftEnd - 1;
+            const int rightCut = rightStarts[rightLine + 1] - 1;
+            addPart(leftFrom, leftCut, rightFrom, rightCut);
+            leftFrom = leftCut + 1;
+            rightFrom = rightCut + 1;
+            lastRightLine = rightLine;
+            nextLine = line + 1;
+            found = true;
+            break;
+        }
+        if (!found)
+            break;      // Later targets would scan the same anchorless tail
+    }
+    if (parts.isEmpty())
+        return parts;
+
+    addPart(leftFrom, int(left.length()), rightFrom, int(right.length()));
+    return parts;
+}
+
+QDiffResult QBatchDiffEngine::stitch(const QList<QDiffResult> &parts)
+{
+    for (const QDiffResult &part : parts) {
+        if (!part.success())
+            return part;
+    }
+
+    // Line separated results (DTL) imply the '\n' between parts, others need it
+    // back as an Equal change; numbering follows the algorithms' own convention
+    const bool lineSeparated = parts.first().metaData("line_separated").toBool();
+    QList<DiffChange> changes;
+    int position = 0;
+    auto append = [&changes, &position](DiffChange change) {
+        change.lineNumber = int(changes.size()) + 1;
+        change.position = position;
+        if (change.operation != DiffOperation::Delete)
+            position += change.text.length();
+        changes.append(change);
+    };
+    for (int i = 0; i < parts.size(); ++i) {
+        if (i > 0 && !lineSeparated)
+            append(DiffChange(DiffOperation::Equal, QStringLiteral("\n")));
+        for (const DiffChange &change : parts[i].changes())
+            append(change);
+    }
+
+    QDiffResult result;
+    result.setChanges(changes);
+    result.setSuccess(true);
+    QMap<QString, QVariant> metadata = parts.first().allMetaData();
+    metadata["total_changes"] = changes.size();
+    metadata["split_parts"] = parts.size();
+    result.setMetaData(metadata);
+    return result;
+}
+
+}//namespace QDiffX
@@ -0,0 +1,64 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include <QFuture>
+#include <QList>
+#include <QString>
+#include <memory>
+
+namespace QDiffX{
+
+struct QDiffPair {
+    QString leftText;
+    QString rightText;
+};
+
+// A pair together with the algorithm that should diff it
+struct QBatchDiffJob {
+    QString leftText;
+    QString rightText;
+    QString algorithmId;
+};
+
+// Aggregate figures of one batch, complete once its future has finished
+struct QBatchDiffStats {
+    int pairCount = 0;
+    int taskCount = 0;          // Diffs actually run, split pairs count once per part
+    int splitPairCount = 0;
+    int stealCount = 0;         // Tasks a worker took from another worker's queue
+    int workerCount = 0;
+    qint64 totalCharacters = 0;
+    qint64 elapsedMs = 0;
+
+    double pairsPerSecond() const { return elapsedMs > 0 ? pairCount * 1000.0 / elapsedMs : 0.0; }
+    double charactersPerSecond() const { return elapsedMs > 0 ? totalCharacters * 1000.0 / elapsedMs : 0.0; }
+};
+
+// Diffs many pairs on a work-stealing pool.
+// Pairs are dealt largest-estimated-cost first across per-worker queues, idle
+// workers steal from the others, and pairs above SPLIT_COST_THRESHOLD are cut
+// at lines that occur exactly once in both texts and diffed as independent
+// parts. Results are reported at their pair index as soon as they complete.
+class QBatchDiffEngine
+{
+public:
+    // workerCount defaults to the global thread pool's maxThreadCount()
+    QFuture<QDiffResult> run(const QList<QBatchDiffJob> &jobs, DiffMode mode,
+                             std::shared_ptr<QBatchDiffStats> stats = nullptr, int workerCount = 0) const;
+
+    // Pairs with at least this many characters (both sides) are split
+    static constexpr qint64 SPLIT_COST_THRESHOLD = 512 * 1024;
+    static constexpr qint64 SPLIT_PART_COST = 256 * 1024;
+    static constexpr int MAX_SPLIT_PARTS = 64;
+
+private:
+    struct BatchState;
+    struct Task;
+
+    static void work(const std::shared_ptr<BatchState> &state, int worker);
+    static bool takeTask(BatchState &state, int worker, Task &task);
+    static void runTask(BatchState &state, int worker, Task &task);
+    static QList<Task> splitTask(const Task &task, int maxParts);
+    static QDiffResult stitch(const QList<QDiffResult> &parts);
+};
+
+}//namespace QDiffX
@@ -4,10 +4,13 @@
 #include <QMap>
 #include <QString>
 #include <QVariant>
+#include <memory>
 
 
 namespace QDiffX{
 
+class QDiffHunkIndex;
+
 enum class DiffOperation{
     Equal,
     Insert,
@@ -71,12 +74,18 @@ public:
     QMap<QString, QVariant> allMetaData() const { return m_metaData; }
     QVariant metaData(const QString &Key) const { return m_metaData.value(Key); }
     void setMetaData(const QMap<QString, QVariant> &newMetaData) { m_metaData = newMetaData; }
+    void setMetaData(const QString &key, const QVariant &value) { m_metaData.insert(key, value); }
+
+    // Set by QAlgorithmManager on successful results, see QDiffHunkIndex.h
+    std::shared_ptr<const QDiffHunkIndex> hunkIndex() const { return m_hunkIndex; }
+    void setHunkIndex(std::shared_ptr<const QDiffHunkIndex> index) { m_hunkIndex = std::move(index); }
 
 private:
     QList<DiffChange> m_changes;
     bool m_success;
     QString m_errorMessage;
     QMap<QString, QVariant> m_metaData;
+    std::shared_ptr<const QDiffHunkIndex> m_hunkIndex;
 };
 
 
@@ -128,6 +137,9 @@ public:
     virtual void setConfiguration(const QMap<QString, QVariant> &newConfig)  { m_config = newConfig; }
     virtual QStringList getConfigurationKeys() const { return QStringList(); }
 
+    // Drops whatever state one diff left behind, before a pooled instance serves the next
+    virtual void reset() {}
+
     // Performance estimation
     virtual int estimateComplexity(const QString& leftText, const QString& rightText) const {
         return leftText.length() + rightText.length();
@@ -0,0 +1,39 @@
+#include "QDiffCancellation.h"
+
+namespace QDiffX{
+
+namespace {
+
+thread_local const std::atomic_bool *t_flag = nullptr;
+
+} // namespace
+
+QDiffCancellation::Scope::Scope(const std::atomic_bool *flag)
+    : m_outer(t_flag)
+{
+    t_flag = flag;
+}
+
+QDiffCancellation::Scope::~Scope()
+{
+    t_flag = m_outer;
+}
+
+const std::atomic_bool *QDiffCancellation::currentFlag()
+{
+    return t_flag;
+}
+
+bool QDiffCancellation::isCancelled()
+{
+    const std::atomic_bool *flag = t_flag;
+    return flag && flag->load(std::memory_order_relaxed);
+}
+
+void QDiffCancellation::checkpoint()
+{
+    if (isCancelled())
+        throw QDiffCancelled();
+}
+
+}//namespace QDiffX
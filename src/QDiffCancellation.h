@@ -0,0 +1,38 @@
+#pragma once
+#include <QtGlobal>
+#include <atomic>
+
+namespace QDiffX{
+
+// Thrown from an engine's inner loop once the diff running on its thread is cancelled
+struct QDiffCancelled {};
+
+// Cooperative cancellation of the diff running on this thread.
+// A Scope binds a flag to the thread for the duration of one calculateDiff();
+// engines poll it from their long-running loops (DTL through its line
+// comparator, DMP in diff_bisect) and abandon the diff once another thread
+// sets it. Without a scope nothing is ever cancelled.
+class QDiffCancellation
+{
+public:
+    class Scope
+    {
+    public:
+        explicit Scope(const std::atomic_bool *flag);
+        ~Scope();
+
+    private:
+        Q_DISABLE_COPY(Scope)
+
+        const std::atomic_bool *m_outer;
+    };
+
+    // Flag of the innermost scope on this thread, nullptr without one; engines
+    // polling in hot loops keep it rather than look it up every time
+    static const std::atomic_bool *currentFlag();
+    static bool isCancelled();
+    // Throws QDiffCancelled when cancelled
+    static void checkpoint();
+};
+
+}//namespace QDiffX
@@ -0,0 +1,92 @@
+#include "QDiffChangeHistogram.h"
+
+namespace QDiffX{
+
+namespace {
+
+void countLine(QDiffChangeHistogram::Counts &counts, DiffOperation operation)
+{
+    switch (operation) {
+    case DiffOperation::Insert:
+        ++counts.inserted;
+        break;
+    case DiffOperation::Delete:
+        ++counts.deleted;
+        break;
+    case DiffOperation::Replace:
+        ++counts.replaced;
+        break;
+    case DiffOperation::Equal:
+        break;
+    }
+}
+
+} // namespace
+
+QDiffChangeHistogram::Counts &QDiffChangeHistogram::Counts::operator+=(const Counts &other)
+{
+    inserted += other.inserted;
+    deleted += other.deleted;
+    replaced += other.replaced;
+    return *this;
+}
+
+QDiffChangeHistogram::QDiffChangeHistogram(const QList<DiffOperation> &lineOperations)
+{
+    auto data = std::make_shared<Data>();
+    data->lines = lineOperations;
+
+    std::vector<Counts> finest((lineOperations.size() + FINEST_BUCKET_LINES - 1) / FINEST_BUCKET_LINES);
+    for (qsizetype line = 0; line < lineOperations.size(); ++line)
+        countLine(finest[line / FINEST_BUCKET_LINES], lineOperations[line]);
+    data->levels.push_back(std::move(finest));
+
+    // Every level sums pairs of the one below, up to a single bucket
+    while (data->levels.back().size() > 1) {
+        const std::vector<Counts> &below = data->levels.back();
+        std::vector<Counts> level((below.size() + 1) / 2);
+        for (size_t bucket = 0; bucket < below.size(); ++bucket)
+            level[bucket / 2] += below[bucket];
+        data->levels.push_back(std::move(level));
+    }
+    m_data = std::move(data);
+}
+
+int QDiffChangeHistogram::lineCount() const
+{
+    return m_data ? int(m_data->lines.size()) : 0;
+}
+
+bool QDiffChangeHistogram::isEmpty() const
+{
+    return lineCount() == 0;
+}
+
+QDiffChangeHistogram::Counts QDiffChangeHistogram::count(int first, int end) const
+{
+    Counts counts;
+    first = qMax(0, first);
+    end = qMin(end, lineCount());
+    const int span = end - first;
+    if (span <= 0)
+        return counts;
+
+    if (span < 2 * FINEST_BUCKET_LINES) {
+        for (int line = first; line < end; ++line)
+            countLine(counts, m_data->lines[line]);
+        return counts;
+    }
+
+    size_t level = 0;
+    int bucketLines = FINEST_BUCKET_LINES;
+    while (level + 1 < m_data->levels.size() && bucketLines * 4 <= span) {
+        ++level;
+        bucketLines *= 2;
+    }
+    const std::vector<Counts> &buckets = m_data->levels[level];
+    for (int bucket = first / bucketLines; bucket <= (end - 1) / bucketLines; ++bucket)
+        counts += buckets[bucket];
+    return counts;
+}
+
+}//namespace QDiffX
@@ -0,0 +1,46 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include <QList>
+#include <memory>
+#include <vector>
+
+namespace QDiffX{
+
+// Changed lines of a document counted at several resolutions, so that any range
+// of lines is read from a handful of buckets whatever its length. Level i holds
+// buckets of FINEST_BUCKET_LINES << i lines; ranges too short for the finest
+// level are counted line by line. Copies share the counts.
+class QDiffChangeHistogram
+{
+public:
+    struct Counts {
+        int inserted = 0;
+        int deleted = 0;
+        int replaced = 0;
+
+        int changed() const { return inserted + deleted + replaced; }
+        Counts &operator+=(const Counts &other);
+    };
+
+    QDiffChangeHistogram() = default;
+    // One operation per line
+    explicit QDiffChangeHistogram(const QList<DiffOperation> &lineOperations);
+
+    int lineCount() const;
+    bool isEmpty() const;
+    // Changes among lines [first, end). Read from buckets at most a quarter of the
+    // range long, so either edge may take in part of one bucket more.
+    Counts count(int first, int end) const;
+
+    static constexpr int FINEST_BUCKET_LINES = 64;
+
+private:
+    struct Data {
+        QList<DiffOperation> lines;
+        std::vector<std::vector<Counts>> levels;
+    };
+
+    std::shared_ptr<const Data> m_data;
+};
+
+}//namespace QDiffX
@@ -0,0 +1,101 @@
+#include "QDiffDaemonProtocol.h"
+#include <QtEndian>
+
+namespace QDiffX{
+
+void QDiffDaemonProtocol::writeFrame(QIODevice *device, const QByteArray &payload)
+{
+    const quint32 size = qToBigEndian(quint32(payload.size()));
+    device->write(reinterpret_cast<const char *>(&size), sizeof(size));
+    device->write(payload);
+}
+
+bool QDiffDaemonProtocol::readFrame(QIODevice *device, QByteArray *payload, bool *error, quint32 maxSize)
+{
+    *error = false;
+    quint32 size = 0;
+    if (device->peek(reinterpret_cast<char *>(&size), sizeof(size)) != sizeof(size))
+        return false;
+    size = qFromBigEndian(size);
+    if (size > maxSize) {
+        *error = true;
+        return false;
+    }
+    if (device->bytesAvailable() < qint64(sizeof(size)) + size)
+        return false;
+    device->skip(sizeof(size));
+    *payload = device->read(size);
+    return true;
+}
+
+bool QDiffDaemonProtocol::readFrameBlocking(QIODevice *device, QByteArray *payload)
+{
+    // Pipes hand out whatever has arrived, so read until the requested size is complete
+    auto readExactly = [device](char *data, qint64 size) {
+        while (size > 0) {
+            const qint64 count = device->read(data, size);
+            if (count <= 0)
+                return false;
+            data += count;
+            size -= count;
+        }
+        return true;
+    };
+
+    quint32 size = 0;
+    if (!readExactly(reinterpret_cast<char *>(&size), sizeof(size)))
+        return false;
+    size = qFromBigEndian(size);
+    if (size > MAX_FRAME_SIZE)
+        return false;
+    payload->resize(size);
+    return readExactly(payload->data(), size);
+}
+
+QString QDiffDaemonProtocol::defaultServerName()
+{
+    QString user = qEnvironmentVariable("USER");
+    if (user.isEmpty())
+        user = qEnvironmentVariable("USERNAME");
+    return user.isEmpty() ? QStringLiteral("qdiffx") : QStringLiteral("qdiffx-%1").arg(user);
+}
+
+// ----------------------- QDiffResult Streaming -------------------------
+
+QDataStream &operator<<(QDataStream &stream, const QDiffResult &result)
+{
+    const QList<DiffChange> changes = result.changes();
+    stream << result.success() << result.errorMessage() << result.allMetaData() << quint32(changes.size());
+    for (const DiffChange &change : changes)
+        stream << quint8(change.operation) << change.text << qint32(change.lineNumber) << qint32(change.position);
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, QDiffResult &result)
+{
+    bool success = false;
+    QString errorMessage;
+    QMap<QString, QVariant> metaData;
+    quint32 count = 0;
+    stream >> success >> errorMessage >> metaData >> count;
+
+    QList<DiffChange> changes;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint8 operation;
+        DiffChange change;
+        qint32 line, position;
+        stream >> operation >> change.text >> line >> position;
+        change.operation = DiffOperation(operation);
+        change.lineNumber = line;
+        change.position = position;
+        changes.append(change);
+    }
+
+    result = QDiffResult(errorMessage);
+    result.setSuccess(success && stream.status() == QDataStream::Ok);
+    result.setChanges(changes);
+    result.setMetaData(metaData);
+    return stream;
+}
+
+}//namespace QDiffX
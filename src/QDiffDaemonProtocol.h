@@ -0,0 +1,47 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include <QByteArray>
+#include <QDataStream>
+#include <QIODevice>
+
+namespace QDiffX{
+
+// Wire format between qdiffx-cli --daemon and its clients, and between
+// QProcessDiffPool and its qdiffx-cli --worker processes.
+//
+// Every message is a frame: quint32 payload size followed by the payload, a
+// QDataStream (Qt_6_0, big endian) of
+//   request:  quint8 type, quint32 id, then
+//             Diff:  QString algorithm id (empty = auto), quint8 DiffMode,
+//                    QString left, QString right
+//             Stats: nothing
+//   response: quint8 type, quint32 id, then
+//             Diff:  bool served from cache, QDiffResult
+//             Stats: QVariantMap
+// Responses carry the id of their request and may arrive out of order.
+class QDiffDaemonProtocol
+{
+public:
+    enum MessageType : quint8 {
+        Diff = 1,
+        Stats = 2
+    };
+
+    static void writeFrame(QIODevice *device, const QByteArray &payload);
+    // False until a whole frame is buffered; *error is set for a frame larger than maxSize
+    static bool readFrame(QIODevice *device, QByteArray *payload, bool *error, quint32 maxSize = MAX_FRAME_SIZE);
+    // For blocking devices such as a QFile on stdin; false at end of input or on a bad frame
+    static bool readFrameBlocking(QIODevice *device, QByteArray *payload);
+
+    // Per-user socket name, so daemons of different users do not collide
+    static QString defaultServerName();
+
+    static constexpr QDataStream::Version STREAM_VERSION = QDataStream::Qt_6_0;
+    // Between a pool and its own workers; daemons take a lower limit from their clients
+    static constexpr quint32 MAX_FRAME_SIZE = 1024u * 1024u * 1024u;
+};
+
+QDataStream &operator<<(QDataStream &stream, const QDiffResult &result);
+QDataStream &operator>>(QDataStream &stream, QDiffResult &result);
+
+}//namespace QDiffX
@@ -0,0 +1,178 @@
+#include "QDiffHunkIndex.h"
+#include <algorithm>
+
+namespace QDiffX{
+
+namespace {
+
+int changeLines(const QString &text)
+{
+    int lines = int(text.count('\n'));
+    if (!text.isEmpty() && !text.endsWith('\n'))
+        ++lines;
+    return lines;
+}
+
+int start(const QDiffHunk &hunk, QDiffHunkIndex::Side side)
+{
+    return side == QDiffHunkIndex::Side::Left ? hunk.leftStart : hunk.rightStart;
+}
+
+int count(const QDiffHunk &hunk, QDiffHunkIndex::Side side)
+{
+    return side == QDiffHunkIndex::Side::Left ? hunk.leftCount : hunk.rightCount;
+}
+
+} // namespace
+
+QDiffHunkIndex::QDiffHunkIndex(const QList<DiffChange> &changes, bool lineSeparated)
+{
+    // A separated text ending in '\n' splits into a trailing empty element,
+    // which is the last change of its side and not a line
+    int lastLeft = -1;
+    int lastRight = -1;
+    if (lineSeparated) {
+        for (int i = 0; i < changes.size(); ++i) {
+            if (changes[i].operation != DiffOperation::Insert) lastLeft = i;
+            if (changes[i].operation != DiffOperation::Delete) lastRight = i;
+        }
+    }
+    auto linesOf = [&](int i, int last) {
+        if (!lineSeparated)
+            return changeLines(changes[i].text);
+        return i == last && changes[i].text.isEmpty() ? 0 : 1;
+    };
+
+    int leftLine = 0;
+    int rightLine = 0;
+    bool open = false;
+    QDiffHunk current;
+    auto close = [&]() {
+        if (open && current.leftCount + current.rightCount > 0)
+            m_hunks.append(current);
+        open = false;
+    };
+
+    for (int i = 0; i < changes.size(); ++i) {
+        const DiffChange &change = changes[i];
+        if (change.operation == DiffOperation::Equal) {
+            const int leftLines = linesOf(i, lastLeft);
+            const int rightLines = linesOf(i, lastRight);
+            // Hunks are only apart when at least one line lies between them
+            if (leftLines > 0 || rightLines > 0)
+                close();
+            leftLine += leftLines;
+            rightLine += rightLines;
+            continue;
+        }
+
+        if (!open) {
+            current = QDiffHunk();
+            current.leftStart = leftLine;
+            current.rightStart = rightLine;
+            open = true;
+        }
+        if (change.operation == DiffOperation::Insert) {
+            const int lines = linesOf(i, lastRight);
+            current.rightCount += lines;
+            rightLine += lines;
+        } else {
+            const int lines = linesOf(i, lastLeft);
+            current.leftCount += lines;
+            leftLine += lines;
+        }
+    }
+    close();
+}
+
+QDiffHunkIndex QDiffHunkIndex::fromLineOperations(const QList<DiffOperation> &left, const QList<DiffOperation> &right)
+{
+    QDiffHunkIndex index;
+    const int lineCount = int(qMax(left.size(), right.size()));
+    auto changed = [&](int line) {
+        return (line < left.size() && left[line] != DiffOperation::Equal)
+               || (line < right.size() && right[line] != DiffOperation::Equal);
+    };
+
+    int line = 0;
+    while (line < lineCount) {
+        if (!changed(line)) {
+            ++line;
+            continue;
+        }
+        int end = line;
+        while (end < lineCount && changed(end))
+            ++end;
+        QDiffHunk hunk;
+        hunk.leftStart = hunk.rightStart = line;
+        hunk.leftCount = hunk.rightCount = end - line;
+        index.m_hunks.append(hunk);
+        line = end;
+    }
+    return index;
+}
+
+int QDiffHunkIndex::hunkCount() const
+{
+    return int(m_hunks.size());
+}
+
+bool QDiffHunkIndex::isEmpty() const
+{
+    return m_hunks.isEmpty();
+}
+
+QDiffHunk QDiffHunkIndex::hunk(int index) const
+{
+    return m_hunks.value(index);
+}
+
+QList<QDiffHunk> QDiffHunkIndex::hunks() const
+{
+    return m_hunks;
+}
+
+int QDiffHunkIndex::hunkAt(Side side, int line) const
+{
+    const int index = lastHunkFrom(side, line);
+    if (index < 0 || line >= start(m_hunks[index], side) + count(m_hunks[index], side))
+        return -1;
+    return index;
+}
+
+int QDiffHunkIndex::nextHunk(Side side, int line) const
+{
+    auto after = std::upper_bound(m_hunks.cbegin(), m_hunks.cend(), line,
+                                  [side](int value, const QDiffHunk &hunk) { return value < start(hunk, side); });
+    return after == m_hunks.cend() ? -1 : int(after - m_hunks.cbegin());
+}
+
+int QDiffHunkIndex::previousHunk(Side side, int line) const
+{
+    auto from = std::lower_bound(m_hunks.cbegin(), m_hunks.cend(), line,
+                                 [side](const QDiffHunk &hunk, int value) { return start(hunk, side) < value; });
+    return int(from - m_hunks.cbegin()) - 1;
+}
+
+int QDiffHunkIndex::mapLine(Side from, int line) const
+{
+    const int index = lastHunkFrom(from, line);
+    // Lines before the first hunk are the same on both sides
+    if (index < 0)
+        return line;
+
+    const Side to = from == Side::Left ? Side::Right : Side::Left;
+    const QDiffHunk &hunk = m_hunks[index];
+    const int end = start(hunk, from) + count(hunk, from);
+    if (line < end)
+        return start(hunk, to) + qMin(line - start(hunk, from), qMax(0, count(hunk, to) - 1));
+    return line - end + start(hunk, to) + count(hunk, to);
+}
+
+int QDiffHunkIndex::lastHunkFrom(Side side, int line) const
+{
+    const int next = nextHunk(side, line);
+    return (next < 0 ? hunkCount() : next) - 1;
+}
+
+}//namespace QDiffX
@@ -0,0 +1,54 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include <QList>
+
+namespace QDiffX{
+
+// A run of changed lines; lines are 0-based, a side with no lines is where the
+// other side's lines would go
+struct QDiffHunk {
+    int leftStart = 0;
+    int leftCount = 0;
+    int rightStart = 0;
+    int rightCount = 0;
+};
+
+// Hunks of a diff sorted on both sides, so that finding a hunk or mapping a line
+// between the sides is a binary search. Between hunks lines map one to one.
+class QDiffHunkIndex
+{
+public:
+    enum class Side { Left, Right };
+
+    QDiffHunkIndex() = default;
+    // From a unified change list. Replace changes count as left lines only, as in
+    // QAlgorithmManager::divideDiffForSideBySide(). With lineSeparated (results
+    // flagged "line_separated", e.g. DTL) every change is one line without its '\n'.
+    explicit QDiffHunkIndex(const QList<DiffChange> &changes, bool lineSeparated = false);
+    // Runs of lines changed in either list, for documents already aligned line by line
+    static QDiffHunkIndex fromLineOperations(const QList<DiffOperation> &left,
+                                             const QList<DiffOperation> &right = QList<DiffOperation>());
+
+    int hunkCount() const;
+    bool isEmpty() const;
+    QDiffHunk hunk(int index) const;
+    QList<QDiffHunk> hunks() const;
+
+    // Hunk holding the line, -1 if it is unchanged
+    int hunkAt(Side side, int line) const;
+    // First hunk starting after the line, -1 if none
+    int nextHunk(Side side, int line) const;
+    // Last hunk starting before the line, -1 if none
+    int previousHunk(Side side, int line) const;
+    // Line of the other side matching the line; lines inside a hunk map into the
+    // other side's part of it, or to where it would be when that part is empty
+    int mapLine(Side from, int line) const;
+
+private:
+    // Last hunk starting at or before the line, -1 if none
+    int lastHunkFrom(Side side, int line) const;
+
+    QList<QDiffHunk> m_hunks;
+};
+
+}//namespace QDiffX
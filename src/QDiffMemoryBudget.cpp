@@ -0,0 +1,161 @@
+#include "QDiffMemoryBudget.h"
+#include "dtl/dtl.hpp"
+#include <QSet>
+#include <cmath>
+#include <new>
+
+namespace QDiffX{
+
+namespace {
+
+thread_local QDiffMemoryBudget::Scope *t_scope = nullptr;
+
+// Rough per-item costs of the containers the engines build
+constexpr qint64 STRING_BYTES = qint64(sizeof(QString));
+constexpr qint64 HASH_NODE_BYTES = 32;
+constexpr qint64 CHANGE_BYTES = qint64(sizeof(DiffChange)) + 16;
+constexpr qint64 DTL_COORDINATE_BYTES = 3 * qint64(sizeof(long long));
+constexpr qint64 DTL_SES_ELEMENT_BYTES = STRING_BYTES + 3 * qint64(sizeof(long long));
+// kTracebackBudgetWords 64-bit words in bit_parallel_lcs.cpp
+constexpr qint64 LCS_TRACEBACK_BYTES = (qint64(1) << 22) * 8;
+
+int lineCount(const QString &text)
+{
+    if (text.isEmpty())
+        return 0;
+    return int(text.count('\n')) + (text.endsWith('\n') ? 0 : 1);
+}
+
+// Lines of a text, split once for everything measure() derives from them
+struct SplitText {
+    QList<QStringView> lines;
+    int lineCount = 0;
+};
+
+SplitText splitLines(const QString &text)
+{
+    SplitText split;
+    if (text.isEmpty())
+        return split;
+    split.lines = QStringView(text).split('\n');
+    // A final '\n' leaves an empty piece that is not a line
+    split.lineCount = int(split.lines.size()) - (text.endsWith('\n') ? 1 : 0);
+    return split;
+}
+
+// Share of an evenly spaced sample of sampled's lines that other does not contain
+double missingLineShare(const QList<QStringView> &sampled, const QList<QStringView> &other)
+{
+    if (sampled.isEmpty())
+        return 0.0;
+    const qsizetype stride = qMax<qsizetype>(1, sampled.size() / QDiffMemoryBudget::EDIT_SAMPLE_LINES);
+    QSet<QStringView> sample;
+    for (qsizetype i = 0; i < sampled.size(); i += stride)
+        sample.insert(sampled[i]);
+
+    const qsizetype sampleSize = sample.size();
+    for (QStringView line : other) {
+        sample.remove(line);
+        if (sample.isEmpty())
+            break;
+    }
+    return double(sample.size()) / double(sampleSize);
+}
+
+} // namespace
+
+QDiffMemoryBudget::Scope::Scope(qint64 limitBytes)
+    : m_limit(limitBytes), m_outer(t_scope)
+{
+    t_scope = this;
+}
+
+QDiffMemoryBudget::Scope::~Scope()
+{
+    t_scope = m_outer;
+}
+
+bool QDiffMemoryBudget::charge(qint64 bytes)
+{
+    bool withinBudget = true;
+    for (Scope *scope = t_scope; scope; scope = scope->m_outer) {
+        scope->m_charged += bytes;
+        ++scope->m_chargeCount;
+        if (scope->m_limit > 0 && scope->m_charged > scope->m_limit)
+            scope->m_exceeded = true;
+        withinBudget = withinBudget && !scope->m_exceeded;
+    }
+    return withinBudget;
+}
+
+void QDiffMemoryBudget::require(qint64 bytes)
+{
+    if (!charge(bytes))
+        throw std::bad_alloc();
+}
+
+QDiffShape QDiffMemoryBudget::measure(const QString &leftText, const QString &rightText)
+{
+    QDiffShape shape;
+    shape.leftChars = leftText.size();
+    shape.rightChars = rightText.size();
+    if (leftText == rightText) {
+        shape.leftLines = shape.rightLines = lineCount(leftText);
+        return shape;
+    }
+    const SplitText left = splitLines(leftText);
+    const SplitText right = splitLines(rightText);
+    shape.leftLines = left.lineCount;
+    shape.rightLines = right.lineCount;
+    const double edits = missingLineShare(left.lines, right.lines) * shape.leftLines
+                         + missingLineShare(right.lines, left.lines) * shape.rightLines;
+    // Differing texts are at least one line apart
+    shape.estimatedEditLines = qMax(1, int(std::ceil(edits)));
+    return shape;
+}
+
+qint64 QDiffMemoryBudget::estimate(const QString &algorithmId, DiffMode mode, const QDiffShape &shape)
+{
+    const qint64 chars = shape.leftChars + shape.rightChars;
+    const qint64 lines = shape.leftLines + shape.rightLines;
+    const qint64 editLines = shape.estimatedEditLines;
+    // Every engine copies the texts into its changes
+    const qint64 result = (lines + editLines) * CHANGE_BYTES + chars * 2;
+
+    if (algorithmId == QLatin1String("dtl")) {
+        // O(NP): P iterations of snakes over diagonals -P..delta+P, each leaving a path coordinate
+        const qint64 delta = qAbs(shape.leftLines - shape.rightLines);
+        const qint64 p = qMax<qint64>(0, (editLines - delta) / 2);
+        const qint64 coordinates = qMin<qint64>(qint64(dtl::MAX_CORDINATES_SIZE), (p + 1) * (delta + p + 1));
+        return lines * STRING_BYTES * 2 + chars * 2
+               + (lines + 3) * 2 * qint64(sizeof(long long))
+               + coordinates * DTL_COORDINATE_BYTES
+               + (lines + editLines) * DTL_SES_ELEMENT_BYTES * 2
+               + result;
+    }
+
+    qint64 symbols = lines;
+    if (mode == DiffMode::CharByChar)
+        symbols = chars;
+    else if (mode == DiffMode::WordByWord)
+        symbols = chars / 5 + lines;
+
+    if (algorithmId == QLatin1String("lcs")) {
+        // Interned ids and linear prefix rows; the stored traceback columns are capped
+        const qint64 rows = mode == DiffMode::CharByChar ? shape.leftChars : symbols / 2;
+        const qint64 columns = mode == DiffMode::CharByChar ? shape.rightChars : symbols / 2;
+        const qint64 traceback = qMin(LCS_TRACEBACK_BYTES, (columns + 1) * ((rows + 63) / 64) * 8);
+        return symbols * (4 + 8 + STRING_BYTES + HASH_NODE_BYTES) + traceback + result;
+    }
+    if (algorithmId == QLatin1String("dmp")) {
+        // Lines (or words) encoded as characters, and the two bisect vectors of 2 * max_d ints
+        if (mode == DiffMode::CharByChar)
+            symbols = lines;
+        return symbols * (STRING_BYTES + HASH_NODE_BYTES + 2) + chars * 2
+               + symbols * 2 * qint64(sizeof(int)) * 2
+               + result;
+    }
+    return chars * 16 + lines * (STRING_BYTES + HASH_NODE_BYTES) + result;
+}
+
+}//namespace QDiffX
@@ -0,0 +1,56 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+
+namespace QDiffX{
+
+// Size of a diff input, cheap enough to measure before every diff
+struct QDiffShape {
+    qint64 leftChars = 0;
+    qint64 rightChars = 0;
+    int leftLines = 0;
+    int rightLines = 0;
+    int estimatedEditLines = 0;     // Lines found on one side only, extrapolated from a sample
+};
+
+// Memory accounting of one diff.
+// estimate() predicts an engine's footprint from the input shape before it runs.
+// While a Scope is active on a thread, the engines charge their large allocations
+// to it, and to every scope it is nested in, as they make them; past any scope's
+// limit charge() returns false (require() throws std::bad_alloc) and the engine
+// abandons the diff, so the caller can degrade to a cheaper engine instead of
+// running out of memory. A limit of 0 only counts.
+class QDiffMemoryBudget
+{
+public:
+    class Scope
+    {
+    public:
+        explicit Scope(qint64 limitBytes);
+        ~Scope();
+
+        qint64 chargedBytes() const { return m_charged; }
+        int chargeCount() const { return m_chargeCount; }
+        bool exceeded() const { return m_exceeded; }
+
+    private:
+        friend class QDiffMemoryBudget;
+        Q_DISABLE_COPY(Scope)
+
+        qint64 m_limit;
+        qint64 m_charged = 0;
+        int m_chargeCount = 0;
+        bool m_exceeded = false;
+        Scope *m_outer;
+    };
+
+    // Always true on threads without an active scope
+    static bool charge(qint64 bytes);
+    static void require(qint64 bytes);
+
+    static QDiffShape measure(const QString &leftText, const QString &rightText);
+    static qint64 estimate(const QString &algorithmId, DiffMode mode, const QDiffShape &shape);
+
+    static constexpr int EDIT_SAMPLE_LINES = 512;
+};
+
+}//namespace QDiffX
@@ -0,0 +1,112 @@
+#include "QDiffOverviewRuler.h"
+#include "QDiffTextBrowser.h"
+#include "QDiffTrace.h"
+#include <QMouseEvent>
+#include <QPainter>
+
+namespace QDiffX{
+
+QDiffOverviewRuler::QDiffOverviewRuler(QWidget *parent)
+    : QWidget(parent)
+{
+    setFixedWidth(RULER_WIDTH);
+    setCursor(Qt::PointingHandCursor);
+}
+
+void QDiffOverviewRuler::setHistograms(const QDiffChangeHistogram &left, const QDiffChangeHistogram &right)
+{
+    m_left = left;
+    m_right = right;
+    update();
+}
+
+void QDiffOverviewRuler::setVisibleLines(int first, int end)
+{
+    if (first == m_firstVisibleLine && end == m_endVisibleLine)
+        return;
+    m_firstVisibleLine = first;
+    m_endVisibleLine = end;
+    update();
+}
+
+QSize QDiffOverviewRuler::sizeHint() const
+{
+    return QSize(RULER_WIDTH, 0);
+}
+
+void QDiffOverviewRuler::paintEvent(QPaintEvent *event)
+{
+    QDIFFX_TRACE_SCOPE("view", "overviewRulerPaint");
+    QPainter painter(this);
+    painter.fillRect(event->rect(), QColor(RULER_BG_COLOR));
+
+    const int lines = lineCount();
+    if (lines == 0)
+        return;
+
+    // One histogram lookup per pixel row
+    const int top = qMax(0, event->rect().top());
+    const int bottom = qMin(height() - 1, event->rect().bottom());
+    for (int y = top; y <= bottom; ++y) {
+        const int first = lineAt(y);
+        const int end = qMax(first + 1, lineAt(y + 1));
+        QDiffChangeHistogram::Counts counts = m_left.count(first, end);
+        counts += m_right.count(first, end);
+        if (counts.changed() == 0)
+            continue;
+
+        uint32_t color = QDiffTextBrowser::REPLACE_TEXT_COLOR;
+        if (counts.inserted > counts.deleted && counts.inserted > counts.replaced)
+            color = QDiffTextBrowser::INSERT_TEXT_COLOR;
+        else if (counts.deleted > counts.replaced)
+            color = QDiffTextBrowser::DELETE_TEXT_COLOR;
+        painter.fillRect(2, y, width() - 4, 1, QColor(color));
+    }
+
+    if (m_endVisibleLine > m_firstVisibleLine) {
+        const int frameTop = yAt(m_firstVisibleLine);
+        const int frameBottom = qMax(frameTop + 2, yAt(m_endVisibleLine));
+        painter.setPen(QColor(VISIBLE_FRAME_COLOR));
+        painter.drawRect(0, frameTop, width() - 1, frameBottom - frameTop - 1);
+    }
+}
+
+void QDiffOverviewRuler::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || lineCount() == 0) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+    emit lineActivated(qBound(0, lineAt(event->position().toPoint().y()), lineCount() - 1));
+}
+
+void QDiffOverviewRuler::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!(event->buttons() & Qt::LeftButton) || lineCount() == 0) {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+    emit lineActivated(qBound(0, lineAt(event->position().toPoint().y()), lineCount() - 1));
+}
+
+int QDiffOverviewRuler::lineCount() const
+{
+    return qMax(m_left.lineCount(), m_right.lineCount());
+}
+
+int QDiffOverviewRuler::lineAt(int y) const
+{
+    if (height() <= 0)
+        return 0;
+    return int(qint64(y) * lineCount() / height());
+}
+
+int QDiffOverviewRuler::yAt(int line) const
+{
+    const int lines = lineCount();
+    if (lines == 0)
+        return 0;
+    return int(qint64(line) * height() / lines);
+}
+
+}//namespace QDiffX
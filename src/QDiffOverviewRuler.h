@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QWidget>
+#include "QDiffChangeHistogram.h"
+
+namespace QDiffX{
+
+// Strip beside the editors showing where the changes of the whole document are.
+// Every pixel row is painted from the histograms, so painting does not depend on
+// the number of lines. Clicking or dragging asks for the line under the mouse.
+class QDiffOverviewRuler : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit QDiffOverviewRuler(QWidget* parent = nullptr);
+
+    // Both sides of a side-by-side diff are drawn together, they cover the same lines
+    void setHistograms(const QDiffChangeHistogram& left,
+                       const QDiffChangeHistogram& right = QDiffChangeHistogram());
+    // Lines [first, end) shown in the editor, framed on the ruler
+    void setVisibleLines(int first, int end);
+
+    QSize sizeHint() const override;
+
+    static constexpr int RULER_WIDTH = 14;
+    static constexpr uint32_t RULER_BG_COLOR = 0xF6F7F9;
+    static constexpr uint32_t VISIBLE_FRAME_COLOR = 0x8A94A6;
+
+signals:
+    void lineActivated(int line);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+
+private:
+    int lineCount() const;
+    int lineAt(int y) const;
+    int yAt(int line) const;
+
+    QDiffChangeHistogram m_left;
+    QDiffChangeHistogram m_right;
+    int m_firstVisibleLine = 0;
+    int m_endVisibleLine = 0;
+};
+
+}//namespace QDiffX
@@ -0,0 +1,176 @@
+#include "QDiffProfiler.h"
+#include <algorithm>
+
+namespace QDiffX{
+
+namespace {
+
+thread_local QDiffProfiler::Scope *t_scope = nullptr;
+thread_local bool t_suspended = false;
+
+int lineCount(const QString &text)
+{
+    if (text.isEmpty())
+        return 0;
+    return int(text.count('\n')) + (text.endsWith('\n') ? 0 : 1);
+}
+
+qint64 percentile(const std::vector<qint64> &sorted, int percent)
+{
+    const size_t index = (sorted.size() * size_t(percent) + 99) / 100;
+    return sorted[qMin(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+} // namespace
+
+// ----------------------- QDiffProfiler -------------------------
+
+QDiffProfiler::Scope::Scope()
+    : m_active(!t_suspended), m_memory(0), m_outer(t_scope)
+{
+    if (!m_active)
+        return;
+    m_timer.start();
+    t_scope = this;
+}
+
+QDiffProfiler::Scope::~Scope()
+{
+    if (m_active)
+        t_scope = m_outer;
+}
+
+void QDiffProfiler::Scope::annotate(QDiffResult &result, const QString &leftText, const QString &rightText, DiffMode mode) const
+{
+    if (!m_active)
+        return;
+    const bool lineSeparated = result.metaData("line_separated").toBool();
+    qint64 editDistance = 0;
+    for (const DiffChange &change : result.changes()) {
+        if (change.operation == DiffOperation::Equal)
+            continue;
+        if (mode == DiffMode::CharByChar)
+            editDistance += change.text.length();
+        else
+            editDistance += lineSeparated ? 1 : lineCount(change.text);
+    }
+
+    QMap<QString, QVariant> metadata = result.allMetaData();
+    metadata["phase_ns"] = m_phases;
+    metadata["total_ns"] = m_timer.nsecsElapsed();
+    metadata["left_lines"] = lineCount(leftText);
+    metadata["right_lines"] = lineCount(rightText);
+    metadata["edit_distance"] = editDistance;
+    metadata["allocation_count"] = m_memory.chargeCount();
+    metadata["peak_memory_estimate"] = m_memory.chargedBytes();
+    result.setMetaData(metadata);
+}
+
+QDiffProfiler::Suspend::Suspend()
+    : m_wasSuspended(t_suspended)
+{
+    t_suspended = true;
+}
+
+QDiffProfiler::Suspend::~Suspend()
+{
+    t_suspended = m_wasSuspended;
+}
+
+void QDiffProfiler::phase(const char *name)
+{
+    Scope *scope = t_scope;
+    if (!scope)
+        return;
+    const qint64 now = scope->m_timer.nsecsElapsed();
+    QVariant &total = scope->m_phases[QString::fromLatin1(name)];
+    total = total.toLongLong() + (now - scope->m_lastMark);
+    scope->m_lastMark = now;
+}
+
+void QDiffProfiler::addPhase(QDiffResult &result, const QString &name, qint64 nanoseconds)
+{
+    QMap<QString, QVariant> metadata = result.allMetaData();
+    QMap<QString, QVariant> phases = metadata.value("phase_ns").toMap();
+    phases[name] = phases.value(name).toLongLong() + nanoseconds;
+    metadata["phase_ns"] = phases;
+    metadata["total_ns"] = metadata.value("total_ns").toLongLong() + nanoseconds;
+    result.setMetaData(metadata);
+}
+
+// ----------------------- QDiffStatistics -------------------------
+
+void QDiffStatistics::record(const QString &algorithmId, const QString &phase, qint64 nanoseconds)
+{
+    QMutexLocker locker(&m_mutex);
+    Window &window = m_windows[algorithmId][phase];
+    if (int(window.samples.size()) < WINDOW) {
+        window.samples.push_back(nanoseconds);
+    } else {
+        window.samples[window.next] = nanoseconds;
+        window.next = (window.next + 1) % WINDOW;
+    }
+}
+
+void QDiffStatistics::record(const QString &algorithmId, const QDiffResult &result)
+{
+    const QMap<QString, QVariant> metadata = result.allMetaData();
+    if (!metadata.contains("total_ns"))
+        return;
+    record(algorithmId, QStringLiteral("total"), metadata.value("total_ns").toLongLong());
+    const QMap<QString, QVariant> phases = metadata.value("phase_ns").toMap();
+    for (auto it = phases.constBegin(); it != phases.constEnd(); ++it)
+        record(algorithmId, it.key(), it.value().toLongLong());
+}
+
+QDiffLatencySummary QDiffStatistics::summary(const QString &algorithmId, const QString &phase) const
+{
+    std::vector<qint64> samples;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto algorithm = m_windows.constFind(algorithmId);
+        if (algorithm == m_windows.constEnd())
+            return QDiffLatencySummary();
+        auto window = algorithm->constFind(phase);
+        if (window == algorithm->constEnd())
+            return QDiffLatencySummary();
+        samples = window->samples;
+    }
+
+    QDiffLatencySummary summary;
+    summary.count = int(samples.size());
+    if (samples.empty())
+        return summary;
+    std::sort(samples.begin(), samples.end());
+    summary.p50Ns = percentile(samples, 50);
+    summary.p95Ns = percentile(samples, 95);
+    summary.p99Ns = percentile(samples, 99);
+    return summary;
+}
+
+QStringList QDiffStatistics::algorithms() const
+{
+    QMutexLocker locker(&m_mutex);
+    QStringList ids = m_windows.keys();
+    ids.sort();
+    return ids;
+}
+
+QStringList QDiffStatistics::phases(const QString &algorithmId) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto algorithm = m_windows.constFind(algorithmId);
+    if (algorithm == m_windows.constEnd())
+        return QStringList();
+    QStringList names = algorithm->keys();
+    names.sort();
+    return names;
+}
+
+void QDiffStatistics::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_windows.clear();
+}
+
+}//namespace QDiffX
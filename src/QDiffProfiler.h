@@ -0,0 +1,101 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include "QDiffMemoryBudget.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <vector>
+
+namespace QDiffX{
+
+// Per-phase timing and memory figures of one diff.
+// An engine opens a Scope around its calculateDiff() and calls phase() as each
+// phase ends; the time since the previous mark, from the monotonic clock, is
+// added to that phase. The large allocations the engine charges to
+// QDiffMemoryBudget are counted by the same scope. annotate() writes it all
+// into the result's metadata:
+//   phase_ns              phase name -> nanoseconds ("tokenize", "engine", "convert", ...)
+//   total_ns              nanoseconds since the scope opened
+//   left_lines, right_lines
+//   edit_distance         inserted plus deleted lines (characters in char mode)
+//   allocation_count      allocations charged to the memory budget
+//   peak_memory_estimate  bytes charged to the memory budget
+// While a Suspend is alive on a thread its scopes measure nothing and annotate()
+// leaves results alone, for diffs so small that measuring them costs more than
+// running them.
+class QDiffProfiler
+{
+public:
+    class Scope
+    {
+    public:
+        Scope();
+        ~Scope();
+
+        void annotate(QDiffResult &result, const QString &leftText, const QString &rightText, DiffMode mode) const;
+
+    private:
+        friend class QDiffProfiler;
+        Q_DISABLE_COPY(Scope)
+
+        bool m_active;
+        QElapsedTimer m_timer;
+        qint64 m_lastMark = 0;
+        QMap<QString, QVariant> m_phases;
+        QDiffMemoryBudget::Scope m_memory;
+        Scope *m_outer;
+    };
+
+    class Suspend
+    {
+    public:
+        Suspend();
+        ~Suspend();
+
+    private:
+        Q_DISABLE_COPY(Suspend)
+
+        bool m_wasSuspended;
+    };
+
+    // Ends the current phase of the innermost scope on this thread, a no-op without one
+    static void phase(const char *name);
+    // Adds a phase timed outside the engine, such as side-by-side splitting, to a result
+    static void addPhase(QDiffResult &result, const QString &name, qint64 nanoseconds);
+};
+
+struct QDiffLatencySummary {
+    int count = 0;
+    qint64 p50Ns = 0;
+    qint64 p95Ns = 0;
+    qint64 p99Ns = 0;
+};
+
+// Rolling latency percentiles over the last WINDOW samples of every algorithm and
+// phase; "total" holds whole diffs. Thread safe.
+class QDiffStatistics
+{
+public:
+    void record(const QString &algorithmId, const QString &phase, qint64 nanoseconds);
+    // total_ns and every phase_ns entry of a profiled result
+    void record(const QString &algorithmId, const QDiffResult &result);
+
+    QDiffLatencySummary summary(const QString &algorithmId, const QString &phase = QStringLiteral("total")) const;
+    QStringList algorithms() const;
+    QStringList phases(const QString &algorithmId) const;
+    void clear();
+
+    static constexpr int WINDOW = 1024;
+
+private:
+    struct Window {
+        std::vector<qint64> samples;
+        int next = 0;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<QString, QHash<QString, Window>> m_windows;
+};
+
+}//namespace QDiffX
@@ -0,0 +1,155 @@
+#include "QDiffRaceEngine.h"
+#include "QAlgorithmRegistry.h"
+#include "QDiffCancellation.h"
+#include "QDiffTrace.h"
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+namespace QDiffX{
+
+namespace {
+
+// Shared with the pool contender, which may outlive race()
+struct RaceState {
+    QString algorithmIds[2];
+    DiffMode mode = DiffMode::Auto;
+    QString leftText;
+    QString rightText;
+    std::atomic_bool cancelled[2] = {false, false};
+
+    QMutex mutex;
+    QWaitCondition done;
+    QDiffResult results[2];
+    qint64 elapsedMs[2] = {-1, -1};
+    int finishedCount = 0;
+    int winner = -1;
+    QElapsedTimer timer;
+};
+
+int bitLength(qint64 value)
+{
+    int bits = 0;
+    while (value > 0) {
+        value >>= 1;
+        ++bits;
+    }
+    return bits;
+}
+
+void runContender(RaceState &state, int contender)
+{
+    QDIFFX_TRACE_SCOPE("race", "contender");
+    QDiffResult result;
+    if (!state.cancelled[contender].load()) {
+        QDiffCancellation::Scope scope(&state.cancelled[contender]);
+        QPooledAlgorithm algorithm = QAlgorithmRegistry::get_Instance().checkoutAlgorithm(state.algorithmIds[contender]);
+        result = algorithm ? algorithm->calculateDiff(state.leftText, state.rightText, state.mode)
+                           : QDiffResult(QStringLiteral("Failed to create algorithm %1").arg(state.algorithmIds[contender]));
+    } else {
+        result = QDiffResult(QStringLiteral("Cancelled before it started"));
+    }
+
+    QMutexLocker locker(&state.mutex);
+    state.results[contender] = result;
+    state.elapsedMs[contender] = state.timer.elapsed();
+    ++state.finishedCount;
+    if (state.winner < 0 && result.success() && !state.cancelled[contender].load()) {
+        state.winner = contender;
+        state.cancelled[1 - contender].store(true);
+    }
+    state.done.wakeAll();
+}
+
+} // namespace
+
+QDiffResult QDiffRaceEngine::race(const QString &firstAlgorithmId, const QString &secondAlgorithmId, DiffMode mode,
+                                  const QString &leftText, const QString &rightText, const QDiffShape &shape)
+{
+    auto state = std::make_shared<RaceState>();
+    state->algorithmIds[0] = firstAlgorithmId;
+    state->algorithmIds[1] = secondAlgorithmId;
+    state->mode = mode;
+    state->leftText = leftText;
+    state->rightText = rightText;
+    state->timer.start();
+
+    // The second contender waits for a free pool thread while the first runs here,
+    // so a saturated pool slows the race down but never stalls it
+    QThreadPool::globalInstance()->start([state]() { runContender(*state, 1); });
+    runContender(*state, 0);
+
+    QMutexLocker locker(&state->mutex);
+    while (state->winner < 0 && state->finishedCount < 2)
+        state->done.wait(&state->mutex);
+
+    if (state->winner < 0) {
+        // Both failed; report the engine that ran here
+        return state->results[0];
+    }
+    const int winner = state->winner;
+    const int loser = 1 - winner;
+    QDiffResult result = state->results[winner];
+    locker.unlock();
+
+    record(shape, state->algorithmIds[winner]);
+
+    QMap<QString, QVariant> metadata = result.allMetaData();
+    metadata["algorithm_id"] = state->algorithmIds[winner];
+    metadata["race_winner"] = state->algorithmIds[winner];
+    metadata["race_loser"] = state->algorithmIds[loser];
+    metadata["race_ms"] = state->elapsedMs[winner];
+    result.setMetaData(metadata);
+    return result;
+}
+
+QString QDiffRaceEngine::learnedWinner(const QDiffShape &shape) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto bucket = m_wins.constFind(shapeBucket(shape));
+    if (bucket == m_wins.constEnd())
+        return QString();
+
+    int races = 0;
+    int bestWins = 0;
+    QString best;
+    for (auto it = bucket->constBegin(); it != bucket->constEnd(); ++it) {
+        races += it.value();
+        if (it.value() > bestWins) {
+            bestWins = it.value();
+            best = it.key();
+        }
+    }
+    if (races < MIN_LEARNED_RACES || bestWins < races * LEARNED_WIN_SHARE)
+        return QString();
+    return best;
+}
+
+bool QDiffRaceEngine::hasRecords() const
+{
+    QMutexLocker locker(&m_mutex);
+    return !m_wins.isEmpty();
+}
+
+void QDiffRaceEngine::clearRecords()
+{
+    QMutexLocker locker(&m_mutex);
+    m_wins.clear();
+}
+
+quint32 QDiffRaceEngine::shapeBucket(const QDiffShape &shape)
+{
+    const int lines = bitLength(qint64(shape.leftLines) + shape.rightLines);
+    const int edits = bitLength(shape.estimatedEditLines);
+    return quint32(lines) << 8 | quint32(edits);
+}
+
+void QDiffRaceEngine::record(const QDiffShape &shape, const QString &winner)
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_wins[shapeBucket(shape)][winner];
+}
+
+}//namespace QDiffX
@@ -0,0 +1,40 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include "QDiffMemoryBudget.h"
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+
+namespace QDiffX{
+
+// Races two algorithms on the same input and keeps the first successful result.
+// One contender runs on the calling thread and the other on the global thread
+// pool; once one finishes the other is cancelled through QDiffCancellation.
+// Every race is recorded against a bucket of the input shape (line count and
+// estimated edit lines, both in powers of two), so later selections for
+// similar inputs can take the usual winner without racing.
+class QDiffRaceEngine
+{
+public:
+    QDiffResult race(const QString &firstAlgorithmId, const QString &secondAlgorithmId, DiffMode mode,
+                     const QString &leftText, const QString &rightText, const QDiffShape &shape);
+
+    // Algorithm that won at least LEARNED_WIN_SHARE of MIN_LEARNED_RACES or more
+    // races for shapes like this one, or an empty string
+    QString learnedWinner(const QDiffShape &shape) const;
+    // Counts a win for shapes like this one; race() records every race it runs
+    void record(const QDiffShape &shape, const QString &winner);
+    bool hasRecords() const;
+    void clearRecords();
+
+    static quint32 shapeBucket(const QDiffShape &shape);
+
+    static constexpr int MIN_LEARNED_RACES = 3;
+    static constexpr double LEARNED_WIN_SHARE = 0.75;
+
+private:
+    mutable QMutex m_mutex;
+    QHash<quint32, QHash<QString, int>> m_wins;
+};
+
+}//namespace QDiffX
@@ -0,0 +1,196 @@
+#include "QDiffTaskPool.h"
+#include "QDiffTrace.h"
+#include <QDeadlineTimer>
+#include <QThread>
+
+namespace QDiffX{
+
+QDiffTaskPool::QDiffTaskPool()
+    : m_maxThreads(qMax(1, QThread::idealThreadCount()))
+{
+    // Prefetches and background work leave threads to the interactive class by default
+    m_caps[int(QDiffPriority::Interactive)] = 0;
+    m_caps[int(QDiffPriority::Prefetch)] = qMax(1, m_maxThreads * 3 / 4);
+    m_caps[int(QDiffPriority::Background)] = qMax(1, m_maxThreads / 2);
+    m_threads.setObjectName(QStringLiteral("QDiffTaskPool"));
+    m_threads.setMaxThreadCount(m_maxThreads);
+    QElapsedTimer timer;
+    timer.start();
+    m_clock = [timer]() { return timer.nsecsElapsed(); };
+}
+
+QDiffTaskPool::~QDiffTaskPool()
+{
+    std::deque<Task> dropped[PRIORITY_COUNT];
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int priority = 0; priority < PRIORITY_COUNT; ++priority)
+            dropped[priority].swap(m_queues[priority]);
+    }
+    // Destroyed outside the lock: their promises cancel the futures on the way out
+    for (std::deque<Task> &queue : dropped)
+        queue.clear();
+    m_threads.waitForDone();
+}
+
+int QDiffTaskPool::maxThreadCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxThreads;
+}
+
+void QDiffTaskPool::setMaxThreadCount(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxThreads = qMax(1, count);
+    m_threads.setMaxThreadCount(m_maxThreads);
+    dispatch();
+}
+
+int QDiffTaskPool::concurrencyCap(QDiffPriority priority) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_caps[int(priority)];
+}
+
+void QDiffTaskPool::setConcurrencyCap(QDiffPriority priority, int cap)
+{
+    QMutexLocker locker(&m_mutex);
+    m_caps[int(priority)] = qMax(0, cap);
+    dispatch();
+}
+
+int QDiffTaskPool::agingInterval() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_agingMs;
+}
+
+void QDiffTaskPool::setAgingInterval(int milliseconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_agingMs = qMax(0, milliseconds);
+}
+
+void QDiffTaskPool::setClock(Clock clock)
+{
+    QMutexLocker locker(&m_mutex);
+    m_clock = std::move(clock);
+}
+
+QDiffPoolMetrics QDiffTaskPool::metrics(QDiffPriority priority) const
+{
+    QDiffPoolMetrics metrics;
+    {
+        QMutexLocker locker(&m_mutex);
+        metrics.queueDepth = int(m_queues[int(priority)].size());
+        metrics.running = m_running[int(priority)];
+        metrics.started = m_started[int(priority)];
+        metrics.promoted = m_promoted[int(priority)];
+    }
+    metrics.wait = m_waits.summary(priorityName(priority), QStringLiteral("wait"));
+    return metrics;
+}
+
+bool QDiffTaskPool::waitForDone(int msecs)
+{
+    const QDeadlineTimer deadline = msecs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(msecs);
+    QMutexLocker locker(&m_mutex);
+    auto busy = [this]() {
+        if (m_totalRunning > 0)
+            return true;
+        for (const std::deque<Task> &queue : m_queues) {
+            if (!queue.empty())
+                return true;
+        }
+        return false;
+    };
+    while (busy()) {
+        if (!m_idle.wait(&m_mutex, deadline))
+            return !busy();
+    }
+    return true;
+}
+
+QString QDiffTaskPool::priorityName(QDiffPriority priority)
+{
+    switch (priority) {
+    case QDiffPriority::Interactive:
+        return QStringLiteral("interactive");
+    case QDiffPriority::Prefetch:
+        return QStringLiteral("prefetch");
+    case QDiffPriority::Background:
+        return QStringLiteral("background");
+    }
+    return QString();
+}
+
+void QDiffTaskPool::enqueue(QDiffPriority priority, std::function<void()> work)
+{
+    Task task;
+    task.work = std::move(work);
+    QMutexLocker locker(&m_mutex);
+    task.queuedAt = m_clock();
+    m_queues[int(priority)].push_back(std::move(task));
+    dispatch();
+}
+
+void QDiffTaskPool::dispatch()
+{
+    const qint64 now = m_clock();
+    while (m_totalRunning < m_maxThreads) {
+        // Front of every class under its cap, ranked by class less the intervals it has waited
+        int best = -1;
+        qint64 bestRank = 0;
+        qint64 bestWaited = 0;
+        for (int priority = 0; priority < PRIORITY_COUNT; ++priority) {
+            if (m_queues[priority].empty())
+                continue;
+            if (m_caps[priority] > 0 && m_running[priority] >= m_caps[priority])
+                continue;
+            const qint64 waited = (now - m_queues[priority].front().queuedAt) / 1000000;
+            const qint64 rank = m_agingMs > 0 ? qMax<qint64>(0, priority - waited / m_agingMs) : priority;
+            if (best < 0 || rank < bestRank || (rank == bestRank && waited > bestWaited)) {
+                best = priority;
+                bestRank = rank;
+                bestWaited = waited;
+            }
+        }
+        if (best < 0)
+            return;
+
+        Task task = std::move(m_queues[best].front());
+        m_queues[best].pop_front();
+        ++m_running[best];
+        ++m_totalRunning;
+        ++m_started[best];
+        // Promoted when a class above had work waiting that this task overtook
+        for (int above = 0; above < best; ++above) {
+            if (!m_queues[above].empty() && (m_caps[above] == 0 || m_running[above] < m_caps[above])) {
+                ++m_promoted[best];
+                break;
+            }
+        }
+        m_waits.record(priorityName(QDiffPriority(best)), QStringLiteral("wait"), now - task.queuedAt);
+
+        std::function<void()> work = std::move(task.work);
+        m_threads.start([this, work, best]() {
+            {
+                QDIFFX_TRACE_SCOPE("pool", "task");
+                work();
+            }
+            finished(best);
+        });
+    }
+}
+
+void QDiffTaskPool::finished(int priority)
+{
+    QMutexLocker locker(&m_mutex);
+    --m_running[priority];
+    --m_totalRunning;
+    dispatch();
+    m_idle.wakeAll();
+}
+
+}//namespace QDiffX
@@ -0,0 +1,106 @@
+#pragma once
+#include "QDiffProfiler.h"
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QMutex>
+#include <QPromise>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace QDiffX{
+
+enum class QDiffPriority {
+    Interactive,    // A diff somebody is looking at
+    Prefetch,       // A diff somebody is likely to look at next
+    Background      // Everything else, such as indexing or bulk comparisons
+};
+
+// Figures of one priority class
+struct QDiffPoolMetrics {
+    int queueDepth = 0;         // Tasks waiting now
+    int running = 0;
+    qint64 started = 0;
+    qint64 promoted = 0;        // Started ahead of a higher class through aging
+    QDiffLatencySummary wait;   // Queue wait of the latest QDiffStatistics::WINDOW tasks
+};
+
+// Thread pool of a QAlgorithmManager, apart from QThreadPool::globalInstance().
+// Tasks wait in one queue per priority class and are started highest class
+// first, at most concurrencyCap() of a class at a time. A task that has waited
+// agingInterval() counts as one class higher for every such interval, so
+// background work cannot starve behind a steady stream of interactive diffs;
+// aging reorders the queues but never lifts a class's cap. Tasks still queued
+// when the pool is destroyed are dropped, their futures canceled.
+class QDiffTaskPool
+{
+public:
+    QDiffTaskPool();
+    ~QDiffTaskPool();
+
+    template<typename Function>
+    auto run(QDiffPriority priority, Function function) -> QFuture<decltype(function())>
+    {
+        using Result = decltype(function());
+        auto promise = std::make_shared<QPromise<Result>>();
+        promise->start();
+        QFuture<Result> future = promise->future();
+        enqueue(priority, [promise, function]() mutable {
+            promise->addResult(function());
+            promise->finish();
+        });
+        return future;
+    }
+
+    int maxThreadCount() const;
+    void setMaxThreadCount(int count);
+    // Tasks of the class running at once, 0 for no cap below maxThreadCount()
+    int concurrencyCap(QDiffPriority priority) const;
+    void setConcurrencyCap(QDiffPriority priority, int cap);
+    // Milliseconds of waiting that raise a task by one class, 0 turns aging off
+    int agingInterval() const;
+    void setAgingInterval(int milliseconds);
+    // Monotonic nanoseconds that queue waits and aging are measured on; a
+    // steady timer started with the pool unless replaced, e.g. by a manual clock in tests
+    using Clock = std::function<qint64()>;
+    void setClock(Clock clock);
+
+    QDiffPoolMetrics metrics(QDiffPriority priority) const;
+    // Until no task is queued or running; false on timeout
+    bool waitForDone(int msecs = -1);
+
+    static QString priorityName(QDiffPriority priority);
+
+    static constexpr int PRIORITY_COUNT = 3;
+    static constexpr int DEFAULT_AGING_INTERVAL_MS = 2000;
+
+private:
+    struct Task {
+        std::function<void()> work;
+        qint64 queuedAt = 0;    // m_clock nanoseconds
+    };
+
+    void enqueue(QDiffPriority priority, std::function<void()> work);
+    // m_mutex held
+    void dispatch();
+    void finished(int priority);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_idle;
+    std::deque<Task> m_queues[PRIORITY_COUNT];
+    int m_caps[PRIORITY_COUNT];
+    int m_running[PRIORITY_COUNT] = {};
+    qint64 m_started[PRIORITY_COUNT] = {};
+    qint64 m_promoted[PRIORITY_COUNT] = {};
+    int m_totalRunning = 0;
+    int m_maxThreads;
+    int m_agingMs = DEFAULT_AGING_INTERVAL_MS;
+    Clock m_clock;
+    QDiffStatistics m_waits;
+    // Only ever given as many tasks as it has threads, the queues above decide the order
+    QThreadPool m_threads;
+};
+
+}//namespace QDiffX
@@ -6,10 +6,225 @@
 #include <QScrollArea>
 #include <QAbstractTextDocumentLayout>
 #include<QScrollBar>
+#include <QElapsedTimer>
+#include <QTextLayout>
+#include <QThread>
+#include <algorithm>
+#include "QDiffTrace.h"
 
 
 namespace QDiffX{
 
+namespace {
+
+// Undo history is useless for a read-only view and costs a copy of every edit.
+// Every block gets the spacing as it is inserted, rather than through a second
+// setBlockFormat() pass that lays the whole document out again.
+std::shared_ptr<QTextDocument> createDocument(const QString &text, bool spaced)
+{
+    auto document = std::make_shared<QTextDocument>();
+    document->setUndoRedoEnabled(false);
+    QTextCursor cursor(document.get());
+    if (spaced) {
+        QTextBlockFormat blockFormat;
+        blockFormat.setTopMargin(QDiffTextBrowser::TEXT_TOP_BOTTOM_MARGIN);
+        blockFormat.setBottomMargin(QDiffTextBrowser::TEXT_TOP_BOTTOM_MARGIN);
+        cursor.setBlockFormat(blockFormat);
+    }
+    cursor.insertText(text);
+    return document;
+}
+
+// Keys of lineOperations are 1-based block numbers; those outside the document never show
+QList<DiffOperation> denseOperations(const QMap<int, DiffOperation> &lineOperations, int blockCount)
+{
+    QList<DiffOperation> operations(blockCount, DiffOperation::Equal);
+    for (auto it = lineOperations.constBegin(); it != lineOperations.constEnd(); ++it) {
+        if (it.key() >= 1 && it.key() <= blockCount)
+            operations[it.key() - 1] = it.value();
+    }
+    return operations;
+}
+
+// Document text of a diff result and the operations of its 1-based lines
+void assembleDiff(const QDiffResult &result, QString &content, QMap<int, DiffOperation> &lineOperations)
+{
+    QMap<int, QString> lineContent;
+    int maxLineNumber = -1;
+
+    int offset = 0;
+    for (auto &change : result.changes()) {
+        if(!change.text.endsWith("\n"))
+            change.text += '\n';
+
+        if (change.lineNumber >= 0) {
+            lineContent[change.lineNumber] = change.text;
+            for(int i = 0 ; i < change.text.count("\n") ; i++){
+            lineOperations[change.lineNumber + i + offset] = change.operation;
+            }
+            maxLineNumber = qMax(maxLineNumber, change.lineNumber + offset);
+        }
+        offset += change.text.count("\n") - 1;
+    }
+
+    // Build the document content
+    QStringList lines;
+
+    // Create enough lines to accommodate the highest line number
+    for (int i = 1; i <= maxLineNumber; ++i) {
+        if (lineContent.contains(i)) {
+            lines.append(lineContent[i]);
+        } else {
+            lines.append(QString()); // Empty line
+            lineOperations[i + offset] = DiffOperation::Equal;
+        }
+    }
+
+    for (const auto &change : result.changes()) {
+        if (change.lineNumber < 0) {
+            lines.append(change.text);
+            lineOperations[lines.size() - 1] = change.operation;
+        }
+    }
+
+    content = lines.join(' ');
+}
+
+void assembleMerge(const QMergeResult &result, QString &content, QMap<int, DiffOperation> &lineOperations)
+{
+    // One document line per merged line; conflicts show both sides between markers
+    int lineNumber = 0;
+    auto appendLine = [&](QStringView line, DiffOperation operation) {
+        content.append(line);
+        if (!content.endsWith('\n'))
+            content.append('\n');
+        lineOperations[++lineNumber] = operation;
+    };
+    auto appendLines = [&](QMergeSide side, int start, int count, DiffOperation operation) {
+        for (int i = start; i < start + count; ++i)
+            appendLine(result.line(side, i), operation);
+    };
+
+    for (const QMergeRegion &region : result.regions()) {
+        switch (region.type) {
+        case QMergeRegionType::Unchanged:
+            appendLines(QMergeSide::Base, region.baseStart, region.baseCount, DiffOperation::Equal);
+            break;
+        case QMergeRegionType::Theirs:
+            appendLines(QMergeSide::Theirs, region.theirsStart, region.theirsCount, DiffOperation::Insert);
+            break;
+        case QMergeRegionType::Ours:
+        case QMergeRegionType::Both:
+            appendLines(QMergeSide::Ours, region.oursStart, region.oursCount, DiffOperation::Insert);
+            break;
+        case QMergeRegionType::Conflict:
+            appendLine(QString::fromLatin1(QMergeResult::CONFLICT_START_MARKER), DiffOperation::Replace);
+            appendLines(QMergeSide::Ours, region.oursStart, region.oursCount, DiffOperation::Replace);
+            appendLine(QString::fromLatin1(QMergeResult::CONFLICT_SEPARATOR_MARKER), DiffOperation::Replace);
+            appendLines(QMergeSide::Theirs, region.theirsStart, region.theirsCount, DiffOperation::Replace);
+            appendLine(QString::fromLatin1(QMergeResult::CONFLICT_END_MARKER), DiffOperation::Replace);
+            break;
+        }
+    }
+    if (content.endsWith('\n'))
+        content.chop(1);
+}
+
+int countLines(const QString &content)
+{
+    return int(content.count('\n')) + 1;
+}
+
+// Runs of lines unchanged in every given side, less the context kept next to changes.
+// Folds end by lineCount, the line count of the shortest side, so that the same
+// plan fits every side it is applied to.
+QList<QDiffFold> planFolds(const QList<DiffOperation> &left, const QList<DiffOperation> &right, int lineCount, int context)
+{
+    QList<QDiffFold> folds;
+    auto unchanged = [&](int line) {
+        return (line >= left.size() || left[line] == DiffOperation::Equal)
+               && (line >= right.size() || right[line] == DiffOperation::Equal);
+    };
+
+    int line = 0;
+    while (line < lineCount) {
+        if (!unchanged(line)) {
+            ++line;
+            continue;
+        }
+        int end = line;
+        while (end < lineCount && unchanged(end))
+            ++end;
+        // No context is needed at the edges of the document
+        const int first = line == 0 ? 0 : line + context;
+        const int last = end == lineCount ? end : end - context;
+        if (last - first >= QDiffTextBrowser::MIN_FOLD_LINES) {
+            QDiffFold fold;
+            fold.firstLine = first;
+            fold.lineCount = last - first;
+            folds.append(fold);
+        }
+        line = end;
+    }
+    return folds;
+}
+
+// Only the shown lines go into the document; folded ones stay in the source text
+// until they are expanded, so the document grows with the changes, not the file
+void finishDocument(QDiffDocument &built, const QString &content, QList<DiffOperation> operations,
+                    const QList<QDiffFold> &folds, QDiffTextBrowser::HighlightingMode mode, QThread *target)
+{
+    built.histogram = QDiffChangeHistogram(operations);
+    if (folds.isEmpty()) {
+        built.document = createDocument(content, true);
+        built.blockOperations = std::move(operations);
+    } else {
+        QList<qsizetype> starts;
+        starts.reserve(operations.size() + 1);
+        starts.append(0);
+        for (qsizetype i = content.indexOf('\n'); i >= 0; i = content.indexOf('\n', i + 1))
+            starts.append(i + 1);
+        // As if the last line ended in a newline as well
+        starts.append(content.size() + 1);
+        const int lineCount = int(starts.size()) - 1;
+
+        QString shown;
+        auto appendLines = [&](int first, int end) {
+            for (int line = first; line < end; ++line) {
+                built.blockOperations.append(line < operations.size() ? operations[line] : DiffOperation::Equal);
+                built.blockLines.append(line);
+            }
+            if (first < end)
+                shown.append(QStringView(content).mid(starts[first], starts[end] - starts[first]));
+        };
+
+        int line = 0;
+        for (int fold = 0; fold < folds.size(); ++fold) {
+            appendLines(line, folds[fold].firstLine);
+            line = folds[fold].firstLine + folds[fold].lineCount;
+            shown.append(QChar(0x22EF) + QLatin1Char(' ')
+                         + QDiffTextBrowser::tr("%n unchanged line(s)", nullptr, folds[fold].lineCount));
+            if (line < lineCount)
+                shown.append('\n');
+            built.blockOperations.append(DiffOperation::Equal);
+            built.blockLines.append(-1 - fold);
+        }
+        appendLines(line, lineCount);
+
+        built.document = createDocument(shown, true);
+        built.folds = folds;
+        built.sourceText = content;
+        built.lineStarts = std::move(starts);
+    }
+
+    if (mode == QDiffTextBrowser::HighlightingMode::Eager)
+        QDiffTextBrowser::applyDiffHighlighting(built.document.get(), built.blockOperations);
+    built.highlighted = mode == QDiffTextBrowser::HighlightingMode::Eager;
+    built.document->moveToThread(target);
+}
+
+} // namespace
+
 QDiffTextBrowser::QDiffTextBrowser(QWidget* parent) {
     m_lineNumberArea = new QLineNumberArea(this);
 
@@ -20,13 +235,15 @@ QDiffTextBrowser::QDiffTextBrowser(QWidget* parent) {
             m_lineNumberArea, QOverload<>::of(&QWidget::update));
     connect(this->horizontalScrollBar(), &QScrollBar::valueChanged,
             m_lineNumberArea, QOverload<>::of(&QWidget::update));
-    connect(this->document(), &QTextDocument::blockCountChanged,
-            this, [this]() { m_lineNumberArea->update(); });
+    connectDocument(document());
 
 }
 
 QDiffTextBrowser::~QDiffTextBrowser()
 {
+    // Lets go of m_document before it is released with the members
+    if (m_document)
+        setDocument(nullptr);
     if(m_lineNumberArea)
         delete m_lineNumberArea;
 }
@@ -44,74 +261,259 @@ int QDiffTextBrowser::lineNumberAreaWidth() const
     return padding + charWidth * lineDigitCount;
 }
 
-void QDiffTextBrowser::setDiffResult(const QDiffResult &result)
+QDiffTextBrowser::HighlightingMode QDiffTextBrowser::highlightingMode() const
 {
-    m_diffResult = result;
-    m_lineOperations.clear();
+    return m_highlightingMode;
+}
 
-    if (!result.success()) {
-        setPlainText(tr("Error: %1").arg(result.errorMessage()));
+void QDiffTextBrowser::setHighlightingMode(HighlightingMode mode)
+{
+    m_highlightingMode = mode;
+}
+
+int QDiffTextBrowser::foldContextLines() const
+{
+    return m_foldContext;
+}
+
+void QDiffTextBrowser::setFoldContextLines(int lines)
+{
+    m_foldContext = qMax(NO_FOLDING, lines);
+}
+
+void QDiffTextBrowser::expandFold(int fold)
+{
+    if (fold < 0 || fold >= m_folds.size() || m_folds[fold].expanded)
+        return;
+    QDIFFX_TRACE_SCOPE("view", "expandFold");
+    QDiffFold &expanding = m_folds[fold];
+    // planFolds() keeps every fold within the lines of both sides
+    Q_ASSERT(expanding.firstLine + expanding.lineCount < m_lineStarts.size());
+    if (expanding.firstLine + expanding.lineCount >= m_lineStarts.size())
         return;
+
+    const int blockNumber = expanding.firstLine - m_hiddenBefore[fold];
+
+    const qsizetype from = m_lineStarts[expanding.firstLine];
+    const qsizetype to = m_lineStarts[expanding.firstLine + expanding.lineCount] - 1;
+    QTextCursor cursor(document()->findBlockByNumber(blockNumber));
+    cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+    cursor.insertText(m_sourceText.mid(from, to - from));
+
+    // Folded lines are unchanged, so they need no highlighting
+    m_blockOperations.insert(blockNumber + 1, expanding.lineCount - 1, DiffOperation::Equal);
+    m_blockLines.insert(blockNumber + 1, expanding.lineCount - 1, 0);
+    for (int i = 0; i < expanding.lineCount; ++i)
+        m_blockLines[blockNumber + i] = expanding.firstLine + i;
+    expanding.expanded = true;
+    updateHiddenLines();
+
+    m_lineNumberArea->update();
+    emit foldExpanded(fold);
+}
+
+void QDiffTextBrowser::expandAllFolds()
+{
+    for (int fold = 0; fold < m_folds.size(); ++fold)
+        expandFold(fold);
+}
+
+const QDiffChangeHistogram &QDiffTextBrowser::changeHistogram() const
+{
+    return m_histogram;
+}
+
+const QDiffHunkIndex &QDiffTextBrowser::hunkIndex() const
+{
+    return m_hunks;
+}
+
+void QDiffTextBrowser::scrollToLine(int line)
+{
+    const int blockNumber = blockForLine(line);
+    ensureBlockIndex();
+    if (blockNumber < 0 || blockNumber >= int(m_blockBottoms.size()))
+        return;
+    const qreal top = blockNumber > 0 ? m_blockBottoms[blockNumber - 1] : 0;
+    verticalScrollBar()->setValue(int(top) - viewport()->height() / 2);
+}
+
+std::pair<int, int> QDiffTextBrowser::visibleLineRange()
+{
+    ensureBlockIndex();
+    const qreal scrollTop = verticalScrollBar()->value();
+    auto first = std::lower_bound(m_blockBottoms.cbegin(), m_blockBottoms.cend(), scrollTop);
+    auto last = std::lower_bound(first, m_blockBottoms.cend(), scrollTop + viewport()->height());
+    if (first == m_blockBottoms.cend())
+        return {0, 0};
+    if (last == m_blockBottoms.cend())
+        --last;
+
+    // Placeholders stand for all the lines they fold
+    const int firstBlock = int(first - m_blockBottoms.cbegin());
+    const int lastBlock = int(last - m_blockBottoms.cbegin());
+    const int firstFold = foldAt(firstBlock);
+    const int lastFold = foldAt(lastBlock);
+    const int firstLine = firstFold >= 0 ? m_folds[firstFold].firstLine : lineAt(firstBlock);
+    const int endLine = lastFold >= 0 ? m_folds[lastFold].firstLine + m_folds[lastFold].lineCount
+                                      : lineAt(lastBlock) + 1;
+    return {firstLine, endLine};
+}
+
+void QDiffTextBrowser::setDiffResult(const QDiffResult &result)
+{
+    setDiffDocument(buildDiffDocument(result, thread(), m_highlightingMode, m_foldContext));
+}
+
+void QDiffTextBrowser::setMergeResult(const QMergeResult &result)
+{
+    setDiffDocument(buildMergeDocument(result, thread(), m_highlightingMode, m_foldContext));
+}
+
+void QDiffTextBrowser::setDiffDocument(const QDiffDocument &document)
+{
+    QDIFFX_TRACE_SCOPE("view", "setDiffDocument");
+    Q_ASSERT(document.document && document.document->thread() == thread());
+    m_diffResult = document.result;
+    m_blockOperations = document.blockOperations;
+    m_folds = document.folds;
+    m_blockLines = document.blockLines;
+    m_sourceText = document.sourceText;
+    m_lineStarts = document.lineStarts;
+    m_histogram = document.histogram;
+    m_hunks = document.hunks;
+    updateHiddenLines();
+    m_lazyHighlighting = !document.highlighted;
+
+    // The previous document is detached by setDocument() before it is released
+    std::shared_ptr<QTextDocument> previous = std::move(m_document);
+    m_document = document.document;
+    m_document->setDefaultFont(font());
+    setDocument(m_document.get());
+    if (previous) {
+        previous->documentLayout()->disconnect(this);
+        previous->disconnect(this);
     }
+    connectDocument(m_document.get());
+    m_blockIndexValid = false;
+    updateTextMargin();
 
-    QMap<int, QString> lineContent;
-    int maxLineNumber = -1;
+    m_lineNumberArea->update();
+    update();
+}
 
-    int offset = 0;
-    for (auto &change : result.changes()) {
-        if(!change.text.endsWith("\n"))
-            change.text += '\n';
+QDiffDocument QDiffTextBrowser::buildDiffDocument(const QDiffResult &result, QThread *target, HighlightingMode mode, int foldContext)
+{
+    QDIFFX_TRACE_SCOPE("view", "buildDiffDocument");
+    QElapsedTimer timer;
+    timer.start();
+    QDiffDocument built;
+    built.result = result;
 
-        if (change.lineNumber >= 0) {
-            lineContent[change.lineNumber] = change.text;
-            for(int i = 0 ; i < change.text.count("\n") ; i++){
-            m_lineOperations[change.lineNumber + i + offset] = change.operation;
-            }
-            maxLineNumber = qMax(maxLineNumber, change.lineNumber + offset);
-        }
-        offset += change.text.count("\n") - 1;
+    if (!result.success()) {
+        built.document = createDocument(tr("Error: %1").arg(result.errorMessage()), false);
+        built.document->moveToThread(target);
+        built.buildNanoseconds = timer.nsecsElapsed();
+        return built;
     }
 
-    // Build the document content
     QString content;
-    QStringList lines;
+    QMap<int, DiffOperation> lineOperations;
+    assembleDiff(result, content, lineOperations);
+    QList<DiffOperation> operations = denseOperations(lineOperations, countLines(content));
+    const QList<QDiffFold> folds = foldContext >= 0 ? planFolds(operations, {}, int(operations.size()), foldContext)
+                                                    : QList<QDiffFold>();
+    built.hunks = QDiffHunkIndex::fromLineOperations(operations);
+    finishDocument(built, content, std::move(operations), folds, mode, target);
+
+    built.buildNanoseconds = timer.nsecsElapsed();
+    return built;
+}
 
-    // Create enough lines to accommodate the highest line number
-    for (int i = 1; i <= maxLineNumber; ++i) {
-        if (lineContent.contains(i)) {
-            lines.append(lineContent[i]);
-        } else {
-            lines.append(QString()); // Empty line
-            m_lineOperations[i + offset] = DiffOperation::Equal;
-        }
-    }
+std::pair<QDiffDocument, QDiffDocument> QDiffTextBrowser::buildSideBySideDocuments(const QSideBySideDiffResult &result, QThread *target,
+                                                                                 HighlightingMode mode, int foldContext)
+{
+    if (!result.success())
+        return {buildDiffDocument(result.leftSide, target, mode), buildDiffDocument(result.rightSide, target, mode)};
+
+    QDIFFX_TRACE_SCOPE("view", "buildSideBySideDocuments");
+    QElapsedTimer timer;
+    timer.start();
+    QDiffDocument left;
+    QDiffDocument right;
+    left.result = result.leftSide;
+    right.result = result.rightSide;
+
+    QString leftContent;
+    QString rightContent;
+    QMap<int, DiffOperation> leftLineOperations;
+    QMap<int, DiffOperation> rightLineOperations;
+    assembleDiff(result.leftSide, leftContent, leftLineOperations);
+    assembleDiff(result.rightSide, rightContent, rightLineOperations);
+    QList<DiffOperation> leftOperations = denseOperations(leftLineOperations, countLines(leftContent));
+    QList<DiffOperation> rightOperations = denseOperations(rightLineOperations, countLines(rightContent));
+
+    // A line folds only when it is unchanged on both sides, and both sides have it
+    const int sharedLines = int(qMin(leftOperations.size(), rightOperations.size()));
+    const QList<QDiffFold> folds = foldContext >= 0 ? planFolds(leftOperations, rightOperations, sharedLines, foldContext)
+                                                    : QList<QDiffFold>();
+    left.hunks = right.hunks = QDiffHunkIndex::fromLineOperations(leftOperations, rightOperations);
+    finishDocument(left, leftContent, std::move(leftOperations), folds, mode, target);
+    finishDocument(right, rightContent, std::move(rightOperations), folds, mode, target);
+
+    // Built together, so the left side carries the time of both
+    left.buildNanoseconds = timer.nsecsElapsed();
+    return {left, right};
+}
 
-    for (const auto &change : result.changes()) {
-        if (change.lineNumber < 0) {
-            lines.append(change.text);
-            m_lineOperations[lines.size() - 1] = change.operation;
-        }
+QDiffDocument QDiffTextBrowser::buildMergeDocument(const QMergeResult &result, QThread *target, HighlightingMode mode, int foldContext)
+{
+    QDIFFX_TRACE_SCOPE("view", "buildMergeDocument");
+    QElapsedTimer timer;
+    timer.start();
+    QDiffDocument built;
+
+    if (!result.success()) {
+        built.document = createDocument(tr("Error: %1").arg(result.errorMessage()), false);
+        built.document->moveToThread(target);
+        built.buildNanoseconds = timer.nsecsElapsed();
+        return built;
     }
 
-    content = lines.join(' ');
-    setPlainText(content);
+    QString content;
+    QMap<int, DiffOperation> lineOperations;
+    assembleMerge(result, content, lineOperations);
+    QList<DiffOperation> operations = denseOperations(lineOperations, countLines(content));
+    const QList<QDiffFold> folds = foldContext >= 0 ? planFolds(operations, {}, int(operations.size()), foldContext)
+                                                    : QList<QDiffFold>();
+    built.hunks = QDiffHunkIndex::fromLineOperations(operations);
+    finishDocument(built, content, std::move(operations), folds, mode, target);
+
+    built.buildNanoseconds = timer.nsecsElapsed();
+    return built;
+}
 
-    applyBlockSpacing();
-    applyDiffHighlighting();
+void QDiffTextBrowser::applyDiffHighlighting()
+{
+    applyDiffHighlighting(document(), m_blockOperations);
+}
 
-    update();
+void QDiffTextBrowser::applyBlockSpacing()
+{
+    applyBlockSpacing(document());
 }
 
-void QDiffTextBrowser::applyDiffHighlighting() {
-    QTextCursor cursor(document());
+void QDiffTextBrowser::applyDiffHighlighting(QTextDocument *document, const QList<DiffOperation> &blockOperations) {
+    QDIFFX_TRACE_SCOPE("view", "applyDiffHighlighting");
+    QTextCursor cursor(document);
     cursor.beginEditBlock();
 
-    QTextBlock block = document()->firstBlock();
-    int blockNumber = 1;
+    QTextBlock block = document->firstBlock();
+    int blockNumber = 0;
 
-    while (block.isValid()) {
-        if (m_lineOperations.contains(blockNumber)) {
-            QTextCharFormat format = getFormatForOperation(m_lineOperations[blockNumber]);
+    while (block.isValid() && blockNumber < blockOperations.size()) {
+        if (blockOperations[blockNumber] != DiffOperation::Equal) {
+            QTextCharFormat format = getFormatForOperation(blockOperations[blockNumber]);
 
             cursor.setPosition(block.position());
             cursor.setPosition(block.position() + block.length() - 1, QTextCursor::KeepAnchor);
@@ -125,12 +527,12 @@ void QDiffTextBrowser::applyDiffHighlighting() {
     cursor.endEditBlock();
 }
 
-void QDiffTextBrowser::applyBlockSpacing()
+void QDiffTextBrowser::applyBlockSpacing(QTextDocument *document)
 {
-    QTextCursor cursor(document());
+    QTextCursor cursor(document);
     cursor.beginEditBlock();
 
-    QTextBlock block = document()->firstBlock();
+    QTextBlock block = document->firstBlock();
     while (block.isValid()) {
         QTextBlockFormat blockFormat;
         blockFormat.setTopMargin(TEXT_TOP_BOTTOM_MARGIN);
@@ -159,18 +561,18 @@ QColor QDiffTextBrowser::getBackgroundColorForOperation(DiffOperation operation)
     }
 }
 
-QTextCharFormat QDiffTextBrowser::getFormatForOperation(DiffOperation operation) const {
+QTextCharFormat QDiffTextBrowser::getFormatForOperation(DiffOperation operation) {
     QTextCharFormat format;
 
     switch (operation) {
     case DiffOperation::Insert:
-        format.setForeground(QColor(0x155724)); // Dark green text
+        format.setForeground(QColor(INSERT_TEXT_COLOR)); // Dark green text
         break;
     case DiffOperation::Delete:
-        format.setForeground(QColor(0x721C24)); // Dark red text
+        format.setForeground(QColor(DELETE_TEXT_COLOR)); // Dark red text
         break;
     case DiffOperation::Replace:
-        format.setForeground(QColor(0x856404)); // Dark yellow text
+        format.setForeground(QColor(REPLACE_TEXT_COLOR)); // Dark yellow text
         break;
     case DiffOperation::Equal:
     default:
@@ -186,10 +588,7 @@ void QDiffTextBrowser::resizeEvent(QResizeEvent *event)
     QRect cr = contentsRect();
     m_lineNumberArea->setGeometry(QRect(cr.left(), cr.top() + 1, lineNumberAreaWidth(), cr.height()-2));
 
-    QTextFrame *rootFrame = document()->rootFrame();
-    QTextFrameFormat format = rootFrame->frameFormat();
-    format.setLeftMargin(m_lineNumberArea->width() + TEXT_LEFT_MARGIN);
-    rootFrame->setFrameFormat(format);
+    updateTextMargin();
     adjustFontSize();
 
      m_lineNumberArea->update();
@@ -203,6 +602,8 @@ void QDiffTextBrowser::scrollContentsBy(int dx, int dy)
 
 void QDiffTextBrowser::paintEvent(QPaintEvent *event)
 {
+    QDIFFX_TRACE_SCOPE("view", "paintEvent");
+    highlightVisibleBlocks(event->rect());
 
     QPainter painter(viewport());
 
@@ -228,11 +629,11 @@ void QDiffTextBrowser::paintEvent(QPaintEvent *event)
 
         // Only paint if the block is visible
         if (visualRect.intersects(event->rect()) && visualRect.bottom() >= 0) {
-            if (m_lineOperations.contains(blockNumber )) {
-                QColor backgroundColor = getBackgroundColorForOperation(m_lineOperations[blockNumber]);
-                if (backgroundColor.isValid()) {
-                    painter.fillRect(visualRect, backgroundColor);
-                }
+            QColor backgroundColor = foldAt(blockNumber - 1) >= 0
+                                         ? QColor(FOLD_BG_COLOR)
+                                         : getBackgroundColorForOperation(operationAt(blockNumber - 1));
+            if (backgroundColor.isValid()) {
+                painter.fillRect(visualRect, backgroundColor);
             }
         }
 
@@ -249,6 +650,16 @@ void QDiffTextBrowser::paintEvent(QPaintEvent *event)
     QTextBrowser::paintEvent(event);
 }
 
+void QDiffTextBrowser::mousePressEvent(QMouseEvent *event)
+{
+    const int fold = foldAt(cursorForPosition(event->position().toPoint()).blockNumber());
+    if (event->button() == Qt::LeftButton && fold >= 0) {
+        expandFold(fold);
+        return;
+    }
+    QTextBrowser::mousePressEvent(event);
+}
+
 void QDiffTextBrowser::paintLineNumberArea(QPaintEvent *event)
 {
     QPainter painter(m_lineNumberArea);
@@ -275,8 +686,9 @@ void QDiffTextBrowser::paintLineNumberArea(QPaintEvent *event)
             break;
         }
 
-        if (block.isVisible() && (visualPos.y() + blockRect.height()) >= event->rect().top()) {
-            QString number = QString::number(blockNumber + 1);
+        const int line = lineAt(blockNumber);
+        if (block.isVisible() && line >= 0 && (visualPos.y() + blockRect.height()) >= event->rect().top()) {
+            QString number = QString::number(line + 1);
 
             QRectF drawRect(
                 0,
@@ -306,25 +718,128 @@ void QDiffTextBrowser::adjustFontSize()
     setFont(font);
 }
 
-QTextBlock QDiffTextBrowser::firstVisibleBlock()
+void QDiffTextBrowser::updateTextMargin()
 {
-    QTextBlock block = document()->firstBlock() ;
-    QPointF scrollOffset(
-        this->horizontalScrollBar()->value(),
-        this->verticalScrollBar()->value()
-        );
+    // Keeps the text clear of the line number area
+    QTextFrame *rootFrame = document()->rootFrame();
+    QTextFrameFormat format = rootFrame->frameFormat();
+    format.setLeftMargin(m_lineNumberArea->width() + TEXT_LEFT_MARGIN);
+    rootFrame->setFrameFormat(format);
+}
 
-    while(block.isValid()){
-        QRectF blockRect = this->document()->documentLayout()->blockBoundingRect(block);
-        QPointF visualPos = blockRect.topLeft() - scrollOffset;
+void QDiffTextBrowser::highlightVisibleBlocks(const QRect &rect)
+{
+    if (!m_lazyHighlighting)
+        return;
+    QDIFFX_TRACE_SCOPE("view", "highlightVisibleBlocks");
 
-        if (visualPos.y() + blockRect.height() >= 0) {
+    // Layout formats leave the document's own formats and undo stack alone;
+    // only the block itself is laid out again
+    const qreal bottom = verticalScrollBar()->value() + rect.bottom();
+    for (QTextBlock block = firstVisibleBlock(); block.isValid(); block = block.next()) {
+        if (document()->documentLayout()->blockBoundingRect(block).top() > bottom)
             break;
-        }
+        if (block.userState() == HIGHLIGHTED_BLOCK_STATE)
+            continue;
+        block.setUserState(HIGHLIGHTED_BLOCK_STATE);
+
+        QTextLayout::FormatRange range;
+        range.start = 0;
+        range.length = block.length() - 1;
+        range.format = getFormatForOperation(operationAt(block.blockNumber()));
+        if (range.format.properties().isEmpty())
+            continue;
+        block.layout()->setFormats({range});
+        document()->markContentsDirty(block.position(), block.length());
+    }
+}
 
-        block = block.next();
+void QDiffTextBrowser::connectDocument(QTextDocument *document)
+{
+    connect(document, &QTextDocument::blockCountChanged, this, [this]() {
+        m_blockIndexValid = false;
+        m_lineNumberArea->update();
+    });
+    // Any block changing height changes the size of the document
+    connect(document->documentLayout(), &QAbstractTextDocumentLayout::documentSizeChanged,
+            this, [this]() { m_blockIndexValid = false; });
+}
+
+DiffOperation QDiffTextBrowser::operationAt(int blockNumber) const
+{
+    if (blockNumber < 0 || blockNumber >= m_blockOperations.size())
+        return DiffOperation::Equal;
+    return m_blockOperations[blockNumber];
+}
+
+int QDiffTextBrowser::lineAt(int blockNumber) const
+{
+    if (m_blockLines.isEmpty())
+        return blockNumber;
+    if (blockNumber < 0 || blockNumber >= m_blockLines.size())
+        return -1;
+    return m_blockLines[blockNumber];
+}
+
+int QDiffTextBrowser::foldAt(int blockNumber) const
+{
+    if (blockNumber < 0 || blockNumber >= m_blockLines.size())
+        return -1;
+    const int line = m_blockLines[blockNumber];
+    return line < 0 ? -1 - line : -1;
+}
+
+int QDiffTextBrowser::blockForLine(int line) const
+{
+    if (m_blockLines.isEmpty())
+        return line;
+    // Last fold starting at or before the line
+    auto after = std::upper_bound(m_folds.cbegin(), m_folds.cend(), line,
+                                  [](int value, const QDiffFold &fold) { return value < fold.firstLine; });
+    const int fold = int(after - m_folds.cbegin()) - 1;
+    if (fold < 0)
+        return line;
+    const QDiffFold &before = m_folds[fold];
+    if (!before.expanded && line < before.firstLine + before.lineCount)
+        return before.firstLine - m_hiddenBefore[fold];
+    return line - m_hiddenBefore[fold + 1];
+}
+
+void QDiffTextBrowser::updateHiddenLines()
+{
+    m_hiddenBefore.resize(m_folds.size() + 1);
+    int hidden = 0;
+    for (int fold = 0; fold < m_folds.size(); ++fold) {
+        m_hiddenBefore[fold] = hidden;
+        if (!m_folds[fold].expanded)
+            hidden += m_folds[fold].lineCount - 1;
     }
-    return block;
+    m_hiddenBefore[m_folds.size()] = hidden;
+}
+
+QTextBlock QDiffTextBrowser::firstVisibleBlock()
+{
+    ensureBlockIndex();
+    // First block whose bottom is not above the viewport
+    const qreal scrollTop = verticalScrollBar()->value();
+    auto visible = std::lower_bound(m_blockBottoms.cbegin(), m_blockBottoms.cend(), scrollTop);
+    if (visible == m_blockBottoms.cend())
+        return QTextBlock();
+    return document()->findBlockByNumber(int(visible - m_blockBottoms.cbegin()));
+}
+
+void QDiffTextBrowser::ensureBlockIndex()
+{
+    if (m_blockIndexValid)
+        return;
+    QDIFFX_TRACE_SCOPE("view", "buildBlockIndex");
+
+    QAbstractTextDocumentLayout *layout = document()->documentLayout();
+    m_blockBottoms.clear();
+    m_blockBottoms.reserve(document()->blockCount());
+    for (QTextBlock block = document()->firstBlock(); block.isValid(); block = block.next())
+        m_blockBottoms.push_back(layout->blockBoundingRect(block).bottom());
+    m_blockIndexValid = true;
 }
 
 qreal QDiffTextBrowser::blockTop(const QTextBlock &block)
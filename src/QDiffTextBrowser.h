@@ -1,31 +1,104 @@
 #pragma once
 
 #include <QObject>
+#include <QTextDocument>
 #include <QtWidgets/QTextBrowser>
+#include <memory>
+#include <utility>
+#include <vector>
 #include "QLineNumberArea.h"
 #include "QDiffAlgorithm.h"
+#include "QDiffChangeHistogram.h"
+#include "QDiffHunkIndex.h"
+#include "QMergeEngine.h"
 
 namespace QDiffX{
 
 class QLineNumberArea;
 
+// Unchanged lines shown as a single placeholder block until expanded
+struct QDiffFold {
+    int firstLine = 0;      // Line of the unfolded document
+    int lineCount = 0;
+    bool expanded = false;
+};
+
+// A result laid out as a highlighted document, ready to be shown by a QDiffTextBrowser.
+// Built by QDiffTextBrowser::buildDiffDocument(), which may run on any thread.
+struct QDiffDocument {
+    std::shared_ptr<QTextDocument> document;
+    QList<DiffOperation> blockOperations;       // By block number, Equal past the end
+    QDiffResult result;
+    bool highlighted = false;   // False when the browser colors blocks as they are shown
+    qint64 buildNanoseconds = 0;
+    QDiffChangeHistogram histogram;     // Over the unfolded lines
+    QDiffHunkIndex hunks;               // Changed runs of the unfolded lines, both sides alike
+
+    // Only set when something is folded
+    QList<QDiffFold> folds;
+    QList<int> blockLines;          // Unfolded line of every block, -1 - fold for placeholders
+    QString sourceText;             // Unfolded text the folded lines are taken from
+    QList<qsizetype> lineStarts;    // Of every unfolded line, plus one past the end
+};
+
 class QDiffTextBrowser : public QTextBrowser
 {
     Q_OBJECT
 public:
+    enum class HighlightingMode {
+        Eager,      // Every block is colored while the document is built
+        Viewport    // Blocks are colored when they are first painted
+    };
+
     explicit QDiffTextBrowser(QWidget* parent = nullptr);
     ~QDiffTextBrowser();
 
+    HighlightingMode highlightingMode() const;
+    // Applies to documents built from now on
+    void setHighlightingMode(HighlightingMode mode);
+    // Unchanged lines kept around every change, NO_FOLDING shows every line.
+    // Applies to documents built from now on.
+    int foldContextLines() const;
+    void setFoldContextLines(int lines);
+    void expandFold(int fold);
+    void expandAllFolds();
+
+    // Lines are those of the unfolded document
+    const QDiffChangeHistogram& changeHistogram() const;
+    const QDiffHunkIndex& hunkIndex() const;
+    // Centers the line, or the placeholder folding it
+    void scrollToLine(int line);
+    // Lines [first, end) at least partly in the viewport
+    std::pair<int, int> visibleLineRange();
+
     int lineNumberAreaWidth() const;
     void setDiffResult(const QDiffResult& result);
+    void setMergeResult(const QMergeResult& result);
+    // Swaps in a document built elsewhere; it must already live in this browser's thread
+    void setDiffDocument(const QDiffDocument& document);
+
+    // Line assembly, spacing and highlighting of a result, without touching any widget.
+    // The document is moved to target before it is returned.
+    static QDiffDocument buildDiffDocument(const QDiffResult& result, QThread* target,
+                                           HighlightingMode mode = HighlightingMode::Viewport,
+                                           int foldContext = NO_FOLDING);
+    // Both sides fold the same lines, so their rows stay aligned
+    static std::pair<QDiffDocument, QDiffDocument> buildSideBySideDocuments(const QSideBySideDiffResult& result, QThread* target,
+                                                                            HighlightingMode mode = HighlightingMode::Viewport,
+                                                                            int foldContext = NO_FOLDING);
+    static QDiffDocument buildMergeDocument(const QMergeResult& result, QThread* target,
+                                            HighlightingMode mode = HighlightingMode::Viewport,
+                                            int foldContext = NO_FOLDING);
 
     void paintLineNumberArea(QPaintEvent* event);
     void applyDiffHighlighting();
     void applyBlockSpacing();
+    static void applyDiffHighlighting(QTextDocument* document, const QList<DiffOperation>& blockOperations);
+    static void applyBlockSpacing(QTextDocument* document);
 
 
 
-    QTextCharFormat getFormatForOperation(DiffOperation operation) const;
+    static QTextCharFormat getFormatForOperation(DiffOperation operation);
     QColor getBackgroundColorForOperation(DiffOperation operation) const;
 
     // Line Number Area
@@ -39,6 +112,12 @@ public:
     static constexpr int FONT_SCALE_DIVISOR = 400;
     static constexpr int TEXT_LEFT_MARGIN = 25;
     static constexpr int TEXT_TOP_BOTTOM_MARGIN = 8;
+    // QTextBlock::userState() of blocks colored in Viewport mode
+    static constexpr int HIGHLIGHTED_BLOCK_STATE = 1;
+
+    //Folding
+    static constexpr int NO_FOLDING = -1;
+    static constexpr int MIN_FOLD_LINES = 2;    // A placeholder for one line saves nothing
 
     //Colors
     static constexpr uint32_t LINE_NUMBER_BG_COLOR = 0xFFFEFC;
@@ -50,23 +129,56 @@ public:
     static constexpr uint32_t INSERT_TEXT_COLOR = 0x155724;
     static constexpr uint32_t DELETE_TEXT_COLOR = 0x721C24;
     static constexpr uint32_t REPLACE_TEXT_COLOR = 0x856404;
+    static constexpr uint32_t FOLD_BG_COLOR = 0xF1F3F5;
+
+signals:
+    void foldExpanded(int fold);
 
 
 protected:
     void resizeEvent(QResizeEvent* event) override;
     void scrollContentsBy(int dx, int dy) override;
     void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
 
 private:
     void adjustFontSize();
+    void updateTextMargin();
+    // Colors the blocks of rect not colored yet, in Viewport mode
+    void highlightVisibleBlocks(const QRect& rect);
     //Helpers
+    void connectDocument(QTextDocument* document);
+    DiffOperation operationAt(int blockNumber) const;
+    // Unfolded line of a block, negative for fold placeholders
+    int lineAt(int blockNumber) const;
+    int foldAt(int blockNumber) const;
+    int blockForLine(int line) const;
+    void updateHiddenLines();
+    // Binary search over the block index
     QTextBlock firstVisibleBlock();
+    void ensureBlockIndex();
     qreal blockTop(const QTextBlock& block);
     qreal blockBottom(const QTextBlock& block);
 private:
     QLineNumberArea* m_lineNumberArea;
     QDiffResult m_diffResult;
-    QMap<int,DiffOperation> m_lineOperations;
+    QList<DiffOperation> m_blockOperations;
+    // Layout bottom of every block, rebuilt when the layout changes size
+    std::vector<qreal> m_blockBottoms;
+    bool m_blockIndexValid = false;
+    // Shown document when it came from setDiffDocument()
+    std::shared_ptr<QTextDocument> m_document;
+    HighlightingMode m_highlightingMode = HighlightingMode::Viewport;
+    bool m_lazyHighlighting = false;
+    int m_foldContext = NO_FOLDING;
+    QList<QDiffFold> m_folds;
+    // Lines hidden by the collapsed folds before each fold, plus a total
+    QList<int> m_hiddenBefore;
+    QList<int> m_blockLines;
+    QString m_sourceText;
+    QList<qsizetype> m_lineStarts;
+    QDiffChangeHistogram m_histogram;
+    QDiffHunkIndex m_hunks;
 };
 
 }// namespace QDiffX
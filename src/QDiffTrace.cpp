@@ -0,0 +1,209 @@
+#include "QDiffTrace.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <memory>
+#include <vector>
+
+namespace QDiffX{
+
+namespace {
+
+struct Event {
+    const char *category;
+    const char *name;
+    qint64 begin;
+    qint64 end;
+};
+
+constexpr int CHUNK_EVENTS = 4096;
+constexpr int MAX_CHUNKS = QDiffTrace::MAX_EVENTS_PER_THREAD / CHUNK_EVENTS;
+
+// Written by its thread only; count is published with release so the reader
+// sees complete events
+struct Chunk {
+    Event events[CHUNK_EVENTS];
+    std::atomic<int> count{0};
+    std::atomic<Chunk *> next{nullptr};
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    QString threadName;
+    std::atomic<quint64> session{0};
+    Chunk *head = new Chunk;
+    Chunk *tail = head;
+    int chunkIndex = 0;
+
+    ~ThreadBuffer()
+    {
+        for (Chunk *chunk = head; chunk;) {
+            Chunk *next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+};
+
+struct Registry {
+    Registry() { clock.start(); }
+
+    QElapsedTimer clock;
+    std::atomic<quint64> session{0};
+    QMutex mutex;
+    // Kept after their threads exit, so their events still get written
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+thread_local std::shared_ptr<ThreadBuffer> t_buffer;
+
+ThreadBuffer &threadBuffer()
+{
+    if (!t_buffer) {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        QThread *thread = QThread::currentThread();
+        buffer->threadName = thread ? thread->objectName() : QString();
+        if (buffer->threadName.isEmpty() && QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+            buffer->threadName = QStringLiteral("Main");
+        Registry &reg = registry();
+        QMutexLocker locker(&reg.mutex);
+        buffer->tid = int(reg.buffers.size()) + 1;
+        if (buffer->threadName.isEmpty())
+            buffer->threadName = QStringLiteral("Thread %1").arg(buffer->tid);
+        reg.buffers.push_back(buffer);
+        t_buffer = std::move(buffer);
+    }
+    return *t_buffer;
+}
+
+void appendEscaped(QByteArray &out, const char *text)
+{
+    out += '"';
+    for (const char *c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            out += '\\';
+        if (uchar(*c) >= 0x20)
+            out += *c;
+    }
+    out += '"';
+}
+
+void appendMicroseconds(QByteArray &out, qint64 nanoseconds)
+{
+    out += QByteArray::number(double(nanoseconds) / 1000.0, 'f', 3);
+}
+
+} // namespace
+
+void QDiffTrace::start()
+{
+    registry().session.fetch_add(1, std::memory_order_acq_rel);
+    s_active.store(true, std::memory_order_release);
+}
+
+void QDiffTrace::stop()
+{
+    s_active.store(false, std::memory_order_release);
+}
+
+qint64 QDiffTrace::now()
+{
+    return registry().clock.nsecsElapsed();
+}
+
+void QDiffTrace::record(const char *category, const char *name, qint64 beginNs, qint64 endNs)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    const quint64 session = registry().session.load(std::memory_order_acquire);
+    if (buffer.session.load(std::memory_order_relaxed) != session) {
+        // First event of a new capture on this thread
+        for (Chunk *chunk = buffer.head; chunk; chunk = chunk->next.load(std::memory_order_relaxed))
+            chunk->count.store(0, std::memory_order_relaxed);
+        buffer.tail = buffer.head;
+        buffer.chunkIndex = 0;
+        buffer.session.store(session, std::memory_order_release);
+    }
+
+    Chunk *chunk = buffer.tail;
+    int count = chunk->count.load(std::memory_order_relaxed);
+    if (count == CHUNK_EVENTS) {
+        if (buffer.chunkIndex + 1 >= MAX_CHUNKS)
+            return;
+        Chunk *next = chunk->next.load(std::memory_order_relaxed);
+        if (!next) {
+            next = new Chunk;
+            chunk->next.store(next, std::memory_order_release);
+        }
+        buffer.tail = chunk = next;
+        ++buffer.chunkIndex;
+        count = 0;
+    }
+    chunk->events[count] = {category, name, beginNs, endNs};
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+bool QDiffTrace::writeChromeTrace(QIODevice *device)
+{
+    Registry &reg = registry();
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        QMutexLocker locker(&reg.mutex);
+        buffers = reg.buffers;
+    }
+    const quint64 session = reg.session.load(std::memory_order_acquire);
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+    QByteArray out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &buffer : buffers) {
+        if (buffer->session.load(std::memory_order_acquire) != session)
+            continue;
+        const QByteArray tid = QByteArray::number(buffer->tid);
+        out += first ? "" : ",";
+        first = false;
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"args\":{\"name\":";
+        appendEscaped(out, buffer->threadName.toUtf8().constData());
+        out += "}}";
+
+        for (Chunk *chunk = buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            const int count = chunk->count.load(std::memory_order_acquire);
+            for (int i = 0; i < count; ++i) {
+                const Event &event = chunk->events[i];
+                out += ",{\"name\":";
+                appendEscaped(out, event.name);
+                out += ",\"cat\":";
+                appendEscaped(out, event.category);
+                out += ",\"ph\":\"X\",\"ts\":";
+                appendMicroseconds(out, event.begin);
+                out += ",\"dur\":";
+                appendMicroseconds(out, event.end - event.begin);
+                out += ",\"pid\":" + pid + ",\"tid\":" + tid + "}";
+            }
+            if (out.size() > (1 << 20)) {
+                if (device->write(out) != out.size())
+                    return false;
+                out.clear();
+            }
+        }
+    }
+    out += "]}\n";
+    return device->write(out) == out.size();
+}
+
+bool QDiffTrace::saveChromeTrace(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return writeChromeTrace(&file);
+}
+
+}//namespace QDiffX
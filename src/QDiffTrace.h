@@ -0,0 +1,68 @@
+#pragma once
+#include <QString>
+#include <atomic>
+
+class QIODevice;
+
+namespace QDiffX{
+
+// Opt-in timeline of the diff pipeline, written as Chrome trace JSON for
+// chrome://tracing or Perfetto.
+// Hot paths are wrapped in QDIFFX_TRACE_SCOPE, which compiles to nothing unless
+// the library is configured with -DQDIFFX_TRACING=ON. Even then nothing is
+// recorded outside start()/stop(). Every thread appends its events to a buffer
+// of its own without locking; the buffers are only read by writeChromeTrace(),
+// which must be called after stop() and before the next start().
+class QDiffTrace
+{
+public:
+    // Begins a new capture, dropping the previous one
+    static void start();
+    static void stop();
+    static bool isActive() { return s_active.load(std::memory_order_relaxed); }
+
+    static bool writeChromeTrace(QIODevice *device);
+    static bool saveChromeTrace(const QString &fileName);
+
+    // Nanoseconds on the trace clock
+    static qint64 now();
+    // category and name must outlive the capture; string literals do
+    static void record(const char *category, const char *name, qint64 beginNs, qint64 endNs);
+
+    // Records the time between its construction and destruction
+    class Scope
+    {
+    public:
+        Scope(const char *category, const char *name)
+            : m_category(category), m_name(name), m_begin(isActive() ? now() : -1) {}
+        ~Scope()
+        {
+            if (m_begin >= 0 && isActive())
+                record(m_category, m_name, m_begin, now());
+        }
+
+    private:
+        Q_DISABLE_COPY(Scope)
+
+        const char *m_category;
+        const char *m_name;
+        qint64 m_begin;
+    };
+
+    // Events kept per thread and capture; later ones are dropped
+    static constexpr int MAX_EVENTS_PER_THREAD = 1 << 20;
+
+private:
+    static inline std::atomic_bool s_active{false};
+};
+
+}//namespace QDiffX
+
+#ifdef QDIFFX_TRACING
+#define QDIFFX_TRACE_CONCAT_(a, b) a##b
+#define QDIFFX_TRACE_CONCAT(a, b) QDIFFX_TRACE_CONCAT_(a, b)
+#define QDIFFX_TRACE_SCOPE(category, name) \
+    QDiffX::QDiffTrace::Scope QDIFFX_TRACE_CONCAT(qdiffxTraceScope, __LINE__)(category, name)
+#else
+#define QDIFFX_TRACE_SCOPE(category, name) do {} while (false)
+#endif
@@ -12,6 +12,8 @@
 #include <QAction>
 #include <QApplication>
 #include <QScrollBar>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 
 namespace QDiffX {
 
@@ -138,9 +140,17 @@ void QDiffWidget::setupUI()
     m_splitter->addWidget(leftPanel);
     m_splitter->addWidget(rightPanel);
 
-    mainLayout->addWidget(m_splitter);
+    // Overview ruler to the right of both panels
+    QHBoxLayout *diffLayout = new QHBoxLayout();
+    diffLayout->setContentsMargins(0,0,0,0);
+    diffLayout->setSpacing(2);
+    diffLayout->addWidget(m_splitter, 1);
+    m_overviewRuler = new QDiffOverviewRuler();
+    diffLayout->addWidget(m_overviewRuler);
+
+    mainLayout->addLayout(diffLayout);
     // Ensure splitter (diff area) expands with window while toolbar/bottom remain stable
-    int splitterIndex = mainLayout->indexOf(m_splitter);
+    int splitterIndex = mainLayout->indexOf(diffLayout);
     if (splitterIndex >= 0) mainLayout->setStretch(splitterIndex, 1);
 
     // Bottom status bar
@@ -165,6 +175,20 @@ void QDiffWidget::setupUI()
 
 void QDiffWidget::updateDiff()
 {
+    ++m_requestedGeneration;
+    // Measured from the first change, so a steady stream of them still gets diffed
+    if (!m_updateTimer->isActive())
+        m_updateTimer->start();
+}
+
+void QDiffWidget::startUpdate()
+{
+    if (m_updateInFlight) {
+        // Runs once more when the in-flight diff is done
+        m_updatePending = true;
+        return;
+    }
+
     if (!m_algorithmManager) {
         // If no algorithm manager is set, just display plain text
         m_leftTextBrowser->setPlainText(m_leftContent);
@@ -185,14 +209,38 @@ void QDiffWidget::updateDiff()
         algorithmId = m_algorithmManager->currentAlgorithm();
     }
 
+    const quint64 generation = m_requestedGeneration;
+    m_updateInFlight = true;
+    // The documents are built by the continuation, on the worker that produced the diff,
+    // so the GUI thread only swaps them in
+    QThread *target = thread();
+    const QDiffTextBrowser::HighlightingMode mode = m_leftTextBrowser->highlightingMode();
+    const int foldContext = m_leftTextBrowser->foldContextLines();
     if (m_displayMode == DisplayMode::SideBySide) {
         // Calculate side-by-side diff asynchronously, passing selection mode and algorithm id
-        m_algorithmManager->calculateSideBySideDiffAsync(m_leftContent, m_rightContent, selMode, algorithmId);
-        // Result will be handled by onSideBySideDiffCalculated slot
+        auto *watcher = new QFutureWatcher<SideBySideDocuments>(this);
+        connect(watcher, &QFutureWatcher<SideBySideDocuments>::finished, this, [this, watcher, generation]() {
+            watcher->deleteLater();
+            if (finishUpdate(generation) && !watcher->isCanceled())
+                onSideBySideDiffCalculated(watcher->result());
+        });
+        watcher->setFuture(m_algorithmManager->calculateSideBySideDiffAsync(m_leftContent, m_rightContent, selMode, algorithmId)
+                               .then([target, mode, foldContext](const QSideBySideDiffResult &result) {
+                                   auto documents = QDiffTextBrowser::buildSideBySideDocuments(result, target, mode, foldContext);
+                                   return SideBySideDocuments{documents.first, documents.second};
+                               }));
     } else {
         // Calculate unified diff for inline mode asynchronously
-        m_algorithmManager->calculateDiffAsync(m_leftContent, m_rightContent, selMode, algorithmId);
-        // Result will be handled by onDiffCalculated slot
+        auto *watcher = new QFutureWatcher<QDiffDocument>(this);
+        connect(watcher, &QFutureWatcher<QDiffDocument>::finished, this, [this, watcher, generation]() {
+            watcher->deleteLater();
+            if (finishUpdate(generation) && !watcher->isCanceled())
+                onDiffCalculated(watcher->result());
+        });
+        watcher->setFuture(m_algorithmManager->calculateDiffAsync(m_leftContent, m_rightContent, selMode, algorithmId)
+                               .then([target, mode, foldContext](const QDiffResult &result) {
+                                   return QDiffTextBrowser::buildDiffDocument(result, target, mode, foldContext);
+                               }));
         // Hide right panel in inline mode so left editor takes full width
         if (m_rightPanel) m_rightPanel->hide();
         if (m_leftPanel && m_splitter) {
@@ -202,10 +250,86 @@ void QDiffWidget::updateDiff()
     }
 }
 
+bool QDiffWidget::finishUpdate(quint64 generation)
+{
+    m_updateInFlight = false;
+    if (m_updatePending) {
+        m_updatePending = false;
+        startUpdate();
+    }
+    return generation == m_requestedGeneration;
+}
+
+int QDiffWidget::updateDelay() const
+{
+    return m_updateTimer->interval();
+}
+
+void QDiffWidget::setUpdateDelay(int milliseconds)
+{
+    m_updateTimer->setInterval(qMax(0, milliseconds));
+}
+
+QDiffTextBrowser::HighlightingMode QDiffWidget::highlightingMode() const
+{
+    return m_leftTextBrowser->highlightingMode();
+}
+
+void QDiffWidget::setHighlightingMode(QDiffTextBrowser::HighlightingMode mode)
+{
+    m_leftTextBrowser->setHighlightingMode(mode);
+    m_rightTextBrowser->setHighlightingMode(mode);
+    updateDiff();
+}
+
+int QDiffWidget::foldContextLines() const
+{
+    return m_leftTextBrowser->foldContextLines();
+}
+
+void QDiffWidget::setFoldContextLines(int lines)
+{
+    m_leftTextBrowser->setFoldContextLines(lines);
+    m_rightTextBrowser->setFoldContextLines(lines);
+    updateDiff();
+}
+
 void QDiffWidget::setupConnections()
 {
     // Connect content changes to diff updates
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(DEFAULT_UPDATE_DELAY_MS);
+    connect(m_updateTimer, &QTimer::timeout, this, &QDiffWidget::startUpdate);
     connect(this, &QDiffWidget::contentChanged, this, &QDiffWidget::updateDiff);
+
+    connect(m_overviewRuler, &QDiffOverviewRuler::lineActivated, this, &QDiffWidget::scrollToLine);
+    connect(m_leftTextBrowser->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &QDiffWidget::updateOverviewRuler);
+    connect(m_leftTextBrowser->verticalScrollBar(), &QScrollBar::rangeChanged,
+            this, &QDiffWidget::updateOverviewRuler);
+    // After a manual scroll, changes are looked for from the top of the view again
+    connect(m_leftTextBrowser->verticalScrollBar(), &QScrollBar::valueChanged, this, [this]() {
+        if (!m_jumpingToChange)
+            m_currentHunk = -1;
+    });
+
+    QAction *nextChangeAction = new QAction(tr("Next Change"), this);
+    nextChangeAction->setShortcut(QKeySequence(Qt::Key_F7));
+    nextChangeAction->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(nextChangeAction, &QAction::triggered, this, &QDiffWidget::nextChange);
+    addAction(nextChangeAction);
+    QAction *previousChangeAction = new QAction(tr("Previous Change"), this);
+    previousChangeAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::Key_F7));
+    previousChangeAction->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(previousChangeAction, &QAction::triggered, this, &QDiffWidget::previousChange);
+    addAction(previousChangeAction);
+
+    // Both sides fold the same lines, so expanding one side expands the other
+    connect(m_leftTextBrowser, &QDiffTextBrowser::foldExpanded,
+            m_rightTextBrowser, &QDiffTextBrowser::expandFold);
+    connect(m_rightTextBrowser, &QDiffTextBrowser::foldExpanded,
+            m_leftTextBrowser, &QDiffTextBrowser::expandFold);
 }
 
 // ---------------Content Setting----------------------
@@ -233,6 +357,25 @@ void QDiffWidget::setContent(const QString &leftContent, const QString &rightCon
 
     emit contentChanged();
 }
+void QDiffWidget::setMergeContent(const QString &baseContent, const QString &oursContent, const QString &theirsContent)
+{
+    m_leftContent = oursContent;
+    m_rightContent = theirsContent;
+
+    if (!m_algorithmManager) {
+        m_leftTextBrowser->setPlainText(m_leftContent);
+        m_rightTextBrowser->setPlainText(m_rightContent);
+        return;
+    }
+
+    // Diffs already scheduled or running would paint over the merge
+    ++m_requestedGeneration;
+    m_updateTimer->stop();
+    m_updatePending = false;
+    m_mergePending = true;
+    m_algorithmManager->calculateMergeAsync(baseContent, oursContent, theirsContent);
+    // Result will be handled by onMergeCalculated slot
+}
 // -----------Labels ------------
 
 void QDiffWidget::setLeftLabel(const QString &leftlabel)
@@ -319,6 +462,38 @@ bool QDiffWidget::setContentFromFiles(const QString &leftPath, const QString &ri
     return true;
 }
 
+bool QDiffWidget::setContentFromDirectoryEntry(const QDirectoryCompareModel *model, int row)
+{
+    if (!model || row < 0 || row >= model->compareResult().entries().size()) {
+        m_lastError = FileOperationResult::LeftFileNotFound;
+        return false;
+    }
+
+    const QString leftPath = model->leftFilePath(row);
+    const QString rightPath = model->rightFilePath(row);
+    if (!leftPath.isEmpty() && !rightPath.isEmpty())
+        return setContentFromFiles(leftPath, rightPath);
+
+    // Added or removed file: diff it against nothing
+    FileOperationResult result = FileOperationResult::Success;
+    const QString content = readFileToQString(leftPath.isEmpty() ? rightPath : leftPath, result);
+    if (result != FileOperationResult::Success) {
+        const bool notFound = result == FileOperationResult::LeftFileNotFound;
+        if (leftPath.isEmpty())
+            m_lastError = notFound ? FileOperationResult::RightFileNotFound : FileOperationResult::RightFileReadError;
+        else
+            m_lastError = notFound ? FileOperationResult::LeftFileNotFound : FileOperationResult::LeftFileReadError;
+        return false;
+    }
+
+    if (leftPath.isEmpty())
+        setContent(QString(), content);
+    else
+        setContent(content, QString());
+    m_lastError = FileOperationResult::Success;
+    return true;
+}
+
 //- -----------------Error handling: -------------------
 QDiffWidget::FileOperationResult QDiffWidget::lastError() const
 {
@@ -581,15 +756,79 @@ QAlgorithmManager* QDiffWidget::algorithmManager() const
 }
 
 // Helper methods for diff display
-void QDiffWidget::displayUnifiedDiff(const QDiffResult& result)
+void QDiffWidget::displayUnifiedDiff(const QDiffDocument& document)
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_leftTextBrowser->setDiffDocument(document);
+    m_overviewRuler->setHistograms(document.histogram);
+    m_currentHunk = -1;
+    // Render covers building the document on the worker and swapping it in here
+    recordRenderTime(document.result, document.buildNanoseconds + timer.nsecsElapsed());
+}
+
+void QDiffWidget::displaySideBySideDiff(const SideBySideDocuments& documents)
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_leftTextBrowser->setDiffDocument(documents.left);
+    m_rightTextBrowser->setDiffDocument(documents.right);
+    m_overviewRuler->setHistograms(documents.left.histogram, documents.right.histogram);
+    m_currentHunk = -1;
+    recordRenderTime(documents.left.result, documents.left.buildNanoseconds + documents.right.buildNanoseconds
+                                                + timer.nsecsElapsed());
+}
+
+bool QDiffWidget::nextChange()
+{
+    return jumpToChange(true);
+}
+
+bool QDiffWidget::previousChange()
 {
-    m_leftTextBrowser->setDiffResult(result);
+    return jumpToChange(false);
 }
 
-void QDiffWidget::displaySideBySideDiff(const QSideBySideDiffResult& result)
+bool QDiffWidget::jumpToChange(bool forward)
 {
-    m_leftTextBrowser->setDiffResult(result.leftSide);
-    m_rightTextBrowser->setDiffResult(result.rightSide);
+    // The hunks are rows of the document, the same on both panels
+    const QDiffHunkIndex &hunks = m_leftTextBrowser->hunkIndex();
+    int hunk = -1;
+    if (m_currentHunk >= 0 && m_currentHunk < hunks.hunkCount()) {
+        hunk = forward ? m_currentHunk + 1 : m_currentHunk - 1;
+    } else {
+        const int firstVisible = m_leftTextBrowser->visibleLineRange().first;
+        hunk = forward ? hunks.nextHunk(QDiffHunkIndex::Side::Left, firstVisible - 1)
+                       : hunks.previousHunk(QDiffHunkIndex::Side::Left, firstVisible);
+    }
+    if (hunk < 0 || hunk >= hunks.hunkCount())
+        return false;
+
+    m_jumpingToChange = true;
+    scrollToLine(hunks.hunk(hunk).leftStart);
+    m_jumpingToChange = false;
+    m_currentHunk = hunk;
+    return true;
+}
+
+void QDiffWidget::updateOverviewRuler()
+{
+    const std::pair<int, int> visible = m_leftTextBrowser->visibleLineRange();
+    m_overviewRuler->setVisibleLines(visible.first, visible.second);
+}
+
+void QDiffWidget::scrollToLine(int line)
+{
+    m_leftTextBrowser->scrollToLine(line);
+    if (m_displayMode == DisplayMode::SideBySide)
+        m_rightTextBrowser->scrollToLine(line);
+}
+
+void QDiffWidget::recordRenderTime(const QDiffResult& result, qint64 nanoseconds)
+{
+    const QString algorithmId = result.metaData("algorithm_id").toString();
+    if (m_algorithmManager && !algorithmId.isEmpty())
+        m_algorithmManager->statistics()->record(algorithmId, QStringLiteral("render"), nanoseconds);
 }
 
 // Signal connection management
@@ -597,10 +836,9 @@ void QDiffWidget::connectAlgorithmManagerSignals()
 {
     if (!m_algorithmManager) return;
     
-    connect(m_algorithmManager, &QAlgorithmManager::diffCalculated,
-            this, &QDiffWidget::onDiffCalculated);
-    connect(m_algorithmManager, &QAlgorithmManager::sideBySideDiffCalculated,
-            this, &QDiffWidget::onSideBySideDiffCalculated);
+    // Diff results come from the futures of startUpdate(), so other callers' diffs are not shown
+    connect(m_algorithmManager, &QAlgorithmManager::mergeCalculated,
+            this, &QDiffWidget::onMergeCalculated);
     connect(m_algorithmManager, &QAlgorithmManager::availableAlgorithmsChanged, this, [this](const QStringList &list){
         if (!m_algorithmButton) return;
         QMenu *menu = m_algorithmButton->menu();
@@ -630,21 +868,20 @@ void QDiffWidget::disconnectAlgorithmManagerSignals()
 {
     if (!m_algorithmManager) return;
     
-    disconnect(m_algorithmManager, &QAlgorithmManager::diffCalculated,
-               this, &QDiffWidget::onDiffCalculated);
-    disconnect(m_algorithmManager, &QAlgorithmManager::sideBySideDiffCalculated,
-               this, &QDiffWidget::onSideBySideDiffCalculated);
+    disconnect(m_algorithmManager, &QAlgorithmManager::mergeCalculated,
+               this, &QDiffWidget::onMergeCalculated);
 }
 
 // Slot implementations
-void QDiffWidget::onDiffCalculated(const QDiffX::QDiffResult& result)
+void QDiffWidget::onDiffCalculated(const QDiffDocument& document)
 {
     if (m_displayMode != DisplayMode::Inline) {
         return; // Ignore if not in inline mode
     }
     
+    const QDiffResult &result = document.result;
     if (result.success()) {
-        displayUnifiedDiff(result);
+        displayUnifiedDiff(document);
         // Update status counts
         int added = 0, removed = 0;
         for (const auto &c : result.changes()) {
@@ -665,14 +902,16 @@ void QDiffWidget::onDiffCalculated(const QDiffX::QDiffResult& result)
     }
 }
 
-void QDiffWidget::onSideBySideDiffCalculated(const QDiffX::QSideBySideDiffResult& result)
+void QDiffWidget::onSideBySideDiffCalculated(const SideBySideDocuments& documents)
 {
     if (m_displayMode != DisplayMode::SideBySide) {
         return; // Ignore if not in side-by-side mode
     }
     
-    if (result.success()) {
-        displaySideBySideDiff(result);
+    const QDiffResult &leftSide = documents.left.result;
+    const QDiffResult &rightSide = documents.right.result;
+    if (leftSide.success() && rightSide.success()) {
+        displaySideBySideDiff(documents);
         // Show both panels in side-by-side mode
         if (m_rightPanel) m_rightPanel->show();
         if (m_splitter) {
@@ -681,12 +920,12 @@ void QDiffWidget::onSideBySideDiffCalculated(const QDiffX::QSideBySideDiffResult
         }
         // Update status counts using both sides
         int added = 0, removed = 0;
-        for (const auto &c : result.rightSide.changes()) {
+        for (const auto &c : rightSide.changes()) {
             int lines = countLinesInChangeText(c.text);
             if (c.operation == DiffOperation::Insert) added += lines;
             if (c.operation == DiffOperation::Replace) added += lines; // defensive
         }
-        for (const auto &c : result.leftSide.changes()) {
+        for (const auto &c : leftSide.changes()) {
             int lines = countLinesInChangeText(c.text);
             if (c.operation == DiffOperation::Delete) removed += lines;
             if (c.operation == DiffOperation::Replace) removed += lines; // defensive
@@ -700,4 +939,24 @@ void QDiffWidget::onSideBySideDiffCalculated(const QDiffX::QSideBySideDiffResult
     }
 }
 
+void QDiffWidget::onMergeCalculated(const QDiffX::QMergeResult& result)
+{
+    if (!m_mergePending) {
+        return; // Merge was requested by someone else
+    }
+    m_mergePending = false;
+
+    m_leftTextBrowser->setMergeResult(result);
+    m_overviewRuler->setHistograms(m_leftTextBrowser->changeHistogram());
+    m_currentHunk = -1;
+    // The merge is a single document, so it gets the full width
+    if (m_rightPanel) m_rightPanel->hide();
+    if (m_splitter) {
+        m_splitter->setStretchFactor(0, 1);
+        m_splitter->setStretchFactor(1, 0);
+    }
+    if (m_addedLabel) m_addedLabel->setText(tr("Conflicts: %1").arg(result.conflictCount()));
+    if (m_removedLabel) m_removedLabel->clear();
+}
+
 }//namespace QDiffX
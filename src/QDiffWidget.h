@@ -3,13 +3,16 @@
 #include <QSplitter>
 #include <QTextBrowser>
 #include <QDiffTextBrowser.h>
+#include "QDiffOverviewRuler.h"
 #include <QWidget>
 #include "QAlgorithmManager.h"
+#include "QDirectoryCompareModel.h"
 #include <QLabel>
 #include <QPushButton>
 #include <QComboBox>
 #include <QCheckBox>
 #include <QMenu>
+#include <QTimer>
 
 namespace QDiffX {
 
@@ -46,10 +49,15 @@ public:
     void setRightContent(const QString &rightContent);
     void setContent(const QString &leftContent,const QString &rightContent);
 
+    // Three-way merge of ours (left) and theirs (right) against base, shown in the left panel
+    void setMergeContent(const QString &baseContent, const QString &oursContent, const QString &theirsContent);
+
     // File Content Setting :
     bool setLeftContentFromFile(const QString &path);
     bool setRightContentFromFile(const QString &path);
     bool setContentFromFiles(const QString &leftPath, const QString &rightPath);
+    // Opens one row of a directory comparison; a side missing from its tree shows as empty
+    bool setContentFromDirectoryEntry(const QDirectoryCompareModel *model, int row);
 
     // Labels
     void setLeftLabel(const QString &leftlabel);
@@ -88,16 +96,38 @@ public:
     void enableSyncScrolling(bool enable);
     void setTheme(Theme theme);
 
+    // Content changes within this many milliseconds of the first are diffed together,
+    // 0 still coalesces the changes of one event loop pass
+    int updateDelay() const;
+    void setUpdateDelay(int milliseconds);
+    static constexpr int DEFAULT_UPDATE_DELAY_MS = 50;
+
+    // How both panels color their diffs, see QDiffTextBrowser::HighlightingMode
+    QDiffTextBrowser::HighlightingMode highlightingMode() const;
+    void setHighlightingMode(QDiffTextBrowser::HighlightingMode mode);
+    // Unchanged lines kept around every change, the rest folded until clicked;
+    // QDiffTextBrowser::NO_FOLDING shows every line
+    int foldContextLines() const;
+    void setFoldContextLines(int lines);
+
+    // Scroll to the next or previous run of changed lines, false if there is none.
+    // Also on F7 and Shift+F7.
+    bool nextChange();
+    bool previousChange();
+
 signals:
     void contentChanged();
 
 private slots:
-    void onDiffCalculated(const QDiffX::QDiffResult& result);
-    void onSideBySideDiffCalculated(const QDiffX::QSideBySideDiffResult& result);
+    void onMergeCalculated(const QDiffX::QMergeResult& result);
 
 private:
     void setupUI();
+    // Schedules a diff of the current content, see updateDelay()
     void updateDiff();
+    void startUpdate();
+    // Ends the in-flight diff of generation; true when its result is still current
+    bool finishUpdate(quint64 generation);
     void setupConnections();
     void connectAlgorithmManagerSignals();
     void disconnectAlgorithmManagerSignals();
@@ -109,6 +139,7 @@ private:
     QSplitter *m_splitter;
     QDiffTextBrowser *m_leftTextBrowser;
     QDiffTextBrowser *m_rightTextBrowser;
+    QDiffOverviewRuler *m_overviewRuler;
     QWidget* m_leftPanel = nullptr;
     QWidget* m_rightPanel = nullptr;
 
@@ -137,6 +168,18 @@ private:
     QString m_rightContent;
     QString m_leftLabel;
     QString m_rightLabel;
+    bool m_mergePending = false;
+
+    // Update scheduling: at most one diff in flight and one pending behind it;
+    // results of any generation but the latest requested are dropped
+    QTimer *m_updateTimer = nullptr;
+    quint64 m_requestedGeneration = 0;
+    bool m_updateInFlight = false;
+    bool m_updatePending = false;
+    // Hunk of the shown document last jumped to, -1 before any jump and once the
+    // view is scrolled by other means
+    int m_currentHunk = -1;
+    bool m_jumpingToChange = false;
 
     // Display and Algorithm Management
     DisplayMode m_displayMode = DisplayMode::SideBySide;
@@ -145,9 +188,23 @@ private:
     // Error Handeling
     FileOperationResult m_lastError = FileOperationResult::Success;
 
+    // Documents of a side-by-side result, built on the worker that diffed it
+    struct SideBySideDocuments {
+        QDiffDocument left;
+        QDiffDocument right;
+    };
+
+    void onDiffCalculated(const QDiffDocument& document);
+    void onSideBySideDiffCalculated(const SideBySideDocuments& documents);
+
     // Helper methods for diff display
-    void displayUnifiedDiff(const QDiffResult& result);
-    void displaySideBySideDiff(const QSideBySideDiffResult& result);
+    void displayUnifiedDiff(const QDiffDocument& document);
+    void displaySideBySideDiff(const SideBySideDocuments& documents);
+    void recordRenderTime(const QDiffResult& result, qint64 nanoseconds);
+    // Shows the histograms of the panels on display and frames the visible lines
+    void updateOverviewRuler();
+    void scrollToLine(int line);
+    bool jumpToChange(bool forward);
 
 };
 
@@ -0,0 +1,145 @@
+#include "QDirectoryCompare.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <vector>
+
+namespace QDiffX{
+
+namespace {
+
+struct FileRecord {
+    QString relativePath;
+    qint64 size = 0;
+};
+
+// Every regular file below root, sorted by path relative to root
+std::vector<FileRecord> listFiles(const QString &root)
+{
+    std::vector<FileRecord> files;
+    const QDir rootDir(root);
+    QDirIterator it(root, QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        files.push_back(FileRecord{rootDir.relativeFilePath(info.filePath()), info.size()});
+    }
+    std::sort(files.begin(), files.end(), [](const FileRecord &a, const FileRecord &b) {
+        return a.relativePath < b.relativePath;
+    });
+    return files;
+}
+
+} // namespace
+
+// ----------------------- QDirectoryCompareResult -------------------------
+
+int QDirectoryCompareResult::count(QFileCompareStatus status) const
+{
+    return int(std::count_if(m_entries.cbegin(), m_entries.cend(), [status](const QFileCompareEntry &entry) {
+        return entry.status == status;
+    }));
+}
+
+// ----------------------- QDirectoryCompareEngine -------------------------
+
+QDirectoryCompareResult QDirectoryCompareEngine::compare(const QString &leftRoot, const QString &rightRoot) const
+{
+    if (!QFileInfo(leftRoot).isDir())
+        return QDirectoryCompareResult(QStringLiteral("Directory not found: %1").arg(leftRoot));
+    if (!QFileInfo(rightRoot).isDir())
+        return QDirectoryCompareResult(QStringLiteral("Directory not found: %1").arg(rightRoot));
+
+    QDirectoryCompareResult result;
+    result.m_leftRoot = QDir(leftRoot).absolutePath();
+    result.m_rightRoot = QDir(rightRoot).absolutePath();
+
+    QFuture<std::vector<FileRecord>> leftFuture = QtConcurrent::run(listFiles, result.m_leftRoot);
+    const std::vector<FileRecord> rightFiles = listFiles(result.m_rightRoot);
+    const std::vector<FileRecord> leftFiles = leftFuture.result();
+
+    // Merge the two sorted listings; only same-size pairs need their contents looked at
+    QList<QFileCompareEntry> &entries = result.m_entries;
+    entries.reserve(qsizetype(qMax(leftFiles.size(), rightFiles.size())));
+    QList<int> candidates;
+    size_t l = 0, r = 0;
+    while (l < leftFiles.size() || r < rightFiles.size()) {
+        QFileCompareEntry entry;
+        if (r == rightFiles.size() || (l < leftFiles.size() && leftFiles[l].relativePath < rightFiles[r].relativePath)) {
+            entry.relativePath = leftFiles[l].relativePath;
+            entry.leftSize = leftFiles[l++].size;
+            entry.status = QFileCompareStatus::Removed;
+        } else if (l == leftFiles.size() || rightFiles[r].relativePath < leftFiles[l].relativePath) {
+            entry.relativePath = rightFiles[r].relativePath;
+            entry.rightSize = rightFiles[r++].size;
+            entry.status = QFileCompareStatus::Added;
+        } else {
+            entry.relativePath = leftFiles[l].relativePath;
+            entry.leftSize = leftFiles[l++].size;
+            entry.rightSize = rightFiles[r++].size;
+            if (entry.leftSize != entry.rightSize) {
+                entry.status = QFileCompareStatus::Modified;
+            } else if (entry.leftSize > 0) {
+                candidates.append(int(entries.size()));
+            } else {
+                entry.addedLines = entry.removedLines = 0;
+            }
+        }
+        entries.append(entry);
+    }
+
+    result.m_hashedPairCount = int(candidates.size());
+    QFileCompareEntry *data = entries.data();
+    const QString leftBase = result.m_leftRoot + '/';
+    const QString rightBase = result.m_rightRoot + '/';
+    QtConcurrent::blockingMap(candidates, [data, &leftBase, &rightBase](int index) {
+        QFileCompareEntry &entry = data[index];
+        bool leftOk = false, rightOk = false;
+        const quint64 leftHash = fingerprint(leftBase + entry.relativePath, &leftOk);
+        const quint64 rightHash = fingerprint(rightBase + entry.relativePath, &rightOk);
+        if (leftOk && rightOk && leftHash == rightHash) {
+            entry.status = QFileCompareStatus::Unchanged;
+            entry.addedLines = entry.removedLines = 0;
+        } else {
+            entry.status = QFileCompareStatus::Modified;
+        }
+    });
+
+    result.m_success = true;
+    return result;
+}
+
+quint64 QDirectoryCompareEngine::fingerprint(const QString &path, bool *ok)
+{
+    if (ok) *ok = false;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    // Chunks are hashed the same way whether the file could be mapped or not,
+    // so a mapped and a read copy of the same content fingerprint alike
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const qint64 size = file.size();
+    if (uchar *mapped = size > 0 ? file.map(0, size) : nullptr) {
+        for (qint64 offset = 0; offset < size; offset += FINGERPRINT_CHUNK_SIZE)
+            hash.addData(QByteArrayView(mapped + offset, qMin(FINGERPRINT_CHUNK_SIZE, size - offset)));
+        file.unmap(mapped);
+    } else {
+        QByteArray chunk;
+        while (!(chunk = file.read(FINGERPRINT_CHUNK_SIZE)).isEmpty())
+            hash.addData(chunk);
+        if (file.error() != QFileDevice::NoError)
+            return 0;
+    }
+    if (ok) *ok = true;
+    // First 64 bits of the digest, the same on 32 and 64-bit targets
+    const QByteArray digest = hash.result();
+    return qFromLittleEndian<quint64>(digest.constData());
+}
+
+}//namespace QDiffX
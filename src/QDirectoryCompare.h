@@ -0,0 +1,70 @@
+#pragma once
+#include <QList>
+#include <QString>
+
+namespace QDiffX{
+
+enum class QFileCompareStatus {
+    Unchanged,
+    Added,          // Only in the right tree
+    Removed,        // Only in the left tree
+    Modified
+};
+
+struct QFileCompareEntry {
+    QString relativePath;
+    QFileCompareStatus status = QFileCompareStatus::Unchanged;
+    qint64 leftSize = -1;       // -1 when the file is missing on that side
+    qint64 rightSize = -1;
+    int addedLines = -1;        // -1 until line stats have been computed
+    int removedLines = -1;
+    bool binary = false;
+
+    bool hasLineStats() const { return addedLines >= 0; }
+};
+
+// Result of comparing two directory trees; entries are sorted by relative path
+class QDirectoryCompareResult {
+public:
+    QDirectoryCompareResult() : m_success(false) {}
+
+    // Error Constructor:
+    QDirectoryCompareResult(QString errorMessage) : m_success(false), m_errorMessage(errorMessage) {}
+
+    bool success() const { return m_success; }
+    QString errorMessage() const { return m_errorMessage; }
+
+    QString leftRoot() const { return m_leftRoot; }
+    QString rightRoot() const { return m_rightRoot; }
+    QList<QFileCompareEntry> entries() const { return m_entries; }
+    int count(QFileCompareStatus status) const;
+    int hashedPairCount() const { return m_hashedPairCount; }
+
+private:
+    friend class QDirectoryCompareEngine;
+
+    bool m_success;
+    QString m_errorMessage;
+    QString m_leftRoot;
+    QString m_rightRoot;
+    QList<QFileCompareEntry> m_entries;
+    int m_hashedPairCount = 0;  // Pairs whose sizes matched, so contents had to be fingerprinted
+};
+
+// Compares two directory trees without diffing anything.
+// Both trees are walked concurrently; files present on both sides with
+// different sizes are Modified right away, equal sizes are decided by a
+// fingerprint of their contents computed in parallel. Line stats are left
+// unset for the caller to fill in (see QDirectoryCompareModel).
+class QDirectoryCompareEngine
+{
+public:
+    QDirectoryCompareResult compare(const QString &leftRoot, const QString &rightRoot) const;
+
+    // 64-bit content fingerprint (truncated SHA-1 over memory-mapped chunks); 0 if unreadable
+    static quint64 fingerprint(const QString &path, bool *ok = nullptr);
+
+    static constexpr qint64 FINGERPRINT_CHUNK_SIZE = 4 * 1024 * 1024;
+};
+
+}//namespace QDiffX
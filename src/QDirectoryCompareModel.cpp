@@ -0,0 +1,318 @@
+#include "QDirectoryCompareModel.h"
+#include "QAlgorithmManager.h"
+#include <QFile>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
+
+namespace QDiffX{
+
+namespace {
+
+// Line stats of one chunk of rows, gathered off the GUI thread
+struct StatsChunk {
+    QList<int> rows;
+    QList<int> addedLines;      // -1 where the pair still has to be diffed
+    QList<int> removedLines;
+    QList<bool> binary;
+    QList<int> diffSlots;       // Index into rows of every entry in pairs
+    QList<QDiffPair> pairs;
+};
+
+int countLines(const QString &text)
+{
+    if (text.isEmpty())
+        return 0;
+    return int(text.count('\n')) + (text.endsWith('\n') ? 0 : 1);
+}
+
+// Opens the file and reads its first BINARY_PROBE_SIZE bytes into head;
+// binary when they hold a NUL, in which case the rest is never read
+bool openProbed(QFile &file, QByteArray *head, bool *binary)
+{
+    *binary = false;
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    *head = file.read(QDirectoryCompareModel::BINARY_PROBE_SIZE);
+    *binary = head->contains('\0');
+    return !*binary;
+}
+
+QString readText(const QString &path, bool *binary)
+{
+    QFile file(path);
+    QByteArray bytes;
+    if (!openProbed(file, &bytes, binary))
+        return QString();
+    bytes += file.readAll();
+    return QString::fromUtf8(bytes);
+}
+
+// Lines of the file as countLines() would count its text, read in blocks
+int streamLineCount(const QString &path, bool *binary)
+{
+    QFile file(path);
+    QByteArray block;
+    if (!openProbed(file, &block, binary))
+        return 0;
+    int lines = 0;
+    char last = '\n';
+    while (!block.isEmpty()) {
+        lines += int(block.count('\n'));
+        last = block.back();
+        block = file.read(QDirectoryCompareModel::LINE_COUNT_BLOCK_SIZE);
+    }
+    return last == '\n' ? lines : lines + 1;
+}
+
+StatsChunk loadStatsChunk(const QString &leftRoot, const QString &rightRoot,
+                          const QList<int> &rows, const QList<QFileCompareEntry> &entries)
+{
+    StatsChunk chunk;
+    chunk.rows = rows;
+    for (int i = 0; i < rows.size(); ++i) {
+        const QFileCompareEntry &entry = entries[i];
+        const QString leftPath = leftRoot + '/' + entry.relativePath;
+        const QString rightPath = rightRoot + '/' + entry.relativePath;
+        bool binary = false;
+        int added = 0, removed = 0;
+        if (entry.status == QFileCompareStatus::Modified) {
+            // Only changed text pairs are read whole, to be diffed
+            const QString leftText = readText(leftPath, &binary);
+            const QString rightText = binary ? QString() : readText(rightPath, &binary);
+            if (!binary) {
+                added = removed = -1;
+                chunk.diffSlots.append(i);
+                chunk.pairs.append(QDiffPair{leftText, rightText});
+            }
+        } else {
+            const int leftLines = entry.leftSize >= 0 ? streamLineCount(leftPath, &binary) : 0;
+            const int rightLines = entry.rightSize >= 0 && !binary ? streamLineCount(rightPath, &binary) : 0;
+            if (!binary) {
+                added = rightLines;
+                removed = leftLines;
+            }
+        }
+        chunk.addedLines.append(added);
+        chunk.removedLines.append(removed);
+        chunk.binary.append(binary);
+    }
+    return chunk;
+}
+
+} // namespace
+
+QDirectoryCompareModel::QDirectoryCompareModel(QAlgorithmManager *manager, QObject *parent)
+    : QAbstractTableModel(parent), m_manager(manager)
+{
+}
+
+// ----------------------- Comparison -------------------------
+
+void QDirectoryCompareModel::compare(const QString &leftRoot, const QString &rightRoot)
+{
+    const int generation = ++m_generation;
+    m_comparing = true;
+    auto *watcher = new QFutureWatcher<QDirectoryCompareResult>(this);
+    connect(watcher, &QFutureWatcher<QDirectoryCompareResult>::finished, this, [this, watcher, generation]() {
+        watcher->deleteLater();
+        if (generation != m_generation)
+            return;     // A newer comparison was started meanwhile
+        m_comparing = false;
+        setCompareResult(watcher->result());
+    });
+    watcher->setFuture(QtConcurrent::run([leftRoot, rightRoot]() {
+        return QDirectoryCompareEngine().compare(leftRoot, rightRoot);
+    }));
+}
+
+void QDirectoryCompareModel::setCompareResult(const QDirectoryCompareResult &result)
+{
+    ++m_generation;
+    beginResetModel();
+    m_result = result;
+    m_entries = result.entries();
+    m_fetchedRows = qMin(int(m_entries.size()), FETCH_BATCH_SIZE);
+    m_pendingStats.clear();
+    for (int row = 0; row < m_entries.size(); ++row) {
+        if (!m_entries[row].hasLineStats())
+            m_pendingStats.append(row);
+    }
+    endResetModel();
+
+    emit comparisonFinished(result);
+    computeNextStatsChunk();
+}
+
+void QDirectoryCompareModel::computeNextStatsChunk()
+{
+    if (m_pendingStats.isEmpty()) {
+        emit lineStatsFinished();
+        return;
+    }
+
+    const QList<int> rows = m_pendingStats.mid(0, STATS_CHUNK_SIZE);
+    m_pendingStats.remove(0, rows.size());
+    QList<QFileCompareEntry> entries;
+    entries.reserve(rows.size());
+    for (int row : rows)
+        entries.append(m_entries[row]);
+
+    const int generation = m_generation;
+    auto applyChunk = [this, generation](const StatsChunk &chunk, const QList<QDiffResult> &diffs) {
+        if (generation != m_generation)
+            return;
+        StatsChunk stats = chunk;
+        for (int i = 0; i < stats.diffSlots.size() && i < diffs.size(); ++i) {
+            const QDiffResult &diff = diffs[i];
+            if (!diff.success())
+                continue;
+            const bool lineSeparated = diff.metaData("line_separated").toBool();
+            int added = 0, removed = 0;
+            for (const DiffChange &change : diff.changes()) {
+                const int lines = lineSeparated ? 1 : countLines(change.text);
+                if (change.operation == DiffOperation::Insert || change.operation == DiffOperation::Replace)
+                    added += lines;
+                if (change.operation == DiffOperation::Delete || change.operation == DiffOperation::Replace)
+                    removed += lines;
+            }
+            stats.addedLines[stats.diffSlots[i]] = added;
+            stats.removedLines[stats.diffSlots[i]] = removed;
+        }
+
+        int firstRow = m_fetchedRows, lastRow = -1;
+        for (int i = 0; i < stats.rows.size(); ++i) {
+            QFileCompareEntry &entry = m_entries[stats.rows[i]];
+            entry.addedLines = stats.addedLines[i];
+            entry.removedLines = stats.removedLines[i];
+            entry.binary = stats.binary[i];
+            if (stats.rows[i] < m_fetchedRows) {
+                firstRow = qMin(firstRow, stats.rows[i]);
+                lastRow = qMax(lastRow, stats.rows[i]);
+            }
+        }
+        if (lastRow >= 0)
+            emit dataChanged(index(firstRow, AddedColumn), index(lastRow, RemovedColumn));
+        computeNextStatsChunk();
+    };
+
+    auto *loadWatcher = new QFutureWatcher<StatsChunk>(this);
+    connect(loadWatcher, &QFutureWatcher<StatsChunk>::finished, this, [this, loadWatcher, generation, applyChunk]() {
+        loadWatcher->deleteLater();
+        if (generation != m_generation)
+            return;
+        const StatsChunk chunk = loadWatcher->result();
+        if (chunk.pairs.isEmpty() || !m_manager) {
+            applyChunk(chunk, QList<QDiffResult>());
+            return;
+        }
+        // Only the changed pairs are diffed, on the manager's batch pool
+        auto *diffWatcher = new QFutureWatcher<QDiffResult>(this);
+        connect(diffWatcher, &QFutureWatcher<QDiffResult>::finished, this, [diffWatcher, chunk, applyChunk]() {
+            diffWatcher->deleteLater();
+            applyChunk(chunk, diffWatcher->future().results());
+        });
+        diffWatcher->setFuture(m_manager->calculateBatchDiff(chunk.pairs));
+    });
+    loadWatcher->setFuture(QtConcurrent::run(loadStatsChunk, m_result.leftRoot(), m_result.rightRoot(), rows, entries));
+}
+
+// ----------------------- Entries -------------------------
+
+QFileCompareEntry QDirectoryCompareModel::entry(int row) const
+{
+    return m_entries.value(row);
+}
+
+QString QDirectoryCompareModel::leftFilePath(int row) const
+{
+    if (row < 0 || row >= m_entries.size() || m_entries[row].leftSize < 0)
+        return QString();
+    return m_result.leftRoot() + '/' + m_entries[row].relativePath;
+}
+
+QString QDirectoryCompareModel::rightFilePath(int row) const
+{
+    if (row < 0 || row >= m_entries.size() || m_entries[row].rightSize < 0)
+        return QString();
+    return m_result.rightRoot() + '/' + m_entries[row].relativePath;
+}
+
+// ----------------------- Model -------------------------
+
+int QDirectoryCompareModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_fetchedRows;
+}
+
+int QDirectoryCompareModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant QDirectoryCompareModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_fetchedRows || role != Qt::DisplayRole)
+        return QVariant();
+
+    const QFileCompareEntry &entry = m_entries[index.row()];
+    switch (index.column()) {
+    case PathColumn:
+        return entry.relativePath;
+    case StatusColumn:
+        switch (entry.status) {
+        case QFileCompareStatus::Added:
+            return tr("Added");
+        case QFileCompareStatus::Removed:
+            return tr("Removed");
+        case QFileCompareStatus::Modified:
+            return entry.binary ? tr("Modified (binary)") : tr("Modified");
+        case QFileCompareStatus::Unchanged:
+        default:
+            return tr("Unchanged");
+        }
+    case AddedColumn:
+        return entry.hasLineStats() ? QVariant(entry.addedLines) : QVariant();
+    case RemovedColumn:
+        return entry.hasLineStats() ? QVariant(entry.removedLines) : QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant QDirectoryCompareModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section) {
+    case PathColumn:
+        return tr("Path");
+    case StatusColumn:
+        return tr("Status");
+    case AddedColumn:
+        return tr("Added");
+    case RemovedColumn:
+        return tr("Removed");
+    default:
+        return QVariant();
+    }
+}
+
+bool QDirectoryCompareModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_fetchedRows < m_entries.size();
+}
+
+void QDirectoryCompareModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid())
+        return;
+    const int count = qMin(FETCH_BATCH_SIZE, int(m_entries.size()) - m_fetchedRows);
+    if (count <= 0)
+        return;
+    beginInsertRows(QModelIndex(), m_fetchedRows, m_fetchedRows + count - 1);
+    m_fetchedRows += count;
+    endInsertRows();
+}
+
+}//namespace QDiffX
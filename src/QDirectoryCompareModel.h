@@ -0,0 +1,68 @@
+#pragma once
+#include "QDirectoryCompare.h"
+#include <QAbstractTableModel>
+#include <QPointer>
+
+namespace QDiffX{
+
+class QAlgorithmManager;
+
+// Flat table of a directory comparison (path, status, added, removed lines).
+// Rows are handed to views in FETCH_BATCH_SIZE steps through fetchMore, and
+// line stats are filled in behind the comparison by diffing the changed pairs
+// STATS_CHUNK_SIZE at a time through QAlgorithmManager::calculateBatchDiff.
+// Full diffs are not kept: a view opens one with leftFilePath/rightFilePath.
+class QDirectoryCompareModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        PathColumn,
+        StatusColumn,
+        AddedColumn,
+        RemovedColumn,
+        ColumnCount
+    };
+
+    explicit QDirectoryCompareModel(QAlgorithmManager *manager = nullptr, QObject *parent = nullptr);
+
+    void compare(const QString &leftRoot, const QString &rightRoot);
+    void setCompareResult(const QDirectoryCompareResult &result);
+    QDirectoryCompareResult compareResult() const { return m_result; }
+    bool isComparing() const { return m_comparing; }
+
+    QFileCompareEntry entry(int row) const;
+    QString leftFilePath(int row) const;    // Empty when the file is not in the left tree
+    QString rightFilePath(int row) const;   // Empty when the file is not in the right tree
+
+    // QAbstractTableModel
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    static constexpr int FETCH_BATCH_SIZE = 1000;
+    static constexpr int STATS_CHUNK_SIZE = 256;
+    static constexpr int BINARY_PROBE_SIZE = 8000;
+    static constexpr int LINE_COUNT_BLOCK_SIZE = 256 * 1024;
+
+signals:
+    void comparisonFinished(const QDiffX::QDirectoryCompareResult &result);
+    void lineStatsFinished();
+
+private:
+    void computeNextStatsChunk();
+
+private:
+    QPointer<QAlgorithmManager> m_manager;
+    QDirectoryCompareResult m_result;
+    QList<QFileCompareEntry> m_entries;
+    QList<int> m_pendingStats;          // Rows still waiting for line stats
+    int m_fetchedRows = 0;
+    int m_generation = 0;               // Bumped by every compare(), stale work is dropped
+    bool m_comparing = false;
+};
+
+}//namespace QDiffX
@@ -1,5 +1,6 @@
 #include "QLineNumberArea.h"
 #include "QDiffTextBrowser.h"
+#include "QDiffTrace.h"
 #include <QPainter>
 #include <QTextBlock>
 
@@ -15,6 +16,7 @@ QSize QLineNumberArea::sizeHint() const {
 }
 
 void QLineNumberArea::paintEvent(QPaintEvent* event) {
+    QDIFFX_TRACE_SCOPE("view", "lineNumberPaint");
     m_editor->paintLineNumberArea(event);
 }
 
@@ -0,0 +1,266 @@
+#include "QMergeEngine.h"
+#include "dtl/dtl.hpp"
+#include <QHash>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <vector>
+
+namespace QDiffX{
+
+namespace {
+
+using LineIds = std::vector<quint32>;
+
+// Offsets of every line start plus the end of the text; lines keep their '\n'
+QVector<int> lineOffsets(const QString &text)
+{
+    QVector<int> offsets;
+    offsets.reserve(text.count('\n') + 2);
+    offsets.append(0);
+    int from = 0;
+    int newline;
+    while ((newline = text.indexOf('\n', from)) != -1) {
+        offsets.append(newline + 1);
+        from = newline + 1;
+    }
+    if (offsets.last() < text.length())
+        offsets.append(text.length());
+    return offsets;
+}
+
+// Gives equal lines of all three texts the same id, so both diffs compare integers
+LineIds intern(const QString &text, const QVector<int> &offsets, QHash<QStringView, quint32> &ids)
+{
+    LineIds sequence;
+    sequence.reserve(offsets.size() - 1);
+    for (int i = 0; i + 1 < offsets.size(); ++i) {
+        const QStringView line = QStringView(text).mid(offsets[i], offsets[i + 1] - offsets[i]);
+        auto it = ids.constFind(line);
+        if (it == ids.constEnd())
+            it = ids.insert(line, quint32(ids.size()));
+        sequence.push_back(it.value());
+    }
+    return sequence;
+}
+
+// For every base line, the index of the line it is matched with in 'other' or -1
+std::vector<int> matchLines(const LineIds &base, const LineIds &other)
+{
+    std::vector<int> matches(base.size(), -1);
+    if (base.empty() || other.empty())
+        return matches;
+
+    dtl::Diff<quint32, LineIds> diff(base, other);
+    diff.compose();
+    for (const auto &edit : diff.getSes().getSequence()) {
+        if (edit.second.type == dtl::SES_COMMON)
+            matches[size_t(edit.second.beforeIdx - 1)] = int(edit.second.afterIdx - 1);
+    }
+    return matches;
+}
+
+bool sameLines(const LineIds &a, int aStart, const LineIds &b, int bStart, int count)
+{
+    return std::equal(a.begin() + aStart, a.begin() + aStart + count, b.begin() + bStart);
+}
+
+} // namespace
+
+// ----------------------- QMergeResult -------------------------
+
+const QString &QMergeResult::text(QMergeSide side) const
+{
+    switch (side) {
+    case QMergeSide::Ours:
+        return m_ours;
+    case QMergeSide::Theirs:
+        return m_theirs;
+    case QMergeSide::Base:
+    default:
+        return m_base;
+    }
+}
+
+const QVector<int> &QMergeResult::offsets(QMergeSide side) const
+{
+    switch (side) {
+    case QMergeSide::Ours:
+        return m_oursOffsets;
+    case QMergeSide::Theirs:
+        return m_theirsOffsets;
+    case QMergeSide::Base:
+    default:
+        return m_baseOffsets;
+    }
+}
+
+int QMergeResult::lineCount(QMergeSide side) const
+{
+    return qMax(0, int(offsets(side).size()) - 1);
+}
+
+QStringView QMergeResult::line(QMergeSide side, int index) const
+{
+    const QVector<int> &lineStarts = offsets(side);
+    if (index < 0 || index + 1 >= lineStarts.size())
+        return QStringView();
+    return QStringView(text(side)).mid(lineStarts[index], lineStarts[index + 1] - lineStarts[index]);
+}
+
+QString QMergeResult::mergedText(const QString &oursLabel, const QString &theirsLabel) const
+{
+    const QString start = QLatin1String(CONFLICT_START_MARKER) + ' ' + oursLabel + '\n';
+    const QString separator = QLatin1String(CONFLICT_SEPARATOR_MARKER) + '\n';
+    const QString end = QLatin1String(CONFLICT_END_MARKER) + ' ' + theirsLabel + '\n';
+
+    auto span = [this](QMergeSide side, int first, int count) {
+        const QVector<int> &lineStarts = offsets(side);
+        return QStringView(text(side)).mid(lineStarts[first], lineStarts[first + count] - lineStarts[first]);
+    };
+
+    // Size the output first so it is written in one pass
+    qsizetype size = 0;
+    for (const QMergeRegion &region : m_regions) {
+        switch (region.type) {
+        case QMergeRegionType::Unchanged:
+            size += span(QMergeSide::Base, region.baseStart, region.baseCount).size();
+            break;
+        case QMergeRegionType::Theirs:
+            size += span(QMergeSide::Theirs, region.theirsStart, region.theirsCount).size();
+            break;
+        case QMergeRegionType::Ours:
+        case QMergeRegionType::Both:
+            size += span(QMergeSide::Ours, region.oursStart, region.oursCount).size();
+            break;
+        case QMergeRegionType::Conflict:
+            size += start.size() + separator.size() + end.size() + 2
+                    + span(QMergeSide::Ours, region.oursStart, region.oursCount).size()
+                    + span(QMergeSide::Theirs, region.theirsStart, region.theirsCount).size();
+            break;
+        }
+    }
+
+    QString merged;
+    merged.reserve(size);
+    auto appendLines = [&](QMergeSide side, int first, int count) {
+        merged.append(span(side, first, count));
+    };
+    auto terminateLine = [&merged]() {
+        if (!merged.isEmpty() && !merged.endsWith('\n'))
+            merged.append('\n');
+    };
+    for (const QMergeRegion &region : m_regions) {
+        switch (region.type) {
+        case QMergeRegionType::Unchanged:
+            appendLines(QMergeSide::Base, region.baseStart, region.baseCount);
+            break;
+        case QMergeRegionType::Theirs:
+            appendLines(QMergeSide::Theirs, region.theirsStart, region.theirsCount);
+            break;
+        case QMergeRegionType::Ours:
+        case QMergeRegionType::Both:
+            appendLines(QMergeSide::Ours, region.oursStart, region.oursCount);
+            break;
+        case QMergeRegionType::Conflict:
+            terminateLine();
+            merged.append(start);
+            appendLines(QMergeSide::Ours, region.oursStart, region.oursCount);
+            terminateLine();
+            merged.append(separator);
+            appendLines(QMergeSide::Theirs, region.theirsStart, region.theirsCount);
+            terminateLine();
+            merged.append(end);
+            break;
+        }
+    }
+    return merged;
+}
+
+// ----------------------- QMergeEngine -------------------------
+
+QMergeResult QMergeEngine::merge(const QString &base, const QString &ours, const QString &theirs) const
+{
+    QMergeResult result;
+    try {
+        result.m_base = base;
+        result.m_ours = ours;
+        result.m_theirs = theirs;
+        result.m_baseOffsets = lineOffsets(base);
+        result.m_oursOffsets = lineOffsets(ours);
+        result.m_theirsOffsets = lineOffsets(theirs);
+
+        QHash<QStringView, quint32> ids;
+        ids.reserve(result.m_baseOffsets.size());
+        const LineIds baseIds = intern(base, result.m_baseOffsets, ids);
+        const LineIds oursIds = intern(ours, result.m_oursOffsets, ids);
+        const LineIds theirsIds = intern(theirs, result.m_theirsOffsets, ids);
+
+        // The two base diffs are independent: run one on the pool and one here
+        QFuture<std::vector<int>> oursFuture = QtConcurrent::run(matchLines, baseIds, oursIds);
+        const std::vector<int> theirsMatch = matchLines(baseIds, theirsIds);
+        const std::vector<int> oursMatch = oursFuture.result();
+
+        // diff3: alternate stable runs (every base line matched on both sides,
+        // consecutively) with unstable chunks that end at the next base line
+        // matched on both sides
+        const int baseCount = int(baseIds.size());
+        const int oursCount = int(oursIds.size());
+        const int theirsCount = int(theirsIds.size());
+        int b = 0, o = 0, t = 0;
+        while (b < baseCount || o < oursCount || t < theirsCount) {
+            QMergeRegion region;
+            region.baseStart = b;
+            region.oursStart = o;
+            region.theirsStart = t;
+
+            while (b < baseCount && oursMatch[b] == o && theirsMatch[b] == t) {
+                ++b; ++o; ++t;
+            }
+            if (b > region.baseStart) {
+                region.type = QMergeRegionType::Unchanged;
+                region.baseCount = region.oursCount = region.theirsCount = b - region.baseStart;
+                result.m_regions.append(region);
+                continue;
+            }
+
+            int next = b;
+            while (next < baseCount && (oursMatch[next] == -1 || theirsMatch[next] == -1))
+                ++next;
+            const int oursEnd = next < baseCount ? oursMatch[next] : oursCount;
+            const int theirsEnd = next < baseCount ? theirsMatch[next] : theirsCount;
+            region.baseCount = next - b;
+            region.oursCount = oursEnd - o;
+            region.theirsCount = theirsEnd - t;
+
+            const bool oursChanged = region.oursCount != region.baseCount
+                                     || !sameLines(oursIds, o, baseIds, b, region.baseCount);
+            const bool theirsChanged = region.theirsCount != region.baseCount
+                                       || !sameLines(theirsIds, t, baseIds, b, region.baseCount);
+            if (oursChanged && theirsChanged) {
+                const bool sameChange = region.oursCount == region.theirsCount
+                                        && sameLines(oursIds, o, theirsIds, t, region.oursCount);
+                region.type = sameChange ? QMergeRegionType::Both : QMergeRegionType::Conflict;
+            } else if (oursChanged) {
+                region.type = QMergeRegionType::Ours;
+            } else if (theirsChanged) {
+                region.type = QMergeRegionType::Theirs;
+            } else {
+                region.type = QMergeRegionType::Unchanged;
+            }
+            if (region.type == QMergeRegionType::Conflict)
+                ++result.m_conflictCount;
+            result.m_regions.append(region);
+
+            b = next;
+            o = oursEnd;
+            t = theirsEnd;
+        }
+
+        result.m_success = true;
+    } catch (...) {
+        result = QMergeResult(QStringLiteral("Three-way merge failed"));
+    }
+    return result;
+}
+
+}//namespace QDiffX
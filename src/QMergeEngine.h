@@ -0,0 +1,87 @@
+#pragma once
+#include <QList>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+namespace QDiffX{
+
+enum class QMergeSide {
+    Base,
+    Ours,
+    Theirs
+};
+
+enum class QMergeRegionType : quint8 {
+    Unchanged,      // Base, ours and theirs agree
+    Ours,           // Only ours changed the base
+    Theirs,         // Only theirs changed the base
+    Both,           // Both sides made the same change
+    Conflict        // Both sides changed the base differently
+};
+
+// A run of lines of the merge; ranges are line indices into each input
+struct QMergeRegion {
+    QMergeRegionType type = QMergeRegionType::Unchanged;
+    int baseStart = 0;
+    int baseCount = 0;
+    int oursStart = 0;
+    int oursCount = 0;
+    int theirsStart = 0;
+    int theirsCount = 0;
+};
+
+// Result of a three-way merge.
+// Holds the three inputs (implicitly shared, not copied), their line offsets and
+// the region list; merged text is only materialized on request.
+class QMergeResult {
+public:
+    QMergeResult() : m_success(false) {}
+
+    // Error Constructor:
+    QMergeResult(QString errorMessage) : m_success(false), m_errorMessage(errorMessage) {}
+
+    bool success() const { return m_success; }
+    QString errorMessage() const { return m_errorMessage; }
+
+    QList<QMergeRegion> regions() const { return m_regions; }
+    int conflictCount() const { return m_conflictCount; }
+    bool hasConflicts() const { return m_conflictCount > 0; }
+
+    int lineCount(QMergeSide side) const;
+    QStringView line(QMergeSide side, int index) const;   // Includes its '\n', if any
+
+    // Merged text; conflicts are written out with git style markers
+    QString mergedText(const QString &oursLabel = QStringLiteral("ours"),
+                       const QString &theirsLabel = QStringLiteral("theirs")) const;
+
+    static constexpr char CONFLICT_START_MARKER[] = "<<<<<<<";
+    static constexpr char CONFLICT_SEPARATOR_MARKER[] = "=======";
+    static constexpr char CONFLICT_END_MARKER[] = ">>>>>>>";
+
+private:
+    friend class QMergeEngine;
+
+    const QString &text(QMergeSide side) const;
+    const QVector<int> &offsets(QMergeSide side) const;
+
+    bool m_success;
+    QString m_errorMessage;
+    QString m_base;
+    QString m_ours;
+    QString m_theirs;
+    QVector<int> m_baseOffsets;     // Start of every line, plus the end of the text
+    QVector<int> m_oursOffsets;
+    QVector<int> m_theirsOffsets;
+    QList<QMergeRegion> m_regions;
+    int m_conflictCount = 0;
+};
+
+// Line based three-way merge (diff3) of ours and theirs against their common base
+class QMergeEngine
+{
+public:
+    QMergeResult merge(const QString &base, const QString &ours, const QString &theirs) const;
+};
+
+}//namespace QDiffX
@@ -0,0 +1,411 @@
+#include "QPatchEngine.h"
+#include "DMP/diff_match_patch.h"
+#include "DMP/diff_simd.h"
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <vector>
+
+namespace QDiffX{
+
+namespace {
+
+// One hunk of a prepared patch list; oversized patches are split into several
+struct Hunk {
+    Patch patch;
+    int source = 0;         // Index of the patch this hunk came from
+    int expectedLoc = 0;    // Where the hunk starts in the unmodified (padded) text
+    QString text1;          // Text the hunk expects
+    QString text2;          // Text the hunk produces
+};
+
+// Where a hunk landed in the padded text and what replaces that range
+struct Placement {
+    int startLoc = -1;
+    int regionStart = 0;
+    int regionEnd = 0;
+    QString replacement;
+};
+
+const char16_t *utf16(const QString &text)
+{
+    return reinterpret_cast<const char16_t *>(text.constData());
+}
+
+// Mirrors the body of diff_match_patch::patch_apply, but records the edit as a
+// range of the unmodified text instead of splicing it into the text.
+void locateHunk(diff_match_patch &dmp, const QString &text, const Hunk &hunk, int expectedLoc, Placement &placement)
+{
+    const QString &text1 = hunk.text1;
+    int startLoc;
+    int endLoc = -1;
+    if (text1.length() > dmp.Match_MaxBits) {
+        // patch_splitMax only leaves an oversized pattern for a monster delete
+        startLoc = dmp.match_main(text, text1.left(dmp.Match_MaxBits), expectedLoc);
+        if (startLoc != -1) {
+            endLoc = dmp.match_main(text, text1.right(dmp.Match_MaxBits),
+                                    expectedLoc + text1.length() - dmp.Match_MaxBits);
+            if (endLoc == -1 || startLoc >= endLoc) {
+                // Can't find valid trailing context, drop this hunk
+                startLoc = -1;
+            }
+        }
+    } else {
+        startLoc = dmp.match_main(text, text1, expectedLoc);
+    }
+    placement.startLoc = startLoc;
+    if (startLoc == -1)
+        return;
+
+    const QString found = endLoc == -1 ? text.mid(startLoc, text1.length())
+                                       : text.mid(startLoc, endLoc + dmp.Match_MaxBits - startLoc);
+    QString region;
+    if (text1 == found) {
+        // Perfect match, the replacement is the hunk's own output
+        region = hunk.text2;
+    } else {
+        // Imperfect match, run a diff to get a framework of equivalent indices
+        QList<Diff> diffs = dmp.diff_main(text1, found, false);
+        if (text1.length() > dmp.Match_MaxBits
+            && dmp.diff_levenshtein(diffs) / static_cast<float>(text1.length()) > dmp.Patch_DeleteThreshold) {
+            // The end points match, but the content is unacceptably bad
+            placement.startLoc = -1;
+            return;
+        }
+        dmp.diff_cleanupSemanticLossless(diffs);
+        region = found;
+        int index1 = 0;
+        for (const Diff &aDiff : hunk.patch.diffs) {
+            if (aDiff.operation != EQUAL) {
+                const int index2 = dmp.diff_xIndex(diffs, index1);
+                if (aDiff.operation == INSERT) {
+                    region.insert(qMin(index2, int(region.length())), aDiff.text);
+                } else if (aDiff.operation == DELETE) {
+                    const int deleteEnd = dmp.diff_xIndex(diffs, index1 + aDiff.text.length());
+                    region.remove(index2, qMax(0, deleteEnd - index2));
+                }
+            }
+            if (aDiff.operation != DELETE)
+                index1 += aDiff.text.length();
+        }
+    }
+
+    // Keep only the changed middle, so hunks whose context overlaps (as split
+    // hunks do) still describe disjoint ranges of the text
+    const int common = qMin(found.length(), region.length());
+    const int prefix = diff_simd::commonPrefix(utf16(found), utf16(region), common);
+    const int suffix = diff_simd::commonSuffix(utf16(found) + found.length(), utf16(region) + region.length(),
+                                               common - prefix);
+    placement.regionStart = startLoc + prefix;
+    placement.regionEnd = startLoc + found.length() - suffix;
+    placement.replacement = region.mid(prefix, region.length() - prefix - suffix);
+}
+
+Operation toOperation(DiffOperation operation)
+{
+    return operation == DiffOperation::Equal ? EQUAL
+           : operation == DiffOperation::Insert ? INSERT : DELETE;
+}
+
+QList<Patch> toDmpPatches(const QList<QDiffPatch> &patches)
+{
+    QList<Patch> converted;
+    converted.reserve(patches.size());
+    for (const QDiffPatch &patch : patches) {
+        Patch dmpPatch;
+        dmpPatch.start1 = patch.leftStart;
+        dmpPatch.start2 = patch.rightStart;
+        dmpPatch.length1 = patch.leftLength;
+        dmpPatch.length2 = patch.rightLength;
+        dmpPatch.diffs.reserve(patch.changes.size());
+        for (const DiffChange &change : patch.changes)
+            dmpPatch.diffs.append(Diff(toOperation(change.operation), change.text));
+        converted.append(dmpPatch);
+    }
+    return converted;
+}
+
+QList<QDiffPatch> fromDmpPatches(const QList<Patch> &patches)
+{
+    QList<QDiffPatch> converted;
+    converted.reserve(patches.size());
+    for (const Patch &dmpPatch : patches) {
+        QDiffPatch patch;
+        patch.leftStart = dmpPatch.start1;
+        patch.rightStart = dmpPatch.start2;
+        patch.leftLength = dmpPatch.length1;
+        patch.rightLength = dmpPatch.length2;
+        patch.changes.reserve(dmpPatch.diffs.size());
+        for (const Diff &diff : dmpPatch.diffs) {
+            const DiffOperation operation = diff.operation == EQUAL ? DiffOperation::Equal
+                                            : diff.operation == INSERT ? DiffOperation::Insert : DiffOperation::Delete;
+            patch.changes.append(DiffChange(operation, diff.text));
+        }
+        converted.append(patch);
+    }
+    return converted;
+}
+
+QList<Diff> toDiffs(const QString &leftText, const QList<DiffChange> &changes, bool lineSeparated, bool *ok)
+{
+    QList<Diff> diffs;
+    diffs.reserve(changes.size() * (lineSeparated ? 2 : 1));
+    const QStringView left(leftText);
+    int leftPos = 0;
+    bool leftHasLine = false;
+    bool rightHasLine = false;
+
+    // Checks that the left side of the diff reproduces leftText as it is walked
+    auto consumeLeft = [&](const QString &text) {
+        if (left.mid(leftPos, text.length()) != text)
+            return false;
+        leftPos += text.length();
+        return true;
+    };
+
+    for (const DiffChange &change : changes) {
+        const bool onLeft = change.operation != DiffOperation::Insert;
+        const bool onRight = change.operation == DiffOperation::Equal || change.operation == DiffOperation::Insert;
+        const Operation op = toOperation(change.operation);
+
+        if (lineSeparated) {
+            // A line that follows another line on its side is preceded by '\n'
+            const bool leftSeparator = onLeft && leftHasLine;
+            const bool rightSeparator = onRight && rightHasLine;
+            if (leftSeparator && !consumeLeft(QStringLiteral("\n"))) {
+                *ok = false;
+                return QList<Diff>();
+            }
+            if (leftSeparator && rightSeparator) {
+                diffs.append(Diff(EQUAL, QStringLiteral("\n")));
+            } else if (leftSeparator) {
+                diffs.append(Diff(DELETE, QStringLiteral("\n")));
+            } else if (rightSeparator) {
+                diffs.append(Diff(INSERT, QStringLiteral("\n")));
+            }
+            leftHasLine = leftHasLine || onLeft;
+            rightHasLine = rightHasLine || onRight;
+        }
+
+        if (onLeft && !consumeLeft(change.text)) {
+            *ok = false;
+            return QList<Diff>();
+        }
+        if (!change.text.isEmpty())
+            diffs.append(Diff(op, change.text));
+    }
+
+    *ok = leftPos == leftText.length();
+    return *ok ? diffs : QList<Diff>();
+}
+
+} // namespace
+
+struct QPatchEngine::PreparedPatches {
+    int patchCount = 0;
+    QString padding;
+    std::vector<Hunk> hunks;
+};
+
+QPatchEngine::QPatchEngine() {}
+
+// ----------------------- Patch construction -------------------------
+
+QList<QDiffPatch> QPatchEngine::makePatches(const QString &leftText, const QString &rightText) const
+{
+    diff_match_patch dmp;
+    return fromDmpPatches(dmp.patch_make(leftText, rightText));
+}
+
+QList<QDiffPatch> QPatchEngine::makePatches(const QString &leftText, const QDiffResult &diffResult, bool *ok) const
+{
+    // Line results of some engines (DTL) hold one line per change without its
+    // terminator; they flag this in their metadata
+    const bool lineSeparated = diffResult.metaData("line_separated").toBool();
+    bool converted = false;
+    QList<Diff> diffs = toDiffs(leftText, diffResult.changes(), lineSeparated, &converted);
+    if (ok)
+        *ok = converted;
+    if (!converted)
+        return QList<QDiffPatch>();
+
+    diff_match_patch dmp;
+    dmp.diff_cleanupMerge(diffs);
+    return fromDmpPatches(dmp.patch_make(leftText, diffs));
+}
+
+// ----------------------- Serialization -------------------------
+
+QString QPatchEngine::toText(const QList<QDiffPatch> &patches) const
+{
+    diff_match_patch dmp;
+    return dmp.patch_toText(toDmpPatches(patches));
+}
+
+QList<QDiffPatch> QPatchEngine::fromText(const QString &text, bool *ok) const
+{
+    diff_match_patch dmp;
+    try {
+        const QList<Patch> patches = dmp.patch_fromText(text);
+        if (ok)
+            *ok = true;
+        return fromDmpPatches(patches);
+    } catch (...) {
+        if (ok)
+            *ok = false;
+        return QList<QDiffPatch>();
+    }
+}
+
+// ----------------------- Application -------------------------
+
+QPatchResult QPatchEngine::apply(const QList<QDiffPatch> &patches, const QString &text) const
+{
+    return applyPrepared(prepare(patches), text, true);
+}
+
+QList<QPatchResult> QPatchEngine::apply(const QList<QDiffPatch> &patches, const QStringList &texts) const
+{
+    // Padding and splitting depend only on the patches, so do them once
+    const PreparedPatches prepared = prepare(patches);
+    // Texts are patched concurrently, the hunks of each one sequentially
+    return QtConcurrent::blockingMapped<QList<QPatchResult>>(texts, [this, &prepared](const QString &text) {
+        return applyPrepared(prepared, text, false);
+    });
+}
+
+QPatchEngine::PreparedPatches QPatchEngine::prepare(const QList<QDiffPatch> &patches) const
+{
+    PreparedPatches prepared;
+    prepared.patchCount = patches.size();
+    if (patches.isEmpty())
+        return prepared;
+
+    diff_match_patch dmp;
+    QList<Patch> padded = toDmpPatches(patches);
+    prepared.padding = dmp.patch_addPadding(padded);
+
+    // Split each patch on its own so every hunk knows which patch it reports to.
+    // patch_make gives start1 in the text with all earlier patches applied, so
+    // the growth of those patches is taken off to get the unmodified offset.
+    prepared.hunks.reserve(padded.size());
+    int growth = 0;
+    for (int i = 0; i < padded.size(); ++i) {
+        QList<Patch> pieces{padded[i]};
+        dmp.patch_splitMax(pieces);
+        for (const Patch &piece : std::as_const(pieces)) {
+            Hunk hunk;
+            hunk.patch = piece;
+            hunk.source = i;
+            hunk.expectedLoc = piece.start1 - growth;
+            hunk.text1 = dmp.diff_text1(piece.diffs);
+            hunk.text2 = dmp.diff_text2(piece.diffs);
+            prepared.hunks.push_back(std::move(hunk));
+        }
+        growth += padded[i].length2 - padded[i].length1;
+    }
+    return prepared;
+}
+
+QPatchResult QPatchEngine::applyPrepared(const PreparedPatches &prepared, const QString &text, bool parallel) const
+{
+    QPatchResult result;
+    if (prepared.patchCount == 0) {
+        result.text = text;
+        return result;
+    }
+
+    const QString paddedText = prepared.padding + text + prepared.padding;
+    const int hunkCount = int(prepared.hunks.size());
+    std::vector<Placement> placements(hunkCount);
+
+    // Hunks are located against the unmodified text at their unmodified offset,
+    // so they do not depend on each other and can be searched concurrently
+    auto locateRange = [&](const QPair<int, int> &range) {
+        diff_match_patch dmp;
+        for (int i = range.first; i < range.second; ++i) {
+            const Hunk &hunk = prepared.hunks[i];
+            locateHunk(dmp, paddedText, hunk, hunk.expectedLoc, placements[i]);
+        }
+    };
+    if (parallel && hunkCount >= PARALLEL_HUNK_THRESHOLD) {
+        const int chunkCount = qMin(hunkCount, 4 * qMax(1, QThread::idealThreadCount()));
+        QList<QPair<int, int>> ranges;
+        ranges.reserve(chunkCount);
+        for (int c = 0; c < chunkCount; ++c)
+            ranges.append(qMakePair(int(qint64(hunkCount) * c / chunkCount), int(qint64(hunkCount) * (c + 1) / chunkCount)));
+        QtConcurrent::blockingMap(ranges, locateRange);
+    } else {
+        locateRange(qMakePair(0, hunkCount));
+    }
+
+    // When the whole file has drifted, retry the misses shifted by the drift
+    // of the closest hunk found before them, as patch_apply's delta does
+    diff_match_patch dmp;
+    int delta = 0;
+    for (int i = 0; i < hunkCount; ++i) {
+        const Hunk &hunk = prepared.hunks[i];
+        if (placements[i].startLoc == -1 && delta != 0)
+            locateHunk(dmp, paddedText, hunk, hunk.expectedLoc + delta, placements[i]);
+        if (placements[i].startLoc != -1)
+            delta = placements[i].startLoc - hunk.expectedLoc;
+    }
+
+    // Order the edits through the text; an edit overlapping an earlier one is dropped
+    std::vector<int> order;
+    order.reserve(hunkCount);
+    for (int i = 0; i < hunkCount; ++i) {
+        if (placements[i].startLoc != -1)
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&placements](int a, int b) {
+        return placements[a].regionStart < placements[b].regionStart;
+    });
+
+    result.applied.fill(true, prepared.patchCount);
+    for (int i = 0; i < hunkCount; ++i) {
+        if (placements[i].startLoc == -1)
+            result.applied[prepared.hunks[i].source] = false;
+    }
+
+    qsizetype outputSize = paddedText.length() - 2 * prepared.padding.length();
+    int lastEnd = 0;
+    std::vector<int> accepted;
+    accepted.reserve(order.size());
+    for (int i : order) {
+        const Placement &placement = placements[i];
+        if (placement.regionStart < lastEnd) {
+            result.applied[prepared.hunks[i].source] = false;
+            continue;
+        }
+        accepted.push_back(i);
+        outputSize += placement.replacement.length() - (placement.regionEnd - placement.regionStart);
+        lastEnd = placement.regionEnd;
+    }
+
+    // Assemble the output in one pass, leaving out the padding
+    const QStringView source(paddedText);
+    const int lowerBound = prepared.padding.length();
+    const int upperBound = paddedText.length() - prepared.padding.length();
+    QString output;
+    output.reserve(qMax<qsizetype>(0, outputSize));
+    auto appendSource = [&](int from, int to) {
+        from = qMax(from, lowerBound);
+        to = qMin(to, upperBound);
+        if (from < to)
+            output.append(source.mid(from, to - from));
+    };
+    int cursor = 0;
+    for (int i : accepted) {
+        const Placement &placement = placements[i];
+        appendSource(cursor, placement.regionStart);
+        output.append(placement.replacement);
+        cursor = placement.regionEnd;
+    }
+    appendSource(cursor, paddedText.length());
+
+    result.text = output;
+    return result;
+}
+
+}//namespace QDiffX
@@ -0,0 +1,58 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include <QStringList>
+#include <QVector>
+
+namespace QDiffX{
+
+// One hunk of a patch in diff_match_patch's patch format; positions are offsets
+// into the texts, the changes include the context around the edit
+struct QDiffPatch {
+    QList<DiffChange> changes;
+    int leftStart = 0;
+    int rightStart = 0;
+    int leftLength = 0;
+    int rightLength = 0;
+};
+
+struct QPatchResult {
+    QString text;
+    QVector<bool> applied;      // One entry per patch, in input order
+
+    bool allApplied() const { return !applied.contains(false); }
+};
+
+// Builds and applies diff_match_patch patches. diff_match_patch stays out of
+// this header: its global Diff, Patch and DELETE would reach every user of
+// QAlgorithmManager.
+// Unlike diff_match_patch::patch_apply, every hunk is located against the
+// unmodified text (in parallel for large batches) and the patched text is
+// assembled in a single pass into a preallocated buffer.
+class QPatchEngine
+{
+public:
+    QPatchEngine();
+
+    // Patch construction
+    QList<QDiffPatch> makePatches(const QString &leftText, const QString &rightText) const;
+    QList<QDiffPatch> makePatches(const QString &leftText, const QDiffResult &diffResult, bool *ok = nullptr) const;
+
+    // Serialization (GNU diff like text format of diff_match_patch)
+    QString toText(const QList<QDiffPatch> &patches) const;
+    QList<QDiffPatch> fromText(const QString &text, bool *ok = nullptr) const;
+
+    // Application
+    QPatchResult apply(const QList<QDiffPatch> &patches, const QString &text) const;
+    QList<QPatchResult> apply(const QList<QDiffPatch> &patches, const QStringList &texts) const;
+
+    // Batches with at least this many hunks are located on the global thread pool
+    static constexpr int PARALLEL_HUNK_THRESHOLD = 32;
+
+private:
+    struct PreparedPatches;
+
+    PreparedPatches prepare(const QList<QDiffPatch> &patches) const;
+    QPatchResult applyPrepared(const PreparedPatches &prepared, const QString &text, bool parallel) const;
+};
+
+}//namespace QDiffX
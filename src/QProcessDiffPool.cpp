@@ -0,0 +1,343 @@
+#include "QProcessDiffPool.h"
+#include "QDiffDaemonProtocol.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QProcess>
+#include <QPromise>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_DARWIN)
+#include <libproc.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+namespace QDiffX{
+
+namespace {
+
+struct Job {
+    quint32 id;
+    QByteArray request;
+    std::shared_ptr<QPromise<QDiffResult>> promise;
+};
+
+struct Worker {
+    QProcess *process = nullptr;
+    std::optional<Job> job;
+    QElapsedTimer jobTimer;
+};
+
+QString defaultWorkerProgram()
+{
+    const QString program = QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("qdiffx-cli"));
+#if defined(Q_OS_WIN)
+    return QFile::exists(program + QStringLiteral(".exe")) ? program : QStringLiteral("qdiffx-cli");
+#else
+    return QFile::exists(program) ? program : QStringLiteral("qdiffx-cli");
+#endif
+}
+
+} // namespace
+
+// Owns the worker processes; lives on QProcessDiffPool::m_thread and is only
+// touched there, apart from the settings behind m_settingsMutex
+class QProcessDiffPool::Dispatcher : public QObject
+{
+public:
+    Dispatcher()
+        : m_program(defaultWorkerProgram()), m_arguments{QStringLiteral("--worker")}, m_watchdog(new QTimer(this))
+    {
+        m_watchdog->setInterval(WATCHDOG_INTERVAL_MS);
+        connect(m_watchdog, &QTimer::timeout, this, [this]() { watch(); });
+    }
+
+    void enqueue(Job job)
+    {
+        m_queue.push_back(std::move(job));
+        schedule();
+    }
+
+    void shutdown()
+    {
+        m_watchdog->stop();
+        for (Job &job : m_queue)
+            fail(job, QStringLiteral("Process pool shut down"));
+        m_queue.clear();
+        while (!m_workers.empty())
+            retire(m_workers.back().get(), QStringLiteral("Process pool shut down"));
+    }
+
+    mutable QMutex m_settingsMutex;
+    QString m_program;
+    QStringList m_arguments;
+    QProcessPoolLimits m_limits;
+
+private:
+    QProcessPoolLimits currentLimits() const
+    {
+        QMutexLocker locker(&m_settingsMutex);
+        QProcessPoolLimits limits = m_limits;
+        if (limits.maxWorkers <= 0)
+            limits.maxWorkers = qMax(1, QThread::idealThreadCount());
+        return limits;
+    }
+
+    void schedule()
+    {
+        const QProcessPoolLimits limits = currentLimits();
+        while (!m_queue.empty()) {
+            Worker *worker = nullptr;
+            for (const auto &candidate : m_workers) {
+                if (!candidate->job) {
+                    worker = candidate.get();
+                    break;
+                }
+            }
+            if (!worker) {
+                if (int(m_workers.size()) >= limits.maxWorkers)
+                    break;
+                worker = spawn();
+            }
+            worker->job = std::move(m_queue.front());
+            m_queue.pop_front();
+            worker->jobTimer.start();
+            QDiffDaemonProtocol::writeFrame(worker->process, worker->job->request);
+        }
+
+        const bool busy = std::any_of(m_workers.cbegin(), m_workers.cend(),
+                                      [](const auto &worker) { return worker->job.has_value(); });
+        if (busy && !m_watchdog->isActive())
+            m_watchdog->start();
+        else if (!busy)
+            m_watchdog->stop();
+    }
+
+    Worker *spawn()
+    {
+        auto worker = std::make_unique<Worker>();
+        worker->process = new QProcess(this);
+        Worker *raw = worker.get();
+        connect(raw->process, &QProcess::readyReadStandardOutput, this, [this, raw]() { onOutput(raw); });
+        connect(raw->process, &QProcess::finished, this, [this, raw]() {
+            retire(raw, QStringLiteral("Worker process exited unexpectedly"));
+            schedule();
+        });
+        QString program;
+        QStringList arguments;
+        {
+            QMutexLocker locker(&m_settingsMutex);
+            program = m_program;
+            arguments = m_arguments;
+        }
+        // Queued, since start() may report the failure before the worker has its job
+        connect(raw->process, &QProcess::errorOccurred, this, [this, raw, program](QProcess::ProcessError error) {
+            if (error != QProcess::FailedToStart)
+                return;
+            const QString reason = QStringLiteral("Cannot start worker process %1").arg(program);
+            retire(raw, reason);
+            // Queued jobs would only fail the same way on a fresh worker
+            for (Job &job : m_queue)
+                fail(job, reason);
+            m_queue.clear();
+            schedule();
+        }, Qt::QueuedConnection);
+        // Worker diagnostics go to our stderr
+        raw->process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        raw->process->start(program, arguments);
+        m_workers.push_back(std::move(worker));
+        return raw;
+    }
+
+    void onOutput(Worker *worker)
+    {
+        QByteArray payload;
+        bool error = false;
+        while (QDiffDaemonProtocol::readFrame(worker->process, &payload, &error)) {
+            QDataStream in(payload);
+            in.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+            quint8 type = 0;
+            quint32 id = 0;
+            bool cached = false;
+            QDiffResult result;
+            in >> type >> id >> cached >> result;
+            if (type != QDiffDaemonProtocol::Diff || !worker->job || worker->job->id != id) {
+                error = true;
+                break;
+            }
+            Job job = std::move(*worker->job);
+            worker->job.reset();
+            job.promise->addResult(result);
+            job.promise->finish();
+
+            // Allocators rarely hand memory back, so a bloated worker is replaced
+            const qint64 resident = residentBytes(worker->process->processId());
+            if (resident > currentLimits().memoryLimitBytes / 2) {
+                retire(worker, QString());
+                break;
+            }
+        }
+        if (error)
+            retire(worker, QStringLiteral("Malformed reply from worker process"));
+        schedule();
+    }
+
+    void watch()
+    {
+        const QProcessPoolLimits limits = currentLimits();
+        std::vector<std::pair<Worker *, QString>> victims;
+        for (const auto &worker : m_workers) {
+            if (!worker->job)
+                continue;
+            if (worker->jobTimer.elapsed() > limits.timeoutMs) {
+                victims.emplace_back(worker.get(), QStringLiteral("Diff timed out after %1 ms in worker process").arg(limits.timeoutMs));
+                continue;
+            }
+            const qint64 resident = residentBytes(worker->process->processId());
+            if (resident > limits.memoryLimitBytes) {
+                victims.emplace_back(worker.get(), QStringLiteral("Diff exceeded the worker memory limit of %1 MiB")
+                                                       .arg(limits.memoryLimitBytes / (1024 * 1024)));
+            }
+        }
+        for (const auto &victim : victims)
+            retire(victim.first, victim.second);
+        if (!victims.empty())
+            schedule();
+    }
+
+    // Kills the worker and fails its job, if any, with reason
+    void retire(Worker *worker, const QString &reason)
+    {
+        auto it = std::find_if(m_workers.begin(), m_workers.end(),
+                               [worker](const auto &candidate) { return candidate.get() == worker; });
+        if (it == m_workers.end())
+            return;
+        std::unique_ptr<Worker> owned = std::move(*it);
+        m_workers.erase(it);
+
+        if (owned->job)
+            fail(*owned->job, reason);
+        owned->process->disconnect(this);
+        owned->process->kill();
+        owned->process->waitForFinished(1000);
+        // May be inside one of the process's own signals
+        owned->process->deleteLater();
+    }
+
+    static void fail(Job &job, const QString &reason)
+    {
+        job.promise->addResult(QDiffResult(reason));
+        job.promise->finish();
+    }
+
+    std::deque<Job> m_queue;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    QTimer *m_watchdog;
+};
+
+// ----------------------- QProcessDiffPool -------------------------
+
+QProcessDiffPool::QProcessDiffPool(QObject *parent)
+    : QObject(parent), m_dispatcher(new Dispatcher)
+{
+    m_dispatcher->moveToThread(&m_thread);
+    m_thread.setObjectName(QStringLiteral("QProcessDiffPool"));
+    m_thread.start();
+}
+
+QProcessDiffPool::~QProcessDiffPool()
+{
+    QMetaObject::invokeMethod(m_dispatcher, [this]() { m_dispatcher->shutdown(); }, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+    delete m_dispatcher;
+}
+
+void QProcessDiffPool::setWorkerProgram(const QString &program, const QStringList &arguments)
+{
+    QMutexLocker locker(&m_dispatcher->m_settingsMutex);
+    m_dispatcher->m_program = program;
+    m_dispatcher->m_arguments = arguments;
+}
+
+QString QProcessDiffPool::workerProgram() const
+{
+    QMutexLocker locker(&m_dispatcher->m_settingsMutex);
+    return m_dispatcher->m_program;
+}
+
+void QProcessDiffPool::setLimits(const QProcessPoolLimits &limits)
+{
+    QMutexLocker locker(&m_dispatcher->m_settingsMutex);
+    m_dispatcher->m_limits = limits;
+}
+
+QProcessPoolLimits QProcessDiffPool::limits() const
+{
+    QMutexLocker locker(&m_dispatcher->m_settingsMutex);
+    return m_dispatcher->m_limits;
+}
+
+QFuture<QDiffResult> QProcessDiffPool::submit(const QString &algorithmId, DiffMode mode, const QString &leftText, const QString &rightText)
+{
+    static std::atomic<quint32> nextId{1};
+    Job job;
+    job.id = nextId++;
+    job.promise = std::make_shared<QPromise<QDiffResult>>();
+    job.promise->start();
+
+    // Serialized here, so the dispatcher thread only moves bytes
+    QDataStream out(&job.request, QIODevice::WriteOnly);
+    out.setVersion(QDiffDaemonProtocol::STREAM_VERSION);
+    out << quint8(QDiffDaemonProtocol::Diff) << job.id << algorithmId << quint8(mode) << leftText << rightText;
+
+    QFuture<QDiffResult> future = job.promise->future();
+    Dispatcher *dispatcher = m_dispatcher;
+    QMetaObject::invokeMethod(dispatcher, [dispatcher, job]() { dispatcher->enqueue(job); }, Qt::QueuedConnection);
+    return future;
+}
+
+qint64 QProcessDiffPool::residentBytes(qint64 pid)
+{
+    if (pid <= 0)
+        return -1;
+#if defined(Q_OS_WIN)
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, FALSE, DWORD(pid));
+    if (!process)
+        return -1;
+    PROCESS_MEMORY_COUNTERS counters;
+    const bool ok = GetProcessMemoryInfo(process, &counters, sizeof(counters));
+    CloseHandle(process);
+    return ok ? qint64(counters.WorkingSetSize) : -1;
+#elif defined(Q_OS_DARWIN)
+    struct proc_taskinfo info;
+    if (proc_pidinfo(int(pid), PROC_PIDTASKINFO, 0, &info, sizeof(info)) != int(sizeof(info)))
+        return -1;
+    return qint64(info.pti_resident_size);
+#elif defined(Q_OS_LINUX)
+    // statm: total and resident size, in pages
+    QFile statm(QStringLiteral("/proc/%1/statm").arg(pid));
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+}//namespace QDiffX
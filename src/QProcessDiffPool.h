@@ -0,0 +1,50 @@
+#pragma once
+#include "QDiffAlgorithm.h"
+#include <QFuture>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+
+namespace QDiffX{
+
+struct QProcessPoolLimits {
+    int maxWorkers = 0;                                     // 0 uses QThread::idealThreadCount()
+    qint64 memoryLimitBytes = 2LL * 1024 * 1024 * 1024;     // Resident set of a worker running a job
+    int timeoutMs = 60000;                                  // Wall time of one job
+};
+
+// Runs diffs in worker processes (qdiffx-cli --worker by default), so a job that
+// exhausts memory or crashes takes only its worker down, never the calling process.
+// Workers are spawned on demand up to maxWorkers and kept for later jobs; they
+// speak QDiffDaemonProtocol over their stdin and stdout. A watchdog samples the
+// resident set and wall time of every busy worker and kills it past the limits,
+// failing its job with an error result. Workers still above half the memory
+// limit after a job are replaced. The processes live on an internal thread and
+// submit() may be called from any thread.
+class QProcessDiffPool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QProcessDiffPool(QObject *parent = nullptr);
+    ~QProcessDiffPool();
+
+    void setWorkerProgram(const QString &program, const QStringList &arguments = QStringList{QStringLiteral("--worker")});
+    QString workerProgram() const;
+    void setLimits(const QProcessPoolLimits &limits);
+    QProcessPoolLimits limits() const;
+
+    QFuture<QDiffResult> submit(const QString &algorithmId, DiffMode mode, const QString &leftText, const QString &rightText);
+
+    // Resident set size of a running process, -1 where the platform does not tell
+    static qint64 residentBytes(qint64 pid);
+
+    static constexpr int WATCHDOG_INTERVAL_MS = 50;
+
+private:
+    class Dispatcher;
+
+    QThread m_thread;
+    Dispatcher *m_dispatcher;
+};
+
+}//namespace QDiffX
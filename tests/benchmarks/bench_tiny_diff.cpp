@@ -0,0 +1,103 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+#include "../src/DTLAlgorithm.h"
+#include "../src/QAlgorithmManager.h"
+#include "../src/QDiffProfiler.h"
+
+// Per-call cost of diffs of a few hundred bytes, the size a validation service
+// sends by the million. The engine alone is the floor; what the manager adds on
+// top of it is the overhead the fast path keeps under OVERHEAD_TARGET_US.
+class Bench_TinyDiff : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void benchmarkEngineOnly();
+    void benchmarkFastPath();
+    void benchmarkFullPath();
+    void testOverheadTarget();
+
+private:
+    qint64 nanosecondsPerCall(const std::function<void()> &call) const;
+
+    QString m_left;
+    QString m_right;
+
+    static constexpr int CALLS = 20000;
+    static constexpr double OVERHEAD_TARGET_US = 5.0;
+};
+
+void Bench_TinyDiff::initTestCase() {
+    for (int i = 0; i < 12; ++i) {
+        m_left += QStringLiteral("field_%1 = value_%1\n").arg(i);
+        m_right += QStringLiteral("field_%1 = value_%2\n").arg(i).arg(i % 5 == 0 ? i + 1 : i);
+    }
+    QVERIFY(m_left.size() + m_right.size() <= QDiffX::QAlgorithmManager::DEFAULT_TINY_DIFF_THRESHOLD);
+}
+
+void Bench_TinyDiff::benchmarkEngineOnly() {
+    QDiffX::DTLAlgorithm engine;
+    QDiffX::QDiffProfiler::Suspend suspend;
+    QBENCHMARK {
+        engine.calculateDiff(m_left, m_right, QDiffX::DiffMode::LineByLine);
+    }
+}
+
+void Bench_TinyDiff::benchmarkFastPath() {
+    QDiffX::QAlgorithmManager manager;
+    QBENCHMARK {
+        manager.calculateDiffSync(m_left, m_right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    }
+}
+
+void Bench_TinyDiff::benchmarkFullPath() {
+    QDiffX::QAlgorithmManager manager;
+    manager.setTinyDiffThreshold(0);
+    QBENCHMARK {
+        manager.calculateDiffSync(m_left, m_right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    }
+}
+
+void Bench_TinyDiff::testOverheadTarget() {
+    QDiffX::DTLAlgorithm engine;
+    QDiffX::QAlgorithmManager fastManager;
+    QDiffX::QAlgorithmManager fullManager;
+    fullManager.setTinyDiffThreshold(0);
+
+    const qint64 engineNs = nanosecondsPerCall([&]() {
+        QDiffX::QDiffProfiler::Suspend suspend;
+        engine.calculateDiff(m_left, m_right, QDiffX::DiffMode::LineByLine);
+    });
+    const qint64 fastNs = nanosecondsPerCall([&]() {
+        fastManager.calculateDiffSync(m_left, m_right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    });
+    const qint64 fullNs = nanosecondsPerCall([&]() {
+        fullManager.calculateDiffSync(m_left, m_right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    });
+
+    const double fastOverheadUs = double(fastNs - engineNs) / 1000.0;
+    const double fullOverheadUs = double(fullNs - engineNs) / 1000.0;
+    qInfo("engine %.2f us/call, overhead: fast path %.2f us, full path %.2f us (target %.1f us)",
+          engineNs / 1000.0, fastOverheadUs, fullOverheadUs, OVERHEAD_TARGET_US);
+#ifdef QT_NO_DEBUG
+    QVERIFY2(fastOverheadUs < OVERHEAD_TARGET_US, "Fast path overhead is over its target");
+#else
+    QSKIP("Overhead target is only checked in release builds");
+#endif
+}
+
+qint64 Bench_TinyDiff::nanosecondsPerCall(const std::function<void()> &call) const {
+    // Warm up the instance pool and the caches first
+    for (int i = 0; i < CALLS / 10; ++i)
+        call();
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < CALLS; ++i)
+        call();
+    return timer.nsecsElapsed() / CALLS;
+}
+
+QTEST_APPLESS_MAIN(Bench_TinyDiff)
+#include "bench_tiny_diff.moc"
@@ -3,6 +3,8 @@
 #include "../src/QAlgorithmManager.h"
 #include "../src/QAlgorithmRegistry.h"
 #include "../src/DMPAlgorithm.h"
+#include "../src/DTLAlgorithm.h"
+#include "../src/DMP/diff_match_patch.h"
 
 class Tst_QAlgorithmManager : public QObject
 {
@@ -23,6 +25,8 @@ private slots:
     void testSetAndGetAlgorithmConfiguration();
     void testGetAlgorithmConfigurationKeys();
     void testErrorHandling_Registry();
+    void testRegistryConcurrentReads();
+    void testAlgorithmPooling();
     void testCalculateDiffSync_AutoSelection_data();
     void testCalculateDiffSync_AutoSelection();
     void testCalculateDiffSync_ManualSelection();
@@ -37,6 +41,11 @@ private slots:
     void testResetManager();
     void testErrorHandling_Manager();
     void testSignals();
+    void testFuzzyLocate();
+    void testPatches();
+    void testThreeWayMerge();
+    void testBatchDiff();
+    void testProcessDiffPool();
 };
 
 void Tst_QAlgorithmManager::initTestCase() {}
@@ -182,6 +191,85 @@ void Tst_QAlgorithmManager::testErrorHandling_Registry() {
     registry.setErrorOutputEnabled(false);
 }
 
+void Tst_QAlgorithmManager::testRegistryConcurrentReads() {
+    QDiffX::QAlgorithmRegistry& registry = QDiffX::QAlgorithmRegistry::get_Instance();
+    registry.clear();
+    std::atomic_int failures{0};
+    std::vector<std::unique_ptr<QThread>> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back(QThread::create([&registry, &failures]() {
+            for (int j = 0; j < 2000; ++j) {
+                if (!registry.isAlgorithmAvailable("dmp") || !registry.createAlgorithm("dtl")
+                    || registry.lastError() != QDiffX::QAlgorithmRegistryError::None)
+                    ++failures;
+                registry.isAlgorithmAvailable("Churn");
+            }
+        }));
+        readers.back()->start();
+    }
+    // Writers publish new snapshots while the readers run
+    for (int i = 0; i < 200; ++i) {
+        QVERIFY(registry.registerAlgorithm<QDiffX::DMPAlgorithm>("Churn"));
+        QVERIFY(registry.unregisterAlgorithm("Churn"));
+    }
+    for (const auto &reader : readers)
+        QVERIFY(reader->wait(30000));
+    QCOMPARE(failures.load(), 0);
+    QVERIFY(!registry.isAlgorithmAvailable("Churn"));
+
+    // Errors are reported to the calling thread only
+    registry.createAlgorithm("NonExistent");
+    QCOMPARE(registry.lastError(), QDiffX::QAlgorithmRegistryError::AlgorithmNotFound);
+    QDiffX::QAlgorithmRegistryError otherThreadError = QDiffX::QAlgorithmRegistryError::AlgorithmNotFound;
+    std::unique_ptr<QThread> other(QThread::create([&registry, &otherThreadError]() { otherThreadError = registry.lastError(); }));
+    other->start();
+    QVERIFY(other->wait(30000));
+    QCOMPARE(otherThreadError, QDiffX::QAlgorithmRegistryError::None);
+    registry.clear();
+}
+
+void Tst_QAlgorithmManager::testAlgorithmPooling() {
+    QDiffX::QAlgorithmRegistry& registry = QDiffX::QAlgorithmRegistry::get_Instance();
+    registry.clear();
+    registry.setPoolCapacity(1);
+    const QDiffX::QAlgorithmPoolStatistics before = registry.poolStatistics();
+
+    QDiffX::QDiffAlgorithm *first = nullptr;
+    {
+        QDiffX::QPooledAlgorithm algorithm = registry.checkoutAlgorithm("dmp");
+        QVERIFY(algorithm);
+        first = algorithm.get();
+    }
+    {
+        // Returned to this thread's pool and handed out again
+        QDiffX::QPooledAlgorithm algorithm = registry.checkoutAlgorithm("dmp");
+        QCOMPARE(algorithm.get(), first);
+        // Over capacity, one of the two is dropped on return
+        QDiffX::QPooledAlgorithm extra = registry.checkoutAlgorithm("dmp");
+        QVERIFY(extra && extra.get() != first);
+    }
+
+    QMap<QString, QVariant> config = registry.getAlgorithmConfiguration("dmp");
+    config["timeout"] = 3.0;
+    QVERIFY(registry.setAlgorithmConfiguration("dmp", config));
+    {
+        QDiffX::QPooledAlgorithm algorithm = registry.checkoutAlgorithm("dmp");
+        QVERIFY(algorithm);
+        QCOMPARE(algorithm->getConfiguration().value("timeout").toDouble(), 3.0);
+    }
+
+    QVERIFY(!registry.checkoutAlgorithm("NonExistent"));
+    QCOMPARE(registry.lastError(), QDiffX::QAlgorithmRegistryError::AlgorithmNotFound);
+
+    const QDiffX::QAlgorithmPoolStatistics after = registry.poolStatistics();
+    QCOMPARE(after.checkouts - before.checkouts, 4);
+    QCOMPARE(after.hits - before.hits, 1);
+    QCOMPARE(after.invalidated - before.invalidated, 1);
+
+    registry.setPoolCapacity(QDiffX::QAlgorithmRegistry::DEFAULT_POOL_CAPACITY);
+    registry.clear();
+}
+
 void Tst_QAlgorithmManager::testCalculateDiffSync_AutoSelection_data() {
     QTest::addColumn<QString>("left");
     QTest::addColumn<QString>("right");
@@ -376,5 +464,237 @@ void Tst_QAlgorithmManager::testSignals() {
     QCOMPARE(freshManagerResetSpy.count(), 1);
 }
 
+void Tst_QAlgorithmManager::testFuzzyLocate() {
+    QDiffX::QAlgorithmManager manager;
+    QString block;
+    for (int i = 0; i < 12; ++i) block += QString("line %1 of the relocated hunk\n").arg(i);
+    QString drifted = block;
+    drifted.replace("line 5", "line five");
+    const QString text = QString("header\n").repeated(300) + drifted + QString("footer\n").repeated(300);
+    const int actual = 300 * 7;
+    QCOMPARE(manager.fuzzyLocate(text, block, actual - 40), actual);
+    QCOMPARE(manager.fuzzyLocate(text, QString("unrelated content ").repeated(20), actual), -1);
+
+    const QList<QDiffX::QFuzzyMatch> matches = manager.fuzzyFindAll(text + drifted, block, 10);
+    QCOMPARE(matches.size(), 2);
+    QCOMPARE(matches[0].position, actual);
+    QCOMPARE(matches[1].position, int(text.length()));
+    QVERIFY(matches[0].errors > 0 && matches[0].errors <= 10);
+}
+
+void Tst_QAlgorithmManager::testPatches() {
+    QDiffX::QAlgorithmManager manager;
+    QString left, right;
+    for (int i = 0; i < 1000; ++i) {
+        left += QString("key%1 = value%1\n").arg(i);
+        right += QString(i % 5 == 0 ? "key%1 = VALUE%1\n" : "key%1 = value%1\n").arg(i);
+    }
+
+    // Enough hunks to be located in parallel
+    const QList<QDiffX::QDiffPatch> patches = manager.makePatches(left, right);
+    QVERIFY(patches.size() >= QDiffX::QPatchEngine::PARALLEL_HUNK_THRESHOLD);
+    QDiffX::QPatchResult applied = manager.applyPatches(patches, left);
+    QVERIFY(applied.allApplied());
+    QCOMPARE(applied.text, right);
+
+    // Hunks still land when the target has drifted
+    const QString header("# generated header\n");
+    applied = manager.applyPatches(patches, header + left);
+    QVERIFY(applied.allApplied());
+    QCOMPARE(applied.text, header + right);
+
+    const QList<QDiffX::QPatchResult> batch = manager.applyPatches(patches, QStringList{left, header + left});
+    QCOMPARE(batch.size(), 2);
+    QCOMPARE(batch[0].text, right);
+    QCOMPARE(batch[1].text, header + right);
+
+    // Round trip through the text format
+    const QList<QDiffX::QDiffPatch> parsed = manager.patchesFromText(manager.patchesToText(patches));
+    QCOMPARE(parsed.size(), patches.size());
+    QCOMPARE(manager.applyPatches(parsed, left).text, right);
+
+    // Line results without terminators (DTL)
+    const QString lineLeft("alpha\nbeta\ngamma\n");
+    const QString lineRight("alpha\nBETA\ngamma\ndelta");
+    QDiffX::DTLAlgorithm dtl;
+    const QList<QDiffX::QDiffPatch> linePatches = manager.makePatches(lineLeft, dtl.calculateDiff(lineLeft, lineRight, QDiffX::DiffMode::LineByLine));
+    QCOMPARE(manager.lastError(), QDiffX::QAlgorithmManagerError::None);
+    QCOMPARE(manager.applyPatches(linePatches, lineLeft).text, lineRight);
+
+    // Hunks that change the length of repeated text shift every later hunk;
+    // the result must be the one patch_apply gives, serial and in parallel
+    for (int lineCount : {40, 1000}) {
+        QString repeatedLeft, repeatedRight;
+        for (int i = 0; i < lineCount; ++i) {
+            repeatedLeft += "same line\n";
+            if (i % 9 == 2)
+                repeatedRight += "same line\ninserted line that is much longer than the others\n";
+            else if (i % 9 == 5)
+                continue;
+            else if (i % 9 == 7)
+                repeatedRight += "short\n";
+            else
+                repeatedRight += "same line\n";
+        }
+        diff_match_patch dmp;
+        const QString expected = dmp.patch_apply(dmp.patch_make(repeatedLeft, repeatedRight), repeatedLeft).first;
+        QCOMPARE(expected, repeatedRight);
+
+        const QList<QDiffX::QDiffPatch> repeatedPatches = manager.makePatches(repeatedLeft, repeatedRight);
+        QVERIFY(repeatedPatches.size() > 1);
+        applied = manager.applyPatches(repeatedPatches, repeatedLeft);
+        QVERIFY(applied.allApplied());
+        QCOMPARE(applied.text, expected);
+    }
+
+    QVERIFY(manager.patchesFromText("not a patch").isEmpty());
+    QCOMPARE(manager.lastError(), QDiffX::QAlgorithmManagerError::InvalidPatch);
+}
+
+void Tst_QAlgorithmManager::testThreeWayMerge() {
+    QDiffX::QAlgorithmManager manager;
+    const QString base("a\nb\nc\nd\ne\n");
+
+    // Non-overlapping edits merge cleanly
+    QDiffX::QMergeResult merged = manager.calculateMerge(base, "a\nB\nc\nd\ne\n", "a\nb\nc\nD\ne\nf\n");
+    QVERIFY(merged.success());
+    QVERIFY(!merged.hasConflicts());
+    QCOMPARE(merged.mergedText(), QString("a\nB\nc\nD\ne\nf\n"));
+
+    // The same edit on both sides is not a conflict
+    merged = manager.calculateMerge(base, "a\nb\nX\nd\ne\n", "a\nb\nX\nd\ne\n");
+    QVERIFY(!merged.hasConflicts());
+    QCOMPARE(merged.mergedText(), QString("a\nb\nX\nd\ne\n"));
+
+    // Different edits of the same line conflict
+    merged = manager.calculateMerge(base, "a\nb\nOURS\nd\ne\n", "a\nb\nTHEIRS\nd\ne");
+    QCOMPARE(merged.conflictCount(), 1);
+    QCOMPARE(merged.mergedText("mine", "yours"),
+             QString("a\nb\n<<<<<<< mine\nOURS\n=======\nTHEIRS\n>>>>>>> yours\nd\ne"));
+    int conflicts = 0;
+    for (const QDiffX::QMergeRegion &region : merged.regions()) {
+        if (region.type != QDiffX::QMergeRegionType::Conflict)
+            continue;
+        ++conflicts;
+        QCOMPARE(merged.line(QDiffX::QMergeSide::Base, region.baseStart), QStringView(u"c\n"));
+        QCOMPARE(merged.line(QDiffX::QMergeSide::Theirs, region.theirsStart), QStringView(u"THEIRS\n"));
+    }
+    QCOMPARE(conflicts, 1);
+
+    // Empty inputs
+    merged = manager.calculateMerge(QString(), "x\n", QString());
+    QVERIFY(merged.success());
+    QCOMPARE(merged.mergedText(), QString("x\n"));
+}
+
+void Tst_QAlgorithmManager::testBatchDiff() {
+    QDiffX::QAlgorithmManager manager;
+    QList<QDiffX::QDiffPair> pairs;
+    for (int i = 0; i < 40; ++i) {
+        QString left, right;
+        for (int line = 0; line < 10 * (i + 1); ++line) {
+            left += QString("pair %1 line %2\n").arg(i).arg(line);
+            right += QString(line % 7 == 0 ? "pair %1 LINE %2\n" : "pair %1 line %2\n").arg(i).arg(line);
+        }
+        pairs.append({left, right});
+    }
+
+    QFuture<QDiffX::QDiffResult> future = manager.calculateBatchDiff(pairs, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    future.waitForFinished();
+    const QList<QDiffX::QDiffResult> results = future.results();
+    QCOMPARE(results.size(), pairs.size());
+    for (int i = 0; i < pairs.size(); ++i) {
+        const QDiffX::QDiffResult expected = manager.calculateDiffWithAlgorithm("dtl", pairs[i].leftText, pairs[i].rightText);
+        QCOMPARE(results[i].changes().size(), expected.changes().size());
+    }
+
+    // A pair above the split threshold is diffed in parts and stitched back together
+    QString left, right;
+    for (int line = 0; line < 40000; ++line) {
+        left += QString("unique line %1 of the large pair\n").arg(line);
+        right += QString(line % 100 == 0 ? "changed line %1 of the large pair\n" : "unique line %1 of the large pair\n").arg(line);
+    }
+    QVERIFY(left.length() + right.length() >= QDiffX::QBatchDiffEngine::SPLIT_COST_THRESHOLD);
+
+    QDiffX::QBatchDiffEngine engine;
+    auto stats = std::make_shared<QDiffX::QBatchDiffStats>();
+    QFuture<QDiffX::QDiffResult> split = engine.run({{left, right, "dtl"}, {"a\nb", "a\nc", "dtl"}},
+                                                    QDiffX::DiffMode::LineByLine, stats, 4);
+    split.waitForFinished();
+    QCOMPARE(split.resultCount(), 2);
+    QCOMPARE(stats->pairCount, 2);
+    QCOMPARE(stats->splitPairCount, 1);
+    QVERIFY(stats->taskCount > 2);
+
+    const QDiffX::QDiffResult stitched = split.resultAt(0);
+    QVERIFY(stitched.success());
+    QVERIFY(stitched.metaData("split_parts").toInt() > 1);
+    QStringList leftLines, rightLines;
+    int deleted = 0;
+    for (int i = 0; i < stitched.changes().size(); ++i) {
+        const QDiffX::DiffChange &change = stitched.changes()[i];
+        QCOMPARE(change.lineNumber, i + 1);
+        if (change.operation != QDiffX::DiffOperation::Insert)
+            leftLines.append(change.text);
+        if (change.operation != QDiffX::DiffOperation::Delete)
+            rightLines.append(change.text);
+        if (change.operation == QDiffX::DiffOperation::Delete)
+            ++deleted;
+    }
+    QCOMPARE(leftLines.join('\n'), left);
+    QCOMPARE(rightLines.join('\n'), right);
+    QCOMPARE(deleted, 400);
+}
+
+void Tst_QAlgorithmManager::testProcessDiffPool() {
+#if defined(Q_OS_LINUX) || defined(Q_OS_WIN) || defined(Q_OS_DARWIN)
+    QVERIFY(QDiffX::QProcessDiffPool::residentBytes(QCoreApplication::applicationPid()) > 0);
+#endif
+
+    // A worker that cannot start fails its job instead of hanging it
+    QDiffX::QProcessDiffPool pool;
+    pool.setWorkerProgram("/nonexistent/qdiffx-cli");
+    QFuture<QDiffX::QDiffResult> future = pool.submit("dtl", QDiffX::DiffMode::LineByLine, "a\nb\n", "a\nc\n");
+    future.waitForFinished();
+    QVERIFY(!future.result().success());
+    QVERIFY(future.result().errorMessage().contains("Cannot start worker process"));
+
+#ifdef QDIFFX_CLI_PATH
+    // A round trip through a real worker gives the same diff as running in process
+    const QString left("alpha\nbeta\ngamma\ndelta\n");
+    const QString right("alpha\nBETA\ngamma\ndelta\nepsilon\n");
+    QDiffX::QProcessDiffPool workerPool;
+    workerPool.setWorkerProgram(QStringLiteral(QDIFFX_CLI_PATH));
+    for (int round = 0; round < 2; ++round) {
+        // The second job goes to the worker kept from the first
+        future = workerPool.submit("dtl", QDiffX::DiffMode::LineByLine, left, right);
+        future.waitForFinished();
+        const QDiffX::QDiffResult remote = future.result();
+        QVERIFY2(remote.success(), qPrintable(remote.errorMessage()));
+
+        const QDiffX::QDiffResult local = QDiffX::DTLAlgorithm().calculateDiff(left, right, QDiffX::DiffMode::LineByLine);
+        QCOMPARE(remote.changes().size(), local.changes().size());
+        for (int i = 0; i < local.changes().size(); ++i) {
+            QCOMPARE(remote.changes()[i].operation, local.changes()[i].operation);
+            QCOMPARE(remote.changes()[i].text, local.changes()[i].text);
+        }
+    }
+
+    // Side-by-side diffs run in the worker too and are split on return
+    QDiffX::QAlgorithmManager manager;
+    manager.processPool()->setWorkerProgram(QStringLiteral(QDIFFX_CLI_PATH));
+    QFuture<QDiffX::QSideBySideDiffResult> sideBySide = manager.calculateSideBySideDiff(left, right, QDiffX::QExecutionMode::OutOfProcess,
+                                                                                       QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    sideBySide.waitForFinished();
+    QVERIFY2(sideBySide.result().success(), qPrintable(sideBySide.result().leftSide.errorMessage()));
+    QCOMPARE(sideBySide.result().algorithmUsed, QString("dtl"));
+    const QDiffX::QSideBySideDiffResult localSides = manager.calculateSideBySideDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QCOMPARE(sideBySide.result().leftSide.changes().size(), localSides.leftSide.changes().size());
+    QCOMPARE(sideBySide.result().rightSide.changes().size(), localSides.rightSide.changes().size());
+    QVERIFY(sideBySide.result().leftSide.hunkIndex());
+    QCOMPARE(sideBySide.result().leftSide.hunkIndex()->hunkCount(), localSides.leftSide.hunkIndex()->hunkCount());
+#endif
+}
+
 QTEST_APPLESS_MAIN(Tst_QAlgorithmManager)
 #include "tst_algorithm_manager.moc"
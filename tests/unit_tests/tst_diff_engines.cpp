@@ -0,0 +1,710 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSemaphore>
+#include <QTemporaryDir>
+#include <algorithm>
+#include "../src/DMP/diff_match_patch.h"
+#include "../src/DMP/diff_bitap.h"
+#include "../src/DMP/diff_simd.h"
+#include "../src/LCS/bit_parallel_lcs.h"
+#include "../src/LCSAlgorithm.h"
+#include "../src/DMPAlgorithm.h"
+#include "../src/DTLAlgorithm.h"
+#include "../src/QAlgorithmManager.h"
+#include "../src/QAlgorithmRegistry.h"
+#include "../src/QDirectoryCompare.h"
+#include "../src/QDiffTrace.h"
+#include "../src/QDiffChangeHistogram.h"
+#include "../src/QDiffHunkIndex.h"
+#include "../cli/QDiffCliWriter.h"
+#include <thread>
+
+class Tst_DiffEngines : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testSimdCommonPrefix();
+    void testSimdCommonSuffix();
+    void testDiffMainNearIdentical();
+    void testBitParallelLcsMatchesReference();
+    void testLCSAlgorithmCharByChar();
+    void testLCSAlgorithmRegistered();
+    void testBitapLongPattern();
+    void testDirectoryCompare();
+    void testMemoryBudgetDegrades();
+    void testRacingSelection();
+    void testPhaseMetadata();
+    void testChromeTraceExport();
+    void testTinyDiffFastPath();
+    void testTaskPoolPriorities();
+    void testChangeHistogram();
+    void testHunkIndex();
+    void testCliUnifiedWriter();
+};
+
+static const char16_t *units(const QString &text)
+{
+    return reinterpret_cast<const char16_t *>(text.constData());
+}
+
+void Tst_DiffEngines::testSimdCommonPrefix() {
+    QRandomGenerator rng(26);
+    for (int round = 0; round < 2000; ++round) {
+        const int length = rng.bounded(200);
+        QString left;
+        for (int i = 0; i < length; ++i) left.append(QChar(0x4E00 + rng.bounded(3)));
+        QString right = left;
+        const int mismatch = rng.bounded(length + 1);
+        if (mismatch < length) right[mismatch] = QChar(0x0041);
+        int expected = 0;
+        while (expected < length && left[expected] == right[expected]) ++expected;
+        QCOMPARE(diff_simd::commonPrefix(units(left), units(right), length), expected);
+    }
+    QVERIFY(QString::fromLatin1(diff_simd::activeKernel()).size() > 0);
+}
+
+void Tst_DiffEngines::testSimdCommonSuffix() {
+    QRandomGenerator rng(27);
+    for (int round = 0; round < 2000; ++round) {
+        const int length = rng.bounded(200);
+        QString left;
+        for (int i = 0; i < length; ++i) left.append(QChar(0x0061 + rng.bounded(3)));
+        QString right = left;
+        const int mismatch = rng.bounded(length + 1);
+        if (mismatch < length) right[mismatch] = QChar(0x00E9);
+        int expected = 0;
+        while (expected < length && left[length - 1 - expected] == right[length - 1 - expected]) ++expected;
+        QCOMPARE(diff_simd::commonSuffix(units(left) + length, units(right) + length, length), expected);
+    }
+}
+
+void Tst_DiffEngines::testDiffMainNearIdentical() {
+    QString left;
+    for (int i = 0; i < 5000; ++i) left += QStringLiteral("line %1 of the file\n").arg(i);
+    QString right = left;
+    right.replace(QStringLiteral("line 2500 "), QStringLiteral("LINE 2500 "));
+    diff_match_patch dmp;
+    QList<Diff> diffs = dmp.diff_main(left, right, false);
+    QCOMPARE(dmp.diff_text1(diffs), left);
+    QCOMPARE(dmp.diff_text2(diffs), right);
+    QVERIFY(dmp.diff_levenshtein(diffs) <= 8);
+}
+
+static int referenceLcs(const QString &left, const QString &right)
+{
+    QVector<int> previous(right.size() + 1, 0), current(right.size() + 1, 0);
+    for (int i = 1; i <= left.size(); ++i) {
+        for (int j = 1; j <= right.size(); ++j)
+            current[j] = left[i - 1] == right[j - 1] ? previous[j - 1] + 1 : qMax(previous[j], current[j - 1]);
+        std::swap(previous, current);
+    }
+    return previous[right.size()];
+}
+
+void Tst_DiffEngines::testBitParallelLcsMatchesReference() {
+    QRandomGenerator rng(270);
+    for (int round = 0; round < 300; ++round) {
+        QString left, right;
+        const int alphabet = 1 + rng.bounded(4);
+        const int leftLength = rng.bounded(150), rightLength = rng.bounded(150);
+        for (int i = 0; i < leftLength; ++i) left.append(QChar('a' + rng.bounded(alphabet)));
+        for (int i = 0; i < rightLength; ++i) right.append(QChar('a' + rng.bounded(alphabet)));
+
+        const auto edits = bit_lcs::diff(units(left), leftLength, units(right), rightLength);
+        int leftPos = 0, rightPos = 0, common = 0;
+        for (const auto &edit : edits) {
+            QVERIFY(edit.length > 0);
+            if (edit.op == bit_lcs::EditOp::Equal) {
+                QCOMPARE(left.mid(leftPos, edit.length), right.mid(rightPos, edit.length));
+                leftPos += edit.length;
+                rightPos += edit.length;
+                common += edit.length;
+            } else if (edit.op == bit_lcs::EditOp::Delete) {
+                leftPos += edit.length;
+            } else {
+                rightPos += edit.length;
+            }
+        }
+        QCOMPARE(leftPos, leftLength);
+        QCOMPARE(rightPos, rightLength);
+        const int expected = referenceLcs(left, right);
+        QCOMPARE(common, expected);
+        QCOMPARE(bit_lcs::lcsLength(units(left), leftLength, units(right), rightLength), expected);
+    }
+}
+
+void Tst_DiffEngines::testLCSAlgorithmCharByChar() {
+    const QString left = QStringLiteral("The quick brown fox\njumps over the lazy dog\n");
+    const QString right = QStringLiteral("The quick red fox\njumped over the lazy cat\n");
+    QDiffX::LCSAlgorithm lcs;
+    const QDiffX::QDiffResult result = lcs.calculateDiff(left, right, QDiffX::DiffMode::CharByChar);
+    QVERIFY(result.success());
+    QCOMPARE(result.metaData("mode").toString(), QString("char"));
+    QString rebuiltLeft, rebuiltRight;
+    for (const auto &change : result.changes()) {
+        if (change.operation != QDiffX::DiffOperation::Insert) rebuiltLeft += change.text;
+        if (change.operation != QDiffX::DiffOperation::Delete) rebuiltRight += change.text;
+    }
+    QCOMPARE(rebuiltLeft, left);
+    QCOMPARE(rebuiltRight, right);
+}
+
+void Tst_DiffEngines::testLCSAlgorithmRegistered() {
+    QDiffX::QAlgorithmRegistry &registry = QDiffX::QAlgorithmRegistry::get_Instance();
+    QVERIFY(registry.isAlgorithmAvailable("lcs"));
+    QVERIFY(registry.getAlgorithmCapabilities("lcs").supportsCharByChar);
+}
+
+void Tst_DiffEngines::testBitapLongPattern() {
+    QRandomGenerator rng(28);
+    QString text;
+    for (int i = 0; i < 5000; ++i) text.append(QChar(0x0061 + rng.bounded(26)));
+    // Longer than any machine word, with a few edits at the real location
+    QString pattern = text.mid(3000, 300);
+    pattern[10] = QChar(0x00E9);
+    pattern.remove(150, 2);
+    pattern.insert(250, QChar(0x4E00));
+
+    diff_match_patch dmp;
+    dmp.Match_Distance = 1000;
+    QCOMPARE(dmp.match_main(text, pattern, 2900), 3000);
+
+    const std::vector<int> errors = diff_bitap::startDistances(
+        units(text), int(text.length()), units(pattern), int(pattern.length()), 2990, 3010);
+    QCOMPARE(int(errors.size()), 21);
+    QCOMPARE(*std::min_element(errors.begin(), errors.end()), errors[10]);
+    QVERIFY(errors[10] <= 4);
+}
+
+void Tst_DiffEngines::testDirectoryCompare() {
+    QTemporaryDir left, right;
+    QVERIFY(left.isValid() && right.isValid());
+    auto write = [](const QString &root, const QString &path, const QByteArray &content) {
+        QDir(root).mkpath(QFileInfo(path).path());
+        QFile file(root + '/' + path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+    };
+    write(left.path(), "same.txt", "one\ntwo\n");
+    write(right.path(), "same.txt", "one\ntwo\n");
+    write(left.path(), "nested/deeper/resized.txt", "short\n");
+    write(right.path(), "nested/deeper/resized.txt", "much longer\n");
+    write(left.path(), "nested/samesize.txt", "abc\n");
+    write(right.path(), "nested/samesize.txt", "abd\n");
+    write(left.path(), "empty.txt", "");
+    write(right.path(), "empty.txt", "");
+    write(left.path(), "gone.txt", "x\n");
+    write(right.path(), "new.txt", "y\n");
+
+    const QDiffX::QDirectoryCompareResult result = QDiffX::QDirectoryCompareEngine().compare(left.path(), right.path());
+    QVERIFY(result.success());
+    QCOMPARE(result.entries().size(), 6);
+    QCOMPARE(result.count(QDiffX::QFileCompareStatus::Unchanged), 2);
+    QCOMPARE(result.count(QDiffX::QFileCompareStatus::Modified), 2);
+    QCOMPARE(result.count(QDiffX::QFileCompareStatus::Added), 1);
+    QCOMPARE(result.count(QDiffX::QFileCompareStatus::Removed), 1);
+    // Only the same-size non-empty pairs are fingerprinted
+    QCOMPARE(result.hashedPairCount(), 2);
+
+    QStringList paths;
+    for (const QDiffX::QFileCompareEntry &entry : result.entries()) {
+        paths.append(entry.relativePath);
+        if (entry.relativePath == "nested/samesize.txt")
+            QCOMPARE(entry.status, QDiffX::QFileCompareStatus::Modified);
+        if (entry.relativePath == "same.txt")
+            QVERIFY(entry.hasLineStats());
+    }
+    QStringList sorted = paths;
+    sorted.sort();
+    QCOMPARE(paths, sorted);
+
+    QVERIFY(!QDiffX::QDirectoryCompareEngine().compare(left.path() + "/missing", right.path()).success());
+}
+
+void Tst_DiffEngines::testMemoryBudgetDegrades() {
+    // Every line differs, so dtl's O(NP) path coordinates dwarf lcs's bounded traceback
+    QString left, right;
+    for (int line = 0; line < 2000; ++line) {
+        left += QString("left line %1\n").arg(line);
+        right += QString("right line %1\n").arg(line);
+    }
+    const QDiffX::QDiffShape shape = QDiffX::QDiffMemoryBudget::measure(left, right);
+    QCOMPARE(shape.leftLines, 2000);
+    QVERIFY(shape.estimatedEditLines >= 3900);
+    const qint64 dtlEstimate = QDiffX::QDiffMemoryBudget::estimate("dtl", QDiffX::DiffMode::LineByLine, shape);
+    const qint64 lcsEstimate = QDiffX::QDiffMemoryBudget::estimate("lcs", QDiffX::DiffMode::LineByLine, shape);
+    QVERIFY(dtlEstimate > 4 * lcsEstimate);
+
+    QDiffX::QAlgorithmManager manager;
+    manager.setMemoryBudget(2 * lcsEstimate);
+    QDiffX::QDiffResult result = manager.calculateDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QVERIFY(result.success());
+    QCOMPARE(result.metaData("degradation").toString(), QString("linear_memory"));
+    QCOMPARE(result.metaData("requested_algorithm").toString(), QString("dtl"));
+    QVERIFY(result.metaData("memory_charged").toLongLong() <= 2 * lcsEstimate);
+    QVERIFY(result.changes().size() >= 4000);
+
+    // Without a budget the requested engine runs as usual
+    manager.setMemoryBudget(0);
+    result = manager.calculateDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QVERIFY(result.success());
+    QVERIFY(!result.allMetaData().contains("degradation"));
+
+    // Charges stop the diff once a scope's limit is spent, whatever the estimate said
+    {
+        QDiffX::QDiffMemoryBudget::Scope scope(1024);
+        QVERIFY(QDiffX::QDiffMemoryBudget::charge(1000));
+        QVERIFY(!QDiffX::QDiffMemoryBudget::charge(100));
+        QVERIFY(scope.exceeded());
+        QVERIFY_THROWS_EXCEPTION(std::bad_alloc, QDiffX::QDiffMemoryBudget::require(1));
+    }
+    QVERIFY(QDiffX::QDiffMemoryBudget::charge(qint64(1) << 40));
+
+    // dtl charges its worst case before composing the edit graph, not after
+    {
+        QDiffX::QDiffMemoryBudget::Scope scope(1024 * 1024);
+        QVERIFY(!QDiffX::DTLAlgorithm().calculateDiff(left, right, QDiffX::DiffMode::LineByLine).success());
+        QVERIFY(scope.exceeded());
+        QCOMPARE(scope.chargeCount(), 2);   // The split lines, then the refused edit graph
+    }
+
+    manager.setMemoryBudget(1);
+    result = manager.calculateDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QVERIFY(!result.success());
+    QCOMPARE(manager.lastError(), QDiffX::QAlgorithmManagerError::MemoryBudgetExceeded);
+}
+
+void Tst_DiffEngines::testRacingSelection() {
+    QString left, right;
+    for (int line = 0; line < 3000; ++line) {
+        left += QString("shared line %1\n").arg(line);
+        right += QString(line % 50 == 0 ? "edited line %1\n" : "shared line %1\n").arg(line);
+    }
+
+    // A cancelled diff is abandoned, not returned half done
+    std::atomic_bool cancelled{true};
+    {
+        QDiffX::QDiffCancellation::Scope scope(&cancelled);
+        QVERIFY(!QDiffX::DTLAlgorithm().calculateDiff(left, right, QDiffX::DiffMode::LineByLine).success());
+        QVERIFY(!QDiffX::DMPAlgorithm().calculateDiff(left, right, QDiffX::DiffMode::LineByLine).success());
+    }
+    QVERIFY(!QDiffX::QDiffCancellation::isCancelled());
+
+    QDiffX::QAlgorithmManager manager;
+    for (int race = 0; race < QDiffX::QDiffRaceEngine::MIN_LEARNED_RACES + 1; ++race) {
+        const QDiffX::QDiffResult result = manager.calculateDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Racing);
+        QVERIFY(result.success());
+        const QString winner = result.metaData("race_winner").toString();
+        QVERIFY(winner == "dtl" || winner == "dmp");
+        QVERIFY(result.metaData("race_loser").toString() != winner);
+        QVERIFY(!result.changes().isEmpty());
+    }
+    QVERIFY(manager.raceEngine()->hasRecords());
+
+    // Auto selection follows a consistent winner for inputs shaped like these.
+    // Which engine wins a real race depends on the machine, so the records are made here.
+    QDiffX::QDiffRaceEngine *engine = manager.raceEngine();
+    const QDiffX::QDiffShape shape = QDiffX::QDiffMemoryBudget::measure(left, right);
+    engine->clearRecords();
+    for (int race = 0; race < QDiffX::QDiffRaceEngine::MIN_LEARNED_RACES - 1; ++race)
+        engine->record(shape, "dmp");
+    QCOMPARE(engine->learnedWinner(shape), QString());     // Too few races
+    engine->record(shape, "dmp");
+    engine->record(shape, "dtl");
+    QCOMPARE(engine->learnedWinner(shape), QString("dmp"));
+    QCOMPARE(manager.selectAlgorithm(left, right, QDiffX::DiffMode::LineByLine), QString("dmp"));
+    engine->record(shape, "dtl");
+    QCOMPARE(engine->learnedWinner(shape), QString());     // No longer consistent
+    QCOMPARE(manager.selectAlgorithm(left, right, QDiffX::DiffMode::LineByLine), QString("dtl"));
+    manager.resetManager();
+    QVERIFY(!manager.raceEngine()->hasRecords());
+}
+
+void Tst_DiffEngines::testPhaseMetadata() {
+    const QString left = "one\ntwo\nthree\nfour\n";
+    const QString right = "one\n2\nthree\nfour\nfive\n";
+
+    QDiffX::QAlgorithmManager manager;
+    // Inputs this small would take the unprofiled fast path
+    manager.setTinyDiffThreshold(0);
+    for (const QString &algorithm : {QString("dtl"), QString("dmp"), QString("lcs")}) {
+        const QDiffX::QDiffResult result = manager.calculateDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, algorithm);
+        QVERIFY2(result.success(), qPrintable(algorithm));
+        QCOMPARE(result.metaData("algorithm_id").toString(), algorithm);
+        const QMap<QString, QVariant> phases = result.metaData("phase_ns").toMap();
+        QVERIFY2(phases.contains("engine") && phases.contains("convert"), qPrintable(algorithm));
+        qint64 phaseTotal = 0;
+        for (const QVariant &nanoseconds : phases)
+            phaseTotal += nanoseconds.toLongLong();
+        QVERIFY(phaseTotal <= result.metaData("total_ns").toLongLong());
+        QCOMPARE(result.metaData("left_lines").toInt(), 4);
+        QCOMPARE(result.metaData("right_lines").toInt(), 5);
+        QCOMPARE(result.metaData("edit_distance").toInt(), 3);
+        QVERIFY(result.metaData("allocation_count").toInt() > 0);
+        QVERIFY(result.metaData("peak_memory_estimate").toLongLong() > 0);
+    }
+
+    for (int i = 0; i < 99; ++i)
+        manager.calculateDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    const QDiffX::QDiffLatencySummary total = manager.statistics()->summary("dtl");
+    QCOMPARE(total.count, 100);
+    QVERIFY(total.p50Ns > 0);
+    QVERIFY(total.p50Ns <= total.p95Ns && total.p95Ns <= total.p99Ns);
+    QCOMPARE(manager.statistics()->summary("dtl", "engine").count, 100);
+    QVERIFY(manager.statistics()->algorithms().contains("lcs"));
+
+    // Side-by-side splitting is a phase of its own
+    const QDiffX::QSideBySideDiffResult sideBySide = manager.calculateSideBySideDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QVERIFY(sideBySide.leftSide.metaData("phase_ns").toMap().contains("side_by_side"));
+    QCOMPARE(manager.statistics()->summary("dtl", "side_by_side").count, 1);
+
+    // The window keeps only the latest samples
+    QDiffX::QDiffStatistics statistics;
+    for (int i = 1; i <= QDiffX::QDiffStatistics::WINDOW + 100; ++i)
+        statistics.record("x", "total", i);
+    const QDiffX::QDiffLatencySummary window = statistics.summary("x");
+    QCOMPARE(window.count, QDiffX::QDiffStatistics::WINDOW);
+    QCOMPARE(window.p99Ns, qint64(QDiffX::QDiffStatistics::WINDOW + 100 - 10));
+}
+
+void Tst_DiffEngines::testChromeTraceExport() {
+    // Outside a capture nothing is recorded
+    { QDiffX::QDiffTrace::Scope ignored("test", "before"); }
+
+    QDiffX::QDiffTrace::start();
+    { QDiffX::QDiffTrace::Scope outer("test", "main"); }
+    std::thread worker([]() {
+        for (int i = 0; i < 5000; ++i)
+            QDiffX::QDiffTrace::Scope scope("test", "worker");
+    });
+    worker.join();
+    QDiffX::QDiffTrace::stop();
+    { QDiffX::QDiffTrace::Scope ignored("test", "after"); }
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(QDiffX::QDiffTrace::writeChromeTrace(&buffer));
+    QJsonParseError error;
+    const QJsonDocument trace = QJsonDocument::fromJson(buffer.data(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+
+    QHash<QString, int> counts;
+    QSet<int> threads;
+    for (const QJsonValue &value : trace.object().value("traceEvents").toArray()) {
+        const QJsonObject event = value.toObject();
+        if (event.value("ph").toString() != "X")
+            continue;
+        QCOMPARE(event.value("cat").toString(), QString("test"));
+        QVERIFY(event.value("dur").toDouble() >= 0);
+        ++counts[event.value("name").toString()];
+        threads.insert(event.value("tid").toInt());
+    }
+    QCOMPARE(counts.value("main"), 1);
+    QCOMPARE(counts.value("worker"), 5000);
+    QVERIFY(!counts.contains("before") && !counts.contains("after"));
+    QCOMPARE(threads.size(), 2);
+
+    // A new capture drops the previous one
+    QDiffX::QDiffTrace::start();
+    QDiffX::QDiffTrace::stop();
+    buffer.close();
+    buffer.setData(QByteArray());
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(QDiffX::QDiffTrace::writeChromeTrace(&buffer));
+    QVERIFY(QJsonDocument::fromJson(buffer.data()).object().value("traceEvents").toArray().isEmpty());
+}
+
+void Tst_DiffEngines::testTinyDiffFastPath() {
+    const QString left = "one\ntwo\nthree\n";
+    const QString right = "one\n2\nthree\n";
+
+    QDiffX::QAlgorithmManager manager;
+    const QDiffX::QDiffResult fast = manager.calculateDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QVERIFY(fast.success());
+    QCOMPARE(fast.metaData("algorithm_id").toString(), QString("dtl"));
+    QVERIFY(!fast.allMetaData().contains("phase_ns"));
+    QCOMPARE(manager.statistics()->summary("dtl").count, 0);
+
+    manager.setTinyDiffThreshold(0);
+    const QDiffX::QDiffResult full = manager.calculateDiffSync(left, right, QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QVERIFY(full.allMetaData().contains("phase_ns"));
+    QCOMPARE(fast.changes().size(), full.changes().size());
+    for (int i = 0; i < fast.changes().size(); ++i) {
+        QCOMPARE(fast.changes()[i].operation, full.changes()[i].operation);
+        QCOMPARE(fast.changes()[i].text, full.changes()[i].text);
+    }
+    manager.resetManager();
+    QCOMPARE(manager.tinyDiffThreshold(), int(QDiffX::QAlgorithmManager::DEFAULT_TINY_DIFF_THRESHOLD));
+
+    // Connected signals still fire
+    QSignalSpy started(&manager, &QDiffX::QAlgorithmManager::calculationStarted);
+    QSignalSpy finished(&manager, &QDiffX::QAlgorithmManager::calculationFinished);
+    manager.calculateDiffSync(left, right);
+    QCOMPARE(started.count(), 1);
+    QCOMPARE(finished.count(), 1);
+
+    // Asynchronous callers get a future that is already done
+    QFuture<QDiffX::QDiffResult> future = manager.calculateDiffAsync(left, right);
+    QVERIFY(future.isFinished());
+    QVERIFY(future.result().success());
+}
+
+void Tst_DiffEngines::testTaskPoolPriorities() {
+    QMutex mutex;
+    QStringList order;
+    auto task = [&](const QString &name) {
+        return [&, name]() {
+            QMutexLocker locker(&mutex);
+            order.append(name);
+            return name;
+        };
+    };
+
+    {
+        QDiffX::QDiffTaskPool pool;
+        pool.setMaxThreadCount(1);
+        pool.setAgingInterval(0);
+        QSemaphore release;
+        pool.run(QDiffX::QDiffPriority::Background, [&]() { release.acquire(); return 0; });
+        pool.run(QDiffX::QDiffPriority::Background, task("background"));
+        pool.run(QDiffX::QDiffPriority::Prefetch, task("prefetch"));
+        QFuture<QString> interactive = pool.run(QDiffX::QDiffPriority::Interactive, task("interactive"));
+        QCOMPARE(pool.metrics(QDiffX::QDiffPriority::Background).queueDepth, 1);
+        release.release();
+        QVERIFY(pool.waitForDone(30000));
+        QCOMPARE(interactive.result(), QString("interactive"));
+        QCOMPARE(order, QStringList({"interactive", "prefetch", "background"}));
+
+        const QDiffX::QDiffPoolMetrics background = pool.metrics(QDiffX::QDiffPriority::Background);
+        QCOMPARE(background.started, qint64(2));
+        QCOMPARE(background.queueDepth, 0);
+        QCOMPARE(background.running, 0);
+        QCOMPARE(background.wait.count, 2);
+    }
+
+    {
+        // A task that waited long enough overtakes higher classes, on a clock the test moves
+        order.clear();
+        std::atomic<qint64> now{0};
+        QDiffX::QDiffTaskPool pool;
+        pool.setClock([&now]() { return now.load(); });
+        pool.setMaxThreadCount(1);
+        pool.setAgingInterval(10);
+        QSemaphore release;
+        pool.run(QDiffX::QDiffPriority::Interactive, [&]() { release.acquire(); return 0; });
+        pool.run(QDiffX::QDiffPriority::Background, task("background"));
+        now = 20 * 1000000;     // Two aging intervals: background ranks as interactive
+        pool.run(QDiffX::QDiffPriority::Interactive, task("interactive"));
+        release.release();
+        QVERIFY(pool.waitForDone(30000));
+        // Equal ranks go to the longer wait
+        QCOMPARE(order, QStringList({"background", "interactive"}));
+        const QDiffX::QDiffPoolMetrics background = pool.metrics(QDiffX::QDiffPriority::Background);
+        QCOMPARE(background.promoted, qint64(1));
+        QCOMPARE(background.wait.count, 1);
+        QCOMPARE(background.wait.p50Ns, qint64(20 * 1000000));
+    }
+
+    {
+        // Classes never exceed their cap
+        QDiffX::QDiffTaskPool pool;
+        pool.setMaxThreadCount(4);
+        pool.setConcurrencyCap(QDiffX::QDiffPriority::Background, 1);
+        std::atomic_int running{0};
+        std::atomic_int peak{0};
+        for (int i = 0; i < 6; ++i) {
+            pool.run(QDiffX::QDiffPriority::Background, [&]() {
+                const int now = ++running;
+                int previous = peak.load();
+                while (now > previous && !peak.compare_exchange_weak(previous, now)) {}
+                QThread::msleep(5);
+                return --running;
+            });
+        }
+        QVERIFY(pool.waitForDone(30000));
+        QCOMPARE(peak.load(), 1);
+    }
+
+    // Destroying a pool cancels what it has not started
+    QSemaphore release;
+    QFuture<int> dropped;
+    {
+        QDiffX::QDiffTaskPool pool;
+        pool.setMaxThreadCount(1);
+        pool.run(QDiffX::QDiffPriority::Interactive, [&]() { release.acquire(); return 0; });
+        dropped = pool.run(QDiffX::QDiffPriority::Background, []() { return 1; });
+        release.release();
+    }
+    QVERIFY(dropped.isFinished());
+}
+
+void Tst_DiffEngines::testChangeHistogram() {
+    using QDiffX::DiffOperation;
+    QList<DiffOperation> lines(10000, DiffOperation::Equal);
+    for (int i = 100; i < 110; ++i)
+        lines[i] = DiffOperation::Insert;
+    lines[5000] = DiffOperation::Delete;
+    lines[9999] = DiffOperation::Replace;
+
+    const QDiffX::QDiffChangeHistogram histogram(lines);
+    QCOMPARE(histogram.lineCount(), 10000);
+
+    // Short ranges are counted line by line
+    QCOMPARE(histogram.count(100, 110).inserted, 10);
+    QCOMPARE(histogram.count(95, 105).inserted, 5);
+    QCOMPARE(histogram.count(110, 200).changed(), 0);
+    QCOMPARE(histogram.count(9990, 20000).replaced, 1);
+
+    // Long ranges are read from the coarser levels
+    const QDiffX::QDiffChangeHistogram::Counts total = histogram.count(0, 10000);
+    QCOMPARE(total.inserted, 10);
+    QCOMPARE(total.deleted, 1);
+    QCOMPARE(total.replaced, 1);
+    QCOMPARE(histogram.count(4000, 6000).deleted, 1);
+    QCOMPARE(histogram.count(2048, 4096).changed(), 0);
+
+    QVERIFY(QDiffX::QDiffChangeHistogram().isEmpty());
+    QCOMPARE(QDiffX::QDiffChangeHistogram().count(0, 10).changed(), 0);
+}
+
+void Tst_DiffEngines::testHunkIndex() {
+    using QDiffX::DiffChange;
+    using QDiffX::DiffOperation;
+    using Side = QDiffX::QDiffHunkIndex::Side;
+    // Left a b c d, right a b x y d z
+    const QList<DiffChange> changes = {
+        DiffChange(DiffOperation::Equal, "a\nb\n"),
+        DiffChange(DiffOperation::Delete, "c\n"),
+        DiffChange(DiffOperation::Insert, "x\ny\n"),
+        DiffChange(DiffOperation::Equal, "d\n"),
+        DiffChange(DiffOperation::Insert, "z\n"),
+    };
+    const QDiffX::QDiffHunkIndex index(changes);
+    QCOMPARE(index.hunkCount(), 2);
+    QCOMPARE(index.hunk(0).leftStart, 2);
+    QCOMPARE(index.hunk(0).leftCount, 1);
+    QCOMPARE(index.hunk(0).rightStart, 2);
+    QCOMPARE(index.hunk(0).rightCount, 2);
+    QCOMPARE(index.hunk(1).leftStart, 4);
+    QCOMPARE(index.hunk(1).leftCount, 0);
+    QCOMPARE(index.hunk(1).rightStart, 5);
+
+    QCOMPARE(index.hunkAt(Side::Left, 2), 0);
+    QCOMPARE(index.hunkAt(Side::Left, 3), -1);
+    QCOMPARE(index.hunkAt(Side::Right, 3), 0);
+    QCOMPARE(index.hunkAt(Side::Right, 5), 1);
+
+    QCOMPARE(index.nextHunk(Side::Left, 0), 0);
+    QCOMPARE(index.nextHunk(Side::Left, 2), 1);
+    QCOMPARE(index.nextHunk(Side::Left, 4), -1);
+    QCOMPARE(index.previousHunk(Side::Right, 5), 0);
+    QCOMPARE(index.previousHunk(Side::Right, 2), -1);
+
+    QCOMPARE(index.mapLine(Side::Left, 1), 1);
+    QCOMPARE(index.mapLine(Side::Left, 2), 2);
+    QCOMPARE(index.mapLine(Side::Left, 3), 4);
+    QCOMPARE(index.mapLine(Side::Right, 3), 2);
+    QCOMPARE(index.mapLine(Side::Right, 4), 3);
+    QCOMPARE(index.mapLine(Side::Right, 5), 4);
+
+    // Results of the manager carry their index
+    QDiffX::QAlgorithmManager manager;
+    const QDiffX::QDiffResult result = manager.calculateDiffSync("a\nb\nc\nd\n", "a\nb\nx\ny\nd\nz\n",
+                                                                 QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QVERIFY(result.success());
+    QVERIFY(result.hunkIndex());
+    QCOMPARE(result.hunkIndex()->hunkCount(), 2);
+    QCOMPARE(result.hunkIndex()->hunk(0).leftStart, 2);
+    QCOMPARE(result.hunkIndex()->hunk(0).rightCount, 2);
+    QCOMPARE(result.hunkIndex()->hunk(1).rightStart, 5);
+
+    // DTL gives blank lines as empty changes, they still count as lines
+    const QDiffX::QDiffResult blank = manager.calculateDiffSync("a\n\nb\n\nc\n", "a\n\nx\n\nc\nz\n",
+                                                                QDiffX::QAlgorithmSelectionMode::Manual, "dtl");
+    QVERIFY(blank.success());
+    QVERIFY(blank.metaData("line_separated").toBool());
+    QVERIFY(blank.hunkIndex());
+    QCOMPARE(blank.hunkIndex()->hunkCount(), 2);
+    QCOMPARE(blank.hunkIndex()->hunk(0).leftStart, 2);
+    QCOMPARE(blank.hunkIndex()->hunk(0).leftCount, 1);
+    QCOMPARE(blank.hunkIndex()->hunk(0).rightStart, 2);
+    QCOMPARE(blank.hunkIndex()->hunk(0).rightCount, 1);
+    QCOMPARE(blank.hunkIndex()->hunk(1).leftStart, 5);
+    QCOMPARE(blank.hunkIndex()->hunk(1).leftCount, 0);
+    QCOMPARE(blank.hunkIndex()->hunk(1).rightStart, 5);
+    QCOMPARE(blank.hunkIndex()->hunk(1).rightCount, 1);
+    QCOMPARE(blank.hunkIndex()->hunkAt(Side::Left, 2), 0);
+    QCOMPARE(blank.hunkIndex()->mapLine(Side::Left, 4), 4);
+}
+
+void Tst_DiffEngines::testCliUnifiedWriter() {
+    using QDiffX::DiffChange;
+    using QDiffX::DiffOperation;
+    auto unified = [](const QList<DiffChange> &changes, int contextLines) {
+        QDiffX::QDiffResult result;
+        result.setChanges(changes);
+        result.setSuccess(true);
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QDiffX::QDiffCliWriter writer(&buffer, QDiffX::QDiffCliFormat::Unified, contextLines);
+        writer.begin();
+        writer.writePair(0, "left", "right", result);
+        writer.end();
+        return QString::fromUtf8(buffer.data());
+    };
+
+    // Chunks that edit inside a line turn the whole line into -/+ (expected outputs are GNU diff's)
+    QCOMPARE(unified({DiffChange(DiffOperation::Equal, "a\nb\nhello "),
+                      DiffChange(DiffOperation::Insert, "there "),
+                      DiffChange(DiffOperation::Equal, "world\nc\nd\n")}, 1),
+             QString("--- left\n+++ right\n"
+                     "@@ -2,3 +2,3 @@\n b\n-hello world\n+hello there world\n c\n"));
+    QCOMPARE(unified({DiffChange(DiffOperation::Equal, "one\nhel"),
+                      DiffChange(DiffOperation::Delete, "lo"),
+                      DiffChange(DiffOperation::Insert, "p"),
+                      DiffChange(DiffOperation::Equal, " world\ntwo\n")}, 3),
+             QString("--- left\n+++ right\n"
+                     "@@ -1,3 +1,3 @@\n one\n-hello world\n+help world\n two\n"));
+
+    // A missing newline at the end of one side
+    QCOMPARE(unified({DiffChange(DiffOperation::Equal, "x\ny"),
+                      DiffChange(DiffOperation::Delete, "\n")}, 3),
+             QString("--- left\n+++ right\n"
+                     "@@ -1,2 +1,2 @@\n x\n-y\n+y\n\\ No newline at end of file\n"));
+    QCOMPARE(unified({DiffChange(DiffOperation::Equal, "x\ny"),
+                      DiffChange(DiffOperation::Insert, "\nz\n")}, 3),
+             QString("--- left\n+++ right\n"
+                     "@@ -1,2 +1,3 @@\n x\n-y\n\\ No newline at end of file\n+y\n+z\n"));
+
+    // Changes 2 * U + 1 lines apart share a hunk, one line further they do not
+    QCOMPARE(unified({DiffChange(DiffOperation::Equal, "l1\n"),
+                      DiffChange(DiffOperation::Delete, "l2\n"),
+                      DiffChange(DiffOperation::Insert, "L2\n"),
+                      DiffChange(DiffOperation::Equal, "l3\nl4\n"),
+                      DiffChange(DiffOperation::Delete, "l5\n"),
+                      DiffChange(DiffOperation::Insert, "L5\n"),
+                      DiffChange(DiffOperation::Equal, "l6\nl7\n")}, 1),
+             QString("--- left\n+++ right\n"
+                     "@@ -1,6 +1,6 @@\n l1\n-l2\n+L2\n l3\n l4\n-l5\n+L5\n l6\n"));
+    QCOMPARE(unified({DiffChange(DiffOperation::Equal, "l1\n"),
+                      DiffChange(DiffOperation::Delete, "l2\n"),
+                      DiffChange(DiffOperation::Insert, "L2\n"),
+                      DiffChange(DiffOperation::Equal, "l3\nl4\nl5\n"),
+                      DiffChange(DiffOperation::Delete, "l6\n"),
+                      DiffChange(DiffOperation::Insert, "L6\n"),
+                      DiffChange(DiffOperation::Equal, "l7\nl8\n")}, 1),
+             QString("--- left\n+++ right\n"
+                     "@@ -1,3 +1,3 @@\n l1\n-l2\n+L2\n l3\n"
+                     "@@ -5,3 +5,3 @@\n l5\n-l6\n+L6\n l7\n"));
+}
+
+QTEST_APPLESS_MAIN(Tst_DiffEngines)
+#include "tst_diff_engines.moc"